@@ -62,11 +62,20 @@ namespace MediaCore
         virtual void ChangeStartOffset(int64_t startOffset) = 0;
         virtual void ChangeEndOffset(int64_t endOffset) = 0;
         virtual void SeekTo(int64_t pos) = 0;
+        virtual void NotifyReadPos(int64_t pos) = 0;
         virtual ImGui::ImMat ReadAudioSamples(uint32_t& readSamples, bool& eof) = 0;
         virtual void SetDirection(bool forward) = 0;
         virtual void SetFilter(AudioFilter::Holder filter) = 0;
         virtual AudioFilter::Holder GetFilter() const = 0;
 
+        // If true, the audio clips open their readers only when the read position comes near, and release them when it goes far away
+        static MEDIACORE_API bool LAZY_READER;
+        // Memory budget in bytes of the process-wide cache of decoded and resampled pcm blocks. It's shared by all the
+        // audio clips, so the clips of the same source don't decode it again. 0 disables the cache. It's enabled by
+        // default with 64MB, and then all the forward reads of the clips go through the cache block by block, the
+        // backward reads always go to the clip readers.
+        static MEDIACORE_API void SetSharedPcmCacheSize(uint64_t size);
+        static MEDIACORE_API uint64_t GetSharedPcmCacheSize();
         friend std::ostream& operator<<(std::ostream& os, Holder hClip);
     };
 
@@ -28,7 +28,16 @@ namespace MediaCore
     struct AudioEffectFilter
     {
         using Holder = std::shared_ptr<AudioEffectFilter>;
-        static MEDIACORE_API Holder CreateInstance(const std::string& loggerName = "");
+
+        // Implementation of the filters. 'BACKEND_FFMPEG' runs them in an FFmpeg filter-graph. 'BACKEND_NATIVE' processes
+        // 'flt' and 'fltp' frames in place. Its limiter differs from 'alimiter': it has no lookahead, so the peaks shorter
+        // than the attack time are hard clipped at the limit, and it has no auto level, so the output isn't scaled by 1/limit.
+        enum Backend
+        {
+            BACKEND_FFMPEG = 0,
+            BACKEND_NATIVE,
+        };
+        static MEDIACORE_API Holder CreateInstance(const std::string& loggerName = "", Backend backend = BACKEND_FFMPEG);
         static MEDIACORE_API Logger::ALogger* GetLogger();
 
         static MEDIACORE_API const uint32_t VOLUME;
@@ -42,9 +51,20 @@ namespace MediaCore
         virtual bool ProcessData(const ImGui::ImMat& in, std::list<ImGui::ImMat>& out) = 0;
         virtual bool HasFilter(uint32_t composeFlags) const = 0;
 
+        // Shape of the transition when 'VolumeParams' or 'PanParams' changes. The ramps are applied per sample
+        // on 'flt' and 'fltp' frames, with other sample formats the FFmpeg backend changes them at the frame boundary.
+        enum RampCurve
+        {
+            RAMP_LINEAR = 0,
+            RAMP_EXPONENTIAL,
+        };
+
         struct VolumeParams
         {
             float volume{1.f};
+            // Length of the ramp from the current value to this one, in samples. 0 means an immediate change.
+            uint32_t rampSamples{0};
+            RampCurve rampCurve{RAMP_LINEAR};
         };
         virtual bool SetVolumeParams(VolumeParams* params) = 0;
         virtual VolumeParams GetVolumeParams() const = 0;
@@ -53,6 +73,8 @@ namespace MediaCore
         {
             float x{0.5f};
             float y{0.5f};
+            uint32_t rampSamples{0};
+            RampCurve rampCurve{RAMP_LINEAR};
         };
         virtual bool SetPanParams(PanParams* params) = 0;
         virtual PanParams GetPanParams() const = 0;
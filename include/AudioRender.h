@@ -24,6 +24,8 @@ namespace MediaCore
 {
 struct AudioRender
 {
+    virtual ~AudioRender() {}
+
     enum class PcmFormat
     {
         UNKNOWN = 0,
@@ -39,17 +41,25 @@ struct AudioRender
     };
 
     virtual bool Initialize() = 0;
-    virtual bool OpenDevice(uint32_t sampleRate, uint32_t channels, PcmFormat format, ByteStream* pcmStream) = 0;
+    // 'bufferSamples' is the sample count the device pulls from 'pcmStream' each time, 0 means the default size.
+    // Use a small value (e.g. 128 or 256) together with the low-latency mode of the pcm source for live monitoring.
+    virtual bool OpenDevice(uint32_t sampleRate, uint32_t channels, PcmFormat format, ByteStream* pcmStream, uint32_t bufferSamples = 0) = 0;
     virtual void CloseDevice() = 0;
     virtual bool Pause() = 0;
     virtual bool Resume() = 0;
     virtual void Flush() = 0;
     virtual uint32_t GetBufferedDataSize() = 0;
+    // Time in microseconds from the last Flush() to when the first non-silent sample pulled after it gets played,
+    // -1 if there is no such sample yet. Flush right after seeking the pcm source to measure the seek-to-audible latency.
+    // The output latency of the audio driver itself is not included.
+    virtual int64_t GetFlushToAudibleLatency() const = 0;
 
     virtual std::string GetError() const = 0;
 
     static MEDIACORE_API uint8_t GetBytesPerSampleByFormat(PcmFormat format);
     static MEDIACORE_API AudioRender* CreateInstance();
+    // A render without output device, it pulls the pcm stream at the real-time pace and discards the data
+    static MEDIACORE_API AudioRender* CreateNullInstance();
     static MEDIACORE_API void ReleaseInstance(AudioRender** audrnd);
 };
 }
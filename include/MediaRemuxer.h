@@ -0,0 +1,50 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include "MediaCore.h"
+#include "MediaParser.h"
+#include "Logger.h"
+
+namespace MediaCore
+{
+struct MediaRemuxer
+{
+    using Holder = std::shared_ptr<MediaRemuxer>;
+    static MEDIACORE_API Holder CreateInstance();
+    static MEDIACORE_API Logger::ALogger* GetLogger();
+
+    // Copy the packets of the time ranges [first, second) (in millisecond) of the media opened by 'hParser' into 'url',
+    // without decoding. The ranges are joined one after another, with the timestamps rebased to be continuous.
+    // If the media has video, the range boundaries are snapped to the video seek points, the start backward and
+    // the end forward, so that every range begins with a key frame. The end is moved further if the key frame there
+    // starts an open GOP, whose leading pictures depend on it. 'streamIndices' selects the streams to copy,
+    // all the streams are copied if it's empty. An empty 'ranges' means the whole media.
+    // This call blocks until the remuxing is done or canceled.
+    virtual bool Remux(MediaParser::Holder hParser, const std::string& url,
+            const std::vector<std::pair<int64_t, int64_t>>& ranges, const std::vector<int>& streamIndices = {}) = 0;
+    virtual void Cancel() = 0;
+    virtual float GetProgress() const = 0;
+
+    virtual std::string GetError() const = 0;
+};
+}
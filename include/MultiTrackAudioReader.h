@@ -50,6 +50,17 @@ struct MultiTrackAudioReader
     virtual void UpdateDuration() = 0;
     virtual bool Refresh() = 0;
     virtual int64_t SizeToDuration(uint32_t sizeInByte) = 0;
+    // In offline mode, the mixing thread mixes up to 'lookAheadFrames' frames ahead and blocks while the output queue
+    // is full, and the reading calls block until the next frame is mixed, without any polling sleep. It is meant for
+    // exporting, where throughput matters more than latency. Probe-mode seeking is disabled in this mode.
+    virtual bool SetOfflineMode(bool enable, uint32_t lookAheadFrames = 64) = 0;
+    virtual bool IsOfflineMode() const = 0;
+    // In low-latency mode, the output queue holds at most 'maxQueuedFrames' frames, and the mixing thread is woken up
+    // as soon as a frame is read out instead of polling, so that with a small 'outSamplesPerFrame' (e.g. 128 or 256)
+    // the mixed samples reach the audio render with little delay. It is meant for live monitoring and scrubbing,
+    // and can't be enabled together with the offline mode.
+    virtual bool SetLowLatencyMode(bool enable, uint32_t maxQueuedFrames = 2) = 0;
+    virtual bool IsLowLatencyMode() const = 0;
 
     virtual int64_t Duration() const = 0;
     virtual int64_t ReadPos() const = 0;
@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MediaCore.h"
+#include "MediaEncoder.h"
+#include "MultiTrackVideoReader.h"
+#include "MultiTrackAudioReader.h"
+#include "Logger.h"
+
+namespace MediaCore
+{
+struct MultiTrackExporter
+{
+    using Holder = std::shared_ptr<MultiTrackExporter>;
+    static MEDIACORE_API Holder CreateInstance();
+    static MEDIACORE_API Logger::ALogger* GetLogger();
+
+    struct VideoSettings
+    {
+        std::string codecName;
+        uint32_t width{0};
+        uint32_t height{0};
+        Ratio frameRate;
+        uint64_t bitRate{0};
+        // key frame interval in frames, the segment boundaries are aligned to it
+        uint32_t gopSize{250};
+        std::vector<MediaEncoder::Option> extraOpts;
+    };
+
+    struct AudioSettings
+    {
+        std::string codecName;
+        uint32_t channels{0};
+        uint32_t sampleRate{0};
+        uint64_t bitRate{0};
+    };
+
+    // Export the time range [start, end) (in millisecond) of the timeline to 'url'. The video is split into 'segmentCount'
+    // segments aligned to the GOP size, each of them is rendered by a clone of 'hVidReader' and encoded by its own encoder
+    // in parallel. The audio is rendered and encoded in one pass to keep it continuous, then the segments and the audio
+    // are concatenated into the output file by packet remuxing. Either reader can be null. If 'segmentCount' is 0,
+    // it's decided by the number of CPU cores. This call blocks until the export is done or canceled.
+    virtual bool Export(const std::string& url,
+            MultiTrackVideoReader::Holder hVidReader, const VideoSettings& vidSettings,
+            MultiTrackAudioReader::Holder hAudReader, const AudioSettings& audSettings,
+            int64_t start, int64_t end, uint32_t segmentCount = 0) = 0;
+    virtual void Cancel() = 0;
+    virtual float GetProgress() const = 0;
+    // In smart render mode, the spans of the timeline whose output is exactly the frames of one video clip, without
+    // filter, transform, transition, subtitle or any other visible layer, and whose source stream matches the output
+    // codec, size, frame rate, aspect ratio and colour properties, are stream copied from the source file by whole GOPs.
+    // Only H.264 and HEVC are copied, with the parameter sets sent in-band, and a copied span only ends at a closed GOP.
+    // Only the parts around the cut points and the other spans go through the rendering and encoding pipeline.
+    virtual void EnableSmartRender(bool enable) = 0;
+    virtual bool IsSmartRenderEnabled() const = 0;
+
+    virtual std::string GetError() const = 0;
+};
+}
@@ -20,6 +20,7 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
 #include "immat.h"
 #include "MediaCore.h"
 #include "VideoTrack.h"
@@ -28,6 +29,16 @@
 
 namespace MediaCore
 {
+struct VideoRenderCacheOptions
+{
+    uint64_t memoryBudget{1024ULL*1024*1024};
+    // compress the frames in the RAM tier with a lossless codec
+    bool compress{false};
+    // path of the spill file for the frames evicted from the RAM tier, no disk tier if it's empty
+    std::string spillPath;
+    uint64_t diskBudget{0};
+};
+
 struct MultiTrackVideoReader
 {
     using Holder = std::shared_ptr<MultiTrackVideoReader>;
@@ -52,6 +63,31 @@ struct MultiTrackVideoReader
     virtual bool ReadNextVideoFrame(ImGui::ImMat& vmat) = 0;
     virtual void UpdateDuration() = 0;
     virtual bool Refresh(bool async = false) = 0;
+    // Only regenerate the output frames in the time ranges invalidated on the tracks since the last refresh,
+    // the track readers outside these ranges keep their read positions.
+    virtual bool RefreshInvalidRanges() = 0;
+    // If enabled, the tracks under an opaque full frame are not read, only their read positions are advanced.
+    // It's disabled by default.
+    virtual void EnableOcclusionCulling(bool enable) = 0;
+    virtual bool IsOcclusionCullingEnabled() const = 0;
+    // If enabled, the post-transform frames of each track are cached within 'memoryBudget' bytes, and a track frame is only
+    // re-read after the track content at its position changes (see 'VideoTrack::GetContentHash()'). Changes that are not
+    // told by the content hash, e.g. the parameters of a filter, must be reported with 'VideoTrack::InvalidateRange()'.
+    virtual void EnableTrackFrameCache(bool enable, uint64_t memoryBudget = 512*1024*1024) = 0;
+    virtual bool IsTrackFrameCacheEnabled() const = 0;
+    // If enabled, the mixed frames are cached by a hash of the frame index and the content hashes of the visible tracks
+    // (see 'VideoTrack::GetContentHash()'), and a cached frame is output without reading the tracks. Only the mixed
+    // frame is output for a cached frame, the track frames are not included in 'ReadVideoFrameEx()'.
+    // Subtitles are not part of the cache, they are always blended at read time.
+    virtual bool EnableRenderCache(bool enable, const VideoRenderCacheOptions& options = VideoRenderCacheOptions()) = 0;
+    virtual bool IsRenderCacheEnabled() const = 0;
+    // Get the time ranges (in millisecond) whose mixed frames are rendered and still in the render cache
+    virtual void GetRenderedRanges(std::vector<std::pair<int64_t, int64_t>>& ranges) = 0;
+    // In offline mode, the mixing thread mixes up to 'lookAheadFrames' frames ahead and blocks while the output queue
+    // is full, and the reading calls block until the required frame is mixed, without any polling sleep. It is meant for
+    // exporting, where throughput matters more than latency. Non-blocking reading is handled as blocking in this mode.
+    virtual bool SetOfflineMode(bool enable, uint32_t lookAheadFrames = 16) = 0;
+    virtual bool IsOfflineMode() const = 0;
 
     virtual int64_t Duration() const = 0;
     virtual int64_t ReadPos() const = 0;
@@ -67,6 +103,7 @@ struct MultiTrackVideoReader
     virtual SubtitleTrackHolder BuildSubtitleTrackFromFile(int64_t id, const std::string& url, int64_t insertAfterId = -1) = 0;
     virtual SubtitleTrackHolder NewEmptySubtitleTrack(int64_t id, int64_t insertAfterId = -1) = 0;
     virtual SubtitleTrackHolder GetSubtitleTrackById(int64_t trackId) = 0;
+    virtual uint32_t SubtitleTrackCount() = 0;
     virtual SubtitleTrackHolder RemoveSubtitleTrackById(int64_t trackId) = 0;
     virtual bool ChangeSubtitleTrackViewOrder(int64_t targetId, int64_t insertAfterId = -1) = 0;
 
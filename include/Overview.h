@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <memory>
 #include <vector>
+#include <functional>
 #include "immat.h"
 #include "MediaParser.h"
 #include "Logger.h"
@@ -47,8 +48,62 @@ struct Overview
         std::vector<std::vector<float>> pcm;
     };
     virtual Waveform::Holder GetWaveform() const = 0;
+
+    // Loudness (ITU-R BS.1770 / EBU R128), peak and RMS analysis, which is done in the same decoding pass as
+    // the waveform. It's calculated on the same pcm data (at most 2 channels) as the waveform.
+    struct AudioAnalysis
+    {
+        using Holder = std::shared_ptr<AudioAnalysis>;
+        double integratedLoudness;              // LUFS, -inf if the audio is silent or shorter than 400ms
+        double maxShortTermLoudness;            // LUFS
+        double shortTermInterval;               // seconds between two values in 'shortTermLoudness'
+        std::vector<float> shortTermLoudness;   // LUFS of the 3s window ending at each interval
+        float samplePeak{0};                    // linear amplitude
+        float truePeak{0};                      // linear amplitude, estimated with 4x oversampling
+        std::vector<std::vector<float>> rms;    // per channel, RMS of each waveform aggregation bucket
+    };
+    // Call it before 'Open()'
+    virtual void EnableAudioAnalysis(bool enable) = 0;
+    // Return nullptr if the analysis is not enabled or not finished yet
+    virtual AudioAnalysis::Holder GetAudioAnalysis() const = 0;
+
+    // The waveform returned by 'GetWaveform()' is filled in place, only the leading samples
+    // in range [0, GetWaveformValidSampleCount()) of each channel are already generated.
+    virtual uint32_t GetWaveformValidSampleCount() const = 0;
+    // Get a consistent copy of the generated part of the waveform
+    virtual Waveform::Holder GetGeneratedWaveform() const = 0;
+    // Progressive waveform delivery. 'callback' is invoked from the waveform generating thread every time another
+    // 'bucketInterval' samples are completed, and once more when the generation is finished. 'hWaveform' holds a copy
+    // of the newly completed samples, and its first sample is at index 'startIdx' of the full waveform.
+    using WaveformCallback = std::function<void(Waveform::Holder hWaveform, uint32_t startIdx, bool isFinished)>;
+    virtual void SetWaveformCallback(WaveformCallback callback, uint32_t bucketInterval = 2048) = 0;
     virtual bool SetSingleFramePixels(uint32_t pixels) = 0;
     virtual bool SetFixedAggregateSamples(double aggregateSamples) = 0;
+    // Scene-change and motion metrics of the snapshots. Each snapshot is a decoded key frame, whose luma plane
+    // is sampled on a low resolution grid to build a histogram and a small thumbnail. All the scores are in
+    // range [0, 1] and measure the difference to the previous distinct snapshot, the first one is always 0.
+    struct SceneAnalysis
+    {
+        using Holder = std::shared_ptr<SceneAnalysis>;
+        std::vector<float> histogramDiff;       // luma histogram difference
+        std::vector<float> motionScore;         // mean absolute difference of the luma thumbnails
+        std::vector<float> sceneChangeScore;    // combination of the two above
+    };
+    // Call it before 'Open()'
+    virtual void EnableSceneAnalysis(bool enable) = 0;
+    // Return nullptr if the analysis is not enabled or the snapshots are not all generated
+    virtual SceneAnalysis::Holder GetSceneAnalysis() const = 0;
+    // Split the snapshots among 'count' independent demux & decode contexts, which run in parallel
+    virtual bool SetVideoDecoderCount(uint32_t count) = 0;
+    // Persist the waveform (and optionally the snapshots) into a versioned sidecar file, which is keyed by the
+    // media file identity (path, size, modification time) and the generation settings. On a later 'Open()' with
+    // matching keys, the cached results are loaded directly instead of being regenerated.
+    // An empty 'cacheDir' means the sidecar file is put beside the media file. Call it before 'Open()'.
+    virtual void EnableSidecarCache(bool enable, const std::string& cacheDir = "", bool cacheSnapshots = true) = 0;
+    virtual bool IsSidecarCacheEnabled() const = 0;
+    // Whether the waveform/snapshots of the currently opened media are loaded from the sidecar cache
+    virtual bool IsWaveformFromCache() const = 0;
+    virtual bool IsSnapshotsFromCache() const = 0;
 
     virtual bool IsOpened() const = 0;
     virtual bool IsDone() const = 0;
@@ -55,6 +55,15 @@ namespace Snapshot
         virtual std::string GetError() const = 0;
     };
 
+    struct CacheStatistics
+    {
+        uint64_t memoryUsage{0};
+        uint64_t memoryBudget{0};
+        uint64_t hitCount{0};
+        uint64_t missCount{0};
+        uint64_t evictionCount{0};
+    };
+
     struct Generator
     {
         using Holder = std::shared_ptr<Generator>;
@@ -73,6 +82,20 @@ namespace Snapshot
         virtual bool HasAudio() const = 0;
         virtual bool ConfigSnapWindow(double& windowSize, double frameCount, bool forceRefresh = false) = 0;
         virtual bool SetCacheFactor(double cacheFactor) = 0;
+        // Shift the cache window towards the viewer's scrolling direction, to cover 'seconds' of scrolling. 0 disables the prediction,
+        // which is the default.
+        virtual bool SetPrefetchLookAhead(double seconds) = 0;
+        // Memory budget in bytes for the snapshot images of all the viewers, 0 means no limit
+        virtual bool SetCacheMemoryBudget(uint64_t bytes) = 0;
+        virtual CacheStatistics GetCacheStatistics() const = 0;
+        // Number of independent decoder instances working on the GOP decoding tasks concurrently
+        virtual bool SetVideoDecoderCount(uint32_t count) = 0;
+        virtual uint32_t GetVideoDecoderCount() const = 0;
+        // When key-frame snap is enabled and the snapshot interval exceeds 'gopDurFactor' times the average GOP duration,
+        // each snapshot is taken from its nearest key frame, only the I-frames are decoded.
+        virtual bool EnableKeyFrameSnap(bool enable, double gopDurFactor = 2.0) = 0;
+        virtual bool IsKeyFrameSnapEnabled() const = 0;
+        virtual bool IsKeyFrameSnapActive() const = 0;
         virtual double GetMinWindowSize() const = 0;
         virtual double GetMaxWindowSize() const = 0;
 
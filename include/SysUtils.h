@@ -18,6 +18,7 @@
 #pragma once
 #include <thread>
 #include <string>
+#include <cstdint>
 #include "MediaCore.h"
 
 namespace SysUtils
@@ -27,4 +28,6 @@ MEDIACORE_API std::string ExtractFileBaseName(const std::string& path);
 MEDIACORE_API std::string ExtractFileExtName(const std::string& path);
 MEDIACORE_API std::string ExtractFileName(const std::string& path);
 MEDIACORE_API std::string ExtractDirectoryPath(const std::string& path);
+// Get the size in bytes and the last modification time (seconds since epoch) of a local file
+MEDIACORE_API bool GetFileStatus(const std::string& path, uint64_t& fileSize, int64_t& modifyTime);
 }
\ No newline at end of file
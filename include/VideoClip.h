@@ -65,6 +65,9 @@ struct VideoClip
     virtual uint32_t SrcHeight() const = 0;
     virtual uint32_t OutWidth() const = 0;
     virtual uint32_t OutHeight() const = 0;
+    // If true, the frames of this clip are known to have no transparent pixel before the transformation.
+    // The clips not telling it are taken as not opaque.
+    virtual bool IsOpaque() const { return false; }
 
     virtual void SetTrackId(int64_t trackId) = 0;
     virtual void SetStart(int64_t start) = 0;
@@ -80,6 +83,8 @@ struct VideoClip
     virtual VideoTransformFilterHolder GetTransformFilter() = 0;
 
     static MEDIACORE_API bool USE_HWACCEL;  // TODO: should find a better place for this global control parameter
+    // If true, the video clips open their readers only when the read position comes near, and release them when it goes far away
+    static MEDIACORE_API bool LAZY_READER;
     friend std::ostream& operator<<(std::ostream& os, VideoClip::Holder hClip);
 };
 
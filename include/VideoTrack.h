@@ -41,6 +41,17 @@ struct VideoTrack
     virtual void SetVisible(bool visible) = 0;
     virtual bool IsVisible() const = 0;
     virtual void ReadVideoFrame(std::vector<CorrelativeFrame>& frames, ImGui::ImMat& out) = 0;
+    // If true, the frame got by the last 'ReadVideoFrame()' call is opaque and covers the whole output frame
+    virtual bool IsReadFrameOpaque() const = 0;
+    // Mark a time range whose output should be regenerated, e.g. after changing the filter or transform of a clip.
+    // The clip edits on this track mark their affected ranges automatically.
+    virtual void InvalidateRange(int64_t start, int64_t end) = 0;
+    // Get the union of the invalidated ranges since the last call, and reset it. Returns false if there is none.
+    virtual bool TakeInvalidRange(int64_t& start, int64_t& end) = 0;
+    // Hash of everything contributing to the track output at 'pos': the clips and overlaps there with their ranges,
+    // transform parameters and key point values at 'pos', filters and transitions. The changes that can't be told from these, e.g. the parameters
+    // of a filter, are taken into account after the affected range is reported with 'InvalidateRange()'.
+    virtual uint64_t GetContentHash(int64_t pos) = 0;
     virtual void SeekTo(int64_t pos) = 0;
     virtual void SetReadFrameIndex(int64_t index) = 0;
     virtual void SkipOneFrame() = 0;
@@ -89,6 +89,10 @@ namespace MediaCore
         virtual float GetCropMarginBScale() const = 0;
         // 
 
+        // Calculate the rectangle on the output frame covered by the transformed image, with the current parameters.
+        // Returns false if the rectangle can't be determined, e.g. no input is processed yet, or the image is rotated.
+        virtual bool CalcOutputRect(int32_t& x, int32_t& y, uint32_t& w, uint32_t& h) = 0;
+
         virtual std::string GetError() const = 0;
     };
 
@@ -0,0 +1,64 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+namespace MediaCore
+{
+    // Measures the time from a flush to the first non-silent sample being played, shared by the render implementations
+    class AudibleLatencyMeter
+    {
+    public:
+        void Reset()
+        {
+            m_latency = -1;
+            m_flushTime = NowUs();
+        }
+
+        // 'playDelay' is the time in microseconds from now to when the first sample of 'buf' gets played
+        void OnPull(const uint8_t* buf, uint32_t buffSize, uint32_t frameSize, uint32_t sampleRate, int64_t playDelay)
+        {
+            const int64_t flushTime = m_flushTime;
+            if (flushTime < 0 || m_latency >= 0 || frameSize == 0)
+                return;
+            for (uint32_t i = 0; i < buffSize; i++)
+            {
+                if (buf[i] != 0)
+                {
+                    const int64_t offset = (int64_t)(i/frameSize)*1000000/sampleRate;
+                    m_latency = NowUs()+playDelay+offset-flushTime;
+                    return;
+                }
+            }
+        }
+
+        int64_t GetLatency() const { return m_latency; }
+
+    private:
+        static int64_t NowUs()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+        std::atomic<int64_t> m_flushTime{-1};
+        std::atomic<int64_t> m_latency{-1};
+    };
+}
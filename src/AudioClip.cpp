@@ -16,8 +16,10 @@
 */
 
 #include <sstream>
+#include <cstring>
 #include <functional>
 #include "AudioClip.h"
+#include "PcmBlockCache.h"
 #include "Logger.h"
 #include "SysUtils.h"
 
@@ -26,6 +28,43 @@ using namespace Logger;
 
 namespace MediaCore
 {
+bool AudioClip::LAZY_READER = false;
+
+void AudioClip::SetSharedPcmCacheSize(uint64_t size)
+{
+    PcmBlockCache::GetInstance().SetMemoryBudget(size);
+}
+
+uint64_t AudioClip::GetSharedPcmCacheSize()
+{
+    return PcmBlockCache::GetInstance().GetMemoryBudget();
+}
+
+// Copy 'count' samples, the planes of planar mats are stored one after another, each has 'w' samples
+static void CopyPcmSamples(ImGui::ImMat& dst, uint32_t dstOffset, const ImGui::ImMat& src, uint32_t srcOffset, uint32_t count)
+{
+    const size_t elemSize = src.elemsize;
+    if (src.elempack == 1)
+    {
+        for (int ch = 0; ch < src.c; ch++)
+            memcpy((uint8_t*)dst.data+((size_t)ch*dst.w+dstOffset)*elemSize, (const uint8_t*)src.data+((size_t)ch*src.w+srcOffset)*elemSize, count*elemSize);
+    }
+    else
+    {
+        const size_t frameSize = elemSize*src.c;
+        memcpy((uint8_t*)dst.data+dstOffset*frameSize, (const uint8_t*)src.data+srcOffset*frameSize, count*frameSize);
+    }
+}
+
+static void CreatePcmMatLike(ImGui::ImMat& dst, const ImGui::ImMat& src, uint32_t samples)
+{
+    dst.create((int)samples, 1, src.c, src.elemsize);
+    dst.type = src.type;
+    dst.elempack = src.elempack;
+    dst.rate = src.rate;
+    dst.flags = src.flags;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 // AudioClip
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -41,20 +80,30 @@ public:
         m_hInfo = hParser->GetMediaInfo();
         if (hParser->GetBestAudioStreamIndex() < 0)
             throw invalid_argument("Argument 'hParser' has NO AUDIO stream!");
-        string loggerName = "";
         if (exclusiveLogger)
         {
             auto fileName = SysUtils::ExtractFileName(hParser->GetUrl());
             ostringstream oss;
             oss << "AUD@" << fileName << "";
-            loggerName = oss.str();
+            m_loggerName = oss.str();
         }
-        m_srcReader = MediaReader::CreateInstance(loggerName);
-        if (!m_srcReader->Open(hParser))
-            throw runtime_error(m_srcReader->GetError());
-        if (!m_srcReader->ConfigAudioReader(outChannels, outSampleRate, outSampleFormat))
-            throw runtime_error(m_srcReader->GetError());
-        m_srcDuration = (int64_t)(m_srcReader->GetAudioStream()->duration*1000);
+        m_hParser = hParser;
+        m_outChannels = outChannels;
+        m_outSampleRate = outSampleRate;
+        m_outSampleFormat = outSampleFormat;
+        // the reader is configured with the 1st audio stream
+        const AudioStream* audStm = nullptr;
+        for (auto& stream : m_hInfo->streams)
+        {
+            if (stream->type == MediaType::AUDIO)
+            {
+                audStm = dynamic_cast<const AudioStream*>(stream.get());
+                break;
+            }
+        }
+        if (!audStm)
+            throw invalid_argument("Argument 'hParser' has NO AUDIO stream!");
+        m_srcDuration = (int64_t)(audStm->duration*1000);
         if (startOffset < 0)
             throw invalid_argument("Argument 'startOffset' can NOT be NEGATIVE!");
         if (endOffset < 0)
@@ -65,8 +114,9 @@ public:
         m_startOffset = startOffset;
         m_endOffset = endOffset;
         m_totalSamples = Duration()*outSampleRate/1000;
-        if (!m_srcReader->Start())
-            throw runtime_error(m_srcReader->GetError());
+        // in lazy mode, the reader is opened when the clip is approached by the read position
+        if (!AudioClip::LAZY_READER)
+            OpenReader();
     }
 
     ~AudioClip_AudioImpl()
@@ -77,7 +127,7 @@ public:
 
     MediaParser::Holder GetMediaParser() const override
     {
-        return m_srcReader->GetMediaParser();
+        return m_hParser;
     }
 
     int64_t Id() const override
@@ -117,23 +167,22 @@ public:
 
     int64_t ReadPos() const override
     {
-        return m_readSamples*1000/m_srcReader->GetAudioOutSampleRate()+m_start;
+        return m_readSamples*1000/m_outSampleRate+m_start;
     }
 
     uint32_t OutChannels() const override
     {
-        return m_srcReader->GetAudioOutChannels();
+        return m_outChannels;
     }
 
     uint32_t OutSampleRate() const override
     {
-        return m_srcReader->GetAudioOutSampleRate();
+        return m_outSampleRate;
     }
 
     uint32_t LeftSamples() const override
     {
-        bool isForward = m_srcReader->IsDirectionForward();
-        if (isForward)
+        if (m_readForward)
             return m_totalSamples > m_readSamples ? (uint32_t)(m_totalSamples-m_readSamples) : 0;
         else
             return m_readSamples > m_totalSamples ? 0 : (m_readSamples >= 0 ? (uint32_t)m_readSamples : 0);
@@ -159,7 +208,7 @@ public:
         if (startOffset+m_endOffset >= m_srcDuration)
             throw invalid_argument("Argument 'startOffset/endOffset', clip duration is NOT LARGER than 0!");
         m_startOffset = startOffset;
-        const int64_t newTotalSamples = Duration()*m_srcReader->GetAudioOutSampleRate()/1000;
+        const int64_t newTotalSamples = Duration()*m_outSampleRate/1000;
         m_readSamples += newTotalSamples-m_totalSamples;
         m_totalSamples = newTotalSamples;
     }
@@ -173,7 +222,7 @@ public:
         if (m_startOffset+endOffset >= m_srcDuration)
             throw invalid_argument("Argument 'startOffset/endOffset', clip duration is NOT LARGER than 0!");
         m_endOffset = endOffset;
-        m_totalSamples = Duration()*m_srcReader->GetAudioOutSampleRate()/1000;
+        m_totalSamples = Duration()*m_outSampleRate/1000;
     }
 
     void SeekTo(int64_t pos) override
@@ -182,11 +231,34 @@ public:
             pos = 0;
         else if (pos > Duration())
             pos = Duration()-1;
+        m_readSamples = pos*m_outSampleRate/1000;
+        m_eof = false;
+        // with the shared pcm cache, the reader is seeked only when a block is missing in the cache
+        if (PcmBlockCache::GetInstance().IsEnabled())
+        {
+            m_readerSynced = false;
+            return;
+        }
         const double p = (double)(pos+m_startOffset)/1000;
-        if (!m_srcReader->SeekTo(p))
+        // a released reader will seek to the position of 'm_readSamples' when it's re-opened
+        if (m_srcReader && !m_srcReader->SeekTo(p))
             throw runtime_error(m_srcReader->GetError());
-        m_readSamples = pos*m_srcReader->GetAudioOutSampleRate()/1000;
-        m_eof = false;
+        m_readerSynced = true;
+    }
+
+    void NotifyReadPos(int64_t pos) override
+    {
+        if (!AudioClip::LAZY_READER)
+            return;
+        if (pos < -m_wakeupRange || pos > Duration()+m_wakeupRange)
+        {
+            if (m_srcReader && (pos <= -m_releaseRange || pos >= Duration()+m_releaseRange))
+                ReleaseReader();
+        }
+        else if (!m_srcReader)
+        {
+            OpenReader();
+        }
     }
 
     ImGui::ImMat ReadAudioSamples(uint32_t& readSamples, bool& eof) override
@@ -198,9 +270,13 @@ public:
             m_eof = eof = true;
             return ImGui::ImMat();
         }
+        // in cache reading mode, the reader is only needed to decode the missing blocks
+        const bool readFromCache = m_readForward && PcmBlockCache::GetInstance().IsEnabled();
+        if (!m_srcReader && !readFromCache)
+            OpenReader();
 
-        uint32_t sampleRate = m_srcReader->GetAudioOutSampleRate();
-        if (m_pcmFrameSize == 0)
+        uint32_t sampleRate = m_outSampleRate;
+        if (m_pcmFrameSize == 0 && m_srcReader)
         {
             m_pcmFrameSize = m_srcReader->GetAudioOutFrameSize();
             m_pcmSizePerSec = sampleRate*m_pcmFrameSize;
@@ -208,17 +284,29 @@ public:
 
         if (readSamples > leftSamples)
             readSamples = leftSamples;
-        int channels = m_srcReader->GetAudioOutChannels();
         ImGui::ImMat amat;
         bool srcEof{false};
-        if (!m_srcReader->ReadAudioSamples(amat, readSamples, srcEof))
-            throw runtime_error(m_srcReader->GetError());
+        if (readFromCache)
+        {
+            ReadCachedSamples(amat, readSamples, srcEof);
+        }
+        else
+        {
+            if (!m_readerSynced)
+            {
+                if (!m_srcReader->SeekTo((double)(m_readSamples*1000/m_outSampleRate+m_startOffset)/1000))
+                    throw runtime_error(m_srcReader->GetError());
+                m_readerSynced = true;
+                m_readerSamplePos = -1;
+            }
+            if (!m_srcReader->ReadAudioSamples(amat, readSamples, srcEof))
+                throw runtime_error(m_srcReader->GetError());
+        }
         double srcpos = amat.time_stamp;
         amat.time_stamp = (double)m_readSamples/sampleRate+(double)m_start/1000.;
         readSamples = amat.w;
         // Log(WARN) << "~~~ srcpos=" << srcpos << ", ts=" << amat.time_stamp << ", delta=" << (srcpos-amat.time_stamp) << endl;
-        const bool isForward = m_srcReader->IsDirectionForward();
-        if (isForward)
+        if (m_readForward)
             m_readSamples += readSamples;
         else
             m_readSamples -= readSamples;
@@ -233,7 +321,11 @@ public:
 
     void SetDirection(bool forward) override
     {
-        m_srcReader->SetDirection(forward);
+        if (forward != m_readForward && PcmBlockCache::GetInstance().IsEnabled())
+            m_readerSynced = false;
+        m_readForward = forward;
+        if (m_srcReader)
+            m_srcReader->SetDirection(forward);
     }
 
     void SetFilter(AudioFilter::Holder filter) override
@@ -254,11 +346,134 @@ public:
         return m_filter;
     }
 
+private:
+    // Read from the shared pcm cache, the missing blocks are decoded by this clip's reader and put into the cache
+    void ReadCachedSamples(ImGui::ImMat& amat, uint32_t& readSamples, bool& srcEof)
+    {
+        auto& cache = PcmBlockCache::GetInstance();
+        PcmBlockCache::Key key{m_hParser->GetUrl(), m_outSampleRate, m_outChannels, m_outSampleFormat, 0};
+        const int64_t blockSamples = PcmBlockCache::BLOCK_SAMPLES;
+        int64_t srcPos = m_readSamples+m_startOffset*m_outSampleRate/1000;
+        uint32_t filled = 0;
+        ImGui::ImMat outMat;
+        while (filled < readSamples)
+        {
+            key.blockIndex = srcPos/blockSamples;
+            const uint32_t offsetInBlock = (uint32_t)(srcPos-key.blockIndex*blockSamples);
+            ImGui::ImMat block;
+            if (!cache.GetBlock(key, block))
+            {
+                DecodeBlock(key.blockIndex, block);
+                if (!block.empty())
+                    cache.PutBlock(key, block);
+            }
+            if (block.empty() || (uint32_t)block.w <= offsetInBlock)
+            {
+                srcEof = true;
+                break;
+            }
+            const uint32_t copySamples = min(readSamples-filled, (uint32_t)block.w-offsetInBlock);
+            if (outMat.empty())
+                CreatePcmMatLike(outMat, block, readSamples);
+            CopyPcmSamples(outMat, filled, block, offsetInBlock, copySamples);
+            filled += copySamples;
+            srcPos += copySamples;
+            if (block.w < blockSamples && offsetInBlock+copySamples >= (uint32_t)block.w)
+            {
+                srcEof = true;
+                break;
+            }
+        }
+        if (filled > 0 && filled < readSamples)
+        {
+            ImGui::ImMat shortMat;
+            CreatePcmMatLike(shortMat, outMat, filled);
+            CopyPcmSamples(shortMat, 0, outMat, 0, filled);
+            outMat = shortMat;
+        }
+        readSamples = filled;
+        amat = outMat;
+    }
+
+    void DecodeBlock(int64_t blockIndex, ImGui::ImMat& block)
+    {
+        if (!m_srcReader)
+            OpenReader();
+        const int64_t blockStart = blockIndex*PcmBlockCache::BLOCK_SAMPLES;
+        if (m_readerSamplePos != blockStart)
+        {
+            if (!m_srcReader->SeekTo((double)blockStart/m_outSampleRate))
+                throw runtime_error(m_srcReader->GetError());
+        }
+        // the reader position is owned by the cache reading now
+        m_readerSynced = false;
+        uint32_t filled = 0;
+        bool eof = false;
+        while (filled < PcmBlockCache::BLOCK_SAMPLES && !eof)
+        {
+            ImGui::ImMat part;
+            uint32_t partSamples = PcmBlockCache::BLOCK_SAMPLES-filled;
+            if (!m_srcReader->ReadAudioSamples(part, partSamples, eof))
+                throw runtime_error(m_srcReader->GetError());
+            if (part.empty() || part.w == 0)
+                break;
+            if (block.empty())
+                CreatePcmMatLike(block, part, PcmBlockCache::BLOCK_SAMPLES);
+            CopyPcmSamples(block, filled, part, 0, (uint32_t)part.w);
+            filled += part.w;
+        }
+        m_readerSamplePos = blockStart+filled;
+        if (filled > 0 && filled < PcmBlockCache::BLOCK_SAMPLES)
+        {
+            ImGui::ImMat lastBlock;
+            CreatePcmMatLike(lastBlock, block, filled);
+            CopyPcmSamples(lastBlock, 0, block, 0, filled);
+            block = lastBlock;
+        }
+        if (!block.empty())
+            block.time_stamp = (double)blockStart/m_outSampleRate;
+    }
+
+    void OpenReader()
+    {
+        // the parsed 'MediaParser' instance is reused, so re-opening a released reader doesn't probe the media again
+        auto hReader = MediaReader::CreateInstance(m_loggerName);
+        if (!hReader->Open(m_hParser))
+            throw runtime_error(hReader->GetError());
+        if (!hReader->ConfigAudioReader(m_outChannels, m_outSampleRate, m_outSampleFormat))
+            throw runtime_error(hReader->GetError());
+        hReader->SetDirection(m_readForward);
+        // always seek, the clip starts at 'm_startOffset' of the source even if nothing is read yet
+        if (!hReader->SeekTo((double)(m_readSamples*1000/m_outSampleRate+m_startOffset)/1000))
+            throw runtime_error(hReader->GetError());
+        if (!hReader->Start())
+            throw runtime_error(hReader->GetError());
+        m_srcReader = hReader;
+        m_readerSamplePos = -1;
+    }
+
+    void ReleaseReader()
+    {
+        m_srcReader->Close();
+        m_srcReader = nullptr;
+        m_readerSamplePos = -1;
+    }
+
 private:
     int64_t m_id;
     int64_t m_trackId{-1};
     MediaInfo::Holder m_hInfo;
+    MediaParser::Holder m_hParser;
+    string m_loggerName;
     MediaReader::Holder m_srcReader;
+    uint32_t m_outChannels;
+    uint32_t m_outSampleRate;
+    string m_outSampleFormat;
+    bool m_readForward{true};
+    int64_t m_wakeupRange{1000};
+    // in lazy mode, the reader is released when the read position is out of this range, it's larger than the
+    // seek range of the track, so that a clip at the edge doesn't open and release its reader over and over
+    int64_t m_releaseRange{3000};
     AudioFilter::Holder m_filter;
     int64_t m_srcDuration;
     int64_t m_start;
@@ -269,6 +484,9 @@ private:
     int64_t m_readSamples{0};
     int64_t m_totalSamples;
     bool m_eof{false};
+    // false if the reader position doesn't follow 'm_readSamples', because it's used to decode the cache blocks
+    bool m_readerSynced{true};
+    int64_t m_readerSamplePos{-1};  // source sample position of the reader after decoding a cache block, -1 if unknown
 };
 
 static const function<void(AudioClip*)> AUDIO_CLIP_HOLDER_DELETER = [] (AudioClip* p) {
@@ -286,7 +504,7 @@ AudioClip::Holder AudioClip::CreateInstance(
 
 AudioClip::Holder AudioClip_AudioImpl::Clone(uint32_t outChannels, uint32_t outSampleRate, const string& outSampleFormat) const
 {
-    return AudioClip::Holder(new AudioClip_AudioImpl(m_id, m_srcReader->GetMediaParser(), outChannels, outSampleRate, outSampleFormat, m_start, m_startOffset, m_endOffset),
+    return AudioClip::Holder(new AudioClip_AudioImpl(m_id, m_hParser, outChannels, outSampleRate, outSampleFormat, m_start, m_startOffset, m_endOffset),
             AUDIO_CLIP_HOLDER_DELETER);
 }
 
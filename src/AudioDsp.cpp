@@ -0,0 +1,236 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <algorithm>
+#include "AudioDsp.h"
+extern "C"
+{
+    #include "libavutil/avutil.h"
+    #include "libavutil/channel_layout.h"
+}
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AUDIO_DSP_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_DSP_NEON
+#endif
+
+using namespace std;
+
+namespace MediaCore
+{
+void ScaleSamples(float* data, float gain, size_t count)
+{
+    size_t i = 0;
+#if defined(AUDIO_DSP_SSE)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i+8 <= count; i += 8)
+    {
+        _mm_storeu_ps(data+i, _mm_mul_ps(_mm_loadu_ps(data+i), g));
+        _mm_storeu_ps(data+i+4, _mm_mul_ps(_mm_loadu_ps(data+i+4), g));
+    }
+#elif defined(AUDIO_DSP_NEON)
+    for (; i+8 <= count; i += 8)
+    {
+        vst1q_f32(data+i, vmulq_n_f32(vld1q_f32(data+i), gain));
+        vst1q_f32(data+i+4, vmulq_n_f32(vld1q_f32(data+i+4), gain));
+    }
+#endif
+    for (; i < count; i++)
+        data[i] *= gain;
+}
+
+float MaxAbsSample(const float* data, size_t count)
+{
+    size_t i = 0;
+    float peak = 0;
+#if defined(AUDIO_DSP_SSE)
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    __m128 m = _mm_setzero_ps();
+    for (; i+4 <= count; i += 4)
+        m = _mm_max_ps(m, _mm_andnot_ps(signMask, _mm_loadu_ps(data+i)));
+    alignas(16) float buf[4];
+    _mm_store_ps(buf, m);
+    peak = max(max(buf[0], buf[1]), max(buf[2], buf[3]));
+#elif defined(AUDIO_DSP_NEON)
+    float32x4_t m = vdupq_n_f32(0);
+    for (; i+4 <= count; i += 4)
+        m = vmaxq_f32(m, vabsq_f32(vld1q_f32(data+i)));
+    float buf[4];
+    vst1q_f32(buf, m);
+    peak = max(max(buf[0], buf[1]), max(buf[2], buf[3]));
+#endif
+    for (; i < count; i++)
+        peak = max(peak, fabs(data[i]));
+    return peak;
+}
+
+void AudioChannelGains::Configure(uint32_t channels, bool isPlanar)
+{
+    m_channels = channels;
+    m_isPlanar = isPlanar;
+    m_gains.assign(channels, 1.f);
+    m_targets = m_gains;
+    m_steps.assign(channels, 0.f);
+    m_rampRemain = 0;
+}
+
+vector<float> AudioChannelGains::CalcPanCoefs(uint32_t channels, float x, float y)
+{
+    vector<float> coefs(channels, 1.f);
+    if (x == 0.5f && y == 0.5f)
+        return coefs;
+#if !defined(FF_API_OLD_CHANNEL_LAYOUT) && (LIBAVUTIL_VERSION_MAJOR < 58)
+    const uint64_t chlyt = (uint64_t)av_get_default_channel_layout(channels);
+#else
+    AVChannelLayout chlyt{AV_CHANNEL_ORDER_UNSPEC, 0};
+    av_channel_layout_default(&chlyt, channels);
+#endif
+    const uint64_t leftMask = AV_CH_FRONT_LEFT|AV_CH_BACK_LEFT|AV_CH_FRONT_LEFT_OF_CENTER|AV_CH_SIDE_LEFT|AV_CH_TOP_FRONT_LEFT
+            |AV_CH_TOP_BACK_LEFT|AV_CH_STEREO_LEFT|AV_CH_WIDE_LEFT|AV_CH_SURROUND_DIRECT_LEFT|AV_CH_TOP_SIDE_LEFT|AV_CH_BOTTOM_FRONT_LEFT;
+    const uint64_t rightMask = AV_CH_FRONT_RIGHT|AV_CH_BACK_RIGHT|AV_CH_FRONT_RIGHT_OF_CENTER|AV_CH_SIDE_RIGHT|AV_CH_TOP_FRONT_RIGHT
+            |AV_CH_TOP_BACK_RIGHT|AV_CH_STEREO_RIGHT|AV_CH_WIDE_RIGHT|AV_CH_SURROUND_DIRECT_RIGHT|AV_CH_TOP_SIDE_RIGHT|AV_CH_BOTTOM_FRONT_RIGHT;
+    const uint64_t frontMask = AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER|AV_CH_FRONT_LEFT_OF_CENTER|AV_CH_FRONT_RIGHT_OF_CENTER
+            |AV_CH_TOP_FRONT_LEFT|AV_CH_TOP_FRONT_CENTER|AV_CH_TOP_FRONT_RIGHT|AV_CH_BOTTOM_FRONT_CENTER|AV_CH_BOTTOM_FRONT_LEFT|AV_CH_BOTTOM_FRONT_RIGHT;
+    const uint64_t backMask = AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT|AV_CH_BACK_CENTER|AV_CH_TOP_BACK_LEFT|AV_CH_TOP_BACK_CENTER|AV_CH_TOP_BACK_RIGHT;
+    for (uint32_t i = 0; i < channels; i++)
+    {
+#if !defined(FF_API_OLD_CHANNEL_LAYOUT) && (LIBAVUTIL_VERSION_MAJOR < 58)
+        const uint64_t ch = av_channel_layout_extract_channel(chlyt, i);
+#else
+        const enum AVChannel chan = av_channel_layout_channel_from_index(&chlyt, i);
+        const uint64_t ch = chan >= 0 && chan < 64 ? 1ULL<<chan : 0;
+#endif
+        double xCoef = 1., yCoef = 1.;
+        if (ch&leftMask)
+            xCoef *= (1-x)/0.5;
+        else if (ch&rightMask)
+            xCoef *= x/0.5;
+        if (ch&frontMask)
+            yCoef *= (1-y)/0.5;
+        else if (ch&backMask)
+            yCoef *= y/0.5;
+        coefs[i] = (float)(xCoef*yCoef);
+    }
+    return coefs;
+}
+
+void AudioChannelGains::SetTargets(const vector<float>& gains, uint32_t rampSamples, AudioEffectFilter::RampCurve rampCurve)
+{
+    m_targets = gains;
+    m_targets.resize(m_channels, 1.f);
+    if (rampSamples == 0)
+    {
+        m_gains = m_targets;
+        m_rampRemain = 0;
+        return;
+    }
+    // the exponential curve can't reach or leave 0, use linear instead
+    m_rampCurve = rampCurve;
+    for (uint32_t ch = 0; ch < m_channels && m_rampCurve == AudioEffectFilter::RAMP_EXPONENTIAL; ch++)
+    {
+        if (m_gains[ch] <= 0 || m_targets[ch] <= 0)
+            m_rampCurve = AudioEffectFilter::RAMP_LINEAR;
+    }
+    for (uint32_t ch = 0; ch < m_channels; ch++)
+    {
+        if (m_rampCurve == AudioEffectFilter::RAMP_EXPONENTIAL)
+            m_steps[ch] = (float)pow((double)m_targets[ch]/m_gains[ch], 1./rampSamples);
+        else
+            m_steps[ch] = (m_targets[ch]-m_gains[ch])/rampSamples;
+    }
+    m_rampRemain = rampSamples;
+}
+
+bool AudioChannelGains::IsUnity() const
+{
+    if (m_rampRemain > 0)
+        return false;
+    for (auto g : m_gains)
+        if (g != 1.f) return false;
+    return true;
+}
+
+void AudioChannelGains::Process(float* data, uint32_t samples)
+{
+    const uint32_t step = m_isPlanar ? 1 : m_channels;
+    auto channelPtr = [this, data, samples] (uint32_t ch) { return m_isPlanar ? data+(size_t)ch*samples : data+ch; };
+    uint32_t start = 0;
+    if (m_rampRemain > 0)
+    {
+        const uint32_t rampLen = min(samples, m_rampRemain);
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+        {
+            float* p = channelPtr(ch);
+            float g = m_gains[ch];
+            const float s = m_steps[ch];
+            if (m_rampCurve == AudioEffectFilter::RAMP_EXPONENTIAL)
+            {
+                for (uint32_t n = 0; n < rampLen; n++)
+                {
+                    g *= s;
+                    p[n*step] *= g;
+                }
+            }
+            else
+            {
+                for (uint32_t n = 0; n < rampLen; n++)
+                {
+                    g += s;
+                    p[n*step] *= g;
+                }
+            }
+            m_gains[ch] = g;
+        }
+        m_rampRemain -= rampLen;
+        if (m_rampRemain == 0)
+            m_gains = m_targets;
+        start = rampLen;
+    }
+    if (start >= samples)
+        return;
+
+    const uint32_t remain = samples-start;
+    bool allEqual = true;
+    for (uint32_t ch = 1; ch < m_channels && allEqual; ch++)
+        allEqual = m_gains[ch] == m_gains[0];
+    if (allEqual)
+    {
+        if (m_gains[0] == 1.f)
+            return;
+        if (!m_isPlanar)
+        {
+            ScaleSamples(data+(size_t)start*m_channels, m_gains[0], (size_t)remain*m_channels);
+            return;
+        }
+    }
+    if (m_isPlanar)
+    {
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+            ScaleSamples(channelPtr(ch)+start, m_gains[ch], remain);
+    }
+    else
+    {
+        float* p = data+(size_t)start*m_channels;
+        for (uint32_t n = 0; n < remain; n++)
+            for (uint32_t ch = 0; ch < m_channels; ch++, p++)
+                *p *= m_gains[ch];
+    }
+}
+}
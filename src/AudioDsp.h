@@ -0,0 +1,53 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "AudioEffectFilter.h"
+
+namespace MediaCore
+{
+    // data[i] *= gain
+    void ScaleSamples(float* data, float gain, size_t count);
+    // max(|data[i]|)
+    float MaxAbsSample(const float* data, size_t count);
+
+    // Per-channel gains of the volume and pan effects, applied in place on float32 (planar or interleaved) buffers.
+    // A change of the gains can be ramped per sample with a linear or an exponential curve.
+    class AudioChannelGains
+    {
+    public:
+        void Configure(uint32_t channels, bool isPlanar);
+        // Per-channel coefficients of the pan position (x, y), the same as the 'pan' filter arguments of the FFmpeg backend
+        static std::vector<float> CalcPanCoefs(uint32_t channels, float x, float y);
+        // Move the gains to 'gains' in 'rampSamples' samples, a new ramp starts from where the current one is
+        void SetTargets(const std::vector<float>& gains, uint32_t rampSamples, AudioEffectFilter::RampCurve rampCurve);
+        // True if no ramp is in progress and all the gains are 1, 'Process()' leaves the data unchanged then
+        bool IsUnity() const;
+        void Process(float* data, uint32_t samples);
+
+    private:
+        uint32_t m_channels{0};
+        bool m_isPlanar{false};
+        // during a ramp the gains move from 'm_gains' to 'm_targets'
+        std::vector<float> m_gains, m_targets, m_steps;
+        uint32_t m_rampRemain{0};
+        AudioEffectFilter::RampCurve m_rampCurve{AudioEffectFilter::RAMP_LINEAR};
+    };
+}
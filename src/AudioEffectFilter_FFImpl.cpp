@@ -17,7 +17,13 @@
 
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
 #include "AudioEffectFilter.h"
+#include "AudioEffectFilter_NativeImpl.h"
+#include "AudioDsp.h"
 #include "FFUtils.h"
 extern "C"
 {
@@ -80,12 +86,22 @@ public:
             return false;
         }
 
+        m_smpfmt = smpfmt;
+        m_matDt = GetDataTypeFromSampleFormat(smpfmt);
+        m_channels = channels;
+        m_sampleRate = sampleRate;
+        m_blockAlign = channels*av_get_bytes_per_sample(smpfmt);
+        m_isPlanar = av_sample_fmt_is_planar(smpfmt);
+        // float32 frames get the volume and pan gains applied in place, and can skip the filter-graph when it's neutral
+        m_gainsInPlace = smpfmt == AV_SAMPLE_FMT_FLT || smpfmt == AV_SAMPLE_FMT_FLTP;
+        m_composeFlags = composeFlags;
+
         if (composeFlags > 0)
         {
             bool ret = CreateFilterGraph(composeFlags, smpfmt, channels, sampleRate);
             if (!ret)
                 return false;
-            if (CheckFilters(composeFlags, PAN))
+            if (CheckFilters(composeFlags, PAN) && !m_gainsInPlace)
             {
                 ret = CreatePanFilterGraph(smpfmt, channels, sampleRate);
                 if (!ret)
@@ -97,13 +113,14 @@ public:
             m_logger->Log(DEBUG) << "This 'AudioEffectFilter' is using pass-through mode because 'composeFlags' is 0." << endl;
             m_passThrough = true;
         }
-
-        m_smpfmt = smpfmt;
-        m_matDt = GetDataTypeFromSampleFormat(smpfmt);
-        m_channels = channels;
-        m_sampleRate = sampleRate;
-        m_blockAlign = channels*av_get_bytes_per_sample(smpfmt);
-        m_isPlanar = av_sample_fmt_is_planar(smpfmt);
+        if (m_gainsInPlace)
+        {
+            m_chGains.Configure(channels, m_isPlanar);
+            UpdateChannelGains(0, RAMP_LINEAR);
+            m_limiterDelay = CalcLimiterDelay();
+            m_delayLine.assign((size_t)m_limiterDelay*channels, 0.f);
+            m_quietSamples = numeric_limits<uint32_t>::max();
+        }
 
         m_inited = true;
         return true;
@@ -125,6 +142,35 @@ public:
             return true;
         }
 
+        UpdateFilterParameters();
+        if (m_gainsInPlace)
+        {
+            if (in.type != IM_DT_FLOAT32 || (uint32_t)in.c != m_channels || (in.elempack == 1) != m_isPlanar)
+            {
+                ostringstream oss;
+                oss << "Input audio frame does NOT match the format this 'AudioEffectFilter' is initialized with! type=" << in.type
+                        << ", channels=" << in.c << ", elempack=" << in.elempack << ".";
+                m_errMsg = oss.str();
+                return false;
+            }
+            if (m_currMuted || IsIdentity(in))
+            {
+                BypassFilterGraph(in, out);
+                return true;
+            }
+            if (m_restartGraph && !RestartFilterGraph(in.time_stamp))
+                return false;
+            if (m_limiterDelay > 0)
+                ShiftDelayLine((const float*)in.data, (uint32_t)in.w, nullptr);
+            if (!m_useGeneralFg)
+            {
+                ImGui::ImMat m = in.clone();
+                m_chGains.Process((float*)m.data, (uint32_t)m.w);
+                out.push_back(m);
+                return true;
+            }
+        }
+
         SelfFreeAVFramePtr avfrm = AllocSelfFreeAVFramePtr();
         int64_t pts = (int64_t)(in.time_stamp*m_sampleRate);
         if (!m_matCvter.ConvertImMatToAVFrame(in, avfrm.get(), pts))
@@ -136,8 +182,6 @@ public:
         }
         // m_logger->Log(DEBUG) << "Get incoming mat: ts=" << in.time_stamp << "; avfrm: pts=" << pts << endl;
 
-        UpdateFilterParameters();
-
         int fferr;
         if (m_useGeneralFg)
         {
@@ -208,6 +252,7 @@ public:
                         m.rate = { (int)m_sampleRate, 1 };
                         m.elempack = m_isPlanar ? 1 : m_channels;
                         m.time_stamp = ts;
+                        out.push_back(m);
                     }
                     else
                     {
@@ -218,6 +263,8 @@ public:
                             m.flags = IM_MAT_FLAGS_AUDIO_FRAME;
                             m.rate = { (int)m_sampleRate, 1 };
                             m.elempack = m_isPlanar ? 1 : m_channels;
+                            if (m_gainsInPlace)
+                                m_chGains.Process((float*)m.data, (uint32_t)m.w);
                             out.push_back(m);
                         }
                         else
@@ -234,6 +281,8 @@ public:
                 {
                     Log(WARN) << "av_buffersink_get_frame() returns INVALID number of samples! nb_samples=" << avfrm->nb_samples << "." << endl;
                 }
+                if (!m_useGeneralFg)
+                    break;
             }
             else if (fferr == AVERROR(EAGAIN))
                 break;
@@ -377,7 +426,8 @@ public:
 private:
     bool CreateFilterGraph(uint32_t composeFlags, const AVSampleFormat smpfmt, uint32_t channels, uint32_t sampleRate)
     {
-        if ((composeFlags&~PAN) == 0)
+        // volume and pan are not in this graph if their gains are applied in place
+        if ((composeFlags&~(m_gainsInPlace ? PAN|VOLUME : PAN)) == 0)
         {
             m_useGeneralFg = false;
             return true;
@@ -467,12 +517,16 @@ private:
         }
         if (CheckFilters(composeFlags, EQUALIZER))
         {
+            // the graph is created again after a bypass, keep the current gains
+            if (m_currEqualizerParamsList.empty())
+            {
+                m_currEqualizerParamsList.resize(DF_CENTER_FREQS.size(), {0});
+                m_setEqualizerParamsList.resize(DF_CENTER_FREQS.size(), {0});
+            }
             for (int i=0; i < DF_CENTER_FREQS.size(); i++)
             {
-                m_currEqualizerParamsList.push_back({0});
-                m_setEqualizerParamsList.push_back({0});
                 if (!isFirstFilter) fgArgsOss << ","; else isFirstFilter = false;
-                fgArgsOss << "equalizer@" << i << "=f=" << DF_CENTER_FREQS[i] << ":t=h:w=" << DF_BAND_WTHS[i] << ":g=0";
+                fgArgsOss << "equalizer@" << i << "=f=" << DF_CENTER_FREQS[i] << ":t=h:w=" << DF_BAND_WTHS[i] << ":g=" << m_currEqualizerParamsList[i].gain;
             }
         }
         if (CheckFilters(composeFlags, COMPRESSOR))
@@ -482,7 +536,7 @@ private:
                 << m_currCompressorParams.knee << ":mix=" << m_currCompressorParams.mix << ":attack=" << m_currCompressorParams.attack << ":release="
                 << m_currCompressorParams.release << ":makeup=" << m_currCompressorParams.makeup << ":level_in=" << m_currCompressorParams.levelIn;
         }
-        if (CheckFilters(composeFlags, VOLUME))
+        if (CheckFilters(composeFlags, VOLUME) && !m_gainsInPlace)
         {
             if (!isFirstFilter) fgArgsOss << ","; else isFirstFilter = false;
             fgArgsOss << "volume=volume=" << m_currVolumeParams.volume << ":precision=float:eval=frame";
@@ -714,7 +768,7 @@ private:
         {
             m_logger->Log(DEBUG) << "Change muted state: " << m_setMuted << "." << endl;;
             m_currMuted = m_setMuted;
-            if (HasFilter(VOLUME))
+            if (HasFilter(VOLUME) && !m_gainsInPlace)
             {
                 int fferr;
                 char cmdArgs[32] = {0};
@@ -732,7 +786,11 @@ private:
                     m_logger->Log(WARN) << "FAILED set muted state as " << m_currMuted << "! Set 'volume' param failed with returned fferr=" << fferr << "." << endl;
             }
         }
-        if (!m_currMuted && m_setVolumeParams.volume != m_currVolumeParams.volume)
+        if (m_gainsInPlace)
+        {
+            UpdateGainParameters();
+        }
+        else if (!m_currMuted && m_setVolumeParams.volume != m_currVolumeParams.volume)
         {
             m_logger->Log(DEBUG) << "Change VolumeParams::volume: " << m_currVolumeParams.volume << " -> " << m_setVolumeParams.volume << " ... ";
             char cmdArgs[32] = {0};
@@ -1121,7 +1179,16 @@ private:
                 m_logger->Log(WARN) << m_errMsg << endl;
             }
         }
-        if (m_setLimiterParams.attack != m_currLimiterParams.attack)
+        if (m_setLimiterParams.attack != m_currLimiterParams.attack && m_gainsInPlace)
+        {
+            // the lookahead of 'alimiter' is its attack time, create the graph again to know the new delay
+            m_logger->Log(DEBUG) << "Change LimiterParams::attack: " << m_currLimiterParams.attack << " -> " << m_setLimiterParams.attack << "." << endl;
+            m_currLimiterParams.attack = m_setLimiterParams.attack;
+            m_limiterDelay = CalcLimiterDelay();
+            ResizeDelayLine();
+            m_restartGraph = true;
+        }
+        else if (m_setLimiterParams.attack != m_currLimiterParams.attack)
         {
             m_logger->Log(DEBUG) << "Change LimiterParams::attack: " << m_currLimiterParams.attack << " -> " << m_setLimiterParams.attack << " ... ";
             char cmdArgs[32] = {0};
@@ -1164,7 +1231,7 @@ private:
             }
         }
         // Check PanParams
-        if (m_setPanParams.x != m_currPanParams.x || m_setPanParams.y != m_currPanParams.y)
+        if (!m_gainsInPlace && (m_setPanParams.x != m_currPanParams.x || m_setPanParams.y != m_currPanParams.y))
         {
             m_logger->Log(DEBUG) << "Change PanParams (" << m_currPanParams.x << ", " << m_currPanParams.y << ") -> (" << m_setPanParams.x << ", " << m_setPanParams.y << ")." << endl;
             m_currPanParams = m_setPanParams;
@@ -1177,6 +1244,236 @@ private:
         }
     }
 
+    // Volume and pan changes of float32 frames are ramped per sample, the same as the native backend
+    void UpdateGainParameters()
+    {
+        bool gainChanged = false;
+        uint32_t rampSamples = 0;
+        RampCurve rampCurve = RAMP_LINEAR;
+        if (m_setVolumeParams.volume != m_currVolumeParams.volume)
+        {
+            m_logger->Log(DEBUG) << "Change VolumeParams::volume: " << m_currVolumeParams.volume << " -> " << m_setVolumeParams.volume
+                    << " in " << m_setVolumeParams.rampSamples << " samples." << endl;
+            m_currVolumeParams = m_setVolumeParams;
+            gainChanged = true;
+            rampSamples = m_currVolumeParams.rampSamples;
+            rampCurve = m_currVolumeParams.rampCurve;
+        }
+        if (m_setPanParams.x != m_currPanParams.x || m_setPanParams.y != m_currPanParams.y)
+        {
+            m_logger->Log(DEBUG) << "Change PanParams: (" << m_currPanParams.x << ", " << m_currPanParams.y << ") -> ("
+                    << m_setPanParams.x << ", " << m_setPanParams.y << ") in " << m_setPanParams.rampSamples << " samples." << endl;
+            m_currPanParams = m_setPanParams;
+            if (!gainChanged || m_currPanParams.rampSamples > rampSamples)
+            {
+                rampSamples = m_currPanParams.rampSamples;
+                rampCurve = m_currPanParams.rampCurve;
+            }
+            gainChanged = true;
+        }
+        if (gainChanged)
+            UpdateChannelGains(rampSamples, rampCurve);
+    }
+
+    void UpdateChannelGains(uint32_t rampSamples, RampCurve rampCurve)
+    {
+        vector<float> gains = HasFilter(PAN) ? AudioChannelGains::CalcPanCoefs(m_channels, m_currPanParams.x, m_currPanParams.y) : vector<float>(m_channels, 1.f);
+        if (HasFilter(VOLUME))
+        {
+            for (auto& g : gains)
+                g *= m_currVolumeParams.volume;
+        }
+        m_chGains.SetTargets(gains, rampSamples, rampCurve);
+    }
+
+    // 'alimiter' delays the signal by its lookahead buffer, which holds 'attack' milliseconds of samples
+    uint32_t CalcLimiterDelay() const
+    {
+        if (!HasFilter(LIMITER))
+            return 0;
+        int bufferSize = (int)(m_sampleRate*(double)m_currLimiterParams.attack/1000.*m_channels);
+        bufferSize -= bufferSize%m_channels;
+        return bufferSize > (int)m_channels ? (uint32_t)bufferSize/m_channels-1 : 0;
+    }
+
+    // The frame can skip the filter-graph if all the filters leave it unchanged. The limiter and the compressor
+    // can only be skipped after their envelopes are released, which is taken as the frames being below their
+    // thresholds for the longer of their release times.
+    bool IsIdentity(const ImGui::ImMat& in)
+    {
+        bool neutral = true;
+        if (HasFilter(EQUALIZER))
+        {
+            for (const auto& eqParams : m_currEqualizerParamsList)
+                if (eqParams.gain != 0) neutral = false;
+        }
+        const auto& gp = m_currGateParams;
+        if (HasFilter(GATE) && (gp.threshold > 0 || gp.makeup != 1))
+            neutral = false;
+        const auto& lp = m_currLimiterParams;
+        const auto& cp = m_currCompressorParams;
+        const bool checkLimiter = HasFilter(LIMITER);
+        const bool checkCompressor = HasFilter(COMPRESSOR);
+        // with its auto level 'alimiter' scales the output by 1/limit
+        if (checkLimiter && lp.limit < 1)
+            neutral = false;
+        if (checkCompressor && (cp.makeup != 1 || cp.levelIn != 1))
+            neutral = false;
+        if (!neutral)
+        {
+            m_quietSamples = 0;
+            return false;
+        }
+        if (checkLimiter || checkCompressor)
+        {
+            const float peak = MaxAbsSample((const float*)in.data, (size_t)in.w*m_channels);
+            const double kneeStart = cp.threshold/sqrt(max(cp.knee, 1.f));
+            if ((checkLimiter && peak > lp.limit) || (checkCompressor && peak > kneeStart))
+            {
+                m_quietSamples = 0;
+                return false;
+            }
+            const uint64_t quietSamples = m_quietSamples;
+            m_quietSamples += (uint64_t)in.w;
+            const float releaseTime = max(checkLimiter ? lp.release : 0.f, checkCompressor ? cp.release : 0.f);
+            if (quietSamples < (uint64_t)(releaseTime*m_sampleRate/1000))
+                return false;
+        }
+        return m_chGains.IsUnity();
+    }
+
+    // Output the frame without running the filter-graph. The limiter's lookahead delay is kept, otherwise the output would
+    // jump when the graph is skipped or used again.
+    void BypassFilterGraph(const ImGui::ImMat& in, list<ImGui::ImMat>& out)
+    {
+        if (!m_restartGraph)
+            m_logger->Log(VERBOSE) << "Bypass the filter-graph from " << in.time_stamp << "." << endl;
+        m_restartGraph = true;
+        if (!m_currMuted && m_limiterDelay == 0)
+        {
+            out.push_back(in);
+            return;
+        }
+        ImGui::ImMat m;
+        m.create_type(in.w, in.h, in.c, in.type);
+        m.elempack = in.elempack;
+        m.flags = IM_MAT_FLAGS_AUDIO_FRAME;
+        m.rate = { (int)m_sampleRate, 1 };
+        m.time_stamp = in.time_stamp;
+        if (m_currMuted)
+        {
+            memset(m.data, 0, m.total()*m.elemsize);
+            if (m_limiterDelay > 0)
+                ShiftDelayLine((const float*)in.data, (uint32_t)in.w, nullptr);
+        }
+        else
+        {
+            ShiftDelayLine((const float*)in.data, (uint32_t)in.w, (float*)m.data);
+        }
+        out.push_back(m);
+    }
+
+    // The filters' states were left as they were when the filter-graph was last used. Create it again to start from clean
+    // states, and fill the limiter's lookahead with the last input samples so the output continues from the bypassed frames.
+    bool RestartFilterGraph(double timestamp)
+    {
+        m_restartGraph = false;
+        ReleaseFilterGraph();
+        if (!CreateFilterGraph(m_composeFlags, m_smpfmt, m_channels, m_sampleRate))
+            return false;
+        if (!m_useGeneralFg || m_limiterDelay == 0)
+            return true;
+
+        const uint32_t delay = m_limiterDelay;
+        ImGui::ImMat primer;
+        primer.create_type((int)delay, 1, (int)m_channels, IM_DT_FLOAT32);
+        primer.elempack = m_isPlanar ? 1 : m_channels;
+        float* dst = (float*)primer.data;
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+        {
+            const float* line = m_delayLine.data()+(size_t)ch*delay;
+            for (uint32_t i = 0; i < delay; i++)
+                (m_isPlanar ? dst[(size_t)ch*delay+i] : dst[(size_t)i*m_channels+ch]) = line[i];
+        }
+        SelfFreeAVFramePtr avfrm = AllocSelfFreeAVFramePtr();
+        const int64_t pts = (int64_t)(timestamp*m_sampleRate)-delay;
+        if (!m_matCvter.ConvertImMatToAVFrame(primer, avfrm.get(), pts))
+        {
+            m_errMsg = "FAILED to invoke AudioImMatAVFrameConverter::ConvertImMatToAVFrame()!";
+            return false;
+        }
+        int fferr = av_buffersrc_add_frame(m_bufsrcCtx, avfrm.get());
+        if (fferr < 0)
+        {
+            ostringstream oss;
+            oss << "FAILED to invoke av_buffersrc_add_frame()! fferr = " << fferr << ".";
+            m_errMsg = oss.str();
+            return false;
+        }
+        // the output of the primer is the initial empty lookahead, drop it
+        do {
+            av_frame_unref(avfrm.get());
+            fferr = av_buffersink_get_frame(m_bufsinkCtx, avfrm.get());
+        } while (fferr >= 0);
+        if (fferr != AVERROR(EAGAIN))
+        {
+            ostringstream oss;
+            oss << "FAILED to invoke av_buffersink_get_frame()! fferr = " << fferr << ".";
+            m_errMsg = oss.str();
+            return false;
+        }
+        return true;
+    }
+
+    // Push 'samples' samples of 'data' into the delay line of the limiter's lookahead, the ones coming out of it are written
+    // into 'out' if it's not null. The delay line is planar, 'm_limiterDelay' samples per channel.
+    void ShiftDelayLine(const float* data, uint32_t samples, float* out)
+    {
+        const uint32_t delay = m_limiterDelay;
+        const uint32_t step = m_isPlanar ? 1 : m_channels;
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+        {
+            const float* src = m_isPlanar ? data+(size_t)ch*samples : data+ch;
+            float* dst = out ? (m_isPlanar ? out+(size_t)ch*samples : out+ch) : nullptr;
+            float* line = m_delayLine.data()+(size_t)ch*delay;
+            if (samples >= delay)
+            {
+                if (dst)
+                {
+                    for (uint32_t i = 0; i < delay; i++)
+                        dst[i*step] = line[i];
+                    for (uint32_t i = delay; i < samples; i++)
+                        dst[i*step] = src[(i-delay)*step];
+                }
+                for (uint32_t i = 0; i < delay; i++)
+                    line[i] = src[(samples-delay+i)*step];
+            }
+            else
+            {
+                if (dst)
+                {
+                    for (uint32_t i = 0; i < samples; i++)
+                        dst[i*step] = line[i];
+                }
+                memmove(line, line+samples, (delay-samples)*sizeof(float));
+                for (uint32_t i = 0; i < samples; i++)
+                    line[delay-samples+i] = src[i*step];
+            }
+        }
+    }
+
+    // Keep the latest samples when the delay changes
+    void ResizeDelayLine()
+    {
+        const uint32_t delay = m_limiterDelay;
+        const uint32_t oldDelay = m_channels > 0 ? (uint32_t)(m_delayLine.size()/m_channels) : 0;
+        vector<float> delayLine((size_t)delay*m_channels, 0.f);
+        const uint32_t keep = min(delay, oldDelay);
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+            memcpy(delayLine.data()+(size_t)ch*delay+(delay-keep), m_delayLine.data()+(size_t)ch*oldDelay+(oldDelay-keep), keep*sizeof(float));
+        m_delayLine.swap(delayLine);
+    }
+
     bool CheckFilters(uint32_t composeFlags, uint32_t checkFlags) const
     {
         return (composeFlags&checkFlags) == checkFlags;
@@ -1213,6 +1510,14 @@ private:
     std::vector<EqualizerParams> m_setEqualizerParamsList, m_currEqualizerParamsList;
     bool m_setMuted{false}, m_currMuted{false};
 
+    // per-sample volume and pan of float32 frames, and the state of the filter-graph bypass
+    bool m_gainsInPlace{false};
+    AudioChannelGains m_chGains;
+    bool m_restartGraph{false};
+    uint64_t m_quietSamples{0};
+    uint32_t m_limiterDelay{0};
+    std::vector<float> m_delayLine;
+
     AudioImMatAVFrameConverter m_matCvter;
     string m_errMsg;
 };
@@ -1232,12 +1537,20 @@ const uint32_t AudioEffectFilter::EQUALIZER     = 0x10;
 const uint32_t AudioEffectFilter::COMPRESSOR    = 0x20;
 
 static const auto AUDIO_EFFECT_FILTER_HOLDER_DELETER = [] (AudioEffectFilter* p) {
-    AudioEffectFilter_FFImpl* ptr = dynamic_cast<AudioEffectFilter_FFImpl*>(p);
-    delete ptr;
+    AudioEffectFilter_NativeImpl* ptr1 = dynamic_cast<AudioEffectFilter_NativeImpl*>(p);
+    if (ptr1)
+    {
+        delete ptr1;
+        return;
+    }
+    AudioEffectFilter_FFImpl* ptr2 = dynamic_cast<AudioEffectFilter_FFImpl*>(p);
+    delete ptr2;
 };
 
-AudioEffectFilter::Holder AudioEffectFilter::CreateInstance(const string& loggerName)
+AudioEffectFilter::Holder AudioEffectFilter::CreateInstance(const string& loggerName, Backend backend)
 {
+    if (backend == BACKEND_NATIVE)
+        return AudioEffectFilter::Holder(new AudioEffectFilter_NativeImpl(loggerName), AUDIO_EFFECT_FILTER_HOLDER_DELETER);
     return AudioEffectFilter::Holder(new AudioEffectFilter_FFImpl(loggerName), AUDIO_EFFECT_FILTER_HOLDER_DELETER);
 }
 
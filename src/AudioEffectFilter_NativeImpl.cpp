@@ -0,0 +1,657 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "AudioEffectFilter_NativeImpl.h"
+extern "C"
+{
+    #include "libavutil/avutil.h"
+}
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AUDIO_EFFECT_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_EFFECT_NEON
+#endif
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+static const uint32_t MAX_EQ_BANDS = 16;
+
+// Same as ffmpeg's 'hermite_interpolation' in af_agate.c/af_sidechaincompress.c
+static double HermiteInterpolation(double x, double x0, double x1, double p0, double p1, double m0, double m1)
+{
+    const double width = x1-x0;
+    const double t = (x-x0)/width;
+    m0 *= width;
+    m1 *= width;
+    const double t2 = t*t;
+    const double t3 = t2*t;
+    const double ct0 = p0;
+    const double ct1 = m0;
+    const double ct2 = -3*p0-2*m0+3*p1-m1;
+    const double ct3 = 2*p0+m0-2*p1+m1;
+    return ct3*t3+ct2*t2+ct1*t+ct0;
+}
+
+void AudioEffectFilter_NativeImpl::DynamicsProcessor::Setup(bool gate, float thres, float ratio, float knee, float range, float attack, float release, uint32_t sampleRate)
+{
+    isGate = gate;
+    enabled = thres > 0 && ratio > 0;
+    if (!enabled)
+        return;
+    this->ratio = ratio;
+    this->knee = max(knee, 1.f);
+    this->range = range;
+    attackCoeff = min(1., 1./(attack*sampleRate/4000.));
+    releaseCoeff = min(1., 1./(release*sampleRate/4000.));
+    thresLog = log(thres);
+    const double linKneeStart = thres/sqrt(this->knee);
+    const double linKneeStop = thres*sqrt(this->knee);
+    adjKneeStart = linKneeStart*linKneeStart;
+    adjKneeStop = linKneeStop*linKneeStop;
+    kneeStart = log(linKneeStart);
+    kneeStop = log(linKneeStop);
+    compressedKneeStop = (kneeStop-thresLog)/ratio+thresLog;
+}
+
+double AudioEffectFilter_NativeImpl::DynamicsProcessor::CalcGain(double detected)
+{
+    linSlope += (detected-linSlope)*(detected > linSlope ? attackCoeff : releaseCoeff);
+    if (!enabled || linSlope <= 0)
+        return 1.;
+    if (isGate)
+    {
+        if (linSlope >= adjKneeStop)
+            return 1.;
+        const double slope = log(linSlope)/2;
+        double gain = (slope-thresLog)*ratio+thresLog;
+        if (knee > 1 && slope > kneeStart)
+            gain = HermiteInterpolation(slope, kneeStart, kneeStop, (kneeStart-thresLog)*ratio+thresLog, kneeStop, ratio, 1);
+        return max(range, exp(gain-slope));
+    }
+    else
+    {
+        if (linSlope <= adjKneeStart)
+            return 1.;
+        const double slope = log(linSlope)/2;
+        double gain = (slope-thresLog)/ratio+thresLog;
+        if (knee > 1 && slope < kneeStop)
+            gain = HermiteInterpolation(slope, kneeStart, kneeStop, kneeStart, compressedKneeStop, 1, 1/ratio);
+        return exp(gain-slope);
+    }
+}
+
+// Let the envelope release as if 'samples' samples of silence were detected
+void AudioEffectFilter_NativeImpl::DynamicsProcessor::Decay(uint64_t samples)
+{
+    if (linSlope <= 0)
+        return;
+    linSlope *= pow(1.-releaseCoeff, (double)samples);
+    if (linSlope < numeric_limits<double>::min())
+        linSlope = 0;
+}
+
+const std::vector<uint32_t> AudioEffectFilter_NativeImpl::DF_CENTER_FREQS = {
+    32, 64, 125, 250, 500, 1000, 2000, 4000, 8000, 16000
+};
+const std::vector<uint32_t> AudioEffectFilter_NativeImpl::DF_BAND_WTHS = {
+    32, 64, 125, 250, 500, 1000, 2000, 4000, 8000, 16000
+};
+
+AudioEffectFilter_NativeImpl::AudioEffectFilter_NativeImpl(const string& loggerName)
+{
+    if (loggerName.empty())
+        m_logger = AudioEffectFilter::GetLogger();
+    else
+    {
+        m_logger = Logger::GetLogger(loggerName);
+        int n;
+        Level l = AudioEffectFilter::GetLogger()->GetShowLevels(n);
+        m_logger->SetShowLevels(l, n);
+    }
+    m_setEqualizerParamsList.resize(DF_CENTER_FREQS.size(), {0});
+    m_currEqualizerParamsList = m_setEqualizerParamsList;
+}
+
+bool AudioEffectFilter_NativeImpl::Init(uint32_t composeFlags, const string& sampleFormat, uint32_t channels, uint32_t sampleRate)
+{
+    AVSampleFormat smpfmt = av_get_sample_fmt(sampleFormat.c_str());
+    if (smpfmt != AV_SAMPLE_FMT_FLT && smpfmt != AV_SAMPLE_FMT_FLTP)
+    {
+        ostringstream oss;
+        oss << "Invalid argument 'sampleFormat' for AudioEffectFilter::Init()! Value '" << sampleFormat << "' is NOT SUPPORTED, only 'flt' and 'fltp' are supported.";
+        m_errMsg = oss.str();
+        return false;
+    }
+    if (channels == 0)
+    {
+        ostringstream oss;
+        oss << "Invalid argument 'channels' for AudioEffectFilter::Init()! Value " << channels << " is a bad value.";
+        m_errMsg = oss.str();
+        return false;
+    }
+    if (sampleRate == 0)
+    {
+        ostringstream oss;
+        oss << "Invalid argument 'sampleRate' for AudioEffectFilter::Init()! Value " << sampleRate << " is a bad value.";
+        m_errMsg = oss.str();
+        return false;
+    }
+
+    if (composeFlags == 0)
+    {
+        m_logger->Log(DEBUG) << "This 'AudioEffectFilter' is using pass-through mode because 'composeFlags' is 0." << endl;
+        m_passThrough = true;
+    }
+    m_composeFlags = composeFlags;
+    m_channels = channels;
+    m_sampleRate = sampleRate;
+    m_isPlanar = av_sample_fmt_is_planar(smpfmt) == 1;
+
+    m_currVolumeParams = m_setVolumeParams;
+    m_currPanParams = m_setPanParams;
+    m_currLimiterParams = m_setLimiterParams;
+    m_currGateParams = m_setGateParams;
+    m_currCompressorParams = m_setCompressorParams;
+    m_currEqualizerParamsList = m_setEqualizerParamsList;
+    const auto& lp = m_currLimiterParams;
+    m_limiterAttackCoeff = 1.f-exp(-1000.f/(max(lp.attack, 0.1f)*sampleRate));
+    m_limiterReleaseCoeff = 1.f-exp(-1000.f/(max(lp.release, 1.f)*sampleRate));
+    const auto& gp = m_currGateParams;
+    m_gate.Setup(true, gp.threshold, gp.ratio, gp.knee, gp.range, gp.attack, gp.release, sampleRate);
+    const auto& cp = m_currCompressorParams;
+    m_compressor.Setup(false, cp.threshold, cp.ratio, cp.knee, 0, cp.attack, cp.release, sampleRate);
+    m_eqStates.assign((size_t)DF_CENTER_FREQS.size()*2*((channels+3)/4*4), 0.f);
+    UpdateEqualizerCoefs();
+    m_chGains.Configure(channels, m_isPlanar);
+    UpdatePanCoefs();
+    UpdateChannelGains(0, RAMP_LINEAR);
+
+    m_inited = true;
+    return true;
+}
+
+bool AudioEffectFilter_NativeImpl::ProcessData(const ImGui::ImMat& in, list<ImGui::ImMat>& out)
+{
+    out.clear();
+    if (!m_inited)
+    {
+        m_errMsg = "This 'AudioEffectFilter' instance is NOT INITIALIZED!";
+        return false;
+    }
+    if (in.empty())
+        return true;
+    if (m_passThrough)
+    {
+        out.push_back(in);
+        return true;
+    }
+    if (in.type != IM_DT_FLOAT32 || (uint32_t)in.c != m_channels || (in.elempack == 1) != m_isPlanar)
+    {
+        ostringstream oss;
+        oss << "Input audio frame does NOT match the format this 'AudioEffectFilter' is initialized with! type=" << in.type
+                << ", channels=" << in.c << ", elempack=" << in.elempack << ".";
+        m_errMsg = oss.str();
+        return false;
+    }
+
+    UpdateParameters();
+    // neutral settings, the input frame is passed out as it is without a copy
+    if (IsIdentity((const float*)in.data, (uint32_t)in.w))
+    {
+        m_bypassedSamples += (uint64_t)in.w;
+        out.push_back(in);
+        return true;
+    }
+
+    ImGui::ImMat m;
+    m.create_type(in.w, in.h, in.c, in.type);
+    m.elempack = in.elempack;
+    m.flags = IM_MAT_FLAGS_AUDIO_FRAME;
+    m.rate = { (int)m_sampleRate, 1 };
+    m.time_stamp = in.time_stamp;
+    const uint32_t samples = (uint32_t)in.w;
+    float* data = (float*)m.data;
+    if (m_setMuted)
+    {
+        m_bypassedSamples += (uint64_t)samples;
+        memset(m.data, 0, m.total()*m.elemsize);
+        out.push_back(m);
+        return true;
+    }
+    memcpy(m.data, in.data, m.total()*m.elemsize);
+    if (m_bypassedSamples > 0)
+        ResumeFromBypass();
+
+    if (HasFilter(LIMITER))
+        ProcessLimiter(data, samples);
+    if (HasFilter(GATE) && m_gate.enabled)
+        ProcessDynamics(m_gate, data, samples, 1.f, m_currGateParams.makeup, 1.f);
+    if (HasFilter(EQUALIZER) && !m_eqActiveBands.empty())
+        ProcessEqualizer(data, samples);
+    if (HasFilter(COMPRESSOR) && m_compressor.enabled)
+    {
+        const auto& cp = m_currCompressorParams;
+        ProcessDynamics(m_compressor, data, samples, cp.levelIn, cp.makeup, cp.mix);
+    }
+
+    // volume and pan are both per-channel gains, apply them in one pass
+    m_chGains.Process(data, samples);
+
+    out.push_back(m);
+    return true;
+}
+
+bool AudioEffectFilter_NativeImpl::HasFilter(uint32_t composeFlags) const
+{
+    return (m_composeFlags&composeFlags) == composeFlags;
+}
+
+bool AudioEffectFilter_NativeImpl::SetVolumeParams(VolumeParams* params)
+{
+    if (!HasFilter(VOLUME))
+    {
+        m_errMsg = "CANNOT set 'VolumeParams' because this instance is NOT initialized with 'AudioEffectFilter::VOLUME' compose-flag!";
+        return false;
+    }
+    m_setVolumeParams = *params;
+    return true;
+}
+
+bool AudioEffectFilter_NativeImpl::SetPanParams(PanParams* params)
+{
+    if (!HasFilter(PAN))
+    {
+        m_errMsg = "CANNOT set 'PanParams' because this instance is NOT initialized with 'AudioEffectFilter::PAN' compose-flag!";
+        return false;
+    }
+    m_setPanParams = *params;
+    return true;
+}
+
+bool AudioEffectFilter_NativeImpl::SetLimiterParams(LimiterParams* params)
+{
+    if (!HasFilter(LIMITER))
+    {
+        m_errMsg = "CANNOT set 'LimiterParams' because this instance is NOT initialized with 'AudioEffectFilter::LIMITER' compose-flag!";
+        return false;
+    }
+    m_setLimiterParams = *params;
+    return true;
+}
+
+bool AudioEffectFilter_NativeImpl::SetGateParams(GateParams* params)
+{
+    if (!HasFilter(GATE))
+    {
+        m_errMsg = "CANNOT set 'GateParams' because this instance is NOT initialized with 'AudioEffectFilter::GATE' compose-flag!";
+        return false;
+    }
+    m_setGateParams = *params;
+    return true;
+}
+
+bool AudioEffectFilter_NativeImpl::SetCompressorParams(CompressorParams* params)
+{
+    if (!HasFilter(COMPRESSOR))
+    {
+        m_errMsg = "CANNOT set 'CompressorParams' because this instance is NOT initialized with 'AudioEffectFilter::COMPRESSOR' compose-flag!";
+        return false;
+    }
+    m_setCompressorParams = *params;
+    return true;
+}
+
+AudioEffectFilter::EqualizerBandInfo AudioEffectFilter_NativeImpl::GetEqualizerBandInfo() const
+{
+    EqualizerBandInfo eqBandInfo;
+    eqBandInfo.bandCount = DF_CENTER_FREQS.size();
+    eqBandInfo.centerFreqList = DF_CENTER_FREQS.data();
+    eqBandInfo.bandWidthList = DF_BAND_WTHS.data();
+    return eqBandInfo;
+}
+
+bool AudioEffectFilter_NativeImpl::SetEqualizerParamsByIndex(EqualizerParams* params, uint32_t index)
+{
+    if (!HasFilter(EQUALIZER))
+    {
+        m_errMsg = "CANNOT set 'EqualizerParams' because this instance is NOT initialized with 'AudioEffectFilter::EQUALIZER' compose-flag!";
+        return false;
+    }
+    m_setEqualizerParamsList.at(index) = *params;
+    return true;
+}
+
+void AudioEffectFilter_NativeImpl::UpdateParameters()
+{
+    bool gainChanged = false;
+    uint32_t rampSamples = 0;
+    RampCurve rampCurve = RAMP_LINEAR;
+    if (m_setVolumeParams.volume != m_currVolumeParams.volume)
+    {
+        m_logger->Log(DEBUG) << "Change VolumeParams::volume: " << m_currVolumeParams.volume << " -> " << m_setVolumeParams.volume
+                << " in " << m_setVolumeParams.rampSamples << " samples." << endl;
+        m_currVolumeParams = m_setVolumeParams;
+        gainChanged = true;
+        rampSamples = m_currVolumeParams.rampSamples;
+        rampCurve = m_currVolumeParams.rampCurve;
+    }
+    if (m_setPanParams.x != m_currPanParams.x || m_setPanParams.y != m_currPanParams.y)
+    {
+        m_logger->Log(DEBUG) << "Change PanParams: (" << m_currPanParams.x << ", " << m_currPanParams.y << ") -> ("
+                << m_setPanParams.x << ", " << m_setPanParams.y << ") in " << m_setPanParams.rampSamples << " samples." << endl;
+        m_currPanParams = m_setPanParams;
+        UpdatePanCoefs();
+        if (!gainChanged || m_currPanParams.rampSamples > rampSamples)
+        {
+            rampSamples = m_currPanParams.rampSamples;
+            rampCurve = m_currPanParams.rampCurve;
+        }
+        gainChanged = true;
+    }
+    if (gainChanged)
+        UpdateChannelGains(rampSamples, rampCurve);
+    const auto& lp = m_setLimiterParams;
+    if (lp.limit != m_currLimiterParams.limit || lp.attack != m_currLimiterParams.attack || lp.release != m_currLimiterParams.release)
+    {
+        m_logger->Log(DEBUG) << "Change LimiterParams: limit=" << lp.limit << ", attack=" << lp.attack << ", release=" << lp.release << "." << endl;
+        m_currLimiterParams = lp;
+        m_limiterAttackCoeff = 1.f-exp(-1000.f/(max(lp.attack, 0.1f)*m_sampleRate));
+        m_limiterReleaseCoeff = 1.f-exp(-1000.f/(max(lp.release, 1.f)*m_sampleRate));
+    }
+    const auto& gp = m_setGateParams;
+    const auto& cgp = m_currGateParams;
+    if (gp.threshold != cgp.threshold || gp.range != cgp.range || gp.ratio != cgp.ratio || gp.attack != cgp.attack
+        || gp.release != cgp.release || gp.makeup != cgp.makeup || gp.knee != cgp.knee)
+    {
+        m_logger->Log(DEBUG) << "Change GateParams: threshold=" << gp.threshold << ", range=" << gp.range << ", ratio=" << gp.ratio
+                << ", attack=" << gp.attack << ", release=" << gp.release << ", makeup=" << gp.makeup << ", knee=" << gp.knee << "." << endl;
+        m_currGateParams = gp;
+        m_gate.Setup(true, gp.threshold, gp.ratio, gp.knee, gp.range, gp.attack, gp.release, m_sampleRate);
+    }
+    const auto& cp = m_setCompressorParams;
+    const auto& ccp = m_currCompressorParams;
+    if (cp.threshold != ccp.threshold || cp.ratio != ccp.ratio || cp.knee != ccp.knee || cp.mix != ccp.mix || cp.attack != ccp.attack
+        || cp.release != ccp.release || cp.makeup != ccp.makeup || cp.levelIn != ccp.levelIn)
+    {
+        m_logger->Log(DEBUG) << "Change CompressorParams: threshold=" << cp.threshold << ", ratio=" << cp.ratio << ", knee=" << cp.knee
+                << ", mix=" << cp.mix << ", attack=" << cp.attack << ", release=" << cp.release << ", makeup=" << cp.makeup
+                << ", levelIn=" << cp.levelIn << "." << endl;
+        m_currCompressorParams = cp;
+        m_compressor.Setup(false, cp.threshold, cp.ratio, cp.knee, 0, cp.attack, cp.release, m_sampleRate);
+    }
+    bool eqChanged = false;
+    for (size_t i = 0; i < m_setEqualizerParamsList.size(); i++)
+    {
+        if (m_setEqualizerParamsList[i].gain != m_currEqualizerParamsList[i].gain)
+        {
+            m_logger->Log(DEBUG) << "Change (CenterFreq@" << DF_CENTER_FREQS[i] << ") EqualizerParams::gain: "
+                    << m_currEqualizerParamsList[i].gain << " -> " << m_setEqualizerParamsList[i].gain << "." << endl;
+            m_currEqualizerParamsList[i] = m_setEqualizerParamsList[i];
+            eqChanged = true;
+        }
+    }
+    if (eqChanged)
+        UpdateEqualizerCoefs();
+}
+
+void AudioEffectFilter_NativeImpl::UpdateEqualizerCoefs()
+{
+    // RBJ peaking filters, with the band width in Hz as the 'equalizer' filter with 't=h'
+    const size_t bandCnt = DF_CENTER_FREQS.size();
+    m_eqCoefs.resize(bandCnt);
+    m_eqActiveBands.clear();
+    for (size_t i = 0; i < bandCnt; i++)
+    {
+        const int32_t gain = m_currEqualizerParamsList[i].gain;
+        const double freq = DF_CENTER_FREQS[i];
+        if (gain == 0 || freq*2 >= m_sampleRate || m_eqActiveBands.size() >= MAX_EQ_BANDS)
+            continue;
+        const double A = pow(10., gain/40.);
+        const double w0 = 2*M_PI*freq/m_sampleRate;
+        const double alpha = sin(w0)/(2*freq/DF_BAND_WTHS[i]);
+        const double a0 = 1+alpha/A;
+        auto& coefs = m_eqCoefs[i];
+        coefs.b0 = (float)((1+alpha*A)/a0);
+        coefs.b1 = (float)(-2*cos(w0)/a0);
+        coefs.b2 = (float)((1-alpha*A)/a0);
+        coefs.a1 = (float)(-2*cos(w0)/a0);
+        coefs.a2 = (float)((1-alpha/A)/a0);
+        m_eqActiveBands.push_back((uint32_t)i);
+    }
+}
+
+void AudioEffectFilter_NativeImpl::UpdatePanCoefs()
+{
+    if (HasFilter(PAN))
+        m_panCoefs = AudioChannelGains::CalcPanCoefs(m_channels, m_currPanParams.x, m_currPanParams.y);
+    else
+        m_panCoefs.assign(m_channels, 1.f);
+}
+
+void AudioEffectFilter_NativeImpl::UpdateChannelGains(uint32_t rampSamples, RampCurve rampCurve)
+{
+    const float volume = HasFilter(VOLUME) ? m_currVolumeParams.volume : 1.f;
+    vector<float> gains(m_channels);
+    for (uint32_t ch = 0; ch < m_channels; ch++)
+        gains[ch] = volume*m_panCoefs[ch];
+    m_chGains.SetTargets(gains, rampSamples, rampCurve);
+}
+
+bool AudioEffectFilter_NativeImpl::IsIdentity(const float* data, uint32_t samples)
+{
+    if (m_setMuted || !m_chGains.IsUnity())
+        return false;
+    if (HasFilter(EQUALIZER) && !m_eqActiveBands.empty())
+        return false;
+    if (HasFilter(GATE) && m_gate.enabled)
+        return false;
+    // the limiter and the compressor are no-op for this frame if its peak is below their thresholds,
+    // and their envelopes have fully recovered. The bypassed samples are counted so that 'ResumeFromBypass()' can
+    // release the envelopes and clear the equalizer states before the next processed frame.
+    const bool checkLimiter = HasFilter(LIMITER) && m_currLimiterParams.limit > 0;
+    const bool checkCompressor = HasFilter(COMPRESSOR) && m_compressor.enabled;
+    if (checkLimiter && m_limiterGain < 1.f)
+        return false;
+    if (checkCompressor)
+    {
+        const auto& cp = m_currCompressorParams;
+        if (cp.makeup != 1 || cp.levelIn != 1 || m_compressor.linSlope > m_compressor.adjKneeStart)
+            return false;
+    }
+    if (checkLimiter || checkCompressor)
+    {
+        const double peak = MaxAbsSample(data, (size_t)samples*m_channels);
+        if (checkLimiter && peak > m_currLimiterParams.limit)
+            return false;
+        if (checkCompressor && peak*peak > m_compressor.adjKneeStart)
+            return false;
+    }
+    return true;
+}
+
+// The processors' states are frozen while frames are bypassed. Bring them to where they would be after the bypassed
+// samples, otherwise the first processed frame starts from a stale envelope or filter history and can click.
+void AudioEffectFilter_NativeImpl::ResumeFromBypass()
+{
+    // the bypassed input was below the thresholds, so the envelopes are released toward zero
+    m_gate.Decay(m_bypassedSamples);
+    m_compressor.Decay(m_bypassedSamples);
+    // the biquad histories hold samples from before the bypass, which don't continue into this frame
+    fill(m_eqStates.begin(), m_eqStates.end(), 0.f);
+    m_bypassedSamples = 0;
+}
+
+void AudioEffectFilter_NativeImpl::ProcessLimiter(float* data, uint32_t samples)
+{
+    // Peak envelope follower with a hard clip at the limit, no lookahead as 'alimiter'
+    const float limit = m_currLimiterParams.limit;
+    if (limit <= 0)
+        return;
+    const uint32_t step = m_isPlanar ? 1 : m_channels;
+    float gain = m_limiterGain;
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        float peak = 0;
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+            peak = max(peak, fabs(ChannelPtr(data, ch, samples)[n*step]));
+        const float target = peak*gain > limit ? limit/peak : 1.f;
+        gain += (target-gain)*(target < gain ? m_limiterAttackCoeff : m_limiterReleaseCoeff);
+        const float g = peak*gain > limit ? limit/peak : gain;
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+            ChannelPtr(data, ch, samples)[n*step] *= g;
+    }
+    // the float envelope never reaches 1 by itself
+    m_limiterGain = gain > 0.99999f ? 1.f : gain;
+}
+
+void AudioEffectFilter_NativeImpl::ProcessDynamics(DynamicsProcessor& proc, float* data, uint32_t samples, float levelIn, float makeup, float mix)
+{
+    // RMS detection, with the channels linked by their average
+    const uint32_t step = m_isPlanar ? 1 : m_channels;
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        double detected = 0;
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+            detected += fabs(ChannelPtr(data, ch, samples)[n*step]*levelIn);
+        detected /= m_channels;
+        const double gain = proc.CalcGain(detected*detected);
+        const float g = (float)(levelIn*(gain*makeup*mix+(1.-mix)));
+        for (uint32_t ch = 0; ch < m_channels; ch++)
+            ChannelPtr(data, ch, samples)[n*step] *= g;
+    }
+}
+
+void AudioEffectFilter_NativeImpl::ProcessEqualizer(float* data, uint32_t samples)
+{
+    // The cascaded biquads are run in transposed direct form II, with up to 4 channels in the SIMD lanes.
+    // The states of the active bands are kept in registers during one frame.
+    const uint32_t bandCnt = (uint32_t)m_eqActiveBands.size();
+    const uint32_t step = m_isPlanar ? 1 : m_channels;
+    float dummy[1];
+    for (uint32_t ch0 = 0; ch0 < m_channels; ch0 += 4)
+    {
+        const uint32_t laneCnt = min(4u, m_channels-ch0);
+        float* lanes[4];
+        uint32_t laneSteps[4];
+        for (uint32_t l = 0; l < 4; l++)
+        {
+            lanes[l] = l < laneCnt ? ChannelPtr(data, ch0+l, samples) : dummy;
+            laneSteps[l] = l < laneCnt ? step : 0;
+        }
+        float* states = m_eqStates.data()+(size_t)ch0*DF_CENTER_FREQS.size()*2;
+#if defined(AUDIO_EFFECT_SSE)
+        __m128 b0[MAX_EQ_BANDS], b1[MAX_EQ_BANDS], b2[MAX_EQ_BANDS], a1[MAX_EQ_BANDS], a2[MAX_EQ_BANDS];
+        __m128 z1[MAX_EQ_BANDS], z2[MAX_EQ_BANDS];
+        for (uint32_t b = 0; b < bandCnt; b++)
+        {
+            const uint32_t bi = m_eqActiveBands[b];
+            const auto& c = m_eqCoefs[bi];
+            b0[b] = _mm_set1_ps(c.b0); b1[b] = _mm_set1_ps(c.b1); b2[b] = _mm_set1_ps(c.b2);
+            a1[b] = _mm_set1_ps(c.a1); a2[b] = _mm_set1_ps(c.a2);
+            z1[b] = _mm_loadu_ps(states+bi*8);
+            z2[b] = _mm_loadu_ps(states+bi*8+4);
+        }
+        dummy[0] = 0;
+        alignas(16) float buf[4];
+        for (uint32_t n = 0; n < samples; n++)
+        {
+            __m128 x = _mm_setr_ps(lanes[0][n*laneSteps[0]], lanes[1][n*laneSteps[1]], lanes[2][n*laneSteps[2]], lanes[3][n*laneSteps[3]]);
+            for (uint32_t b = 0; b < bandCnt; b++)
+            {
+                const __m128 y = _mm_add_ps(_mm_mul_ps(b0[b], x), z1[b]);
+                z1[b] = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(b1[b], x), z2[b]), _mm_mul_ps(a1[b], y));
+                z2[b] = _mm_sub_ps(_mm_mul_ps(b2[b], x), _mm_mul_ps(a2[b], y));
+                x = y;
+            }
+            _mm_store_ps(buf, x);
+            for (uint32_t l = 0; l < laneCnt; l++)
+                lanes[l][n*step] = buf[l];
+        }
+        for (uint32_t b = 0; b < bandCnt; b++)
+        {
+            const uint32_t bi = m_eqActiveBands[b];
+            _mm_storeu_ps(states+bi*8, z1[b]);
+            _mm_storeu_ps(states+bi*8+4, z2[b]);
+        }
+#elif defined(AUDIO_EFFECT_NEON)
+        float32x4_t z1[MAX_EQ_BANDS], z2[MAX_EQ_BANDS];
+        for (uint32_t b = 0; b < bandCnt; b++)
+        {
+            const uint32_t bi = m_eqActiveBands[b];
+            z1[b] = vld1q_f32(states+bi*8);
+            z2[b] = vld1q_f32(states+bi*8+4);
+        }
+        dummy[0] = 0;
+        float buf[4];
+        for (uint32_t n = 0; n < samples; n++)
+        {
+            for (uint32_t l = 0; l < 4; l++)
+                buf[l] = lanes[l][n*laneSteps[l]];
+            float32x4_t x = vld1q_f32(buf);
+            for (uint32_t b = 0; b < bandCnt; b++)
+            {
+                const auto& c = m_eqCoefs[m_eqActiveBands[b]];
+                const float32x4_t y = vmlaq_n_f32(z1[b], x, c.b0);
+                z1[b] = vmlsq_n_f32(vmlaq_n_f32(z2[b], x, c.b1), y, c.a1);
+                z2[b] = vmlsq_n_f32(vmulq_n_f32(x, c.b2), y, c.a2);
+                x = y;
+            }
+            vst1q_f32(buf, x);
+            for (uint32_t l = 0; l < laneCnt; l++)
+                lanes[l][n*step] = buf[l];
+        }
+        for (uint32_t b = 0; b < bandCnt; b++)
+        {
+            const uint32_t bi = m_eqActiveBands[b];
+            vst1q_f32(states+bi*8, z1[b]);
+            vst1q_f32(states+bi*8+4, z2[b]);
+        }
+#else
+        for (uint32_t l = 0; l < laneCnt; l++)
+        {
+            float* p = lanes[l];
+            for (uint32_t b = 0; b < bandCnt; b++)
+            {
+                const uint32_t bi = m_eqActiveBands[b];
+                const auto& c = m_eqCoefs[bi];
+                float z1 = states[bi*8+l], z2 = states[bi*8+4+l];
+                for (uint32_t n = 0; n < samples; n++)
+                {
+                    const float x = p[n*step];
+                    const float y = c.b0*x+z1;
+                    z1 = c.b1*x+z2-c.a1*y;
+                    z2 = c.b2*x-c.a2*y;
+                    p[n*step] = y;
+                }
+                states[bi*8+l] = z1;
+                states[bi*8+4+l] = z2;
+            }
+        }
+#endif
+    }
+}
+}
@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include <string>
+#include "AudioEffectFilter.h"
+#include "AudioDsp.h"
+
+namespace MediaCore
+{
+    // AudioEffectFilter backend doing the DSP in place on float32 (planar or interleaved) buffers, without filter graphs.
+    // The processing chain is the same as the FFmpeg backend: limiter, gate, equalizer, compressor, volume and pan.
+    class AudioEffectFilter_NativeImpl : public AudioEffectFilter
+    {
+    public:
+        AudioEffectFilter_NativeImpl(const std::string& loggerName = "");
+
+        bool Init(uint32_t composeFlags, const std::string& sampleFormat, uint32_t channels, uint32_t sampleRate) override;
+        bool ProcessData(const ImGui::ImMat& in, std::list<ImGui::ImMat>& out) override;
+        bool HasFilter(uint32_t composeFlags) const override;
+
+        bool SetVolumeParams(VolumeParams* params) override;
+        VolumeParams GetVolumeParams() const override { return m_setVolumeParams; }
+        bool SetPanParams(PanParams* params) override;
+        PanParams GetPanParams() const override { return m_setPanParams; }
+        bool SetLimiterParams(LimiterParams* params) override;
+        LimiterParams GetLimiterParams() const override { return m_setLimiterParams; }
+        bool SetGateParams(GateParams* params) override;
+        GateParams GetGateParams() const override { return m_setGateParams; }
+        bool SetCompressorParams(CompressorParams* params) override;
+        CompressorParams GetCompressorParams() const override { return m_setCompressorParams; }
+        EqualizerBandInfo GetEqualizerBandInfo() const override;
+        bool SetEqualizerParamsByIndex(EqualizerParams* params, uint32_t index) override;
+        EqualizerParams GetEqualizerParamsByIndex(uint32_t index) const override { return m_setEqualizerParamsList.at(index); }
+
+        void SetMuted(bool muted) override { m_setMuted = muted; }
+        bool IsMuted() const override { return m_setMuted; }
+
+        std::string GetError() const override { return m_errMsg; }
+
+    private:
+        // Gain computer shared by the gate and the compressor, ported from FFmpeg's 'agate' and 'acompressor'
+        struct DynamicsProcessor
+        {
+            bool isGate{false};
+            bool enabled{false};
+            double thresLog{0}, ratio{1}, knee{1}, range{0};
+            double attackCoeff{1}, releaseCoeff{1};
+            double kneeStart{0}, kneeStop{0};
+            // the detection is in RMS, so the linear knee bounds are squared
+            double adjKneeStart{0}, adjKneeStop{0};
+            double compressedKneeStop{0};
+            double linSlope{0};
+
+            void Setup(bool gate, float thres, float ratio, float knee, float range, float attack, float release, uint32_t sampleRate);
+            double CalcGain(double detected);
+            void Decay(uint64_t samples);
+        };
+
+        struct BiquadCoefs
+        {
+            float b0, b1, b2, a1, a2;
+        };
+
+        void UpdateParameters();
+        void UpdateEqualizerCoefs();
+        void UpdatePanCoefs();
+        void UpdateChannelGains(uint32_t rampSamples, RampCurve rampCurve);
+        bool IsIdentity(const float* data, uint32_t samples);
+        void ResumeFromBypass();
+        float* ChannelPtr(float* data, uint32_t ch, uint32_t samples) const { return m_isPlanar ? data+ch*samples : data+ch; }
+        void ProcessLimiter(float* data, uint32_t samples);
+        void ProcessDynamics(DynamicsProcessor& proc, float* data, uint32_t samples, float levelIn, float makeup, float mix);
+        void ProcessEqualizer(float* data, uint32_t samples);
+
+    private:
+        Logger::ALogger* m_logger;
+        uint32_t m_composeFlags{0};
+        bool m_inited{false};
+        bool m_passThrough{false};
+        uint32_t m_channels{0};
+        uint32_t m_sampleRate{0};
+        bool m_isPlanar{false};
+
+        static const std::vector<uint32_t> DF_CENTER_FREQS;
+        static const std::vector<uint32_t> DF_BAND_WTHS;
+        VolumeParams m_setVolumeParams, m_currVolumeParams;
+        PanParams m_setPanParams, m_currPanParams;
+        LimiterParams m_setLimiterParams, m_currLimiterParams;
+        GateParams m_setGateParams, m_currGateParams;
+        CompressorParams m_setCompressorParams, m_currCompressorParams;
+        std::vector<EqualizerParams> m_setEqualizerParamsList, m_currEqualizerParamsList;
+        bool m_setMuted{false};
+
+        float m_limiterGain{1.f};
+        float m_limiterAttackCoeff{1.f}, m_limiterReleaseCoeff{1.f};
+        DynamicsProcessor m_gate;
+        DynamicsProcessor m_compressor;
+        std::vector<BiquadCoefs> m_eqCoefs;
+        std::vector<uint32_t> m_eqActiveBands;  // the bands with non-zero gain
+        std::vector<float> m_eqStates;  // 2 states per band per channel, channels are grouped by 4
+        std::vector<float> m_panCoefs;
+        AudioChannelGains m_chGains;  // gains of volume and pan
+        uint64_t m_bypassedSamples{0};  // samples passed out without running the processors since the last processed frame
+        std::string m_errMsg;
+    };
+}
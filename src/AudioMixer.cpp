@@ -0,0 +1,170 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "AudioMixer.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AUDIO_MIXER_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_MIXER_NEON
+#endif
+
+using namespace std;
+
+namespace MediaCore
+{
+// dst[i] += src[i]*gain
+static void MulAdd(float* dst, const float* src, float gain, uint32_t count)
+{
+    uint32_t i = 0;
+#if defined(AUDIO_MIXER_SSE)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i+8 <= count; i += 8)
+    {
+        __m128 d0 = _mm_loadu_ps(dst+i);
+        __m128 d1 = _mm_loadu_ps(dst+i+4);
+        d0 = _mm_add_ps(d0, _mm_mul_ps(_mm_loadu_ps(src+i), g));
+        d1 = _mm_add_ps(d1, _mm_mul_ps(_mm_loadu_ps(src+i+4), g));
+        _mm_storeu_ps(dst+i, d0);
+        _mm_storeu_ps(dst+i+4, d1);
+    }
+#elif defined(AUDIO_MIXER_NEON)
+    const float32x4_t g = vdupq_n_f32(gain);
+    for (; i+8 <= count; i += 8)
+    {
+        vst1q_f32(dst+i, vmlaq_f32(vld1q_f32(dst+i), vld1q_f32(src+i), g));
+        vst1q_f32(dst+i+4, vmlaq_f32(vld1q_f32(dst+i+4), vld1q_f32(src+i+4), g));
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] += src[i]*gain;
+}
+
+// Interleave the planes of 'channels' channels, each has 'count' samples and they are stored one after another
+static void Interleave(float* dst, const float* planes, uint32_t channels, uint32_t count)
+{
+    uint32_t i = 0;
+    if (channels == 2)
+    {
+        const float* l = planes;
+        const float* r = planes+count;
+#if defined(AUDIO_MIXER_SSE)
+        for (; i+4 <= count; i += 4)
+        {
+            const __m128 lv = _mm_loadu_ps(l+i);
+            const __m128 rv = _mm_loadu_ps(r+i);
+            _mm_storeu_ps(dst+i*2, _mm_unpacklo_ps(lv, rv));
+            _mm_storeu_ps(dst+i*2+4, _mm_unpackhi_ps(lv, rv));
+        }
+#elif defined(AUDIO_MIXER_NEON)
+        for (; i+4 <= count; i += 4)
+        {
+            float32x4x2_t lr = { vld1q_f32(l+i), vld1q_f32(r+i) };
+            vst2q_f32(dst+i*2, lr);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            dst[i*2] = l[i];
+            dst[i*2+1] = r[i];
+        }
+        return;
+    }
+    if (channels == 1)
+    {
+        memcpy(dst, planes, count*sizeof(float));
+        return;
+    }
+    for (uint32_t ch = 0; ch < channels; ch++)
+    {
+        const float* src = planes+(size_t)ch*count;
+        float* d = dst+ch;
+        for (i = 0; i < count; i++, d += channels)
+            *d = src[i];
+    }
+}
+
+void AudioMixer::Configure(uint32_t channels, bool normalize)
+{
+    m_channels = channels;
+    m_normalize = normalize;
+    m_accum.clear();
+}
+
+bool AudioMixer::Mix(const vector<ImGui::ImMat>& inputs, const vector<float>& weights, uint32_t sampleCount, ImGui::ImMat& out)
+{
+    if (m_channels == 0)
+    {
+        m_errMsg = "AudioMixer is NOT configured!";
+        return false;
+    }
+    if (!weights.empty() && weights.size() != inputs.size())
+    {
+        m_errMsg = "The count of 'weights' doesn't match the count of 'inputs'!";
+        return false;
+    }
+    const size_t planeSize = sampleCount;
+    m_accum.assign(planeSize*m_channels, 0.f);
+
+    float weightSum = 0;
+    for (size_t i = 0; i < inputs.size(); i++)
+        weightSum += weights.empty() ? 1.f : fabs(weights[i]);
+    const float scale = m_normalize && weightSum > 0 ? 1.f/weightSum : 1.f;
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        const ImGui::ImMat& amat = inputs[i];
+        if (amat.empty())
+            continue;
+        if (amat.type != IM_DT_FLOAT32 || (uint32_t)amat.c != m_channels)
+        {
+            m_errMsg = "Input audio frame is NOT float32 or has different channel count!";
+            return false;
+        }
+        const float gain = (weights.empty() ? 1.f : weights[i])*scale;
+        if (gain == 0)
+            continue;
+        const uint32_t samples = min((uint32_t)amat.w, sampleCount);
+        const float* src = (const float*)amat.data;
+        if (amat.elempack == 1)
+        {
+            // the planes are stored one after another, each has 'amat.w' samples
+            for (uint32_t ch = 0; ch < m_channels; ch++)
+                MulAdd(m_accum.data()+ch*planeSize, src+(size_t)ch*amat.w, gain, samples);
+        }
+        else
+        {
+            for (uint32_t n = 0; n < samples; n++)
+            {
+                for (uint32_t ch = 0; ch < m_channels; ch++)
+                    m_accum[ch*planeSize+n] += src[n*m_channels+ch]*gain;
+            }
+        }
+    }
+
+    out.create((int)sampleCount, 1, (int)m_channels, (size_t)4);
+    Interleave((float*)out.data, m_accum.data(), m_channels, sampleCount);
+    out.type = IM_DT_FLOAT32;
+    out.elempack = m_channels;
+    out.flags = IM_MAT_FLAGS_AUDIO_FRAME;
+    return true;
+}
+}
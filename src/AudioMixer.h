@@ -0,0 +1,44 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "immat.h"
+
+namespace MediaCore
+{
+    // Mixes float32 audio frames of any number of inputs into one interleaved frame, in the same way as
+    // the 'amix' filter: each input is scaled by its weight and summed, and with 'normalize' the weights
+    // are divided by their sum. The inputs can be planar or interleaved, and the input count can change
+    // from call to call, so no rebuild is needed when tracks are added or removed.
+    class AudioMixer
+    {
+    public:
+        void Configure(uint32_t channels, bool normalize);
+        // Weights are 1 if 'weights' is empty. The inputs shorter than 'sampleCount' are padded with silence.
+        bool Mix(const std::vector<ImGui::ImMat>& inputs, const std::vector<float>& weights, uint32_t sampleCount, ImGui::ImMat& out);
+        std::string GetError() const { return m_errMsg; }
+
+    private:
+        uint32_t m_channels{0};
+        bool m_normalize{false};
+        std::vector<float> m_accum;  // planar accumulating buffer
+        std::string m_errMsg;
+    };
+}
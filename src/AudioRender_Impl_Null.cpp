@@ -0,0 +1,101 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <sstream>
+#include "AudioRender_Impl_Null.h"
+
+using namespace std;
+
+namespace MediaCore
+{
+static const uint32_t NULL_RENDER_DEFAULT_BUFFER_SAMPLES = 512;
+
+bool AudioRender_Impl_Null::OpenDevice(uint32_t sampleRate, uint32_t channels, PcmFormat format, ByteStream* pcmStream, uint32_t bufferSamples)
+{
+    CloseDevice();
+    const uint32_t bytesPerSample = GetBytesPerSampleByFormat(format);
+    if (sampleRate == 0 || channels == 0 || bytesPerSample == 0 || !pcmStream)
+    {
+        ostringstream oss;
+        oss << "INVALID arguments for AudioRender::OpenDevice()! sampleRate=" << sampleRate << ", channels=" << channels
+                << ", bytesPerSample=" << (int)bytesPerSample << ", pcmStream=" << pcmStream << ".";
+        m_errMessage = oss.str();
+        return false;
+    }
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_pcmFormat = format;
+    m_pcmStream = pcmStream;
+    m_bufferSamples = bufferSamples > 0 ? bufferSamples : NULL_RENDER_DEFAULT_BUFFER_SAMPLES;
+    m_buffer.resize((size_t)m_bufferSamples*bytesPerSample*channels);
+    // same as SDL, the device is paused after opened
+    m_paused = true;
+    m_quit = false;
+    m_renderThread = thread(&AudioRender_Impl_Null::RenderThreadProc, this);
+    return true;
+}
+
+void AudioRender_Impl_Null::CloseDevice()
+{
+    if (m_renderThread.joinable())
+    {
+        m_quit = true;
+        m_renderThread.join();
+    }
+    m_sampleRate = 0;
+    m_channels = 0;
+    m_pcmFormat = PcmFormat::UNKNOWN;
+    m_pcmStream = nullptr;
+}
+
+void AudioRender_Impl_Null::Flush()
+{
+    if (m_pcmStream)
+        m_pcmStream->Flush();
+    m_latencyMeter.Reset();
+}
+
+void AudioRender_Impl_Null::RenderThreadProc()
+{
+    const chrono::microseconds period((int64_t)m_bufferSamples*1000000/m_sampleRate);
+    const uint32_t frameSize = GetBytesPerSampleByFormat(m_pcmFormat)*m_channels;
+    auto nextPullTime = chrono::steady_clock::now();
+    while (!m_quit)
+    {
+        if (m_paused)
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            nextPullTime = chrono::steady_clock::now();
+            continue;
+        }
+        const uint32_t buffSize = (uint32_t)m_buffer.size();
+        uint32_t readSize = m_pcmStream->Read(m_buffer.data(), buffSize, true);
+        if (readSize < buffSize)
+            memset(m_buffer.data()+readSize, 0, buffSize-readSize);
+        // like a real device, the pulled buffer is played after the one being played now
+        m_latencyMeter.OnPull(m_buffer.data(), buffSize, frameSize, m_sampleRate, period.count());
+        nextPullTime += period;
+        this_thread::sleep_until(nextPullTime);
+    }
+}
+
+AudioRender* AudioRender::CreateNullInstance()
+{
+    return static_cast<AudioRender*>(new AudioRender_Impl_Null());
+}
+}
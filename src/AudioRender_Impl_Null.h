@@ -0,0 +1,64 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include "AudioRender.h"
+#include "AudibleLatencyMeter.h"
+
+namespace MediaCore
+{
+    class AudioRender_Impl_Null : public AudioRender
+    {
+    public:
+        AudioRender_Impl_Null() = default;
+        AudioRender_Impl_Null(const AudioRender_Impl_Null&) = delete;
+        AudioRender_Impl_Null& operator=(const AudioRender_Impl_Null&) = delete;
+        virtual ~AudioRender_Impl_Null() { CloseDevice(); }
+
+        bool Initialize() override { return true; }
+        bool OpenDevice(uint32_t sampleRate, uint32_t channels, PcmFormat format, ByteStream* pcmStream, uint32_t bufferSamples) override;
+        void CloseDevice() override;
+        bool Pause() override { m_paused = true; return true; }
+        bool Resume() override { m_paused = false; return true; }
+        void Flush() override;
+        uint32_t GetBufferedDataSize() override { return (uint32_t)m_buffer.size(); }
+        int64_t GetFlushToAudibleLatency() const override { return m_latencyMeter.GetLatency(); }
+
+        std::string GetError() const override { return m_errMessage; }
+
+    private:
+        void RenderThreadProc();
+
+    private:
+        uint32_t m_sampleRate{0};
+        uint32_t m_channels{0};
+        PcmFormat m_pcmFormat{PcmFormat::UNKNOWN};
+        ByteStream* m_pcmStream{nullptr};
+        std::vector<uint8_t> m_buffer;
+        uint32_t m_bufferSamples{0};
+        std::thread m_renderThread;
+        std::atomic_bool m_quit{false};
+        std::atomic_bool m_paused{true};
+        AudibleLatencyMeter m_latencyMeter;
+        std::string m_errMessage;
+    };
+}
@@ -19,6 +19,7 @@
 #include <sstream>
 #include <SDL.h>
 #include "AudioRender.h"
+#include "AudibleLatencyMeter.h"
 
 using namespace std;
 
@@ -86,7 +87,7 @@ public:
         return true;
     }
 
-    bool OpenDevice(uint32_t sampleRate, uint32_t channels, PcmFormat format, ByteStream* pcmStream) override
+    bool OpenDevice(uint32_t sampleRate, uint32_t channels, PcmFormat format, ByteStream* pcmStream, uint32_t bufferSamples) override
     {
         CloseDevice();
         SDL_AudioSpec desiredAudSpec, obtainedAudSpec;
@@ -94,7 +95,10 @@ public:
         desiredAudSpec.freq = sampleRate;
         desiredAudSpec.format = PcmFormatToSDLAudioFormat(format);
         desiredAudSpec.silence = 0;
-        desiredAudSpec.samples = MAX(SDL_AUDIO_MIN_BUFFER_SIZE, 2 << log2_c(desiredAudSpec.freq / SDL_AUDIO_MAX_CALLBACKS_PER_SEC));
+        if (bufferSamples > 0)
+            desiredAudSpec.samples = bufferSamples;
+        else
+            desiredAudSpec.samples = MAX(SDL_AUDIO_MIN_BUFFER_SIZE, 2 << log2_c(desiredAudSpec.freq / SDL_AUDIO_MAX_CALLBACKS_PER_SEC));
         desiredAudSpec.callback = sdl_audio_callback;
         desiredAudSpec.userdata = this;
         m_audDevId = SDL_OpenAudioDevice(NULL, 0, &desiredAudSpec, &obtainedAudSpec, 0);
@@ -110,6 +114,7 @@ public:
         m_pcmFormat = format;
         m_pcmStream = pcmStream;
         m_renderBufferSize = obtainedAudSpec.samples*GetBytesPerSampleByFormat(format)*channels;
+        m_renderBufferDuration = (int64_t)obtainedAudSpec.samples*1000000/obtainedAudSpec.freq;
         return true;
     }
 
@@ -146,6 +151,7 @@ public:
             SDL_ClearQueuedAudio(m_audDevId);
         if (m_pcmStream)
             m_pcmStream->Flush();
+        m_latencyMeter.Reset();
     }
 
     uint32_t GetBufferedDataSize() override
@@ -155,6 +161,11 @@ public:
         return m_renderBufferSize;
     }
 
+    int64_t GetFlushToAudibleLatency() const override
+    {
+        return m_latencyMeter.GetLatency();
+    }
+
     string GetError() const override
     {
         return m_errMessage;
@@ -165,6 +176,8 @@ public:
         uint32_t readSize = m_pcmStream->Read(buf, buffSize, true);
         if (readSize < buffSize)
             memset(buf+readSize, 0, buffSize-readSize);
+        // the buffer filled in this callback is played after the one in the device
+        m_latencyMeter.OnPull(buf, buffSize, GetBytesPerSampleByFormat(m_pcmFormat)*m_channels, m_sampleRate, m_renderBufferDuration);
     }
 
 private:
@@ -192,6 +205,8 @@ private:
     std::string m_errMessage;
     int64_t m_pcmdataEndTimestamp{0};
     int32_t m_renderBufferSize{0};
+    int64_t m_renderBufferDuration{0};
+    AudibleLatencyMeter m_latencyMeter;
 };
 
 void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
@@ -207,13 +222,10 @@ AudioRender* AudioRender::CreateInstance()
 
 void AudioRender::ReleaseInstance(AudioRender** audrnd)
 {
-    if (!audrnd)
-        return;
-    AudioRender_Impl_Sdl2* sdlrnd = dynamic_cast<AudioRender_Impl_Sdl2*>(*audrnd);
-    if (!sdlrnd)
+    if (!audrnd || !*audrnd)
         return;
-    sdlrnd->CloseDevice();
-    delete sdlrnd;
+    (*audrnd)->CloseDevice();
+    delete *audrnd;
     *audrnd = nullptr;
 }
 
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include "AudioTrack.h"
 #include "FFUtils.h"
+#include "TimelineIndex.h"
 extern "C"
 {
     #include "libavutil/samplefmt.h"
@@ -35,6 +36,7 @@ class AudioTrack_Impl : public AudioTrack
 public:
     AudioTrack_Impl(int64_t id, uint32_t outChannels, uint32_t outSampleRate, const string& outSampleFormat)
         : m_id(id), m_outChannels(outChannels), m_outSampleRate(outSampleRate), m_outSampleFormat(outSampleFormat)
+        , m_clipIndex(m_clips), m_overlapIndex(m_overlaps)
     {
         AVSampleFormat m_outAvSmpfmt = av_get_sample_fmt(outSampleFormat.c_str());
         if (m_outAvSmpfmt == AV_SAMPLE_FMT_NONE)
@@ -232,6 +234,7 @@ public:
     {
         lock_guard<recursive_mutex> lk(m_apiLock);
         pos = (double)m_readSamples/m_outSampleRate;
+        NotifyClipsNearReadPos(m_readSamples*1000/m_outSampleRate);
         uint32_t readSamples = 0, toReadSamples = size/m_frameSize;
         unique_ptr<uint8_t*[]> planbuf(new uint8_t* [m_outChannels]);
         for (int i = 0; i < m_outChannels; i++)
@@ -582,11 +585,17 @@ public:
 private:
     static function<bool(const AudioClip::Holder&, const AudioClip::Holder&)> CLIP_SORT_CMP;
     static function<bool(const AudioOverlap::Holder&, const AudioOverlap::Holder&)> OVERLAP_SORT_CMP;
+    // range around the read position in which the clips are sought in advance
+    static const int64_t CLIP_SEEK_RANGE = 2000;
+    // range around the read position in which the clips are notified, it must be larger than the clip release range
+    static const int64_t CLIP_RELEASE_NOTIFY_RANGE = 4000;
 
     bool CheckClipRangeValid(int64_t clipId, int64_t start, int64_t end)
     {
-        for (auto& overlap : m_overlaps)
+        m_overlapIndex.Query(start, end, m_queryResult);
+        for (auto idx : m_queryResult)
         {
+            auto& overlap = *m_overlapIndex.GetEntry(idx).iter;
             if (clipId == overlap->FrontClip()->Id() || clipId == overlap->RearClip()->Id())
                 continue;
             if ((start > overlap->Start() && start < overlap->End()) ||
@@ -599,6 +608,7 @@ private:
     void UpdateClipOverlap(AudioClip::Holder hUpdateClip, bool remove = false)
     {
         const int64_t id1 = hUpdateClip->Id();
+        m_clipIndex.Rebuild();
         // remove invalid overlaps
         auto ovIter = m_overlaps.begin();
         while (ovIter != m_overlaps.end())
@@ -623,8 +633,10 @@ private:
         if (!remove)
         {
             // add new overlaps
-            for (auto& clip : m_clips)
+            m_clipIndex.Query(hUpdateClip->Start(), hUpdateClip->End(), m_queryResult);
+            for (auto idx : m_queryResult)
             {
+                auto& clip = *m_clipIndex.GetEntry(idx).iter;
                 if (hUpdateClip == clip)
                     continue;
                 if (AudioOverlap::HasOverlap(hUpdateClip, clip))
@@ -646,6 +658,7 @@ private:
 
         // sort overlap by 'Start' time
         m_overlaps.sort(OVERLAP_SORT_CMP);
+        m_overlapIndex.Rebuild();
     }
 
     uint32_t ReadClipData(uint8_t** buf, uint32_t toReadSamples)
@@ -785,67 +798,54 @@ private:
     {
         if (m_readForward)
         {
-            // update read clip iterator
-            m_readClipIter = m_clips.end();
-            {
-                auto iter = m_clips.begin();
-                while (iter != m_clips.end())
-                {
-                    const AudioClip::Holder& hClip = *iter;
-                    int64_t clipPos = pos-hClip->Start();
-                    hClip->SeekTo(clipPos);
-                    if (m_readClipIter == m_clips.end() && clipPos < hClip->Duration())
-                        m_readClipIter = iter;
-                    iter++;
-                }
-            }
-            // update read overlap iterator
-            m_readOverlapIter = m_overlaps.end();
-            {
-                auto iter = m_overlaps.begin();
-                while (iter != m_overlaps.end())
-                {
-                    const AudioOverlap::Holder& hOverlap = *iter;
-                    int64_t overlapPos = pos-hOverlap->Start();
-                    if (m_readOverlapIter == m_overlaps.end() && overlapPos < hOverlap->Duration())
-                    {
-                        m_readOverlapIter = iter;
-                        break;
-                    }
-                    iter++;
-                }
-            }
+            m_readClipIter = m_clipIndex.FindForward(pos);
+            m_readOverlapIter = m_overlapIndex.FindForward(pos);
         }
         else
         {
-            m_readClipIter = m_clips.end();
-            {
-                auto riter = m_clips.rbegin();
-                while (riter != m_clips.rend())
-                {
-                    const AudioClip::Holder& hClip = *riter;
-                    int64_t clipPos = pos-hClip->Start();
-                    hClip->SeekTo(clipPos);
-                    if (m_readClipIter == m_clips.end() && clipPos >= 0)
-                        m_readClipIter = riter.base();
-                    riter++;
-                }
-            }
-            m_readOverlapIter = m_overlaps.end();
+            m_readClipIter = m_clipIndex.FindBackward(pos);
+            m_readOverlapIter = m_overlapIndex.FindBackward(pos);
+        }
+        // only the clips near the read position are sought now, the others are sought when they are approached
+        m_seekSerial++;
+        SeekClipsNearReadPos(pos);
+    }
+
+    void SeekClipsNearReadPos(int64_t readPos)
+    {
+        m_clipIndex.Query(readPos-CLIP_SEEK_RANGE, readPos+CLIP_SEEK_RANGE, m_queryResult);
+        for (auto idx : m_queryResult)
+        {
+            auto& entry = m_clipIndex.GetEntry(idx);
+            if (entry.seekSerial != m_seekSerial)
             {
-                auto riter = m_overlaps.rbegin();
-                while (riter != m_overlaps.rend())
-                {
-                    const AudioOverlap::Holder& hOverlap = *riter;
-                    int64_t overlapPos = pos-hOverlap->Start();
-                    if (m_readOverlapIter == m_overlaps.end() && overlapPos >= 0)
-                        m_readOverlapIter = riter.base();
-                    riter++;
-                }
+                const AudioClip::Holder& hClip = *entry.iter;
+                hClip->SeekTo(readPos-hClip->Start());
+                entry.seekSerial = m_seekSerial;
             }
         }
     }
 
+    void NotifyClipsNearReadPos(int64_t readPos)
+    {
+        SeekClipsNearReadPos(readPos);
+        // the notifications go further than the seek range, so that the clips get released before they stop being notified
+        m_clipIndex.Query(readPos-CLIP_RELEASE_NOTIFY_RANGE, readPos+CLIP_RELEASE_NOTIFY_RANGE, m_queryResult);
+        // clips leaving the notify range get a last notification, so they can release their readers
+        vector<AudioClip::Holder> nearClips;
+        nearClips.reserve(m_queryResult.size());
+        for (auto idx : m_queryResult)
+            nearClips.push_back(*m_clipIndex.GetEntry(idx).iter);
+        for (auto& hClip : m_notifiedClips)
+        {
+            if (hClip->TrackId() == m_id && find(nearClips.begin(), nearClips.end(), hClip) == nearClips.end())
+                hClip->NotifyReadPos(readPos-hClip->Start());
+        }
+        for (auto& hClip : nearClips)
+            hClip->NotifyReadPos(readPos-hClip->Start());
+        m_notifiedClips = std::move(nearClips);
+    }
+
     void CopyMatData(uint8_t** dstbuf, uint32_t dstOffset, ImGui::ImMat& srcmat)
     {
         if (m_isPlanar)
@@ -917,6 +917,11 @@ private:
     list<AudioClip::Holder>::iterator m_readClipIter;
     list<AudioOverlap::Holder> m_overlaps;
     list<AudioOverlap::Holder>::iterator m_readOverlapIter;
+    TimelineIndex<AudioClip::Holder> m_clipIndex;
+    TimelineIndex<AudioOverlap::Holder> m_overlapIndex;
+    vector<size_t> m_queryResult;
+    vector<AudioClip::Holder> m_notifiedClips;
+    uint32_t m_seekSerial{0};
     int64_t m_readSamples{0};
     int64_t m_duration{0};
     list<ImGui::ImMat> m_cachedMats;
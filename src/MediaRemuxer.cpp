@@ -0,0 +1,527 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <mutex>
+#include <atomic>
+#include <sstream>
+#include <algorithm>
+#include "MediaRemuxer.h"
+#include "FFUtils.h"
+extern "C"
+{
+    #include "libavutil/avutil.h"
+    #include "libavformat/avformat.h"
+    #include "libavcodec/avcodec.h"
+}
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+class MediaRemuxer_Impl : public MediaRemuxer
+{
+public:
+    MediaRemuxer_Impl()
+    {
+        m_logger = MediaRemuxer::GetLogger();
+    }
+
+    MediaRemuxer_Impl(const MediaRemuxer_Impl&) = delete;
+    MediaRemuxer_Impl(MediaRemuxer_Impl&&) = delete;
+    MediaRemuxer_Impl& operator=(const MediaRemuxer_Impl&) = delete;
+
+    bool Remux(MediaParser::Holder hParser, const string& url,
+            const vector<pair<int64_t, int64_t>>& ranges, const vector<int>& streamIndices) override
+    {
+        lock_guard<mutex> lk(m_apiLock);
+        m_cancel = false;
+        m_finished = false;
+        m_totalDuration = m_doneDuration = 0;
+        if (!hParser || !hParser->IsOpened())
+        {
+            m_errMsg = "Argument 'hParser' is NOT OPENED!";
+            return false;
+        }
+
+        bool success = OpenInput(hParser->GetUrl());
+        if (success)
+            success = SelectStreams(streamIndices);
+        vector<pair<int64_t, int64_t>> usRanges;
+        if (success)
+            success = PrepareRanges(hParser, ranges, usRanges);
+        if (success)
+            success = MeasureReorderDelays(usRanges);
+        if (success)
+            success = OpenOutput(url);
+        if (success)
+        {
+            int64_t outOffset = 0;
+            for (size_t i = 0; i < usRanges.size(); i++)
+            {
+                auto& range = usRanges[i];
+                if (!CopyRange(i, range.first, range.second, outOffset))
+                {
+                    success = false;
+                    break;
+                }
+                outOffset += range.second-range.first;
+            }
+            if (success && m_cancel)
+            {
+                m_errMsg = "Remuxing is canceled.";
+                success = false;
+            }
+            int fferr = av_write_trailer(m_ofmtCtx);
+            if (fferr < 0 && success)
+            {
+                m_errMsg = FFapiFailureMessage("av_write_trailer", fferr);
+                success = false;
+            }
+        }
+        CloseAll();
+        m_finished = success;
+        return success;
+    }
+
+    void Cancel() override
+    {
+        m_cancel = true;
+    }
+
+    float GetProgress() const override
+    {
+        if (m_finished)
+            return 1.f;
+        if (m_totalDuration <= 0)
+            return 0.f;
+        return (float)min((double)m_doneDuration/m_totalDuration, 1.);
+    }
+
+    string GetError() const override
+    {
+        return m_errMsg;
+    }
+
+private:
+    string FFapiFailureMessage(const string& apiName, int fferr)
+    {
+        ostringstream oss;
+        oss << "FF api '" << apiName << "' returns error! fferr=" << fferr << ".";
+        return oss.str();
+    }
+
+    bool OpenInput(const string& inputUrl)
+    {
+        int fferr = avformat_open_input(&m_ifmtCtx, inputUrl.c_str(), nullptr, nullptr);
+        if (fferr < 0)
+        {
+            m_errMsg = FFapiFailureMessage("avformat_open_input", fferr);
+            return false;
+        }
+        fferr = avformat_find_stream_info(m_ifmtCtx, nullptr);
+        if (fferr < 0)
+        {
+            m_errMsg = FFapiFailureMessage("avformat_find_stream_info", fferr);
+            return false;
+        }
+        return true;
+    }
+
+    bool SelectStreams(const vector<int>& streamIndices)
+    {
+        m_outStmIdx.assign(m_ifmtCtx->nb_streams, -1);
+        m_vidStmIdx = -1;
+        int outIdx = 0;
+        for (int i = 0; i < (int)m_ifmtCtx->nb_streams; i++)
+        {
+            const AVMediaType mediaType = m_ifmtCtx->streams[i]->codecpar->codec_type;
+            bool selected;
+            if (streamIndices.empty())
+                selected = mediaType == AVMEDIA_TYPE_VIDEO || mediaType == AVMEDIA_TYPE_AUDIO || mediaType == AVMEDIA_TYPE_SUBTITLE;
+            else
+                selected = find(streamIndices.begin(), streamIndices.end(), i) != streamIndices.end();
+            if (!selected)
+                continue;
+            m_outStmIdx[i] = outIdx++;
+            if (mediaType == AVMEDIA_TYPE_VIDEO && m_vidStmIdx < 0)
+                m_vidStmIdx = i;
+        }
+        if (outIdx == 0)
+        {
+            m_errMsg = "No stream is selected to remux!";
+            return false;
+        }
+        return true;
+    }
+
+    // Convert the ranges into microsecond, snap them to the video seek points, then sort and merge them
+    bool PrepareRanges(MediaParser::Holder hParser, const vector<pair<int64_t, int64_t>>& ranges, vector<pair<int64_t, int64_t>>& usRanges)
+    {
+        const int64_t mediaDuration = m_ifmtCtx->duration != AV_NOPTS_VALUE ? m_ifmtCtx->duration : INT64_MAX;
+        vector<int64_t> seekPoints;
+        vector<int64_t> seekPointPts;
+        if (m_vidStmIdx >= 0 && m_vidStmIdx == hParser->GetBestVideoStreamIndex())
+        {
+            hParser->EnableParseInfo(MediaParser::VIDEO_SEEK_POINTS);
+            auto hSeekPoints = hParser->GetVideoSeekPoints(true);
+            if (hSeekPoints)
+            {
+                const AVStream* vidStm = m_ifmtCtx->streams[m_vidStmIdx];
+                const int64_t stmStart = vidStm->start_time != AV_NOPTS_VALUE ? vidStm->start_time : 0;
+                for (int64_t pts : *hSeekPoints)
+                {
+                    seekPoints.push_back(av_rescale_q(pts-stmStart, vidStm->time_base, MICROSEC_TIMEBASE));
+                    seekPointPts.push_back(pts);
+                }
+            }
+            if (seekPoints.empty())
+                m_logger->Log(WARN) << "No video seek point is available, the ranges are NOT snapped to key frames." << endl;
+        }
+
+        if (ranges.empty())
+            usRanges.push_back({0, mediaDuration});
+        for (auto& range : ranges)
+        {
+            int64_t start = max(range.first, (int64_t)0)*1000;
+            int64_t end = min(range.second*1000, mediaDuration);
+            if (end <= start)
+                continue;
+            if (!seekPoints.empty())
+            {
+                auto iter = upper_bound(seekPoints.begin(), seekPoints.end(), start);
+                start = iter == seekPoints.begin() ? 0 : *(iter-1);
+                iter = lower_bound(seekPoints.begin(), seekPoints.end(), end);
+                // the range ends at a key frame starting a closed GOP, the leading pictures of an open GOP depend on it
+                while (iter != seekPoints.end() && !IsClosedGopStart(seekPointPts[iter-seekPoints.begin()]))
+                    iter++;
+                end = iter == seekPoints.end() ? mediaDuration : *iter;
+            }
+            usRanges.push_back({start, end});
+        }
+        sort(usRanges.begin(), usRanges.end());
+        vector<pair<int64_t, int64_t>> merged;
+        for (auto& range : usRanges)
+        {
+            if (!merged.empty() && range.first <= merged.back().second)
+                merged.back().second = max(merged.back().second, range.second);
+            else
+                merged.push_back(range);
+        }
+        usRanges.swap(merged);
+        if (usRanges.empty())
+        {
+            m_errMsg = "No valid range to remux!";
+            return false;
+        }
+        if (usRanges.back().second == INT64_MAX)
+        {
+            m_errMsg = "The media duration is unknown, the ranges must be bounded!";
+            return false;
+        }
+        for (auto& range : usRanges)
+            m_totalDuration += range.second-range.first;
+        return true;
+    }
+
+    // Whether the video key frame at 'keyPts' starts a closed GOP, that is, no leading picture follows it in decoding order
+    bool IsClosedGopStart(int64_t keyPts)
+    {
+        if (av_seek_frame(m_ifmtCtx, m_vidStmIdx, keyPts, AVSEEK_FLAG_BACKWARD) < 0)
+            return false;
+        AVPacket* pkt = av_packet_alloc();
+        bool keyFound = false;
+        bool closed = false;
+        // the leading pictures come right after the key frame, before any trailing picture
+        for (int i = 0; i < 256 && av_read_frame(m_ifmtCtx, pkt) >= 0; i++)
+        {
+            const bool isVideo = pkt->stream_index == m_vidStmIdx;
+            const int64_t pts = pkt->pts;
+            const bool isKey = (pkt->flags&AV_PKT_FLAG_KEY) != 0;
+            av_packet_unref(pkt);
+            if (!isVideo || pts == AV_NOPTS_VALUE)
+                continue;
+            if (!keyFound)
+            {
+                keyFound = isKey && pts == keyPts;
+                if (pts > keyPts)
+                    break;
+                continue;
+            }
+            closed = pts > keyPts;
+            break;
+        }
+        av_packet_free(&pkt);
+        return closed;
+    }
+
+    bool SeekToRangeStart(int64_t start)
+    {
+        int fferr;
+        if (m_vidStmIdx >= 0)
+        {
+            const AVStream* vidStm = m_ifmtCtx->streams[m_vidStmIdx];
+            const int64_t stmStart = vidStm->start_time != AV_NOPTS_VALUE ? vidStm->start_time : 0;
+            fferr = av_seek_frame(m_ifmtCtx, m_vidStmIdx, av_rescale_q(start, MICROSEC_TIMEBASE, vidStm->time_base)+stmStart, AVSEEK_FLAG_BACKWARD);
+        }
+        else
+        {
+            const int64_t fmtStart = m_ifmtCtx->start_time != AV_NOPTS_VALUE ? m_ifmtCtx->start_time : 0;
+            fferr = av_seek_frame(m_ifmtCtx, -1, start+fmtStart, AVSEEK_FLAG_BACKWARD);
+        }
+        if (fferr < 0)
+        {
+            m_errMsg = FFapiFailureMessage("av_seek_frame", fferr);
+            return false;
+        }
+        return true;
+    }
+
+    // Find out how far the decoding of the first packet of each stream is ahead of its presentation in each range.
+    // The decoding time of each range is moved back to the largest delay, so that it keeps increasing across the ranges.
+    bool MeasureReorderDelays(const vector<pair<int64_t, int64_t>>& usRanges)
+    {
+        const int stmCount = (int)m_ifmtCtx->nb_streams;
+        m_maxDelays.assign(stmCount, 0);
+        m_rangeDelays.assign(usRanges.size(), vector<int64_t>(stmCount, 0));
+        AVPacket* pkt = av_packet_alloc();
+        bool success = true;
+        for (size_t i = 0; i < usRanges.size() && success; i++)
+        {
+            const int64_t start = usRanges[i].first;
+            if (!SeekToRangeStart(start))
+            {
+                success = false;
+                break;
+            }
+            vector<bool> found(stmCount, true);
+            for (int j = 0; j < stmCount; j++)
+            {
+                if (m_outStmIdx[j] >= 0 && m_ifmtCtx->streams[j]->codecpar->codec_type != AVMEDIA_TYPE_SUBTITLE)
+                    found[j] = false;
+            }
+            for (int n = 0; n < 1024 && find(found.begin(), found.end(), false) != found.end(); n++)
+            {
+                if (av_read_frame(m_ifmtCtx, pkt) < 0)
+                    break;
+                const int stmIdx = pkt->stream_index;
+                if (!found[stmIdx] && pkt->pts != AV_NOPTS_VALUE && pkt->dts != AV_NOPTS_VALUE)
+                {
+                    const AVStream* istm = m_ifmtCtx->streams[stmIdx];
+                    const int64_t stmStart = istm->start_time != AV_NOPTS_VALUE ? istm->start_time : 0;
+                    const int64_t presTime = av_rescale_q(pkt->pts-stmStart, istm->time_base, MICROSEC_TIMEBASE);
+                    if (presTime >= start && (stmIdx != m_vidStmIdx || (pkt->flags&AV_PKT_FLAG_KEY) != 0))
+                    {
+                        m_rangeDelays[i][stmIdx] = max(pkt->pts-pkt->dts, (int64_t)0);
+                        m_maxDelays[stmIdx] = max(m_maxDelays[stmIdx], m_rangeDelays[i][stmIdx]);
+                        found[stmIdx] = true;
+                    }
+                }
+                av_packet_unref(pkt);
+            }
+        }
+        av_packet_free(&pkt);
+        return success;
+    }
+
+    bool OpenOutput(const string& url)
+    {
+        int fferr = avformat_alloc_output_context2(&m_ofmtCtx, nullptr, nullptr, url.c_str());
+        if (fferr < 0)
+        {
+            m_errMsg = FFapiFailureMessage("avformat_alloc_output_context2", fferr);
+            return false;
+        }
+        for (int i = 0; i < (int)m_ifmtCtx->nb_streams; i++)
+        {
+            if (m_outStmIdx[i] < 0)
+                continue;
+            const AVStream* istm = m_ifmtCtx->streams[i];
+            AVStream* ostm = avformat_new_stream(m_ofmtCtx, nullptr);
+            fferr = avcodec_parameters_copy(ostm->codecpar, istm->codecpar);
+            if (fferr < 0)
+            {
+                m_errMsg = FFapiFailureMessage("avcodec_parameters_copy", fferr);
+                return false;
+            }
+            ostm->codecpar->codec_tag = 0;
+            ostm->time_base = istm->time_base;
+            av_dict_copy(&ostm->metadata, istm->metadata, 0);
+        }
+        av_dict_copy(&m_ofmtCtx->metadata, m_ifmtCtx->metadata, 0);
+        if ((m_ofmtCtx->oformat->flags&AVFMT_NOFILE) == 0)
+        {
+            fferr = avio_open(&m_ofmtCtx->pb, url.c_str(), AVIO_FLAG_WRITE);
+            if (fferr < 0)
+            {
+                m_errMsg = FFapiFailureMessage("avio_open", fferr);
+                return false;
+            }
+        }
+        fferr = avformat_write_header(m_ofmtCtx, nullptr);
+        if (fferr < 0)
+        {
+            m_errMsg = FFapiFailureMessage("avformat_write_header", fferr);
+            return false;
+        }
+        m_lastDts.assign(m_ofmtCtx->nb_streams, AV_NOPTS_VALUE);
+        return true;
+    }
+
+    // Copy the packets of the 'rangeIdx'th range [start, end) (in microsecond) to the output, rebased to 'outOffset'
+    bool CopyRange(size_t rangeIdx, int64_t start, int64_t end, int64_t outOffset)
+    {
+        if (!SeekToRangeStart(start))
+            return false;
+
+        // a stream is done when its decoding time reaches the range end, sparse subtitle streams are not waited for
+        vector<bool> done(m_ifmtCtx->nb_streams, true);
+        for (int i = 0; i < (int)m_ifmtCtx->nb_streams; i++)
+        {
+            if (m_outStmIdx[i] >= 0 && m_ifmtCtx->streams[i]->codecpar->codec_type != AVMEDIA_TYPE_SUBTITLE)
+                done[i] = false;
+        }
+        bool vidStarted = m_vidStmIdx < 0;
+        bool vidEnded = false;
+        AVPacket* pkt = av_packet_alloc();
+        bool success = true;
+        int fferr;
+        while (!m_cancel && find(done.begin(), done.end(), false) != done.end())
+        {
+            fferr = av_read_frame(m_ifmtCtx, pkt);
+            if (fferr == AVERROR_EOF)
+                break;
+            if (fferr < 0)
+            {
+                m_errMsg = FFapiFailureMessage("av_read_frame", fferr);
+                success = false;
+                break;
+            }
+            const int stmIdx = pkt->stream_index;
+            if (m_outStmIdx[stmIdx] < 0 || (pkt->pts == AV_NOPTS_VALUE && pkt->dts == AV_NOPTS_VALUE))
+            {
+                av_packet_unref(pkt);
+                continue;
+            }
+            const AVStream* istm = m_ifmtCtx->streams[stmIdx];
+            const int64_t stmStart = istm->start_time != AV_NOPTS_VALUE ? istm->start_time : 0;
+            const int64_t decTime = av_rescale_q((pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts)-stmStart, istm->time_base, MICROSEC_TIMEBASE);
+            const int64_t presTime = av_rescale_q((pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts)-stmStart, istm->time_base, MICROSEC_TIMEBASE);
+            if (decTime >= end)
+                done[stmIdx] = true;
+            // the video starts from the key frame at the range start, the leading pictures of an open GOP are dropped
+            if (stmIdx == m_vidStmIdx && !vidStarted)
+                vidStarted = (pkt->flags&AV_PKT_FLAG_KEY) != 0 && presTime >= start;
+            // the video ends at the key frame at the range end, which starts a closed GOP, nothing after it is needed
+            if (stmIdx == m_vidStmIdx && !vidEnded && (pkt->flags&AV_PKT_FLAG_KEY) != 0 && presTime >= end)
+            {
+                vidEnded = true;
+                done[stmIdx] = true;
+            }
+            if (presTime < start || presTime >= end || (stmIdx == m_vidStmIdx && (!vidStarted || vidEnded)))
+            {
+                av_packet_unref(pkt);
+                continue;
+            }
+
+            const int64_t rebase = av_rescale_q(outOffset-start, MICROSEC_TIMEBASE, istm->time_base)-stmStart;
+            if (pkt->pts != AV_NOPTS_VALUE)
+                pkt->pts += rebase;
+            // the decoding time is moved back to the largest reorder delay among the ranges, the pts is left untouched
+            if (pkt->dts != AV_NOPTS_VALUE)
+                pkt->dts += rebase-(m_maxDelays[stmIdx]-m_rangeDelays[rangeIdx][stmIdx]);
+            const int outIdx = m_outStmIdx[stmIdx];
+            av_packet_rescale_ts(pkt, istm->time_base, m_ofmtCtx->streams[outIdx]->time_base);
+            if (pkt->dts != AV_NOPTS_VALUE)
+            {
+                int64_t& lastDts = m_lastDts[outIdx];
+                if (lastDts != AV_NOPTS_VALUE && pkt->dts <= lastDts)
+                {
+                    ostringstream oss;
+                    oss << "Non-monotonic dts " << pkt->dts << " after " << lastDts << " on output stream #" << outIdx << "!";
+                    m_errMsg = oss.str();
+                    av_packet_unref(pkt);
+                    success = false;
+                    break;
+                }
+                lastDts = pkt->dts;
+            }
+            pkt->stream_index = outIdx;
+            pkt->pos = -1;
+            fferr = av_interleaved_write_frame(m_ofmtCtx, pkt);
+            if (fferr < 0)
+            {
+                m_errMsg = FFapiFailureMessage("av_interleaved_write_frame", fferr);
+                success = false;
+                break;
+            }
+            m_doneDuration = outOffset+presTime-start;
+        }
+        av_packet_free(&pkt);
+        return success;
+    }
+
+    void CloseAll()
+    {
+        if (m_ofmtCtx)
+        {
+            if ((m_ofmtCtx->oformat->flags&AVFMT_NOFILE) == 0)
+                avio_closep(&m_ofmtCtx->pb);
+            avformat_free_context(m_ofmtCtx);
+            m_ofmtCtx = nullptr;
+        }
+        if (m_ifmtCtx)
+            avformat_close_input(&m_ifmtCtx);
+        m_outStmIdx.clear();
+        m_lastDts.clear();
+        m_maxDelays.clear();
+        m_rangeDelays.clear();
+    }
+
+private:
+    ALogger* m_logger;
+    string m_errMsg;
+    mutex m_apiLock;
+    atomic_bool m_cancel{false};
+    atomic_bool m_finished{false};
+    atomic_int64_t m_totalDuration{0};
+    atomic_int64_t m_doneDuration{0};
+    AVFormatContext* m_ifmtCtx{nullptr};
+    AVFormatContext* m_ofmtCtx{nullptr};
+    vector<int> m_outStmIdx;
+    int m_vidStmIdx{-1};
+    vector<int64_t> m_lastDts;
+    // the reorder delays of the input streams, in their time bases
+    vector<int64_t> m_maxDelays;
+    vector<vector<int64_t>> m_rangeDelays;
+};
+
+static const auto MEDIA_REMUXER_DELETER = [] (MediaRemuxer* p) {
+    MediaRemuxer_Impl* ptr = dynamic_cast<MediaRemuxer_Impl*>(p);
+    delete ptr;
+};
+
+MediaRemuxer::Holder MediaRemuxer::CreateInstance()
+{
+    return MediaRemuxer::Holder(new MediaRemuxer_Impl(), MEDIA_REMUXER_DELETER);
+}
+
+ALogger* MediaRemuxer::GetLogger()
+{
+    return Logger::GetLogger("MRemuxer");
+}
+}
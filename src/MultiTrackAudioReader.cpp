@@ -18,10 +18,12 @@
 #include <sstream>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <list>
 #include <algorithm>
 #include "AudioTrack.h"
+#include "AudioMixer.h"
 #include "MultiTrackAudioReader.h"
 #include "FFUtils.h"
 #include "SysUtils.h"
@@ -33,9 +35,6 @@ extern "C"
     #include "libavformat/avformat.h"
     #include "libavcodec/avcodec.h"
     #include "libavdevice/avdevice.h"
-    #include "libavfilter/avfilter.h"
-    #include "libavfilter/buffersrc.h"
-    #include "libavfilter/buffersink.h"
     #include "libswscale/swscale.h"
     #include "libswresample/swresample.h"
 }
@@ -80,7 +79,8 @@ public:
         m_readPos = 0;
         m_frameSize = outChannels*4;  // for now, output sample format only supports float32 data type, thus 4 bytes per sample.
         m_isTrackOutputPlanar = av_sample_fmt_is_planar(m_trackOutSmpfmt);
-        m_matAvfrmCvter = new AudioImMatAVFrameConverter();
+        // same as 'amix' with 'normalize=0', the tracks are summed with unit weights
+        m_mixer.Configure(outChannels, false);
         m_mixOutDataType = GetDataTypeFromSampleFormat(m_mixOutSmpfmt);
         m_outMtsPerFrame = av_rescale_q(m_outSamplesPerFrame, {1, (int)m_outSampleRate}, MILLISEC_TIMEBASE);
 
@@ -123,7 +123,6 @@ public:
         lock_guard<recursive_mutex> lk(m_apiLock);
         TerminateMixingThread();
 
-        ReleaseMixer();
         m_tracks.clear();
         m_outputMats.clear();
         m_configured = false;
@@ -135,11 +134,6 @@ public:
 #endif
         m_outSampleRate = 0;
         m_outSamplesPerFrame = 1024;
-        if (m_matAvfrmCvter)
-        {
-            delete m_matAvfrmCvter;
-            m_matAvfrmCvter = nullptr;
-        }
     }
 
     AudioTrack::Holder AddTrack(int64_t trackId) override
@@ -171,10 +165,6 @@ public:
             m_outputMats.clear();
         }
 
-        ReleaseMixer();
-        if (!CreateMixer())
-            return nullptr;
-
         StartMixingThread();
         return hTrack;
     }
@@ -212,13 +202,6 @@ public:
                 for (auto track : m_tracks)
                     track->SeekTo(ReadPos());
                 m_outputMats.clear();
-
-                ReleaseMixer();
-                if (!m_tracks.empty())
-                {
-                    if (!CreateMixer())
-                        return nullptr;
-                }
             }
         }
 
@@ -251,13 +234,6 @@ public:
                 for (auto track : m_tracks)
                     track->SeekTo(ReadPos());
                 m_outputMats.clear();
-
-                ReleaseMixer();
-                if (!m_tracks.empty())
-                {
-                    if (!CreateMixer())
-                        return nullptr;
-                }
             }
         }
 
@@ -283,12 +259,6 @@ public:
         m_samplePos = readPos*m_outSampleRate/1000;
 
         m_outputMats.clear();
-        ReleaseMixer();
-        if (!m_tracks.empty())
-        {
-            if (!CreateMixer())
-                return false;
-        }
 
         StartMixingThread();
         return true;
@@ -308,6 +278,8 @@ public:
             return false;
         }
 
+        if (m_offlineMode)
+            probeMode = false;
         m_logger->Log(DEBUG) << "------> SeekTo(pos=" << pos << "), probeMode=" << probeMode << endl;
         if (probeMode)
         {
@@ -317,9 +289,13 @@ public:
             }
             else
             {
-                m_prevSeekPos = m_seekPos = pos;
-                m_seeking = true;
-                m_probeMode = probeMode;
+                {
+                    lock_guard<mutex> lk2(m_outputMatsLock);
+                    m_prevSeekPos = m_seekPos = pos;
+                    m_seeking = true;
+                    m_probeMode = probeMode;
+                }
+                m_outputMatsCv.notify_all();
             }
         }
         else
@@ -373,21 +349,26 @@ public:
             return false;
         }
 
-        m_outputMatsLock.lock();
+        unique_lock<mutex> lk2(m_outputMatsLock);
         if (m_probeMode && m_outputMats.empty())
         {
             m_logger->Log(DEBUG) << "In probe-mode, NO more pcm samples." << endl;
-            m_outputMatsLock.unlock();
             return false;
         }
 
         while (m_outputMats.empty() && !m_quit)
         {
-            m_outputMatsLock.unlock();
-            this_thread::sleep_for(chrono::milliseconds(5));
-            m_outputMatsLock.lock();
+            if (m_offlineMode || m_lowLatencyMode)
+            {
+                m_outputMatsCv.wait_for(lk2, chrono::milliseconds(EVENT_WAIT_TIMEOUT));
+            }
+            else
+            {
+                lk2.unlock();
+                this_thread::sleep_for(chrono::milliseconds(5));
+                lk2.lock();
+            }
         }
-        lock_guard<mutex> lk2(m_outputMatsLock, adopt_lock);
         if (m_quit)
         {
             m_errMsg = "This 'MultiTrackAudioReader' instance is quit.";
@@ -396,11 +377,68 @@ public:
 
         amats = m_outputMats.front();
         m_outputMats.pop_front();
+        // wake up the mixing thread to fill the slot just freed
+        if (m_offlineMode || m_lowLatencyMode)
+            m_outputMatsCv.notify_all();
         m_readPos += (int64_t)amats[0].frame.w*1000/m_outSampleRate;
         eof = m_eof;
         return true;
     }
 
+    bool SetOfflineMode(bool enable, uint32_t lookAheadFrames) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (enable && lookAheadFrames == 0)
+        {
+            m_errMsg = "Argument 'lookAheadFrames' must be positive!";
+            return false;
+        }
+        if (enable && m_lowLatencyMode)
+        {
+            m_errMsg = "CANNOT enable offline mode while low-latency mode is enabled!";
+            return false;
+        }
+        {
+            lock_guard<mutex> lk2(m_outputMatsLock);
+            m_offlineMode = enable;
+            m_outputMatsMaxCount = enable ? lookAheadFrames : DEFAULT_OUTPUT_MATS_MAX_COUNT;
+        }
+        m_outputMatsCv.notify_all();
+        return true;
+    }
+
+    bool IsOfflineMode() const override
+    {
+        return m_offlineMode;
+    }
+
+    bool SetLowLatencyMode(bool enable, uint32_t maxQueuedFrames) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (enable && maxQueuedFrames == 0)
+        {
+            m_errMsg = "Argument 'maxQueuedFrames' must be positive!";
+            return false;
+        }
+        if (enable && m_offlineMode)
+        {
+            m_errMsg = "CANNOT enable low-latency mode while offline mode is enabled!";
+            return false;
+        }
+        {
+            lock_guard<mutex> lk2(m_outputMatsLock);
+            m_lowLatencyMode = enable;
+            m_outputMatsMaxCount = enable ? maxQueuedFrames : DEFAULT_OUTPUT_MATS_MAX_COUNT;
+        }
+        m_outputMatsCv.notify_all();
+        return true;
+    }
+
+    bool IsLowLatencyMode() const override
+    {
+        return m_lowLatencyMode;
+    }
+
     bool ReadAudioSamples(ImGui::ImMat& amat, bool& eof) override
     {
         vector<CorrelativeFrame> amats;
@@ -561,162 +599,19 @@ private:
         if (m_mixingThread.joinable())
         {
             m_quit = true;
+            m_outputMatsCv.notify_all();
             m_mixingThread.join();
         }
     }
 
-    bool CreateMixer()
-    {
-        const AVFilter *abuffersrc  = avfilter_get_by_name("abuffer");
-        const AVFilter *abuffersink = avfilter_get_by_name("abuffersink");
-
-        m_filterGraph = avfilter_graph_alloc();
-        if (!m_filterGraph)
-        {
-            m_errMsg = "FAILED to allocate new 'AVFilterGraph'!";
-            return false;
-        }
-
-        ostringstream oss;
-        oss << "time_base=1/" << m_outSampleRate << ":sample_rate=" << m_outSampleRate
-            << ":sample_fmt=" << av_get_sample_fmt_name(m_trackOutSmpfmt);
-#if !defined(FF_API_OLD_CHANNEL_LAYOUT) && (LIBAVUTIL_VERSION_MAJOR < 58)
-        oss << ":channel_layout=" << av_get_default_channel_layout(m_outChannels);
-#else
-        char chlytDescBuff[256] = {0};
-        av_channel_layout_describe(&m_outChlyt, chlytDescBuff, sizeof(chlytDescBuff));
-        oss << ":channel_layout=" << chlytDescBuff;
-#endif
-        string bufsrcArgs = oss.str(); oss.str("");
-        int fferr;
-
-        AVFilterInOut* prevFiltInOutPtr = nullptr;
-        for (uint32_t i = 0; i < m_tracks.size(); i++)
-        {
-            oss << "in_" << i;
-            string filtName = oss.str(); oss.str("");
-            m_logger->Log(DEBUG) << "buffersrc name '" << filtName << "'." << endl;
-
-            AVFilterContext* bufSrcCtx = nullptr;
-            fferr = avfilter_graph_create_filter(&bufSrcCtx, abuffersrc, filtName.c_str(), bufsrcArgs.c_str(), nullptr, m_filterGraph);
-            if (fferr < 0)
-            {
-                oss << "FAILED when invoking 'avfilter_graph_create_filter' for INPUTs! fferr=" << fferr << ".";
-                m_errMsg = oss.str();
-                return false;
-            }
-
-            AVFilterInOut* filtInOutPtr = avfilter_inout_alloc();
-            if (!filtInOutPtr)
-            {
-                m_errMsg = "FAILED to allocate 'AVFilterInOut' instance!";
-                return false;
-            }
-            filtInOutPtr->name       = av_strdup(filtName.c_str());
-            filtInOutPtr->filter_ctx = bufSrcCtx;
-            filtInOutPtr->pad_idx    = 0;
-            filtInOutPtr->next       = nullptr;
-            if (prevFiltInOutPtr)
-                prevFiltInOutPtr->next = filtInOutPtr;
-            else
-                m_filterOutputs = filtInOutPtr;
-            prevFiltInOutPtr = filtInOutPtr;
-
-            m_bufSrcCtxs.push_back(bufSrcCtx);
-        }
-
-        {
-            string filtName = "out";
-
-            AVFilterContext* bufSinkCtx = nullptr;
-            fferr = avfilter_graph_create_filter(&bufSinkCtx, abuffersink, filtName.c_str(), nullptr, nullptr, m_filterGraph);
-            if (fferr < 0)
-            {
-                oss << "FAILED when invoking 'avfilter_graph_create_filter' for OUTPUTS! fferr=" << fferr << ".";
-                m_errMsg = oss.str();
-                return false;
-            }
-
-            const AVSampleFormat out_sample_fmts[] = { m_mixOutSmpfmt, (AVSampleFormat)-1 };
-            fferr = av_opt_set_int_list(bufSinkCtx, "sample_fmts", out_sample_fmts, -1, AV_OPT_SEARCH_CHILDREN);
-            if (fferr < 0)
-            {
-                oss << "FAILED when invoking 'av_opt_set_int_list' for OUTPUTS! fferr=" << fferr << ".";
-                m_errMsg = oss.str();
-                return false;
-            }
-
-            AVFilterInOut* filtInOutPtr = avfilter_inout_alloc();
-            if (!filtInOutPtr)
-            {
-                m_errMsg = "FAILED to allocate 'AVFilterInOut' instance!";
-                return false;
-            }
-            filtInOutPtr->name        = av_strdup(filtName.c_str());
-            filtInOutPtr->filter_ctx  = bufSinkCtx;
-            filtInOutPtr->pad_idx     = 0;
-            filtInOutPtr->next        = nullptr;
-            m_filterInputs = filtInOutPtr;
-
-            m_bufSinkCtxs.push_back(bufSinkCtx);
-        }
-
-        for (uint32_t i = 0; i < m_tracks.size(); i++)
-            oss << "[in_" << i << "]";
-        oss << "amix=inputs=" << m_tracks.size();
-        oss << ":normalize=0";
-        string filtArgs = oss.str(); oss.str("");
-        m_logger->Log(DEBUG) << "'MultiTrackAudioReader' mixer filter args: '" << filtArgs << "'." << endl;
-        fferr = avfilter_graph_parse_ptr(m_filterGraph, filtArgs.c_str(), &m_filterInputs, &m_filterOutputs, nullptr);
-        if (fferr < 0)
-        {
-            oss << "FAILED to invoke 'avfilter_graph_parse_ptr'! fferr=" << fferr << ".";
-            m_errMsg = oss.str();
-            return false;
-        }
-
-        fferr = avfilter_graph_config(m_filterGraph, nullptr);
-        if (fferr < 0)
-        {
-            oss << "FAILED to invoke 'avfilter_graph_config'! fferr=" << fferr << ".";
-            m_errMsg = oss.str();
-            return false;
-        }
-
-        FreeAVFilterInOutPtrs();
-        return true;
-    }
-
-    void ReleaseMixer()
-    {
-        if (m_filterGraph)
-        {
-            avfilter_graph_free(&m_filterGraph);
-            m_filterGraph = nullptr;
-        }
-        m_bufSrcCtxs.clear();
-        m_bufSinkCtxs.clear();
-
-        FreeAVFilterInOutPtrs();
-    }
-
-    void FreeAVFilterInOutPtrs()
-    {
-        if (m_filterOutputs)
-            avfilter_inout_free(&m_filterOutputs);
-        if (m_filterInputs)
-            avfilter_inout_free(&m_filterInputs);
-    }
-
     void MixingThreadProc()
     {
         m_logger->Log(DEBUG) << "Enter MixingThreadProc(AUDIO)..." << endl;
 
-        SelfFreeAVFramePtr outfrm = AllocSelfFreeAVFramePtr();
+        vector<ImGui::ImMat> trackMats;
         while (!m_quit)
         {
             bool idleLoop = true;
-            int fferr;
 
             int64_t mixingPos = m_samplePos*1000/m_outSampleRate;
             m_eof = m_readForward ? mixingPos >= Duration() : mixingPos <= 0;
@@ -752,7 +647,17 @@ private:
                     else if (m_probeStage == -1)
                     {
                         // stop reading more samples
-                        this_thread::sleep_for(chrono::milliseconds(5));
+                        if (m_lowLatencyMode)
+                        {
+                            unique_lock<mutex> lk(m_outputMatsLock);
+                            m_outputMatsCv.wait_for(lk, chrono::milliseconds(EVENT_WAIT_TIMEOUT), [this] {
+                                return m_quit || m_seeking;
+                            });
+                        }
+                        else
+                        {
+                            this_thread::sleep_for(chrono::milliseconds(5));
+                        }
                         continue;
                     }
                     else if (m_probeSampleDur >= m_probeDuration)
@@ -767,22 +672,16 @@ private:
                 corFrames.push_back({CorrelativeFrame::PHASE_AFTER_MIXING, 0, 0, ImGui::ImMat()});
                 if (!m_tracks.empty())
                 {
+                    const int64_t mixPts = m_samplePos;
+                    trackMats.clear();
                     {
                         lock_guard<recursive_mutex> lk(m_trackLock);
-                        uint32_t i = 0;
-                        for (auto iter = m_tracks.begin(); iter != m_tracks.end(); iter++, i++)
+                        for (auto iter = m_tracks.begin(); iter != m_tracks.end(); iter++)
                         {
                             auto& track = *iter;
                             ImGui::ImMat amat = track->ReadAudioSamples(m_outSamplesPerFrame);
                             corFrames.push_back({CorrelativeFrame::PHASE_AFTER_TRANSITION, 0, track->Id(), amat});
-                            SelfFreeAVFramePtr audfrm = AllocSelfFreeAVFramePtr();
-                            m_matAvfrmCvter->ConvertImMatToAVFrame(amat, audfrm.get(), m_samplePos);
-                            fferr = av_buffersrc_add_frame(m_bufSrcCtxs[i], audfrm.get());
-                            if (fferr < 0)
-                            {
-                                m_logger->Log(Error) << "FAILED to invoke 'av_buffersrc_add_frame'(In MixingThreadProc)! fferr=" << fferr << "." << endl;
-                                break;
-                            }
+                            trackMats.push_back(amat);
                         }
                         if (m_readForward)
                             m_samplePos += m_outSamplesPerFrame;
@@ -790,52 +689,37 @@ private:
                             m_samplePos -= m_outSamplesPerFrame;
                     }
 
-                    fferr = av_buffersink_get_frame(m_bufSinkCtxs[0], outfrm.get());
-                    if (fferr >= 0)
+                    ImGui::ImMat amat;
+                    if (m_mixer.Mix(trackMats, {}, m_outSamplesPerFrame, amat))
                     {
-                        ImGui::ImMat amat;
-#if !defined(FF_API_OLD_CHANNEL_LAYOUT) && (LIBAVUTIL_VERSION_MAJOR < 58)
-                        int outChannels = m_outChannels;
-#else
-                        int outChannels = m_outChlyt.nb_channels;
-#endif
-                        amat.create((int)m_outSamplesPerFrame, 1, outChannels, (size_t)4);
-                        if (amat.total()*4 == outfrm->linesize[0])
+                        amat.time_stamp = ConvertPtsToTs(mixPts);
+                        amat.type = m_mixOutDataType;
+                        amat.rate = { (int)m_outSampleRate, 1 };
+                        list<ImGui::ImMat> aeOutMats;
+                        if (!m_aeFilter->ProcessData(amat, aeOutMats))
                         {
-                            memcpy(amat.data, outfrm->data[0], outfrm->linesize[0]);
-                            amat.time_stamp = ConvertPtsToTs(outfrm->pts);
-                            amat.type = m_mixOutDataType;
-                            amat.flags = IM_MAT_FLAGS_AUDIO_FRAME;
-                            amat.rate = { (int)m_outSampleRate, 1 };
-                            amat.elempack = outChannels;
-                            av_frame_unref(outfrm.get());
-                            list<ImGui::ImMat> aeOutMats;
-                            if (!m_aeFilter->ProcessData(amat, aeOutMats))
-                            {
-                                m_logger->Log(Error) << "FAILED to apply AudioEffectFilter after mixing! Error is '" << m_aeFilter->GetError() << "'." << endl;
-                            }
-                            else if (aeOutMats.size() != 1)
-                                m_logger->Log(Error) << "After mixing AudioEffectFilter returns " << aeOutMats.size() << " mats!" << endl;
-                            else
-                            {
-                                auto& frontMat = aeOutMats.front();
-                                if (frontMat.total() != amat.total())
-                                    m_logger->Log(Error) << "After mixing AudioEffectFilter, front mat has different size (" << (frontMat.total()*4)
-                                        << ") against input mat (" << (amat.total()*4) << ")!" << endl;
-                                else
-                                    amat = frontMat;
-                            }
-                            corFrames[0].frame = amat;
-                            lock_guard<mutex> lk(m_outputMatsLock);
-                            m_outputMats.push_back(corFrames);
-                            idleLoop = false;
+                            m_logger->Log(Error) << "FAILED to apply AudioEffectFilter after mixing! Error is '" << m_aeFilter->GetError() << "'." << endl;
                         }
+                        else if (aeOutMats.size() != 1)
+                            m_logger->Log(Error) << "After mixing AudioEffectFilter returns " << aeOutMats.size() << " mats!" << endl;
                         else
-                            m_logger->Log(Error) << "Audio frame linesize(" << outfrm->linesize[0] << ") is ABNORMAL!" << endl;
+                        {
+                            auto& frontMat = aeOutMats.front();
+                            if (frontMat.total() != amat.total())
+                                m_logger->Log(Error) << "After mixing AudioEffectFilter, front mat has different size (" << (frontMat.total()*4)
+                                    << ") against input mat (" << (amat.total()*4) << ")!" << endl;
+                            else
+                                amat = frontMat;
+                        }
+                        corFrames[0].frame = amat;
+                        lock_guard<mutex> lk(m_outputMatsLock);
+                        m_outputMats.push_back(corFrames);
+                        m_outputMatsCv.notify_all();
+                        idleLoop = false;
                     }
-                    else if (fferr != AVERROR(EAGAIN))
+                    else
                     {
-                        m_logger->Log(Error) << "FAILED to invoke 'av_buffersink_get_frame'(In MixingThreadProc)! fferr=" << fferr << "." << endl;
+                        m_logger->Log(Error) << "FAILED to mix audio tracks! Error is '" << m_mixer.GetError() << "'." << endl;
                     }
                 }
                 else
@@ -859,6 +743,7 @@ private:
                     corFrames[0].frame = amat;
                     lock_guard<mutex> lk(m_outputMatsLock);
                     m_outputMats.push_back(corFrames);
+                    m_outputMatsCv.notify_all();
                     idleLoop = false;
                 }
 
@@ -869,7 +754,20 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(5));
+            {
+                if (m_offlineMode || m_lowLatencyMode)
+                {
+                    // block on the back-pressure of the output queue instead of polling, a read or a seek wakes it up
+                    unique_lock<mutex> lk(m_outputMatsLock);
+                    m_outputMatsCv.wait_for(lk, chrono::milliseconds(EVENT_WAIT_TIMEOUT), [this] {
+                        return m_quit || m_seeking || m_outputMats.size() < m_outputMatsMaxCount;
+                    });
+                }
+                else
+                {
+                    this_thread::sleep_for(chrono::milliseconds(5));
+                }
+            }
         }
 
         m_logger->Log(DEBUG) << "Leave MixingThreadProc(AUDIO)." << endl;
@@ -910,21 +808,21 @@ private:
     int64_t m_seekPos{INT64_MIN};
     int64_t m_prevSeekPos{INT64_MIN};
 
-    AudioImMatAVFrameConverter* m_matAvfrmCvter{nullptr};
+    static const uint32_t DEFAULT_OUTPUT_MATS_MAX_COUNT = 4;
+    // max waiting time in offline and low-latency mode, in case a notification is missed
+    static const int EVENT_WAIT_TIMEOUT = 100;
     list<vector<CorrelativeFrame>> m_outputMats;
     mutex m_outputMatsLock;
-    uint32_t m_outputMatsMaxCount{4};
+    condition_variable m_outputMatsCv;
+    uint32_t m_outputMatsMaxCount{DEFAULT_OUTPUT_MATS_MAX_COUNT};
+    atomic_bool m_offlineMode{false};
+    atomic_bool m_lowLatencyMode{false};
 
     bool m_configured{false};
     bool m_started{false};
     bool m_quit{false};
 
-    AVFilterGraph* m_filterGraph{nullptr};
-    AVFilterInOut* m_filterOutputs{nullptr};
-    AVFilterInOut* m_filterInputs{nullptr};
-    vector<AVFilterContext*> m_bufSrcCtxs;
-    vector<AVFilterContext*> m_bufSinkCtxs;
-
+    AudioMixer m_mixer;
     AudioEffectFilter::Holder m_aeFilter;
 };
 
@@ -957,14 +855,10 @@ MultiTrackAudioReader::Holder MultiTrackAudioReader_Impl::CloneAndConfigure(uint
         newInstance->m_tracks.push_back(track->Clone(outChannels, outSampleRate, av_get_sample_fmt_name(m_trackOutSmpfmt)));
     }
     newInstance->UpdateDuration();
-    // create mixer in the new instance
-    if (!newInstance->CreateMixer())
-    {
-        m_errMsg = newInstance->GetError();
-        newInstance->Close(); delete newInstance;
-        return nullptr;
-    }
 
+    newInstance->m_offlineMode = m_offlineMode.load();
+    newInstance->m_lowLatencyMode = m_lowLatencyMode.load();
+    newInstance->m_outputMatsMaxCount = m_outputMatsMaxCount;
     // seek to 0
     newInstance->m_outputMats.clear();
     newInstance->m_samplePos = 0;
@@ -0,0 +1,1300 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include "MultiTrackExporter.h"
+#include "VideoTransformFilter.h"
+#include "FFUtils.h"
+#include "SysUtils.h"
+extern "C"
+{
+    #include "libavutil/avutil.h"
+    #include "libavformat/avformat.h"
+    #include "libavcodec/avcodec.h"
+    #include "libavutil/pixdesc.h"
+}
+
+using namespace std;
+using namespace Logger;
+
+namespace MediaCore
+{
+static string FFapiFailureMessage(const string& apiName, int fferr)
+{
+    ostringstream oss;
+    oss << "FF api '" << apiName << "' returns error! fferr=" << fferr << ".";
+    return oss.str();
+}
+
+// Reads the packets of one stream from a list of files as a continuous stream. The timestamps of each file are rebased
+// to start from its offset, and rescaled to the output time base.
+class ConcatPacketSource
+{
+public:
+    struct InputFile
+    {
+        string path;
+        int64_t offset;  // in 'offsetTb'
+    };
+
+    ~ConcatPacketSource()
+    {
+        CloseFile();
+    }
+
+    bool Open(const vector<InputFile>& files, AVRational offsetTb, AVMediaType mediaType)
+    {
+        m_files = files;
+        m_offsetTb = offsetTb;
+        m_mediaType = mediaType;
+        m_lastDts = AV_NOPTS_VALUE;
+        m_inbandParamSets = false;
+        if (m_files.empty())
+            return false;
+        // all the files are probed first, their codec headers and reorder delays decide how the packets are joined
+        m_fileInfos.assign(m_files.size(), FileInfo());
+        m_maxDelayIdx = 0;
+        for (m_fileIdx = 0; m_fileIdx < m_files.size(); m_fileIdx++)
+        {
+            if (!ProbeFile(m_fileInfos[m_fileIdx]))
+                return false;
+            const FileInfo& info = m_fileInfos[m_fileIdx];
+            const FileInfo& maxInfo = m_fileInfos[m_maxDelayIdx];
+            if (av_compare_ts(info.reorderDelay, info.timeBase, maxInfo.reorderDelay, maxInfo.timeBase) > 0)
+                m_maxDelayIdx = m_fileIdx;
+        }
+        // the output header is taken from the first file, the NEW_EXTRADATA side data is ignored by most muxers.
+        // if the headers differ, the parameter sets of each file are put in front of its key frames instead.
+        const FileInfo& firstInfo = m_fileInfos[0];
+        for (size_t i = 1; i < m_fileInfos.size() && !m_inbandParamSets; i++)
+            m_inbandParamSets = m_fileInfos[i].extradata != firstInfo.extradata;
+        if (m_inbandParamSets)
+        {
+            for (size_t i = 0; i < m_fileInfos.size(); i++)
+            {
+                FileInfo& info = m_fileInfos[i];
+                if (info.codecId != firstInfo.codecId || !ExtractParamSets(info.codecId, info.extradata, info.paramSets, info.nalLengthSize))
+                {
+                    m_errMsg = "The codec header of file '"+m_files[i].path+"' differs from the first file's, and it can NOT be sent in-band!";
+                    return false;
+                }
+                if (info.nalLengthSize != firstInfo.nalLengthSize)
+                {
+                    m_errMsg = "The NAL length size of file '"+m_files[i].path+"' differs from the first file's!";
+                    return false;
+                }
+            }
+        }
+        m_fileIdx = 0;
+        return OpenFile();
+    }
+
+    const AVStream* GetStream() const
+    {
+        return m_ifmtCtx ? m_ifmtCtx->streams[m_stmIdx] : nullptr;
+    }
+
+    // Whether the parameter sets are sent in the key frames, the stream should be tagged as such if the muxer supports it
+    bool HasInbandParamSets() const
+    {
+        return m_inbandParamSets;
+    }
+
+    // Returns 0 if a packet is read, AVERROR_EOF if all the files are read
+    int ReadPacket(AVPacket* pkt, AVRational outTb)
+    {
+        while (m_ifmtCtx)
+        {
+            int fferr = av_read_frame(m_ifmtCtx, pkt);
+            if (fferr == AVERROR_EOF)
+            {
+                CloseFile();
+                if (++m_fileIdx >= m_files.size())
+                    return AVERROR_EOF;
+                if (!OpenFile())
+                    return AVERROR(EINVAL);
+                continue;
+            }
+            if (fferr < 0)
+            {
+                m_errMsg = FFapiFailureMessage("av_read_frame", fferr);
+                return fferr;
+            }
+            if (pkt->stream_index != m_stmIdx)
+            {
+                av_packet_unref(pkt);
+                continue;
+            }
+            const AVStream* stm = m_ifmtCtx->streams[m_stmIdx];
+            const int64_t base = stm->start_time != AV_NOPTS_VALUE ? stm->start_time : 0;
+            if (pkt->pts != AV_NOPTS_VALUE)
+                pkt->pts -= base;
+            if (pkt->dts != AV_NOPTS_VALUE)
+                pkt->dts -= base;
+            av_packet_rescale_ts(pkt, stm->time_base, outTb);
+            const int64_t offset = av_rescale_q(m_files[m_fileIdx].offset, m_offsetTb, outTb);
+            if (pkt->pts != AV_NOPTS_VALUE)
+                pkt->pts += offset;
+            if (pkt->dts != AV_NOPTS_VALUE)
+                pkt->dts += offset;
+            pkt->pos = -1;
+            // the files can be encoded with different reorder delays. the decoding time of each file is moved back to
+            // the largest delay, so that it keeps increasing across the files. the presentation time is left untouched.
+            if (pkt->dts != AV_NOPTS_VALUE)
+            {
+                const FileInfo& info = m_fileInfos[m_fileIdx];
+                const FileInfo& maxInfo = m_fileInfos[m_maxDelayIdx];
+                pkt->dts -= av_rescale_q(maxInfo.reorderDelay, maxInfo.timeBase, outTb)-av_rescale_q(info.reorderDelay, info.timeBase, outTb);
+                if (m_lastDts != AV_NOPTS_VALUE && pkt->dts <= m_lastDts)
+                {
+                    ostringstream oss;
+                    oss << "Non-monotonic dts " << pkt->dts << " after " << m_lastDts << " in file '" << m_files[m_fileIdx].path << "'!";
+                    m_errMsg = oss.str();
+                    av_packet_unref(pkt);
+                    return AVERROR(EINVAL);
+                }
+                m_lastDts = pkt->dts;
+            }
+            if (m_inbandParamSets && (pkt->flags&AV_PKT_FLAG_KEY) != 0 && !PrependParamSets(pkt, m_fileInfos[m_fileIdx].paramSets))
+                return AVERROR(ENOMEM);
+            return 0;
+        }
+        return AVERROR_EOF;
+    }
+
+    string GetError() const
+    {
+        return m_errMsg;
+    }
+
+private:
+    struct FileInfo
+    {
+        AVCodecID codecId{AV_CODEC_ID_NONE};
+        vector<uint8_t> extradata;
+        AVRational timeBase{1, 1};
+        // the time by which the decoding of the first packet is ahead of its presentation, in 'timeBase'
+        int64_t reorderDelay{0};
+        // the parameter sets in the format of the packets, only for the in-band mode
+        vector<uint8_t> paramSets;
+        int nalLengthSize{0};
+    };
+
+    bool OpenFile()
+    {
+        const string& path = m_files[m_fileIdx].path;
+        int fferr = avformat_open_input(&m_ifmtCtx, path.c_str(), nullptr, nullptr);
+        if (fferr < 0)
+        {
+            m_errMsg = FFapiFailureMessage("avformat_open_input", fferr);
+            return false;
+        }
+        fferr = avformat_find_stream_info(m_ifmtCtx, nullptr);
+        if (fferr < 0)
+        {
+            m_errMsg = FFapiFailureMessage("avformat_find_stream_info", fferr);
+            CloseFile();
+            return false;
+        }
+        m_stmIdx = av_find_best_stream(m_ifmtCtx, m_mediaType, -1, -1, nullptr, 0);
+        if (m_stmIdx < 0)
+        {
+            m_errMsg = "No stream of the required type is found in file '"+path+"'!";
+            CloseFile();
+            return false;
+        }
+        return true;
+    }
+
+    void CloseFile()
+    {
+        if (m_ifmtCtx)
+            avformat_close_input(&m_ifmtCtx);
+    }
+
+    bool ProbeFile(FileInfo& info)
+    {
+        if (!OpenFile())
+            return false;
+        const AVStream* stm = m_ifmtCtx->streams[m_stmIdx];
+        info.codecId = stm->codecpar->codec_id;
+        info.extradata.assign(stm->codecpar->extradata, stm->codecpar->extradata+stm->codecpar->extradata_size);
+        info.timeBase = stm->time_base;
+        const int64_t base = stm->start_time != AV_NOPTS_VALUE ? stm->start_time : 0;
+        AVPacket* pkt = av_packet_alloc();
+        while (av_read_frame(m_ifmtCtx, pkt) >= 0)
+        {
+            const bool found = pkt->stream_index == m_stmIdx;
+            if (found && pkt->dts != AV_NOPTS_VALUE && pkt->dts < base)
+                info.reorderDelay = base-pkt->dts;
+            av_packet_unref(pkt);
+            if (found)
+                break;
+        }
+        av_packet_free(&pkt);
+        CloseFile();
+        return true;
+    }
+
+    // Convert the parameter sets in an avcC/hvcC header to NAL units with length prefixes, like the packets of such
+    // stream. An Annex B header is used as it is, with 'nalLengthSize' set to 0.
+    static bool ExtractParamSets(AVCodecID codecId, const vector<uint8_t>& extradata, vector<uint8_t>& paramSets, int& nalLengthSize)
+    {
+        paramSets.clear();
+        const size_t size = extradata.size();
+        const uint8_t* data = extradata.data();
+        if (size >= 4 && data[0] == 0 && data[1] == 0 && (data[2] == 1 || (data[2] == 0 && data[3] == 1)))
+        {
+            paramSets = extradata;
+            nalLengthSize = 0;
+            return true;
+        }
+        auto appendNal = [&] (size_t& pos) {
+            if (pos+2 > size)
+                return false;
+            const size_t nalSize = ((size_t)data[pos]<<8)|data[pos+1];
+            pos += 2;
+            if (pos+nalSize > size)
+                return false;
+            for (int i = nalLengthSize-1; i >= 0; i--)
+                paramSets.push_back((uint8_t)(nalSize>>(i*8)));
+            paramSets.insert(paramSets.end(), data+pos, data+pos+nalSize);
+            pos += nalSize;
+            return true;
+        };
+        if (codecId == AV_CODEC_ID_H264 && size >= 7 && data[0] == 1)
+        {
+            nalLengthSize = (data[4]&0x3)+1;
+            size_t pos = 5;
+            const int spsCount = data[pos++]&0x1f;
+            for (int i = 0; i < spsCount; i++)
+            {
+                if (!appendNal(pos))
+                    return false;
+            }
+            if (pos >= size)
+                return false;
+            const int ppsCount = data[pos++];
+            for (int i = 0; i < ppsCount; i++)
+            {
+                if (!appendNal(pos))
+                    return false;
+            }
+            return true;
+        }
+        if (codecId == AV_CODEC_ID_HEVC && size >= 23 && data[0] == 1)
+        {
+            nalLengthSize = (data[21]&0x3)+1;
+            size_t pos = 22;
+            const int arrayCount = data[pos++];
+            for (int i = 0; i < arrayCount; i++)
+            {
+                if (pos+3 > size)
+                    return false;
+                const int nalCount = ((int)data[pos+1]<<8)|data[pos+2];
+                pos += 3;
+                for (int j = 0; j < nalCount; j++)
+                {
+                    if (!appendNal(pos))
+                        return false;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool PrependParamSets(AVPacket* pkt, const vector<uint8_t>& paramSets)
+    {
+        AVPacket* newPkt = av_packet_alloc();
+        if (!newPkt || av_new_packet(newPkt, (int)paramSets.size()+pkt->size) < 0)
+        {
+            m_errMsg = "FAILED to allocate packet for the in-band parameter sets!";
+            av_packet_free(&newPkt);
+            av_packet_unref(pkt);
+            return false;
+        }
+        memcpy(newPkt->data, paramSets.data(), paramSets.size());
+        memcpy(newPkt->data+paramSets.size(), pkt->data, pkt->size);
+        av_packet_copy_props(newPkt, pkt);
+        av_packet_unref(pkt);
+        av_packet_move_ref(pkt, newPkt);
+        av_packet_free(&newPkt);
+        return true;
+    }
+
+private:
+    vector<InputFile> m_files;
+    vector<FileInfo> m_fileInfos;
+    size_t m_maxDelayIdx{0};
+    AVRational m_offsetTb{1, 1000};
+    AVMediaType m_mediaType{AVMEDIA_TYPE_UNKNOWN};
+    size_t m_fileIdx{0};
+    AVFormatContext* m_ifmtCtx{nullptr};
+    int m_stmIdx{-1};
+    int64_t m_lastDts{AV_NOPTS_VALUE};
+    bool m_inbandParamSets{false};
+    string m_errMsg;
+};
+
+static bool IsIdentityTransform(VideoTransformFilterHolder hTransform, uint32_t width, uint32_t height)
+{
+    if (!hTransform)
+        return true;
+    if (hTransform->GetOutWidth() != width || hTransform->GetOutHeight() != height)
+        return false;
+    if (hTransform->GetKeyPoint() && hTransform->GetKeyPoint()->GetCurveCount() > 0)
+        return false;
+    if (fmod(hTransform->GetRotationAngle(), 360.) != 0 || hTransform->GetScaleH() != 1 || hTransform->GetScaleV() != 1)
+        return false;
+    if (hTransform->GetPositionOffsetH() != 0 || hTransform->GetPositionOffsetV() != 0 ||
+        hTransform->GetPositionOffsetHScale() != 0 || hTransform->GetPositionOffsetVScale() != 0)
+        return false;
+    if (hTransform->GetCropMarginL() != 0 || hTransform->GetCropMarginT() != 0 ||
+        hTransform->GetCropMarginR() != 0 || hTransform->GetCropMarginB() != 0 ||
+        hTransform->GetCropMarginLScale() != 0 || hTransform->GetCropMarginTScale() != 0 ||
+        hTransform->GetCropMarginRScale() != 0 || hTransform->GetCropMarginBScale() != 0)
+        return false;
+    return true;
+}
+
+class MultiTrackExporter_Impl : public MultiTrackExporter
+{
+public:
+    MultiTrackExporter_Impl()
+    {
+        m_logger = MultiTrackExporter::GetLogger();
+    }
+
+    MultiTrackExporter_Impl(const MultiTrackExporter_Impl&) = delete;
+    MultiTrackExporter_Impl(MultiTrackExporter_Impl&&) = delete;
+    MultiTrackExporter_Impl& operator=(const MultiTrackExporter_Impl&) = delete;
+
+    bool Export(const string& url,
+            MultiTrackVideoReader::Holder hVidReader, const VideoSettings& vidSettings,
+            MultiTrackAudioReader::Holder hAudReader, const AudioSettings& audSettings,
+            int64_t start, int64_t end, uint32_t segmentCount) override
+    {
+        lock_guard<mutex> lk(m_apiLock);
+        m_cancel = false;
+        m_finished = false;
+        m_encodedFrames = m_totalFrames = 0;
+        m_encodedSamples = m_totalSamples = 0;
+        if (!hVidReader && !hAudReader)
+        {
+            m_errMsg = "Neither video nor audio reader is provided!";
+            return false;
+        }
+        if (start < 0 || end <= start)
+        {
+            m_errMsg = "Invalid export range!";
+            return false;
+        }
+        if (hVidReader && (vidSettings.width == 0 || vidSettings.height == 0 || vidSettings.frameRate.num <= 0 || vidSettings.frameRate.den <= 0))
+        {
+            m_errMsg = "Invalid video settings!";
+            return false;
+        }
+        if (hAudReader && (audSettings.channels == 0 || audSettings.sampleRate == 0))
+        {
+            m_errMsg = "Invalid audio settings!";
+            return false;
+        }
+        if (segmentCount == 0)
+            segmentCount = max(thread::hardware_concurrency()/2, 1u);
+
+        // split the rendered parts of the video into segments whose lengths are multiples of the GOP size
+        vector<Task> segments;
+        const Ratio& frameRate = vidSettings.frameRate;
+        int64_t startFrame = 0;
+        string imageFormat;
+        if (hVidReader)
+        {
+            startFrame = (start*frameRate.num+frameRate.den*1000-1)/(frameRate.den*1000);
+            const int64_t endFrame = (end*frameRate.num+frameRate.den*1000-1)/(frameRate.den*1000);
+            m_totalFrames = endFrame-startFrame;
+            vector<Task> pieces;
+            PlanVideoPieces(hVidReader, vidSettings, startFrame, m_totalFrames, pieces, imageFormat);
+            int64_t renderFrames = 0;
+            for (auto& piece : pieces)
+            {
+                if (!piece.copy)
+                    renderFrames += piece.end-piece.start;
+            }
+            const int64_t gopSize = vidSettings.gopSize > 0 ? vidSettings.gopSize : 1;
+            int64_t segFrames = (renderFrames+segmentCount-1)/segmentCount;
+            segFrames = max((segFrames+gopSize-1)/gopSize*gopSize, gopSize);
+            for (auto& piece : pieces)
+            {
+                for (int64_t f = piece.start; f < piece.end; f += segFrames)
+                {
+                    Task seg = piece;
+                    seg.start = f;
+                    seg.end = piece.copy ? piece.end : min(f+segFrames, piece.end);
+                    seg.path = MakeTempPath(url, "seg"+to_string(segments.size()));
+                    segments.push_back(seg);
+                    if (piece.copy)
+                        break;
+                }
+            }
+            m_logger->Log(DEBUG) << "Export " << m_totalFrames << " video frames in " << segments.size() << " segment(s), "
+                    << m_totalFrames-renderFrames << " frames are stream copied." << endl;
+        }
+        Task audioTask;
+        if (hAudReader)
+        {
+            audioTask.start = start*audSettings.sampleRate/1000;
+            audioTask.end = end*audSettings.sampleRate/1000;
+            audioTask.path = MakeTempPath(url, "audio");
+            m_totalSamples = audioTask.end-audioTask.start;
+        }
+
+        vector<thread> workers;
+        atomic_size_t nextSegIdx{0};
+        const uint32_t workerCount = min((uint32_t)segments.size(), segmentCount);
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            workers.push_back(thread([&] () {
+                size_t segIdx;
+                while ((segIdx = nextSegIdx++) < segments.size() && !m_cancel)
+                {
+                    Task& seg = segments[segIdx];
+                    if (seg.copy)
+                        CopyVideoSegment(seg);
+                    else
+                        ExportVideoSegment(hVidReader, vidSettings, imageFormat, startFrame, seg);
+                }
+            }));
+        }
+        if (hAudReader)
+            workers.push_back(thread(&MultiTrackExporter_Impl::ExportAudio, this, hAudReader, cref(audSettings), ref(audioTask)));
+        for (auto& worker : workers)
+            worker.join();
+
+        bool success = !m_cancel;
+        if (!success)
+            m_errMsg = "Export is canceled.";
+        for (auto& seg : segments)
+        {
+            if (success && !seg.success)
+            {
+                m_errMsg = seg.errMsg;
+                success = false;
+            }
+        }
+        if (success && hAudReader && !audioTask.success)
+        {
+            m_errMsg = audioTask.errMsg;
+            success = false;
+        }
+        if (success)
+        {
+            vector<ConcatPacketSource::InputFile> vidFiles;
+            for (auto& seg : segments)
+                vidFiles.push_back({seg.path, seg.start});
+            vector<ConcatPacketSource::InputFile> audFiles;
+            if (hAudReader)
+                audFiles.push_back({audioTask.path, 0});
+            success = Concatenate(url, vidFiles, {frameRate.den, frameRate.num}, audFiles);
+        }
+
+        for (auto& seg : segments)
+            remove(seg.path.c_str());
+        if (hAudReader)
+            remove(audioTask.path.c_str());
+        m_finished = success;
+        return success;
+    }
+
+    void Cancel() override
+    {
+        m_cancel = true;
+    }
+
+    void EnableSmartRender(bool enable) override
+    {
+        m_smartRender = enable;
+    }
+
+    bool IsSmartRenderEnabled() const override
+    {
+        return m_smartRender;
+    }
+
+    float GetProgress() const override
+    {
+        if (m_finished)
+            return 1.f;
+        double ratio = 1;
+        if (m_totalFrames > 0)
+            ratio = min(ratio, (double)m_encodedFrames/m_totalFrames);
+        if (m_totalSamples > 0)
+            ratio = min(ratio, (double)m_encodedSamples/m_totalSamples);
+        // the last part is for concatenating
+        return (float)(ratio*0.95);
+    }
+
+    string GetError() const override
+    {
+        return m_errMsg;
+    }
+
+private:
+    struct Task
+    {
+        int64_t start{0};  // in frames for video, in samples for audio
+        int64_t end{0};
+        string path;
+        bool success{false};
+        string errMsg;
+        // for the stream copied video segments, the packets from key frame 'srcStartPts' to key frame 'srcEndPts'
+        bool copy{false};
+        string srcUrl;
+        int64_t srcStartPts{0};
+        int64_t srcEndPts{0};
+    };
+
+    struct SourceInfo
+    {
+        bool valid{false};
+        AVCodecID codecId{AV_CODEC_ID_NONE};
+        int width{0};
+        int height{0};
+        int pixfmt{-1};
+        AVRational frameRate{0, 1};
+        AVRational timeBase{0, 1};
+        int64_t startTime{0};
+        int profile{-1};
+        int level{-1};
+        int bitDepth{0};
+        AVRational sar{0, 1};
+        AVColorRange colorRange{AVCOL_RANGE_UNSPECIFIED};
+        AVColorPrimaries colorPrimaries{AVCOL_PRI_UNSPECIFIED};
+        AVColorTransferCharacteristic colorTrc{AVCOL_TRC_UNSPECIFIED};
+        AVColorSpace colorSpace{AVCOL_SPC_UNSPECIFIED};
+        MediaParser::SeekPointsHolder hSeekPoints;
+        // the demuxer is kept open to check the GOPs at the candidate key frames
+        shared_ptr<AVFormatContext> hFmtCtx;
+        int stmIdx{-1};
+    };
+
+    // Temporary file next to the output file, with the same extension so that the same muxer is used
+    static string MakeTempPath(const string& url, const string& tag)
+    {
+        auto slashPos = url.find_last_of("/\\");
+        auto dotPos = url.rfind('.');
+        if (dotPos == string::npos || (slashPos != string::npos && dotPos < slashPos))
+            return url+"."+tag;
+        return url.substr(0, dotPos)+"."+tag+url.substr(dotPos);
+    }
+
+    static bool ProbeSource(MediaParser::Holder hParser, SourceInfo& src)
+    {
+        AVFormatContext* ifmtCtx = nullptr;
+        if (avformat_open_input(&ifmtCtx, hParser->GetUrl().c_str(), nullptr, nullptr) < 0)
+            return false;
+        const int stmIdx = hParser->GetBestVideoStreamIndex();
+        if (avformat_find_stream_info(ifmtCtx, nullptr) >= 0 && stmIdx >= 0 && stmIdx < (int)ifmtCtx->nb_streams)
+        {
+            const AVStream* stm = ifmtCtx->streams[stmIdx];
+            src.codecId = stm->codecpar->codec_id;
+            src.width = stm->codecpar->width;
+            src.height = stm->codecpar->height;
+            src.pixfmt = stm->codecpar->format;
+            src.profile = stm->codecpar->profile;
+            src.level = stm->codecpar->level;
+            src.bitDepth = stm->codecpar->bits_per_raw_sample;
+            src.sar = stm->codecpar->sample_aspect_ratio;
+            src.colorRange = stm->codecpar->color_range;
+            src.colorPrimaries = stm->codecpar->color_primaries;
+            src.colorTrc = stm->codecpar->color_trc;
+            src.colorSpace = stm->codecpar->color_space;
+            src.frameRate = stm->avg_frame_rate;
+            src.timeBase = stm->time_base;
+            src.startTime = stm->start_time != AV_NOPTS_VALUE ? stm->start_time : 0;
+            hParser->EnableParseInfo(MediaParser::VIDEO_SEEK_POINTS);
+            src.hSeekPoints = hParser->GetVideoSeekPoints(true);
+            src.valid = src.hSeekPoints && !src.hSeekPoints->empty();
+        }
+        if (!src.valid)
+        {
+            avformat_close_input(&ifmtCtx);
+            return false;
+        }
+        src.hFmtCtx = shared_ptr<AVFormatContext>(ifmtCtx, [] (AVFormatContext* ctx) {
+            avformat_close_input(&ctx);
+        });
+        src.stmIdx = stmIdx;
+        return true;
+    }
+
+    // Whether the key frame at 'keyPts' starts a closed GOP, that is, no leading picture follows it in decoding order.
+    // The leading pictures of an open GOP depend on the key frame, so a copied span can NOT end at it.
+    static bool IsClosedGopStart(const SourceInfo& src, int64_t keyPts)
+    {
+        AVFormatContext* ifmtCtx = src.hFmtCtx.get();
+        const int stmIdx = src.stmIdx;
+        if (av_seek_frame(ifmtCtx, stmIdx, keyPts, AVSEEK_FLAG_BACKWARD) < 0)
+            return false;
+        bool closed = false;
+        AVPacket* pkt = av_packet_alloc();
+        bool keyFound = false;
+        // the leading pictures come right after the key frame, before any trailing picture
+        for (int i = 0; i < 256 && av_read_frame(ifmtCtx, pkt) >= 0; i++)
+        {
+            const bool isVideo = pkt->stream_index == stmIdx;
+            const int64_t pts = pkt->pts;
+            const bool isKey = (pkt->flags&AV_PKT_FLAG_KEY) != 0;
+            av_packet_unref(pkt);
+            if (!isVideo || pts == AV_NOPTS_VALUE)
+                continue;
+            if (!keyFound)
+            {
+                keyFound = isKey && pts == keyPts;
+                if (pts > keyPts)
+                    break;
+                continue;
+            }
+            if (pts < keyPts)
+                break;
+            closed = true;
+            break;
+        }
+        av_packet_free(&pkt);
+        return closed;
+    }
+
+    // Find the value of an encoder option in 'opts', or return 'defVal' if it's not set
+    static int64_t GetIntOption(const vector<MediaEncoder::Option>& opts, const string& name, int64_t defVal)
+    {
+        auto iter = find_if(opts.begin(), opts.end(), [&name] (const MediaEncoder::Option& opt) {
+            return opt.name == name;
+        });
+        if (iter == opts.end() || iter->value.type != MediaEncoder::Option::OPVT_INT)
+            return defVal;
+        return iter->value.numval.i64;
+    }
+
+    // Split the export range [0, totalFrames) into pieces, which are either rendered or stream copied from a source file
+    void PlanVideoPieces(MultiTrackVideoReader::Holder hVidReader, const VideoSettings& settings, int64_t startFrame, int64_t totalFrames,
+            vector<Task>& pieces, string& imageFormat)
+    {
+        vector<Task> copyPieces;
+        if (m_smartRender)
+            FindCopyPieces(hVidReader, settings, startFrame, totalFrames, copyPieces, imageFormat);
+        int64_t f = 0;
+        for (auto& piece : copyPieces)
+        {
+            if (piece.start > f)
+            {
+                Task render;
+                render.start = f;
+                render.end = piece.start;
+                pieces.push_back(render);
+            }
+            pieces.push_back(piece);
+            f = piece.end;
+        }
+        if (f < totalFrames)
+        {
+            Task render;
+            render.start = f;
+            render.end = totalFrames;
+            pieces.push_back(render);
+        }
+    }
+
+    void FindCopyPieces(MultiTrackVideoReader::Holder hVidReader, const VideoSettings& settings, int64_t startFrame, int64_t totalFrames,
+            vector<Task>& copyPieces, string& imageFormat)
+    {
+        const AVCodec* encoder = avcodec_find_encoder_by_name(settings.codecName.c_str());
+        if (!encoder)
+            return;
+        // the copied and the encoded spans carry different codec headers, they are joined with in-band parameter sets,
+        // which is only done for H.264 and HEVC
+        if (encoder->id != AV_CODEC_ID_H264 && encoder->id != AV_CODEC_ID_HEVC)
+        {
+            m_logger->Log(DEBUG) << "Smart render is skipped because codec '" << encoder->name << "' is not H.264 or HEVC." << endl;
+            return;
+        }
+        // the properties the encoded spans are tagged with, the copied ones must match them
+        const AVColorRange encColorRange = (AVColorRange)GetIntOption(settings.extraOpts, "color_range", AVCOL_RANGE_UNSPECIFIED);
+        const AVColorPrimaries encColorPrimaries = (AVColorPrimaries)GetIntOption(settings.extraOpts, "color_primaries", AVCOL_PRI_UNSPECIFIED);
+        const AVColorTransferCharacteristic encColorTrc = (AVColorTransferCharacteristic)GetIntOption(settings.extraOpts, "color_trc", AVCOL_TRC_UNSPECIFIED);
+        const AVColorSpace encColorSpace = (AVColorSpace)GetIntOption(settings.extraOpts, "colorspace", AVCOL_SPC_UNSPECIFIED);
+        if (hVidReader->SubtitleTrackCount() > 0)
+        {
+            m_logger->Log(DEBUG) << "Smart render is skipped because subtitles are burned into the video." << endl;
+            return;
+        }
+        vector<VideoClip::Holder> clips;
+        for (auto trkIter = hVidReader->TrackListBegin(); trkIter != hVidReader->TrackListEnd(); trkIter++)
+        {
+            auto& hTrack = *trkIter;
+            if (!hTrack->IsVisible())
+                continue;
+            for (auto clipIter = hTrack->ClipListBegin(); clipIter != hTrack->ClipListEnd(); clipIter++)
+                clips.push_back(*clipIter);
+        }
+
+        const Ratio& frameRate = settings.frameRate;
+        const int64_t endFrame = startFrame+totalFrames;
+        auto framePos = [&frameRate] (int64_t frameIdx) {
+            return (frameIdx*frameRate.den*1000+frameRate.num-1)/frameRate.num;
+        };
+        auto frameAt = [&frameRate] (int64_t pos) {
+            return (pos*frameRate.num+frameRate.den*1000-1)/(frameRate.den*1000);
+        };
+        map<string, SourceInfo> sources;
+        int refPixfmt = -1;
+        const SourceInfo* refSrc = nullptr;
+        for (auto& hClip : clips)
+        {
+            if (hClip->IsImage() || hClip->GetFilter() || !IsIdentityTransform(hClip->GetTransformFilter(), settings.width, settings.height))
+                continue;
+            // the parts of the clip not covered by any other clip, including the overlaps on the same track
+            vector<pair<int64_t, int64_t>> spans = {{hClip->Start(), hClip->End()}};
+            for (auto& hOther : clips)
+            {
+                if (hOther == hClip)
+                    continue;
+                vector<pair<int64_t, int64_t>> remains;
+                for (auto& span : spans)
+                {
+                    if (hOther->End() <= span.first || hOther->Start() >= span.second)
+                    {
+                        remains.push_back(span);
+                        continue;
+                    }
+                    if (hOther->Start() > span.first)
+                        remains.push_back({span.first, hOther->Start()});
+                    if (hOther->End() < span.second)
+                        remains.push_back({hOther->End(), span.second});
+                }
+                spans.swap(remains);
+            }
+            if (spans.empty())
+                continue;
+
+            auto hParser = hClip->GetMediaParser();
+            const string url = hParser->GetUrl();
+            auto srcIter = sources.find(url);
+            if (srcIter == sources.end())
+            {
+                SourceInfo src;
+                ProbeSource(hParser, src);
+                srcIter = sources.insert({url, src}).first;
+            }
+            const SourceInfo& src = srcIter->second;
+            if (!src.valid || src.codecId != encoder->id || src.width != (int)settings.width || src.height != (int)settings.height ||
+                av_cmp_q(src.frameRate, {frameRate.num, frameRate.den}) != 0)
+                continue;
+            // the encoder writes square pixels and the colour properties from its options
+            if ((src.sar.num != 0 && av_cmp_q(src.sar, {1, 1}) != 0) || src.colorRange != encColorRange || src.colorPrimaries != encColorPrimaries ||
+                src.colorTrc != encColorTrc || src.colorSpace != encColorSpace)
+                continue;
+            // all the copied segments must share the same pixel format, the rendered ones are encoded in it too.
+            // they must also share the profile, the level and the bit depth, the output header is taken from one of them.
+            if (refSrc && (src.pixfmt != refSrc->pixfmt || src.profile != refSrc->profile || src.level != refSrc->level || src.bitDepth != refSrc->bitDepth))
+                continue;
+
+            auto srcPts = [&] (int64_t frameIdx) {
+                return av_rescale_q(framePos(frameIdx)-hClip->Start()+hClip->StartOffset(), MILLISEC_TIMEBASE, src.timeBase)+src.startTime;
+            };
+            // the timeline frame showing the source frame at 'pts', it must be on the frame grid within 1 millisecond
+            auto keyFrameIdx = [&] (int64_t pts, int64_t& frameIdx) {
+                const double srcSec = (double)(pts-src.startTime)*src.timeBase.num/src.timeBase.den;
+                const double tlSec = srcSec+(double)(hClip->Start()-hClip->StartOffset())/1000;
+                frameIdx = llround(tlSec*frameRate.num/frameRate.den);
+                return fabs((double)frameIdx*frameRate.den/frameRate.num-tlSec) <= 0.001;
+            };
+            const auto& seekPoints = *src.hSeekPoints;
+            for (auto& span : spans)
+            {
+                const int64_t f0 = max(frameAt(span.first), startFrame);
+                const int64_t f1 = min(frameAt(span.second), endFrame);
+                if (f1 <= f0)
+                    continue;
+                // copy whole GOPs only, the parts before the first key frame and after the last one are rendered
+                auto kpIter0 = lower_bound(seekPoints.begin(), seekPoints.end(), srcPts(f0));
+                auto kpIter1 = upper_bound(seekPoints.begin(), seekPoints.end(), srcPts(f1));
+                if (kpIter0 == seekPoints.end() || kpIter1 == seekPoints.begin())
+                    continue;
+                kpIter1--;
+                // the span ends at a key frame without leading pictures, so that the frames before it are all copied
+                while (kpIter1 != kpIter0 && !IsClosedGopStart(src, *kpIter1))
+                    kpIter1--;
+                if (*kpIter0 >= *kpIter1)
+                    continue;
+                int64_t fa, fb;
+                if (!keyFrameIdx(*kpIter0, fa) || !keyFrameIdx(*kpIter1, fb) || fa < f0 || fb > f1 || fb <= fa)
+                    continue;
+                Task piece;
+                piece.copy = true;
+                piece.start = fa-startFrame;
+                piece.end = fb-startFrame;
+                piece.srcUrl = url;
+                piece.srcStartPts = *kpIter0;
+                piece.srcEndPts = *kpIter1;
+                copyPieces.push_back(piece);
+                refPixfmt = src.pixfmt;
+                refSrc = &src;
+            }
+        }
+        sort(copyPieces.begin(), copyPieces.end(), [] (const Task& a, const Task& b) {
+            return a.start < b.start;
+        });
+        if (refPixfmt >= 0)
+            imageFormat = av_get_pix_fmt_name((AVPixelFormat)refPixfmt);
+    }
+
+    // Copy the packets of one GOP-aligned span from the source file, without decoding
+    void CopyVideoSegment(Task& seg)
+    {
+        AVFormatContext* ifmtCtx = nullptr;
+        AVFormatContext* ofmtCtx = nullptr;
+        AVPacket* pkt = av_packet_alloc();
+        bool success = false;
+        int fferr;
+        do {
+            fferr = avformat_open_input(&ifmtCtx, seg.srcUrl.c_str(), nullptr, nullptr);
+            if (fferr < 0)
+            {
+                seg.errMsg = FFapiFailureMessage("avformat_open_input", fferr);
+                break;
+            }
+            fferr = avformat_find_stream_info(ifmtCtx, nullptr);
+            if (fferr < 0)
+            {
+                seg.errMsg = FFapiFailureMessage("avformat_find_stream_info", fferr);
+                break;
+            }
+            const int stmIdx = av_find_best_stream(ifmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+            if (stmIdx < 0)
+            {
+                seg.errMsg = "No video stream is found in file '"+seg.srcUrl+"'!";
+                break;
+            }
+            const AVStream* istm = ifmtCtx->streams[stmIdx];
+            fferr = avformat_alloc_output_context2(&ofmtCtx, nullptr, nullptr, seg.path.c_str());
+            if (fferr < 0)
+            {
+                seg.errMsg = FFapiFailureMessage("avformat_alloc_output_context2", fferr);
+                break;
+            }
+            AVStream* ostm = avformat_new_stream(ofmtCtx, nullptr);
+            avcodec_parameters_copy(ostm->codecpar, istm->codecpar);
+            ostm->codecpar->codec_tag = 0;
+            ostm->time_base = istm->time_base;
+            if ((ofmtCtx->oformat->flags&AVFMT_NOFILE) == 0)
+            {
+                fferr = avio_open(&ofmtCtx->pb, seg.path.c_str(), AVIO_FLAG_WRITE);
+                if (fferr < 0)
+                {
+                    seg.errMsg = FFapiFailureMessage("avio_open", fferr);
+                    break;
+                }
+            }
+            fferr = avformat_write_header(ofmtCtx, nullptr);
+            if (fferr < 0)
+            {
+                seg.errMsg = FFapiFailureMessage("avformat_write_header", fferr);
+                break;
+            }
+            fferr = av_seek_frame(ifmtCtx, stmIdx, seg.srcStartPts, AVSEEK_FLAG_BACKWARD);
+            if (fferr < 0)
+            {
+                seg.errMsg = FFapiFailureMessage("av_seek_frame", fferr);
+                break;
+            }
+
+            bool started = false;
+            while (!m_cancel)
+            {
+                fferr = av_read_frame(ifmtCtx, pkt);
+                if (fferr < 0)
+                    break;
+                if (pkt->stream_index != stmIdx)
+                {
+                    av_packet_unref(pkt);
+                    continue;
+                }
+                const bool isKey = (pkt->flags&AV_PKT_FLAG_KEY) != 0;
+                // some demuxers only set the dts of a packet, the key frames are located by it then
+                const int64_t keyTs = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+                // the end key frame starts a closed GOP, no packet after it is shown before it
+                if (isKey && keyTs != AV_NOPTS_VALUE && keyTs >= seg.srcEndPts)
+                {
+                    av_packet_unref(pkt);
+                    break;
+                }
+                if (!started)
+                    started = isKey && keyTs != AV_NOPTS_VALUE && keyTs >= seg.srcStartPts;
+                // the leading pictures of an open GOP refer to the frames before the start point. they can only be
+                // told by their pts, the packets without pts are kept.
+                if (!started || (pkt->pts != AV_NOPTS_VALUE && pkt->pts < seg.srcStartPts))
+                {
+                    av_packet_unref(pkt);
+                    continue;
+                }
+                if (pkt->pts != AV_NOPTS_VALUE)
+                    pkt->pts -= seg.srcStartPts;
+                if (pkt->dts != AV_NOPTS_VALUE)
+                    pkt->dts -= seg.srcStartPts;
+                av_packet_rescale_ts(pkt, istm->time_base, ostm->time_base);
+                pkt->stream_index = ostm->index;
+                pkt->pos = -1;
+                fferr = av_interleaved_write_frame(ofmtCtx, pkt);
+                if (fferr < 0)
+                {
+                    seg.errMsg = FFapiFailureMessage("av_interleaved_write_frame", fferr);
+                    break;
+                }
+                m_encodedFrames++;
+            }
+            if (fferr < 0 && fferr != AVERROR_EOF)
+            {
+                if (seg.errMsg.empty())
+                    seg.errMsg = FFapiFailureMessage("av_read_frame", fferr);
+                break;
+            }
+            fferr = av_write_trailer(ofmtCtx);
+            if (fferr < 0)
+            {
+                seg.errMsg = FFapiFailureMessage("av_write_trailer", fferr);
+                break;
+            }
+            success = true;
+        } while (false);
+
+        av_packet_free(&pkt);
+        if (ofmtCtx)
+        {
+            if ((ofmtCtx->oformat->flags&AVFMT_NOFILE) == 0)
+                avio_closep(&ofmtCtx->pb);
+            avformat_free_context(ofmtCtx);
+        }
+        if (ifmtCtx)
+            avformat_close_input(&ifmtCtx);
+        seg.success = success && !m_cancel;
+    }
+
+    void ExportVideoSegment(MultiTrackVideoReader::Holder hVidReader, const VideoSettings& settings, const string& imageFormat,
+            int64_t startFrame, Task& seg)
+    {
+        const Ratio& frameRate = settings.frameRate;
+        auto hReader = hVidReader->CloneAndConfigure(settings.width, settings.height, frameRate);
+        if (!hReader)
+        {
+            seg.errMsg = "FAILED to clone MultiTrackVideoReader! Error is '"+hVidReader->GetError()+"'.";
+            return;
+        }
+        hReader->SetOfflineMode(true);
+        auto hEncoder = MediaEncoder::CreateInstance();
+        vector<MediaEncoder::Option> extraOpts = settings.extraOpts;
+        auto iter = find_if(extraOpts.begin(), extraOpts.end(), [] (const MediaEncoder::Option& opt) {
+            return opt.name == "g";
+        });
+        if (iter == extraOpts.end())
+        {
+            MediaEncoder::Option gopOpt;
+            gopOpt.name = "g";
+            gopOpt.value.type = MediaEncoder::Option::OPVT_INT;
+            gopOpt.value.numval.i64 = settings.gopSize;
+            extraOpts.push_back(gopOpt);
+        }
+        string encImageFormat = imageFormat;
+        if (!hEncoder->Open(seg.path) ||
+            !hEncoder->ConfigureVideoStream(settings.codecName, encImageFormat, settings.width, settings.height, frameRate, settings.bitRate, &extraOpts) ||
+            !hEncoder->Start())
+        {
+            seg.errMsg = "FAILED to setup MediaEncoder for segment '"+seg.path+"'! Error is '"+hEncoder->GetError()+"'.";
+            hReader->Close();
+            return;
+        }
+
+        bool success = true;
+        // the positions are rounded up, so that they don't fall into the previous frames
+        auto framePos = [&frameRate] (int64_t frameIdx) {
+            return (frameIdx*frameRate.den*1000+frameRate.num-1)/frameRate.num;
+        };
+        hReader->SeekTo(framePos(startFrame+seg.start), false);
+        for (int64_t f = seg.start; f < seg.end && !m_cancel; f++)
+        {
+            ImGui::ImMat vmat;
+            if (!hReader->ReadVideoFrame(framePos(startFrame+f), vmat))
+            {
+                seg.errMsg = "FAILED to read video frame! Error is '"+hReader->GetError()+"'.";
+                success = false;
+                break;
+            }
+            // each segment starts from 0, they are rebased when concatenating
+            vmat.time_stamp = (double)(f-seg.start)*frameRate.den/frameRate.num;
+            if (!hEncoder->EncodeVideoFrame(vmat))
+            {
+                seg.errMsg = "FAILED to encode video frame! Error is '"+hEncoder->GetError()+"'.";
+                success = false;
+                break;
+            }
+            m_encodedFrames++;
+        }
+        ImGui::ImMat eofMat;
+        hEncoder->EncodeVideoFrame(eofMat);
+        if (!hEncoder->FinishEncoding() && success)
+        {
+            seg.errMsg = "FAILED to finish encoding segment '"+seg.path+"'! Error is '"+hEncoder->GetError()+"'.";
+            success = false;
+        }
+        hEncoder->Close();
+        hReader->Close();
+        seg.success = success && !m_cancel;
+    }
+
+    void ExportAudio(MultiTrackAudioReader::Holder hAudReader, const AudioSettings& settings, Task& task)
+    {
+        auto hReader = hAudReader->CloneAndConfigure(settings.channels, settings.sampleRate, 1024);
+        if (!hReader)
+        {
+            task.errMsg = "FAILED to clone MultiTrackAudioReader! Error is '"+hAudReader->GetError()+"'.";
+            return;
+        }
+        hReader->SetOfflineMode(true);
+        auto hEncoder = MediaEncoder::CreateInstance();
+        string sampleFormat;
+        if (!hEncoder->Open(task.path) ||
+            !hEncoder->ConfigureAudioStream(settings.codecName, sampleFormat, settings.channels, settings.sampleRate, settings.bitRate) ||
+            !hEncoder->Start())
+        {
+            task.errMsg = "FAILED to setup MediaEncoder for audio '"+task.path+"'! Error is '"+hEncoder->GetError()+"'.";
+            hReader->Close();
+            return;
+        }
+
+        bool success = true;
+        hReader->SeekTo(task.start*1000/settings.sampleRate);
+        int64_t samplePos = task.start;
+        while (samplePos < task.end && !m_cancel)
+        {
+            ImGui::ImMat amat;
+            bool eof;
+            if (!hReader->ReadAudioSamples(amat, eof))
+            {
+                task.errMsg = "FAILED to read audio samples! Error is '"+hReader->GetError()+"'.";
+                success = false;
+                break;
+            }
+            const int64_t remaining = task.end-samplePos;
+            if (amat.w > remaining)
+            {
+                // cut the samples beyond the export range, the planar ones are cut plane by plane
+                ImGui::ImMat trimmed;
+                trimmed.create_type((int)remaining, 1, amat.c, amat.type);
+                if (amat.elempack == amat.c)
+                {
+                    memcpy(trimmed.data, amat.data, (size_t)remaining*amat.c*amat.elemsize);
+                }
+                else
+                {
+                    const size_t srcLineSize = (size_t)amat.w*amat.elemsize;
+                    const size_t dstLineSize = (size_t)remaining*amat.elemsize;
+                    const uint8_t* srcptr = (const uint8_t*)amat.data;
+                    uint8_t* dstptr = (uint8_t*)trimmed.data;
+                    for (int ch = 0; ch < amat.c; ch++)
+                        memcpy(dstptr+ch*dstLineSize, srcptr+ch*srcLineSize, dstLineSize);
+                }
+                trimmed.elempack = amat.elempack;
+                trimmed.flags = amat.flags;
+                trimmed.rate = amat.rate;
+                trimmed.time_stamp = amat.time_stamp;
+                amat = trimmed;
+            }
+            if (!hEncoder->EncodeAudioSamples(amat))
+            {
+                task.errMsg = "FAILED to encode audio samples! Error is '"+hEncoder->GetError()+"'.";
+                success = false;
+                break;
+            }
+            samplePos += amat.w;
+            m_encodedSamples = samplePos-task.start;
+        }
+        hEncoder->EncodeAudioSamples(nullptr, 0);
+        if (!hEncoder->FinishEncoding() && success)
+        {
+            task.errMsg = "FAILED to finish encoding audio '"+task.path+"'! Error is '"+hEncoder->GetError()+"'.";
+            success = false;
+        }
+        hEncoder->Close();
+        hReader->Close();
+        task.success = success && !m_cancel;
+    }
+
+    bool Concatenate(const string& url, const vector<ConcatPacketSource::InputFile>& vidFiles, AVRational vidOffsetTb,
+            const vector<ConcatPacketSource::InputFile>& audFiles)
+    {
+        ConcatPacketSource sources[2];
+        AVMediaType mediaTypes[2] = { AVMEDIA_TYPE_VIDEO, AVMEDIA_TYPE_AUDIO };
+        bool hasSource[2] = { !vidFiles.empty(), !audFiles.empty() };
+        if (hasSource[0] && !sources[0].Open(vidFiles, vidOffsetTb, mediaTypes[0]))
+        {
+            m_errMsg = sources[0].GetError();
+            return false;
+        }
+        if (hasSource[1] && !sources[1].Open(audFiles, MILLISEC_TIMEBASE, mediaTypes[1]))
+        {
+            m_errMsg = sources[1].GetError();
+            return false;
+        }
+
+        AVFormatContext* ofmtCtx = nullptr;
+        int fferr = avformat_alloc_output_context2(&ofmtCtx, nullptr, nullptr, url.c_str());
+        if (fferr < 0)
+        {
+            m_errMsg = FFapiFailureMessage("avformat_alloc_output_context2", fferr);
+            return false;
+        }
+        int outStmIdx[2] = { -1, -1 };
+        for (int i = 0; i < 2; i++)
+        {
+            if (!hasSource[i])
+                continue;
+            const AVStream* istm = sources[i].GetStream();
+            AVStream* ostm = avformat_new_stream(ofmtCtx, nullptr);
+            avcodec_parameters_copy(ostm->codecpar, istm->codecpar);
+            ostm->codecpar->codec_tag = 0;
+            // tag the stream as carrying in-band parameter sets, like 'avc3' or 'hev1' in mp4, if the muxer has such tag
+            if (sources[i].HasInbandParamSets() && ofmtCtx->oformat->codec_tag)
+            {
+                const uint32_t inbandTag = istm->codecpar->codec_id == AV_CODEC_ID_H264 ? MKTAG('a', 'v', 'c', '3') : MKTAG('h', 'e', 'v', '1');
+                if (av_codec_get_id(ofmtCtx->oformat->codec_tag, inbandTag) == istm->codecpar->codec_id)
+                    ostm->codecpar->codec_tag = inbandTag;
+            }
+            ostm->time_base = istm->time_base;
+            outStmIdx[i] = ostm->index;
+        }
+        bool success = true;
+        if ((ofmtCtx->oformat->flags&AVFMT_NOFILE) == 0)
+        {
+            fferr = avio_open(&ofmtCtx->pb, url.c_str(), AVIO_FLAG_WRITE);
+            if (fferr < 0)
+            {
+                m_errMsg = FFapiFailureMessage("avio_open", fferr);
+                success = false;
+            }
+        }
+        if (success)
+        {
+            fferr = avformat_write_header(ofmtCtx, nullptr);
+            if (fferr < 0)
+            {
+                m_errMsg = FFapiFailureMessage("avformat_write_header", fferr);
+                success = false;
+            }
+        }
+
+        if (success)
+        {
+            // the packets of the two streams are written in the order of their decoding time
+            AVPacket* pkts[2] = { av_packet_alloc(), av_packet_alloc() };
+            bool pending[2] = { false, false };
+            for (int i = 0; i < 2; i++)
+            {
+                if (hasSource[i])
+                    pending[i] = sources[i].ReadPacket(pkts[i], ofmtCtx->streams[outStmIdx[i]]->time_base) == 0;
+            }
+            while ((pending[0] || pending[1]) && !m_cancel)
+            {
+                int sel = pending[0] ? 0 : 1;
+                if (pending[0] && pending[1])
+                {
+                    const int64_t ts0 = pkts[0]->dts != AV_NOPTS_VALUE ? pkts[0]->dts : pkts[0]->pts;
+                    const int64_t ts1 = pkts[1]->dts != AV_NOPTS_VALUE ? pkts[1]->dts : pkts[1]->pts;
+                    if (av_compare_ts(ts1, ofmtCtx->streams[outStmIdx[1]]->time_base, ts0, ofmtCtx->streams[outStmIdx[0]]->time_base) < 0)
+                        sel = 1;
+                }
+                pkts[sel]->stream_index = outStmIdx[sel];
+                fferr = av_interleaved_write_frame(ofmtCtx, pkts[sel]);
+                if (fferr < 0)
+                {
+                    m_errMsg = FFapiFailureMessage("av_interleaved_write_frame", fferr);
+                    success = false;
+                    break;
+                }
+                fferr = sources[sel].ReadPacket(pkts[sel], ofmtCtx->streams[outStmIdx[sel]]->time_base);
+                pending[sel] = fferr == 0;
+                if (fferr < 0 && fferr != AVERROR_EOF)
+                {
+                    m_errMsg = sources[sel].GetError();
+                    success = false;
+                    break;
+                }
+            }
+            av_packet_free(&pkts[0]);
+            av_packet_free(&pkts[1]);
+            if (m_cancel)
+            {
+                m_errMsg = "Export is canceled.";
+                success = false;
+            }
+            fferr = av_write_trailer(ofmtCtx);
+            if (fferr < 0 && success)
+            {
+                m_errMsg = FFapiFailureMessage("av_write_trailer", fferr);
+                success = false;
+            }
+        }
+        if ((ofmtCtx->oformat->flags&AVFMT_NOFILE) == 0)
+            avio_closep(&ofmtCtx->pb);
+        avformat_free_context(ofmtCtx);
+        return success;
+    }
+
+private:
+    ALogger* m_logger;
+    string m_errMsg;
+    mutex m_apiLock;
+    atomic_bool m_cancel{false};
+    bool m_smartRender{false};
+    atomic_bool m_finished{false};
+    atomic_int64_t m_totalFrames{0};
+    atomic_int64_t m_encodedFrames{0};
+    atomic_int64_t m_totalSamples{0};
+    atomic_int64_t m_encodedSamples{0};
+};
+
+static const auto MULTI_TRACK_EXPORTER_DELETER = [] (MultiTrackExporter* p) {
+    MultiTrackExporter_Impl* ptr = dynamic_cast<MultiTrackExporter_Impl*>(p);
+    delete ptr;
+};
+
+MultiTrackExporter::Holder MultiTrackExporter::CreateInstance()
+{
+    return MultiTrackExporter::Holder(new MultiTrackExporter_Impl(), MULTI_TRACK_EXPORTER_DELETER);
+}
+
+ALogger* MultiTrackExporter::GetLogger()
+{
+    return Logger::GetLogger("MTExporter");
+}
+}
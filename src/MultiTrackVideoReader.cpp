@@ -16,11 +16,14 @@
 */
 
 #include <thread>
+#include <condition_variable>
 #include <algorithm>
 #include <atomic>
 #include <sstream>
+#include <unordered_map>
 #include "MultiTrackVideoReader.h"
 #include "VideoBlender.h"
+#include "RenderFrameCache.h"
 #include "FFUtils.h"
 #include "SysUtils.h"
 
@@ -29,6 +32,133 @@ using namespace Logger;
 
 namespace MediaCore
 {
+// Cache of the post-transform frames of the tracks, keyed by track id and frame index. Each entry keeps the content
+// hash of the track at that frame (see 'VideoTrack::GetContentHash()'), it's dropped when the hash doesn't match any
+// more, so an edit only drops the frames it affects. The least recently used frames are evicted when the memory
+// budget is exceeded.
+class TrackFrameCache
+{
+public:
+    struct Entry
+    {
+        // all the correlative frames added by reading this track frame, the last one is the track output
+        vector<CorrelativeFrame> outputFrames;
+        ImGui::ImMat vmat;
+        bool opaque{false};
+    };
+
+    void SetMemoryBudget(uint64_t memoryBudget)
+    {
+        lock_guard<mutex> lk(m_cacheLock);
+        m_memoryBudget = memoryBudget;
+        EvictFrames();
+    }
+
+    void Clear()
+    {
+        lock_guard<mutex> lk(m_cacheLock);
+        m_tracks.clear();
+        m_lruList.clear();
+        m_usedMemory = 0;
+    }
+
+    void RemoveTrack(int64_t trackId)
+    {
+        lock_guard<mutex> lk(m_cacheLock);
+        auto iter = m_tracks.find(trackId);
+        if (iter == m_tracks.end())
+            return;
+        for (auto& elem : iter->second)
+        {
+            m_usedMemory -= elem.second.size;
+            m_lruList.erase(elem.second.lruIter);
+        }
+        m_tracks.erase(iter);
+    }
+
+    bool GetFrame(int64_t trackId, int64_t frameIdx, uint64_t contentHash, Entry& entry)
+    {
+        lock_guard<mutex> lk(m_cacheLock);
+        auto trackIter = m_tracks.find(trackId);
+        if (trackIter == m_tracks.end())
+            return false;
+        auto& frames = trackIter->second;
+        auto frameIter = frames.find(frameIdx);
+        if (frameIter == frames.end())
+            return false;
+        if (frameIter->second.contentHash != contentHash)
+        {
+            m_usedMemory -= frameIter->second.size;
+            m_lruList.erase(frameIter->second.lruIter);
+            frames.erase(frameIter);
+            return false;
+        }
+        m_lruList.splice(m_lruList.begin(), m_lruList, frameIter->second.lruIter);
+        entry = frameIter->second.entry;
+        return true;
+    }
+
+    void PutFrame(int64_t trackId, int64_t frameIdx, uint64_t contentHash, const Entry& entry)
+    {
+        // the correlative frames can share their buffers with each other and with the output
+        uint64_t frameSize = 0;
+        vector<const void*> buffers;
+        auto addBuffer = [&frameSize, &buffers] (const ImGui::ImMat& m) {
+            if (m.empty() || find(buffers.begin(), buffers.end(), m.data) != buffers.end())
+                return;
+            buffers.push_back(m.data);
+            frameSize += (uint64_t)m.total()*m.elemsize;
+        };
+        addBuffer(entry.vmat);
+        for (auto& frame : entry.outputFrames)
+            addBuffer(frame.frame);
+        lock_guard<mutex> lk(m_cacheLock);
+        if (frameSize > m_memoryBudget)
+            return;
+        auto& frames = m_tracks[trackId];
+        auto frameIter = frames.find(frameIdx);
+        if (frameIter != frames.end())
+        {
+            m_usedMemory -= frameIter->second.size;
+            m_lruList.erase(frameIter->second.lruIter);
+            frames.erase(frameIter);
+        }
+        m_lruList.push_front({trackId, frameIdx});
+        frames[frameIdx] = {entry, contentHash, frameSize, m_lruList.begin()};
+        m_usedMemory += frameSize;
+        EvictFrames();
+    }
+
+private:
+    struct CachedFrame
+    {
+        Entry entry;
+        uint64_t contentHash;
+        uint64_t size;
+        list<pair<int64_t, int64_t>>::iterator lruIter;
+    };
+
+    void EvictFrames()
+    {
+        while (m_usedMemory > m_memoryBudget && !m_lruList.empty())
+        {
+            const auto key = m_lruList.back();
+            m_lruList.pop_back();
+            auto& frames = m_tracks[key.first];
+            auto frameIter = frames.find(key.second);
+            m_usedMemory -= frameIter->second.size;
+            frames.erase(frameIter);
+        }
+    }
+
+private:
+    mutex m_cacheLock;
+    unordered_map<int64_t, unordered_map<int64_t, CachedFrame>> m_tracks;
+    list<pair<int64_t, int64_t>> m_lruList;  // (track id, frame index), the most recently used at front
+    uint64_t m_memoryBudget{0};
+    uint64_t m_usedMemory{0};
+};
+
 class MultiTrackVideoReader_Impl : public MultiTrackVideoReader
 {
 public:
@@ -119,6 +249,8 @@ public:
 
         m_tracks.clear();
         m_outputCache.clear();
+        m_trackFrameCache.Clear();
+        m_renderCache.Clear();
         m_configured = false;
         m_started = false;
         m_outWidth = 0;
@@ -204,6 +336,7 @@ public:
             {
                 delTrack = *iter;
                 m_tracks.erase(iter);
+                m_trackFrameCache.RemoveTrack(delTrack->Id());
                 UpdateDuration();
                 for (auto track : m_tracks)
                     track->SeekTo(ReadPos());
@@ -236,6 +369,7 @@ public:
             {
                 delTrack = *iter;
                 m_tracks.erase(iter);
+                m_trackFrameCache.RemoveTrack(delTrack->Id());
                 UpdateDuration();
                 for (auto track : m_tracks)
                     track->SeekTo(ReadPos());
@@ -330,11 +464,21 @@ public:
         m_inSeekingState = true;
         m_seeking = true;
         m_logger->Log(DEBUG) << "------> SeekTo seekPos=" << pos << endl;
+        NotifyOutputCacheChange();
 
         if (!async)
         {
-            while (m_inSeekingState && !m_quit)
-                this_thread::sleep_for(chrono::milliseconds(5));
+            if (m_offlineMode)
+            {
+                unique_lock<mutex> lk2(m_outputCacheLock);
+                while (m_inSeekingState && !m_quit)
+                    m_outputCacheCv.wait_for(lk2, chrono::milliseconds(OFFLINE_WAIT_TIMEOUT));
+            }
+            else
+            {
+                while (m_inSeekingState && !m_quit)
+                    this_thread::sleep_for(chrono::milliseconds(5));
+            }
             if (m_quit)
                 return false;
         }
@@ -383,7 +527,8 @@ public:
         }
 
         int64_t targetFrmidx = (int64_t)(floor((double)pos*m_frameRate.num/(m_frameRate.den*1000)));
-        if (nonblocking)
+        // no frame is skipped in offline mode
+        if (nonblocking && !m_offlineMode)
         {
             if (!m_inSeekingState && pos != m_prevReadPos)
             {
@@ -450,8 +595,17 @@ public:
         }
         else
         {
-            while (!m_quit && m_inSeekingState)
-                this_thread::sleep_for(chrono::milliseconds(5));
+            if (m_offlineMode)
+            {
+                unique_lock<mutex> lk2(m_outputCacheLock);
+                while (!m_quit && m_inSeekingState)
+                    m_outputCacheCv.wait_for(lk2, chrono::milliseconds(OFFLINE_WAIT_TIMEOUT));
+            }
+            else
+            {
+                while (!m_quit && m_inSeekingState)
+                    this_thread::sleep_for(chrono::milliseconds(5));
+            }
 
             if ((m_readForward && (targetFrmidx < m_readFrameIdx || targetFrmidx-m_readFrameIdx >= m_outputCacheSize)) ||
                 (!m_readForward && (targetFrmidx > m_readFrameIdx || m_readFrameIdx-targetFrmidx >= m_outputCacheSize)))
@@ -461,26 +615,27 @@ public:
             }
 
             // the frame queue may not be filled with the target frame, wait for the mixing thread to fill it
-            bool lockAquaired = false;
-            while (!m_quit)
+            unique_lock<mutex> lk2(m_outputCacheLock);
+            while (!m_quit && !((m_readForward && targetFrmidx < m_outputCache.size()+m_readFrameIdx) ||
+                    (!m_readForward && m_readFrameIdx < m_outputCache.size()+targetFrmidx)))
             {
-                m_outputCacheLock.lock();
-                lockAquaired = true;
-                if ((m_readForward && targetFrmidx < m_outputCache.size()+m_readFrameIdx) ||
-                    (!m_readForward && m_readFrameIdx < m_outputCache.size()+targetFrmidx))
-                    break;
-                m_outputCacheLock.unlock();
-                lockAquaired = false;
-                this_thread::sleep_for(chrono::milliseconds(5));
+                if (m_offlineMode)
+                {
+                    m_outputCacheCv.wait_for(lk2, chrono::milliseconds(OFFLINE_WAIT_TIMEOUT));
+                }
+                else
+                {
+                    lk2.unlock();
+                    this_thread::sleep_for(chrono::milliseconds(5));
+                    lk2.lock();
+                }
             }
             if (m_quit)
             {
-                if (lockAquaired) m_outputCacheLock.unlock();
                 m_errMsg = "This 'MultiTrackVideoReader' instance is quit.";
                 return false;
             }
 
-            lock_guard<mutex> lk2(m_outputCacheLock, adopt_lock);
             if ((m_readForward && targetFrmidx > m_readFrameIdx) || (!m_readForward && m_readFrameIdx > targetFrmidx))
             {
                 auto popCnt = m_readForward ? targetFrmidx-m_readFrameIdx : m_readFrameIdx-targetFrmidx;
@@ -492,6 +647,8 @@ public:
                     else
                         m_readFrameIdx--;
                 }
+                if (m_offlineMode)
+                    m_outputCacheCv.notify_all();
             }
             if (m_outputCache.empty())
             {
@@ -530,25 +687,26 @@ public:
             return false;
         }
 
-        bool lockAquaired = false;
-        while (!m_quit)
+        unique_lock<mutex> lk2(m_outputCacheLock);
+        while (!m_quit && m_outputCache.size() <= 1)
         {
-            m_outputCacheLock.lock();
-            lockAquaired = true;
-            if (m_outputCache.size() > 1)
-                break;
-            m_outputCacheLock.unlock();
-            lockAquaired = false;
-            this_thread::sleep_for(chrono::milliseconds(5));
+            if (m_offlineMode)
+            {
+                m_outputCacheCv.wait_for(lk2, chrono::milliseconds(OFFLINE_WAIT_TIMEOUT));
+            }
+            else
+            {
+                lk2.unlock();
+                this_thread::sleep_for(chrono::milliseconds(5));
+                lk2.lock();
+            }
         }
         if (m_quit)
         {
-            if (lockAquaired) m_outputCacheLock.unlock();
             m_errMsg = "This 'MultiTrackVideoReader' instance is quit.";
             return false;
         }
 
-        lock_guard<mutex> lk2(m_outputCacheLock, adopt_lock);
         if (m_readForward)
         {
             m_outputCache.pop_front();
@@ -559,6 +717,8 @@ public:
             m_outputCache.pop_front();
             m_readFrameIdx--;
         }
+        if (m_offlineMode)
+            m_outputCacheCv.notify_all();
         frames = m_outputCache.front();
         if (!m_subtrks.empty())
             frames[0].frame = BlendSubtitle(frames[0].frame);
@@ -598,12 +758,142 @@ public:
         }
 
         UpdateDuration();
+        {
+            // everything is regenerated, the invalid ranges are no longer needed
+            lock_guard<recursive_mutex> lk2(m_trackLock);
+            int64_t start, end;
+            for (auto& track : m_tracks)
+            {
+                if (track->TakeInvalidRange(start, end))
+                    InvalidateRenderedFrames(start, end);
+            }
+        }
 
         int64_t currPos = m_inSeekingState ? m_seekPos : ReadPos();
         SeekTo(currPos, async);
         return true;
     }
 
+    bool RefreshInvalidRanges() override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (!m_started)
+        {
+            m_errMsg = "This MultiTrackVideoReader instance is NOT started yet!";
+            return false;
+        }
+
+        UpdateDuration();
+        int64_t invalidStart = INT64_MAX, invalidEnd = INT64_MIN;
+        {
+            lock_guard<recursive_mutex> lk2(m_trackLock);
+            for (auto& track : m_tracks)
+            {
+                int64_t start, end;
+                if (track->TakeInvalidRange(start, end))
+                {
+                    if (invalidStart > start) invalidStart = start;
+                    if (invalidEnd < end) invalidEnd = end;
+                }
+            }
+        }
+        if (invalidStart >= invalidEnd)
+            return true;
+        InvalidateRenderedFrames(invalidStart, invalidEnd);
+
+        // the cached output frames are checked by the mixing thread
+        lock_guard<mutex> lk2(m_outputCacheLock);
+        if (m_invalidStart > invalidStart) m_invalidStart = invalidStart;
+        if (m_invalidEnd < invalidEnd) m_invalidEnd = invalidEnd;
+        m_logger->Log(DEBUG) << "------> Invalidate range [" << invalidStart << ", " << invalidEnd << ")" << endl;
+        m_outputCacheCv.notify_all();
+        return true;
+    }
+
+    void EnableOcclusionCulling(bool enable) override
+    {
+        m_occlusionCulling = enable;
+    }
+
+    bool IsOcclusionCullingEnabled() const override
+    {
+        return m_occlusionCulling;
+    }
+
+    void EnableTrackFrameCache(bool enable, uint64_t memoryBudget) override
+    {
+        m_trackFrameCache.SetMemoryBudget(memoryBudget);
+        if (!enable)
+            m_trackFrameCache.Clear();
+        m_trackFrameCacheEnabled = enable;
+    }
+
+    bool IsTrackFrameCacheEnabled() const override
+    {
+        return m_trackFrameCacheEnabled;
+    }
+
+    bool EnableRenderCache(bool enable, const VideoRenderCacheOptions& options) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        m_renderCacheEnabled = false;
+        if (!enable)
+        {
+            m_renderCache.Configure(0, false, "", 0);
+            return true;
+        }
+        if (!m_renderCache.Configure(options.memoryBudget, options.compress, options.spillPath, options.diskBudget))
+        {
+            m_errMsg = m_renderCache.GetError();
+            m_renderCache.Configure(0, false, "", 0);
+            return false;
+        }
+        m_renderCacheEnabled = true;
+        return true;
+    }
+
+    bool IsRenderCacheEnabled() const override
+    {
+        return m_renderCacheEnabled;
+    }
+
+    bool SetOfflineMode(bool enable, uint32_t lookAheadFrames) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (enable && lookAheadFrames < 2)
+        {
+            m_errMsg = "Argument 'lookAheadFrames' must be at least 2!";
+            return false;
+        }
+        {
+            lock_guard<mutex> lk2(m_outputCacheLock);
+            m_offlineMode = enable;
+            m_outputCacheSize = enable ? lookAheadFrames : DEFAULT_OUTPUT_CACHE_SIZE;
+        }
+        m_outputCacheCv.notify_all();
+        return true;
+    }
+
+    bool IsOfflineMode() const override
+    {
+        return m_offlineMode;
+    }
+
+    void GetRenderedRanges(vector<pair<int64_t, int64_t>>& ranges) override
+    {
+        m_renderCache.GetRenderedFrameRanges(ranges);
+        if (m_frameRate.num <= 0)
+        {
+            ranges.clear();
+            return;
+        }
+        for (auto& range : ranges)
+        {
+            range.first = range.first*m_frameRate.den*1000/m_frameRate.num;
+            range.second = range.second*m_frameRate.den*1000/m_frameRate.num;
+        }
+    }
+
     uint32_t TrackCount() const override
     {
         return m_tracks.size();
@@ -774,6 +1064,12 @@ public:
         return *iter;
     }
 
+    uint32_t SubtitleTrackCount() override
+    {
+        lock_guard<mutex> lk(m_subtrkLock);
+        return m_subtrks.size();
+    }
+
     SubtitleTrackHolder RemoveSubtitleTrackById(int64_t trackId) override
     {
         lock_guard<mutex> lk(m_subtrkLock);
@@ -855,6 +1151,7 @@ private:
         if (m_mixingThread.joinable())
         {
             m_quit = true;
+            NotifyOutputCacheChange();
             m_mixingThread.join();
         }
     }
@@ -882,8 +1179,11 @@ private:
                 }
                 afterSeek = true;
                 m_inSeekingState = false;
+                NotifyOutputCacheChange();
             }
 
+            DiscardInvalidOutputFrames();
+
             if (m_nextReadPos != INT64_MIN)
             {
                 int64_t nextReadFrameIdx = (int64_t)(floor((double)m_nextReadPos*m_frameRate.num/(m_frameRate.den*1000)))-1;
@@ -925,25 +1225,47 @@ private:
                 frames.reserve(tracks.size()*7);
                 frames.push_back({CorrelativeFrame::PHASE_AFTER_MIXING, 0, 0, mixedFrame});
                 double timestamp = (double)m_readFrameIdx*m_frameRate.den/m_frameRate.num;
+                bool renderCacheHit = false;
+                int64_t renderFrameIdx = 0;
+                uint64_t renderKey = 0;
+                if (m_renderCacheEnabled && !tracks.empty())
+                {
+                    renderFrameIdx = (int64_t)round((double)tracks.front()->ReadPos()*m_frameRate.num/(m_frameRate.den*1000));
+                    renderKey = CalcRenderKey(tracks, renderFrameIdx);
+                    if (m_renderCache.GetFrame(renderKey, mixedFrame))
+                    {
+                        // the tracks only advance their read positions
+                        for (auto& hTrack : tracks)
+                            hTrack->SkipOneFrame();
+                        timestamp = mixedFrame.time_stamp;
+                        renderCacheHit = true;
+                    }
+                }
                 auto trackIter = tracks.begin();
                 bool isFirstTrack = true;
-                while (trackIter != tracks.end())
+                bool occluded = false;
+                while (!renderCacheHit && trackIter != tracks.end())
                 {
                     auto hTrack = *trackIter++;
-                    if (!hTrack->IsVisible())
+                    // the tracks under an opaque full frame only advance their read positions
+                    if (!hTrack->IsVisible() || occluded)
                     {
                         hTrack->SkipOneFrame();
                         continue;
                     }
 
                     ImGui::ImMat vmat;
-                    hTrack->ReadVideoFrame(frames, vmat);
+                    bool opaque;
+                    ReadTrackFrame(hTrack, frames, vmat, opaque);
                     if (!vmat.empty())
                     {
                         if (mixedFrame.empty())
                             mixedFrame = vmat;
                         else
                             mixedFrame = m_hMixBlender->Blend(vmat, mixedFrame);
+                        // tracks are mixed from top to bottom, an opaque full frame occludes all the tracks after it
+                        if (m_occlusionCulling && opaque)
+                            occluded = true;
                     }
                     if (isFirstTrack)
                         timestamp = vmat.time_stamp;
@@ -958,6 +1280,12 @@ private:
                     memset(mixedFrame.data, 0, mixedFrame.total()*mixedFrame.elemsize);
                     mixedFrame.time_stamp = timestamp;
                 }
+                if (m_renderCacheEnabled && !renderCacheHit && !tracks.empty())
+                {
+                    // the frame is only cached if the track content isn't changed while it's being read
+                    if (CalcRenderKey(tracks, renderFrameIdx) == renderKey)
+                        m_renderCache.PutFrame(renderKey, renderFrameIdx, mixedFrame);
+                }
                 frames[0].frame = mixedFrame;
                 m_logger->Log(DEBUG) << "---------> Got mixed frame at pos=" << (int64_t)(timestamp*1000) << endl;
 
@@ -979,6 +1307,7 @@ private:
                     if (!m_inSeekingState)
                         m_outputCache.push_back(frames);
                     m_seekingFlash = frames;
+                    m_outputCacheCv.notify_all();
                     idleLoop = false;
                 }
                 else
@@ -988,12 +1317,118 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(5));
+            {
+                if (m_offlineMode)
+                {
+                    // block on the back-pressure of the output queue instead of polling
+                    unique_lock<mutex> lk(m_outputCacheLock);
+                    m_outputCacheCv.wait_for(lk, chrono::milliseconds(OFFLINE_WAIT_TIMEOUT), [this] {
+                        return m_quit || m_seeking || m_outputCache.size() < m_outputCacheSize || m_invalidStart < m_invalidEnd;
+                    });
+                }
+                else
+                {
+                    this_thread::sleep_for(chrono::milliseconds(5));
+                }
+            }
         }
 
         m_logger->Log(DEBUG) << "Leave MixingThreadProc(VIDEO)." << endl;
     }
 
+    void ReadTrackFrame(VideoTrack::Holder hTrack, vector<CorrelativeFrame>& frames, ImGui::ImMat& vmat, bool& opaque)
+    {
+        if (!m_trackFrameCacheEnabled)
+        {
+            hTrack->ReadVideoFrame(frames, vmat);
+            opaque = hTrack->IsReadFrameOpaque();
+            return;
+        }
+
+        const int64_t readPos = hTrack->ReadPos();
+        const int64_t frameIdx = (int64_t)round((double)readPos*m_frameRate.num/(m_frameRate.den*1000));
+        const uint64_t contentHash = hTrack->GetContentHash(readPos);
+        TrackFrameCache::Entry entry;
+        if (m_trackFrameCache.GetFrame(hTrack->Id(), frameIdx, contentHash, entry))
+        {
+            // the read position is advanced as reading a frame
+            hTrack->SkipOneFrame();
+            frames.insert(frames.end(), entry.outputFrames.begin(), entry.outputFrames.end());
+            vmat = entry.vmat;
+            opaque = entry.opaque;
+            return;
+        }
+        const auto frameCnt = frames.size();
+        hTrack->ReadVideoFrame(frames, vmat);
+        opaque = hTrack->IsReadFrameOpaque();
+        entry.outputFrames.assign(frames.begin()+frameCnt, frames.end());
+        entry.vmat = vmat;
+        entry.opaque = opaque;
+        m_trackFrameCache.PutFrame(hTrack->Id(), frameIdx, contentHash, entry);
+    }
+
+    uint64_t CalcRenderKey(const list<VideoTrack::Holder>& tracks, int64_t frameIdx)
+    {
+        ContentHasher hasher;
+        hasher.Add(frameIdx).Add(m_outWidth).Add(m_outHeight);
+        const int64_t pos = frameIdx*m_frameRate.den*1000/m_frameRate.num;
+        for (auto& hTrack : tracks)
+        {
+            if (!hTrack->IsVisible())
+                continue;
+            hasher.Add(hTrack->Id()).Add(hTrack->GetContentHash(pos));
+        }
+        return hasher.Value();
+    }
+
+    void InvalidateRenderedFrames(int64_t start, int64_t end)
+    {
+        if (!m_renderCacheEnabled || m_frameRate.num <= 0)
+            return;
+        const int64_t startIdx = (int64_t)floor((double)start*m_frameRate.num/(m_frameRate.den*1000));
+        const int64_t endIdx = (int64_t)ceil((double)end*m_frameRate.num/(m_frameRate.den*1000));
+        m_renderCache.InvalidateFrames(startIdx, endIdx);
+    }
+
+    void DiscardInvalidOutputFrames()
+    {
+        int64_t rewindFrameIdx;
+        {
+            lock_guard<mutex> lk(m_outputCacheLock);
+            if (m_invalidStart >= m_invalidEnd)
+                return;
+            const int64_t invalidStart = m_invalidStart;
+            const int64_t invalidEnd = m_invalidEnd;
+            m_invalidStart = INT64_MAX;
+            m_invalidEnd = INT64_MIN;
+            // the output frames are in read order, so the first invalid frame and all the frames after it are discarded
+            auto iter = find_if(m_outputCache.begin(), m_outputCache.end(), [invalidStart, invalidEnd] (const vector<CorrelativeFrame>& frames) {
+                const int64_t pos = (int64_t)round(frames[0].frame.time_stamp*1000);
+                return pos >= invalidStart && pos < invalidEnd;
+            });
+            if (iter == m_outputCache.end())
+                return;
+            rewindFrameIdx = (int64_t)round((*iter)[0].frame.time_stamp*m_frameRate.num/m_frameRate.den);
+            m_logger->Log(DEBUG) << "\t\t ===== Discard " << distance(iter, m_outputCache.end()) << " output frame(s) from frame index "
+                    << rewindFrameIdx << endl;
+            m_outputCache.erase(iter, m_outputCache.end());
+        }
+        // only rewind the tracks to the first discarded frame
+        lock_guard<recursive_mutex> trackLk(m_trackLock);
+        for (auto& track : m_tracks)
+            track->SetReadFrameIndex(rewindFrameIdx);
+    }
+
+    // Wake up the threads waiting on the output cache, the lock is taken so that the notification can't be missed
+    // by a thread that is about to wait
+    void NotifyOutputCacheChange()
+    {
+        {
+            lock_guard<mutex> lk(m_outputCacheLock);
+        }
+        m_outputCacheCv.notify_all();
+    }
+
     ImGui::ImMat BlendSubtitle(ImGui::ImMat& vmat)
     {
         if (m_subtrks.empty())
@@ -1042,9 +1477,21 @@ private:
     recursive_mutex m_trackLock;
     VideoBlender::Holder m_hMixBlender;
 
+    static const uint32_t DEFAULT_OUTPUT_CACHE_SIZE = 4;
+    // max waiting time in offline mode, in case a notification is missed
+    static const int OFFLINE_WAIT_TIMEOUT = 100;
     list<vector<CorrelativeFrame>> m_outputCache;
     mutex m_outputCacheLock;
-    uint32_t m_outputCacheSize{4};
+    condition_variable m_outputCacheCv;
+    uint32_t m_outputCacheSize{DEFAULT_OUTPUT_CACHE_SIZE};
+    atomic_bool m_offlineMode{false};
+    int64_t m_invalidStart{INT64_MAX};
+    int64_t m_invalidEnd{INT64_MIN};
+    TrackFrameCache m_trackFrameCache;
+    atomic_bool m_trackFrameCacheEnabled{false};
+    atomic_bool m_occlusionCulling{false};
+    RenderFrameCache m_renderCache;
+    atomic_bool m_renderCacheEnabled{false};
 
     uint32_t m_outWidth{0};
     uint32_t m_outHeight{0};
@@ -1101,6 +1548,9 @@ MultiTrackVideoReader::Holder MultiTrackVideoReader_Impl::CloneAndConfigure(uint
         }
     }
     newInstance->UpdateDuration();
+    newInstance->m_occlusionCulling = m_occlusionCulling.load();
+    newInstance->m_offlineMode = m_offlineMode.load();
+    newInstance->m_outputCacheSize = m_outputCacheSize;
     // seek to 0
     newInstance->m_outputCache.clear();
     for (auto track : newInstance->m_tracks)
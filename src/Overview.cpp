@@ -19,9 +19,23 @@
 #include <thread>
 #include <algorithm>
 #include <list>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <limits>
 #include "Overview.h"
 #include "FFUtils.h"
 #include "SysUtils.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OVERVIEW_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OVERVIEW_NEON
+#endif
 extern "C"
 {
     #include "libavutil/avutil.h"
@@ -42,6 +56,232 @@ using namespace Logger;
 
 namespace MediaCore
 {
+static const char SIDECAR_MAGIC[8] = { 'M', 'C', 'O', 'V', 'W', 'C', 'A', 'C' };
+static const uint32_t SIDECAR_VERSION = 3;
+static const string SIDECAR_FILE_EXT = ".ovwcache";
+
+// Loudness (ITU-R BS.1770-4 / EBU R128), sample-peak, true-peak and per-bucket RMS accumulators,
+// which consume the same planar float pcm as the waveform generation.
+class _AudioAnalyzer
+{
+public:
+    _AudioAnalyzer(uint32_t sampleRate, uint32_t channels, double aggregateSamples, uint32_t bucketCount)
+        : m_channels(channels), m_aggregateSamples(aggregateSamples), m_bucketCount(bucketCount)
+    {
+        m_subBlockSize = (uint32_t)round(sampleRate*0.1);
+        if (m_subBlockSize < 1)
+            m_subBlockSize = 1;
+        // K-weighting filter, the two biquad stages are re-derived for 'sampleRate'
+        double K = tan(M_PI*1681.974450955533/sampleRate);
+        const double Vh = pow(10., 3.999843853973347/20.);
+        const double Vb = pow(Vh, 0.4996667741545416);
+        double Q = 0.7071752369554196;
+        double a0 = 1.+K/Q+K*K;
+        m_shelfCoef[0] = (Vh+Vb*K/Q+K*K)/a0;
+        m_shelfCoef[1] = 2.*(K*K-Vh)/a0;
+        m_shelfCoef[2] = (Vh-Vb*K/Q+K*K)/a0;
+        m_shelfCoef[3] = 2.*(K*K-1.)/a0;
+        m_shelfCoef[4] = (1.-K/Q+K*K)/a0;
+        K = tan(M_PI*38.13547087602444/sampleRate);
+        Q = 0.5003270373238773;
+        a0 = 1.+K/Q+K*K;
+        m_hpassCoef[0] = 2.*(K*K-1.)/a0;
+        m_hpassCoef[1] = (1.-K/Q+K*K)/a0;
+        // polyphase interpolator for 4x oversampling true-peak estimation, not needed for high sample rate input
+        if (sampleRate < 176400)
+        {
+            const int taps = TRUE_PEAK_FACTOR*TRUE_PEAK_PHASE_TAPS;
+            const double center = (taps-1)/2.;
+            m_tpFir.resize(taps);
+            for (int i = 0; i < taps; i++)
+            {
+                const double x = (i-center)/TRUE_PEAK_FACTOR;
+                const double sinc = x == 0 ? 1. : sin(M_PI*x)/(M_PI*x);
+                const double hann = 0.5-0.5*cos(2.*M_PI*(i+0.5)/taps);
+                m_tpFir[i] = (float)(sinc*hann);
+            }
+        }
+        m_chStates.resize(channels);
+        for (auto& st : m_chStates)
+            st.tpHistory.assign(TRUE_PEAK_PHASE_TAPS*2, 0.f);
+        m_rms.assign(channels, vector<float>(bucketCount, 0.f));
+    }
+
+    void Process(const float* const* chData, uint32_t sampleCnt)
+    {
+        for (uint32_t i = 0; i < sampleCnt; i++)
+        {
+            for (uint32_t ch = 0; ch < m_channels; ch++)
+            {
+                auto& st = m_chStates[ch];
+                const float val = chData[ch][i];
+                const float absVal = fabs(val);
+                if (m_samplePeak < absVal)
+                    m_samplePeak = absVal;
+                st.rmsSum += (double)val*val;
+
+                // K-weighting, transposed direct form II
+                const double y1 = m_shelfCoef[0]*val+st.shelfZ[0];
+                st.shelfZ[0] = m_shelfCoef[1]*val-m_shelfCoef[3]*y1+st.shelfZ[1];
+                st.shelfZ[1] = m_shelfCoef[2]*val-m_shelfCoef[4]*y1;
+                const double y2 = y1+st.hpassZ[0];
+                st.hpassZ[0] = -2.*y1-m_hpassCoef[0]*y2+st.hpassZ[1];
+                st.hpassZ[1] = y1-m_hpassCoef[1]*y2;
+                st.msSum += y2*y2;
+
+                if (!m_tpFir.empty())
+                {
+                    st.tpPos = st.tpPos == 0 ? TRUE_PEAK_PHASE_TAPS-1 : st.tpPos-1;
+                    st.tpHistory[st.tpPos] = st.tpHistory[st.tpPos+TRUE_PEAK_PHASE_TAPS] = val;
+                    const float* hist = st.tpHistory.data()+st.tpPos;
+                    for (int p = 0; p < TRUE_PEAK_FACTOR; p++)
+                    {
+                        float interp = 0.f;
+                        for (int k = 0; k < TRUE_PEAK_PHASE_TAPS; k++)
+                            interp += m_tpFir[k*TRUE_PEAK_FACTOR+p]*hist[k];
+                        interp = fabs(interp);
+                        if (m_truePeak < interp)
+                            m_truePeak = interp;
+                    }
+                }
+            }
+
+            // 100ms sub-blocks, momentary and short-term blocks are built upon them
+            m_subBlockPos++;
+            if (m_subBlockPos >= m_subBlockSize)
+            {
+                double z = 0;
+                for (auto& st : m_chStates)
+                {
+                    z += st.msSum/m_subBlockSize;
+                    st.msSum = 0;
+                }
+                m_subBlocks.push_back(z);
+                m_subBlockPos = 0;
+            }
+
+            m_bucketSmpCnt++;
+            m_bucketStep++;
+            if (m_bucketStep >= m_aggregateSamples)
+            {
+                m_bucketStep -= m_aggregateSamples;
+                FinishBucket();
+            }
+        }
+    }
+
+    void GetResult(Overview::AudioAnalysis& result)
+    {
+        if (m_bucketSmpCnt > 0)
+            FinishBucket();
+
+        // integrated loudness of the 400ms blocks with 75% overlap, gated by -70 LUFS and then by -10 LU relatively
+        vector<double> blocks;
+        for (size_t j = 3; j < m_subBlocks.size(); j++)
+            blocks.push_back((m_subBlocks[j-3]+m_subBlocks[j-2]+m_subBlocks[j-1]+m_subBlocks[j])/4.);
+        double gatedSum = 0;
+        uint32_t gatedCnt = 0;
+        for (auto z : blocks)
+        {
+            if (ToLufs(z) > ABSOLUTE_GATE_LUFS)
+            {
+                gatedSum += z;
+                gatedCnt++;
+            }
+        }
+        result.integratedLoudness = -numeric_limits<double>::infinity();
+        if (gatedCnt > 0)
+        {
+            const double relativeGate = ToLufs(gatedSum/gatedCnt)+RELATIVE_GATE_LU;
+            gatedSum = 0;
+            gatedCnt = 0;
+            for (auto z : blocks)
+            {
+                const double lufs = ToLufs(z);
+                if (lufs > ABSOLUTE_GATE_LUFS && lufs > relativeGate)
+                {
+                    gatedSum += z;
+                    gatedCnt++;
+                }
+            }
+            if (gatedCnt > 0)
+                result.integratedLoudness = ToLufs(gatedSum/gatedCnt);
+        }
+
+        // short-term loudness of the 3s window, reported every second
+        result.shortTermInterval = 1.;
+        result.maxShortTermLoudness = -numeric_limits<double>::infinity();
+        result.shortTermLoudness.clear();
+        for (size_t j = 9; j < m_subBlocks.size(); j += 10)
+        {
+            const size_t start = j >= 29 ? j-29 : 0;
+            double sum = 0;
+            for (size_t k = start; k <= j; k++)
+                sum += m_subBlocks[k];
+            const double lufs = ToLufs(sum/(j-start+1));
+            result.shortTermLoudness.push_back((float)lufs);
+            if (result.maxShortTermLoudness < lufs)
+                result.maxShortTermLoudness = lufs;
+        }
+
+        result.samplePeak = m_samplePeak;
+        result.truePeak = m_truePeak > m_samplePeak ? m_truePeak : m_samplePeak;
+        result.rms = m_rms;
+    }
+
+private:
+    void FinishBucket()
+    {
+        if (m_bucketIdx < m_bucketCount)
+        {
+            for (uint32_t ch = 0; ch < m_channels; ch++)
+                m_rms[ch][m_bucketIdx] = (float)sqrt(m_chStates[ch].rmsSum/m_bucketSmpCnt);
+        }
+        for (auto& st : m_chStates)
+            st.rmsSum = 0;
+        m_bucketIdx++;
+        m_bucketSmpCnt = 0;
+    }
+
+    static double ToLufs(double z)
+    {
+        return z > 0 ? -0.691+10.*log10(z) : -numeric_limits<double>::infinity();
+    }
+
+private:
+    static const int TRUE_PEAK_FACTOR = 4;
+    static const int TRUE_PEAK_PHASE_TAPS = 12;
+    static constexpr double ABSOLUTE_GATE_LUFS = -70.;
+    static constexpr double RELATIVE_GATE_LU = -10.;
+
+    struct ChannelState
+    {
+        double shelfZ[2]{0, 0};
+        double hpassZ[2]{0, 0};
+        double msSum{0};
+        double rmsSum{0};
+        vector<float> tpHistory;
+        int tpPos{0};
+    };
+
+    uint32_t m_channels;
+    double m_aggregateSamples;
+    uint32_t m_bucketCount;
+    double m_shelfCoef[5];
+    double m_hpassCoef[2];
+    vector<float> m_tpFir;
+    vector<ChannelState> m_chStates;
+    uint32_t m_subBlockSize;
+    uint32_t m_subBlockPos{0};
+    vector<double> m_subBlocks;
+    double m_bucketStep{0};
+    uint32_t m_bucketSmpCnt{0};
+    uint32_t m_bucketIdx{0};
+    float m_samplePeak{0};
+    float m_truePeak{0};
+    vector<vector<float>> m_rms;
+};
+
 class Overview_Impl : public Overview
 {
 public:
@@ -125,6 +365,8 @@ public:
         m_audStmIdx = -1;
         m_hParser = nullptr;
         m_hMediaInfo = nullptr;
+        m_wfFromCache = false;
+        m_ssFromCache = false;
         m_opened = false;
         m_errMsg = "";
     }
@@ -151,12 +393,91 @@ public:
         return m_hWaveform;
     }
 
+    uint32_t GetWaveformValidSampleCount() const override
+    {
+        return m_wfValidCnt;
+    }
+
+    Waveform::Holder GetGeneratedWaveform() const override
+    {
+        return CopyWaveform(0, m_wfValidCnt);
+    }
+
+    void EnableAudioAnalysis(bool enable) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        m_analyzeAudio = enable;
+    }
+
+    AudioAnalysis::Holder GetAudioAnalysis() const override
+    {
+        lock_guard<mutex> lk(m_wfLock);
+        return m_hAudioAnalysis;
+    }
+
+    void EnableSceneAnalysis(bool enable) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        m_analyzeScene = enable;
+    }
+
+    SceneAnalysis::Holder GetSceneAnalysis() const override
+    {
+        lock_guard<mutex> lk(m_sceneLock);
+        return m_hSceneAnalysis;
+    }
+
+    void SetWaveformCallback(WaveformCallback callback, uint32_t bucketInterval) override
+    {
+        lock_guard<mutex> lk(m_wfLock);
+        m_wfCallback = callback;
+        m_wfCallbackInterval = bucketInterval > 0 ? bucketInterval : 1;
+    }
+
     bool SetSingleFramePixels(uint32_t pixels) override
     {
         m_singleFramePixels = pixels;
         return true;
     }
 
+    bool SetVideoDecoderCount(uint32_t count) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (count < 1)
+        {
+            m_errMsg = "Argument 'count' must be greater or equal than 1!";
+            return false;
+        }
+        if (m_viddecCount == count)
+            return true;
+        m_viddecCount = count;
+        RebuildSnapshots();
+        return true;
+    }
+
+    void EnableSidecarCache(bool enable, const string& cacheDir, bool cacheSnapshots) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        m_sidecarCacheEnabled = enable;
+        m_sidecarCacheDir = cacheDir;
+        m_sidecarCacheSnapshots = cacheSnapshots;
+    }
+
+    bool IsSidecarCacheEnabled() const override
+    {
+        return m_sidecarCacheEnabled;
+    }
+
+    bool IsWaveformFromCache() const override
+    {
+        return m_wfFromCache;
+    }
+
+    bool IsSnapshotsFromCache() const override
+    {
+        return m_ssFromCache;
+    }
+
     bool SetFixedAggregateSamples(double aggregateSamples) override
     {
         if (aggregateSamples < 1)
@@ -363,8 +684,159 @@ private:
         uint32_t sameAsIndex{0};
         int64_t ssFrmPts{INT64_MIN};
         ImGui::ImMat img;
+        // scene analysis features, calculated on the downscaled luma plane
+        vector<float> lumaHist;
+        vector<uint8_t> lumaThumb;
     };
 
+    static const int SCENE_GRID_WIDTH = 128;
+    static const int SCENE_GRID_HEIGHT = 72;
+    static const int SCENE_THUMB_SCALE = 4;
+    static const int SCENE_HIST_BINS = 32;
+
+    void CalcSceneFeatures(const AVFrame* avfrm, Snapshot& ss)
+    {
+        SelfFreeAVFramePtr swfrm;
+        if (IsHwFrame(avfrm))
+        {
+            swfrm = AllocSelfFreeAVFramePtr();
+            if (!swfrm || !HwFrameToSwFrame(swfrm.get(), avfrm))
+                return;
+            avfrm = swfrm.get();
+        }
+        // only the formats with a luma component in the first plane are supported
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)avfrm->format);
+        if (!desc || (desc->flags&(AV_PIX_FMT_FLAG_RGB|AV_PIX_FMT_FLAG_PAL|AV_PIX_FMT_FLAG_HWACCEL|AV_PIX_FMT_FLAG_BE)) != 0 ||
+            desc->comp[0].plane != 0 || desc->comp[0].depth < 8 || avfrm->width <= 0 || avfrm->height <= 0)
+            return;
+
+        // sample the luma plane on a low resolution grid
+        const bool is16bit = desc->comp[0].depth > 8;
+        const int lumaShift = desc->comp[0].shift+desc->comp[0].depth-8;
+        int xoffs[SCENE_GRID_WIDTH];
+        for (int i = 0; i < SCENE_GRID_WIDTH; i++)
+            xoffs[i] = (2*i+1)*avfrm->width/(2*SCENE_GRID_WIDTH)*desc->comp[0].step+desc->comp[0].offset;
+        vector<uint8_t> grid(SCENE_GRID_WIDTH*SCENE_GRID_HEIGHT);
+        uint8_t* gridPtr = grid.data();
+        for (int j = 0; j < SCENE_GRID_HEIGHT; j++)
+        {
+            const uint8_t* lineptr = avfrm->data[0]+(int64_t)((2*j+1)*avfrm->height/(2*SCENE_GRID_HEIGHT))*avfrm->linesize[0];
+            if (is16bit)
+            {
+                for (int i = 0; i < SCENE_GRID_WIDTH; i++)
+                    *gridPtr++ = (uint8_t)(*(const uint16_t*)(lineptr+xoffs[i])>>lumaShift);
+            }
+            else
+            {
+                for (int i = 0; i < SCENE_GRID_WIDTH; i++)
+                    *gridPtr++ = lineptr[xoffs[i]];
+            }
+        }
+
+        // normalized luma histogram
+        uint32_t hist[SCENE_HIST_BINS] = {0};
+        for (auto val : grid)
+            hist[val*SCENE_HIST_BINS/256]++;
+        ss.lumaHist.resize(SCENE_HIST_BINS);
+        for (int i = 0; i < SCENE_HIST_BINS; i++)
+            ss.lumaHist[i] = (float)hist[i]/grid.size();
+
+        // box filtered luma thumbnail for the frame difference
+        const int thumbW = SCENE_GRID_WIDTH/SCENE_THUMB_SCALE;
+        const int thumbH = SCENE_GRID_HEIGHT/SCENE_THUMB_SCALE;
+        const int boxSize = SCENE_THUMB_SCALE*SCENE_THUMB_SCALE;
+        ss.lumaThumb.resize(thumbW*thumbH);
+        for (int ty = 0; ty < thumbH; ty++)
+        {
+            for (int tx = 0; tx < thumbW; tx++)
+            {
+                uint32_t sum = 0;
+                for (int y = 0; y < SCENE_THUMB_SCALE; y++)
+                {
+                    const uint8_t* rowptr = grid.data()+(ty*SCENE_THUMB_SCALE+y)*SCENE_GRID_WIDTH+tx*SCENE_THUMB_SCALE;
+                    for (int x = 0; x < SCENE_THUMB_SCALE; x++)
+                        sum += rowptr[x];
+                }
+                ss.lumaThumb[ty*thumbW+tx] = (uint8_t)(sum/boxSize);
+            }
+        }
+    }
+
+    // Half of the L1 distance between two normalized histograms. The compiler doesn't vectorize a float reduction
+    // without -ffast-math, so the SSE and NEON paths keep two 4-lane partial sums. The scalar loop adds the remaining
+    // bins, and all of them on the other targets.
+    static float CalcHistogramDiff(const float* hist1, const float* hist2, int bins)
+    {
+        int i = 0;
+        float sum = 0.f;
+#if defined(OVERVIEW_SSE)
+        const __m128 signMask = _mm_set1_ps(-0.f);
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        for (; i+8 <= bins; i += 8)
+        {
+            acc0 = _mm_add_ps(acc0, _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(hist1+i), _mm_loadu_ps(hist2+i))));
+            acc1 = _mm_add_ps(acc1, _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(hist1+i+4), _mm_loadu_ps(hist2+i+4))));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+        sum = lanes[0]+lanes[1]+lanes[2]+lanes[3];
+#elif defined(OVERVIEW_NEON)
+        float32x4_t acc0 = vdupq_n_f32(0.f);
+        float32x4_t acc1 = vdupq_n_f32(0.f);
+        for (; i+8 <= bins; i += 8)
+        {
+            acc0 = vaddq_f32(acc0, vabdq_f32(vld1q_f32(hist1+i), vld1q_f32(hist2+i)));
+            acc1 = vaddq_f32(acc1, vabdq_f32(vld1q_f32(hist1+i+4), vld1q_f32(hist2+i+4)));
+        }
+        const float32x4_t acc = vaddq_f32(acc0, acc1);
+        const float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+        sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+        for (; i < bins; i++)
+            sum += fabs(hist1[i]-hist2[i]);
+        return sum*0.5f;
+    }
+
+    // an integer reduction, the plain loop can be auto-vectorized
+    static float CalcMeanAbsDiff(const uint8_t* thumb1, const uint8_t* thumb2, int size)
+    {
+        uint32_t sum = 0;
+        for (int i = 0; i < size; i++)
+            sum += (uint32_t)abs((int)thumb1[i]-(int)thumb2[i]);
+        return (float)sum/(255.f*size);
+    }
+
+    void BuildSceneAnalysis()
+    {
+        if (!m_analyzeScene)
+            return;
+        SceneAnalysis::Holder hScene(new SceneAnalysis);
+        hScene->histogramDiff.assign(m_snapshots.size(), 0.f);
+        hScene->motionScore.assign(m_snapshots.size(), 0.f);
+        hScene->sceneChangeScore.assign(m_snapshots.size(), 0.f);
+        const Snapshot* prevSs = nullptr;
+        for (uint32_t i = 0; i < m_snapshots.size(); i++)
+        {
+            const Snapshot& ss = m_snapshots[i].sameFrame ? m_snapshots[m_snapshots[i].sameAsIndex] : m_snapshots[i];
+            if (ss.lumaHist.empty())
+                continue;
+            if (prevSs && prevSs != &ss)
+            {
+                const float histDiff = CalcHistogramDiff(prevSs->lumaHist.data(), ss.lumaHist.data(), SCENE_HIST_BINS);
+                const float motion = CalcMeanAbsDiff(prevSs->lumaThumb.data(), ss.lumaThumb.data(), (int)ss.lumaThumb.size());
+                hScene->histogramDiff[i] = histDiff;
+                hScene->motionScore[i] = motion;
+                // histogram difference is robust to camera & object motion, so it dominates the combined score
+                float score = 0.7f*histDiff+0.3f*motion;
+                hScene->sceneChangeScore[i] = score > 1.f ? 1.f : score;
+            }
+            prevSs = &ss;
+        }
+        lock_guard<mutex> lk(m_sceneLock);
+        m_hSceneAnalysis = hScene;
+    }
+
     string FFapiFailureMessage(const string& apiName, int fferr)
     {
         ostringstream oss;
@@ -397,6 +869,7 @@ private:
         if (HasVideo())
         {
             VideoStream* vidStream = dynamic_cast<VideoStream*>(m_hMediaInfo->streams[m_vidStmIdx].get());
+            m_vidAvStm = m_avfmtCtx->streams[m_vidStmIdx];
             m_isImage = vidStream->isImage;
             m_vidStartMts = (int64_t)(vidStream->startTime*1000);
             m_vidDurMts = (int64_t)(vidStream->duration*1000);
@@ -456,7 +929,9 @@ private:
                 hWaveform->pcm.resize(1);
             for (auto& chpcm : hWaveform->pcm)
                 chpcm.resize(waveformSamples, 0);
+            m_wfValidCnt = 0;
             m_hWaveform = hWaveform;
+            m_hAudioAnalysis = nullptr;
         }
 
         return true;
@@ -601,6 +1076,12 @@ private:
             ss.img.time_stamp = (m_ssIntvMts*i+m_vidStartMts)/1000.;
             m_snapshots.push_back(ss);
         }
+        {
+            lock_guard<mutex> lk(m_sceneLock);
+            m_hSceneAnalysis = nullptr;
+        }
+        if (m_sidecarCacheEnabled)
+            LoadSidecarCache();
         StartAllThreads();
     }
 
@@ -609,7 +1090,18 @@ private:
         string fileName = SysUtils::ExtractFileName(m_hParser->GetUrl());
         ostringstream thnOss;
         m_quit = false;
-        if (HasVideo())
+        if (HasVideo() && !m_ssFromCache && !m_isImage && m_viddecCount > 1)
+        {
+            // split the snapshots among several independent demux & decode contexts
+            m_finishedSsWorkerCnt = 0;
+            for (uint32_t i = 0; i < m_viddecCount; i++)
+            {
+                m_ssWorkerThreads.push_back(thread(&Overview_Impl::SnapshotWorkerThreadProc, this, i));
+                thnOss.str(""); thnOss << "OvwSsw" << i << "-" << fileName;
+                SysUtils::SetThreadName(m_ssWorkerThreads.back(), thnOss.str());
+            }
+        }
+        else if (HasVideo() && !m_ssFromCache)
         {
             m_demuxVidThread = thread(&Overview_Impl::DemuxVideoThreadProc, this);
             thnOss.str(""); thnOss << "OvwVdmx-" << fileName;
@@ -621,7 +1113,7 @@ private:
             thnOss.str(""); thnOss << "OvwGss-" << fileName;
             SysUtils::SetThreadName(m_genSsThread, thnOss.str());
         }
-        if (HasAudio())
+        if (HasAudio() && !m_wfFromCache)
         {
             m_demuxAudThread = thread(&Overview_Impl::DemuxAudioThreadProc, this);
             thnOss.str(""); thnOss << "OvwAdmx-" << fileName;
@@ -633,7 +1125,9 @@ private:
             thnOss.str(""); thnOss << "OvwGwf-" << fileName;
             SysUtils::SetThreadName(m_genWfThread, thnOss.str());
         }
-        m_releaseThread = thread(&Overview_Impl::ReleaseResourceProc, this);
+        // nothing to decode if all the results are loaded from the sidecar cache
+        if ((HasVideo() && !m_ssFromCache) || (HasAudio() && !m_wfFromCache))
+            m_releaseThread = thread(&Overview_Impl::ReleaseResourceProc, this);
     }
 
     void WaitAllThreadsQuit(bool callFromReleaseProc = false)
@@ -659,6 +1153,12 @@ private:
             m_genSsThread.join();
             m_genSsThread = thread();
         }
+        for (auto& ssWorkerThread : m_ssWorkerThreads)
+        {
+            if (ssWorkerThread.joinable())
+                ssWorkerThread.join();
+        }
+        m_ssWorkerThreads.clear();
         if (m_demuxAudThread.joinable())
         {
             m_demuxAudThread.join();
@@ -703,6 +1203,13 @@ private:
             avcodec_flush_buffers(m_viddecCtx);
         if (m_auddecCtx)
             avcodec_flush_buffers(m_auddecCtx);
+        if (m_ssFromCache)
+        {
+            // snapshots loaded from the sidecar cache don't match the new settings, regenerate them
+            m_ssFromCache = false;
+            m_demuxVidEof = m_viddecEof = false;
+            m_genSsEof = false;
+        }
         BuildSnapshots();
     }
 
@@ -713,6 +1220,7 @@ private:
         if (!m_prepared && !Prepare())
         {
             m_logger->Log(Error) << "Prepare() FAILED for url '" << m_hParser->GetUrl() << "'! Error is '" << m_errMsg << "'." << endl;
+            m_prepareFailed = true;
             return;
         }
         if (!m_decodeVideo)
@@ -833,9 +1341,9 @@ private:
     {
         m_logger->Log(DEBUG) << "Enter VideoDecodeThreadProc()..." << endl;
 
-        while (!m_prepared && !m_quit)
+        while (!m_prepared && !m_prepareFailed && !m_quit)
             this_thread::sleep_for(chrono::milliseconds(5));
-        if (m_quit || !m_decodeVideo)
+        if (m_quit || !m_prepared || !m_decodeVideo)
         {
             m_viddecEof = true;
             return;
@@ -961,6 +1469,8 @@ private:
                 });
                 if (iter != m_snapshots.end())
                 {
+                    if (m_analyzeScene)
+                        CalcSceneFeatures(frm, *iter);
                     if (!m_frmCvt.ConvertImage(frm, iter->img, ts))
                         m_logger->Log(Error) << "FAILED to convert AVFrame to ImGui::ImMat! Message is '" << m_frmCvt.GetError() << "'." << endl;
                     // else
@@ -981,9 +1491,19 @@ private:
                 this_thread::sleep_for(chrono::milliseconds(5));
         }
 
+        FillMissingSnapshots();
+        BuildSceneAnalysis();
+        m_genSsEof = true;
+        m_logger->Log(DEBUG) << "Leave GenerateSsThreadProc()." << endl;
+    }
+
+    void FillMissingSnapshots()
+    {
         auto iter = find_if(m_snapshots.begin(), m_snapshots.end(), [](const Snapshot& ss) {
             return ss.ssFrmPts == INT64_MIN;
         });
+        if (iter == m_snapshots.end())
+            return;
         if (iter != m_snapshots.begin())
         {
             auto iter2 = iter;
@@ -1006,25 +1526,165 @@ private:
                 iter++;
             }
         }
-        m_genSsEof = true;
-        m_logger->Log(DEBUG) << "Leave GenerateSsThreadProc()." << endl;
+    }
+
+    void SnapshotWorkerThreadProc(uint32_t workerIdx)
+    {
+        m_logger->Log(DEBUG) << "Enter SnapshotWorkerThreadProc(#" << workerIdx << ")..." << endl;
+
+        // worker #0 prepares, the others wait for it and quit if it fails
+        if (workerIdx == 0)
+        {
+            if (!m_prepared && !Prepare())
+            {
+                m_logger->Log(Error) << "Prepare() FAILED for url '" << m_hParser->GetUrl() << "'! Error is '" << m_errMsg << "'." << endl;
+                m_prepareFailed = true;
+            }
+        }
+        else
+        {
+            while (!m_prepared && !m_prepareFailed && !m_quit)
+                this_thread::sleep_for(chrono::milliseconds(5));
+        }
+
+        const uint32_t ssIdx0 = (uint32_t)((uint64_t)m_ssCount*workerIdx/m_viddecCount);
+        const uint32_t ssIdx1 = (uint32_t)((uint64_t)m_ssCount*(workerIdx+1)/m_viddecCount);
+        if (!m_quit && m_prepared && m_decodeVideo && ssIdx0 < ssIdx1)
+            ExtractSnapshots(workerIdx, ssIdx0, ssIdx1);
+
+        if (++m_finishedSsWorkerCnt == m_viddecCount)
+        {
+            if (m_prepared)
+            {
+                FillMissingSnapshots();
+                BuildSceneAnalysis();
+            }
+            m_demuxVidEof = m_viddecEof = true;
+            m_genSsEof = true;
+        }
+        m_logger->Log(DEBUG) << "Leave SnapshotWorkerThreadProc(#" << workerIdx << ")." << endl;
+    }
+
+    void ExtractSnapshots(uint32_t workerIdx, uint32_t ssIdx0, uint32_t ssIdx1)
+    {
+        AVFormatContext* avfmtCtx = nullptr;
+        int fferr = avformat_open_input(&avfmtCtx, m_hParser->GetUrl().c_str(), nullptr, nullptr);
+        if (fferr < 0)
+        {
+            m_logger->Log(Error) << "'avformat_open_input' FAILED with return code " << fferr << "! Quit snapshot worker #" << workerIdx << "." << endl;
+            return;
+        }
+        fferr = avformat_find_stream_info(avfmtCtx, nullptr);
+        if (fferr < 0)
+        {
+            m_logger->Log(Error) << "'avformat_find_stream_info' FAILED with return code " << fferr << "! Quit snapshot worker #" << workerIdx << "." << endl;
+            avformat_close_input(&avfmtCtx);
+            return;
+        }
+        FFUtils::OpenVideoDecoderOptions viddecOpenOpts = m_viddecOpenOpts;
+        FFUtils::OpenVideoDecoderResult res;
+        if (!FFUtils::OpenVideoDecoder(avfmtCtx, m_vidStmIdx, &viddecOpenOpts, &res))
+        {
+            m_logger->Log(Error) << "Snapshot worker #" << workerIdx << " FAILED to open video decoder! Error is '" << res.errMsg << "'." << endl;
+            avformat_close_input(&avfmtCtx);
+            return;
+        }
+        AVCodecContext* viddecCtx = res.decCtx;
+        AVFrameToImMatConverter frmCvt;
+        frmCvt.SetOutSize(m_frmCvt.GetOutWidth(), m_frmCvt.GetOutHeight());
+        frmCvt.SetOutColorFormat(m_frmCvt.GetOutColorFormat());
+        frmCvt.SetResizeInterpolateMode(m_frmCvt.GetResizeInterpolateMode());
+
+        AVPacket avpkt = {0};
+        AVFrame avfrm = {0};
+        for (uint32_t i = ssIdx0; i < ssIdx1 && !m_quit; i++)
+        {
+            Snapshot& ss = m_snapshots[i];
+            int64_t seekTargetPts = av_rescale_q((int64_t)(m_ssIntvMts*ss.index+m_vidStartMts), MILLISEC_TIMEBASE, m_vidAvStm->time_base);
+            fferr = avformat_seek_file(avfmtCtx, m_vidStmIdx, INT64_MIN, seekTargetPts, seekTargetPts, 0);
+            if (fferr < 0)
+            {
+                m_logger->Log(Error) << "Snapshot worker #" << workerIdx << ": avformat_seek_file() FAILED for seeking to pts(" << seekTargetPts << ")! fferr = " << fferr << "!" << endl;
+                break;
+            }
+            // read the key frame packet at the seek position
+            bool avpktLoaded = false;
+            while (!m_quit && (fferr = av_read_frame(avfmtCtx, &avpkt)) == 0)
+            {
+                if (avpkt.stream_index == m_vidStmIdx)
+                {
+                    avpktLoaded = true;
+                    break;
+                }
+                av_packet_unref(&avpkt);
+            }
+            if (!avpktLoaded)
+            {
+                if (fferr < 0 && fferr != AVERROR_EOF)
+                    m_logger->Log(Error) << "Snapshot worker #" << workerIdx << ": demuxer ERROR! 'av_read_frame()' returns " << fferr << "." << endl;
+                break;
+            }
+            // the same key frame as the previous snapshot, no need to decode it again
+            if (i > ssIdx0 && m_snapshots[i-1].ssFrmPts == avpkt.pts)
+            {
+                ss.sameFrame = true;
+                ss.sameAsIndex = m_snapshots[i-1].sameFrame ? m_snapshots[i-1].sameAsIndex : m_snapshots[i-1].index;
+                ss.ssFrmPts = avpkt.pts;
+                av_packet_unref(&avpkt);
+                continue;
+            }
+
+            // decode this single packet and drain the decoder
+            const int64_t keyPts = avpkt.pts;
+            fferr = avcodec_send_packet(viddecCtx, &avpkt);
+            av_packet_unref(&avpkt);
+            if (fferr < 0)
+            {
+                m_logger->Log(WARN) << "Snapshot worker #" << workerIdx << ": 'avcodec_send_packet' FAILED with return code " << fferr << "." << endl;
+                avcodec_flush_buffers(viddecCtx);
+                continue;
+            }
+            avcodec_send_packet(viddecCtx, nullptr);
+            bool imgConverted = false;
+            while (avcodec_receive_frame(viddecCtx, &avfrm) == 0)
+            {
+                if (!imgConverted)
+                {
+                    if (m_analyzeScene)
+                        CalcSceneFeatures(&avfrm, ss);
+                    double ts = (double)av_rescale_q(avfrm.pts, m_vidAvStm->time_base, MILLISEC_TIMEBASE)/1000.;
+                    if (frmCvt.ConvertImage(&avfrm, ss.img, ts))
+                        imgConverted = true;
+                    else
+                        m_logger->Log(Error) << "Snapshot worker #" << workerIdx << " FAILED to convert AVFrame to ImGui::ImMat! Message is '" << frmCvt.GetError() << "'." << endl;
+                }
+                av_frame_unref(&avfrm);
+            }
+            avcodec_flush_buffers(viddecCtx);
+            if (imgConverted)
+                ss.ssFrmPts = keyPts;
+        }
+
+        avcodec_free_context(&viddecCtx);
+        avformat_close_input(&avfmtCtx);
     }
 
     void DemuxAudioThreadProc()
     {
         m_logger->Log(DEBUG) << "Enter DemuxAudioThreadProc()..." << endl;
 
-        if (!HasVideo() && !m_prepared && !Prepare())
+        if ((!HasVideo() || m_ssFromCache) && !m_prepared && !Prepare())
         {
             m_logger->Log(Error) << "Prepare() FAILED! Error is '" << m_errMsg << "'." << endl;
+            m_prepareFailed = true;
             return;
         }
         else
         {
-            while (!m_prepared && !m_quit)
+            while (!m_prepared && !m_prepareFailed && !m_quit)
                 this_thread::sleep_for(chrono::milliseconds(5));
         }
-        if (m_quit || !m_decodeAudio)
+        if (m_quit || !m_prepared || !m_decodeAudio)
         {
             m_demuxAudEof = true;
             return;
@@ -1104,9 +1764,9 @@ private:
     {
         m_logger->Log(DEBUG) << "Enter AudioDecodeThreadProc()..." << endl;
 
-        while (!m_prepared && !m_quit)
+        while (!m_prepared && !m_prepareFailed && !m_quit)
             this_thread::sleep_for(chrono::milliseconds(5));
-        if (m_quit || !m_decodeAudio)
+        if (m_quit || !m_prepared || !m_decodeAudio)
         {
             m_auddecEof = true;
             return;
@@ -1219,9 +1879,9 @@ private:
     {
         m_logger->Log(DEBUG) << "Enter GenWaveformThreadProc()..." << endl;
 
-        while (!m_prepared && !m_quit)
+        while (!m_prepared && !m_prepareFailed && !m_quit)
             this_thread::sleep_for(chrono::milliseconds(5));
-        if (m_quit)
+        if (m_quit || !m_prepared)
             return;
 
         double wfStep = 0;
@@ -1233,6 +1893,11 @@ private:
         float minSmp{1.f}, maxSmp{-1.f};
         if (m_hWaveform->pcm.size() > 1)
             wf2 = &m_hWaveform->pcm[1];
+        uint32_t wfNotifiedIdx = 0;
+        m_wfValidCnt = 0;
+        unique_ptr<_AudioAnalyzer> analyzer;
+        if (m_analyzeAudio)
+            analyzer.reset(new _AudioAnalyzer(m_swrOutSampleRate, (uint32_t)m_hWaveform->pcm.size(), wfAggsmpCnt, wfSize));
         while (!m_quit && wfIdx < wfSize)
         {
             bool idleLoop = true;
@@ -1355,8 +2020,22 @@ private:
                 }
                 wfStep = currWfStep;
                 wfIdx = currWfIdx;
-                m_hWaveform->maxSample = maxSmp;
-                m_hWaveform->minSample = minSmp;
+                if (analyzer)
+                {
+                    const float* chData[2] = { (const float*)dstfrm->data[0], (const float*)dstfrm->data[dstCh > 1 ? 1 : 0] };
+                    analyzer->Process(chData, dstfrm->nb_samples);
+                }
+                {
+                    lock_guard<mutex> lk(m_wfLock);
+                    m_hWaveform->maxSample = maxSmp;
+                    m_hWaveform->minSample = minSmp;
+                    m_wfValidCnt = wfIdx;
+                }
+                if (wfIdx-wfNotifiedIdx >= m_wfCallbackInterval)
+                {
+                    NotifyWaveformProgress(wfNotifiedIdx, wfIdx, false);
+                    wfNotifiedIdx = wfIdx;
+                }
 
                 if (dstfrm != srcfrm)
                     av_frame_free(&dstfrm);
@@ -1369,10 +2048,389 @@ private:
             if (idleLoop)
                 this_thread::sleep_for(chrono::milliseconds(1));
         }
+        if (!m_quit && analyzer)
+        {
+            AudioAnalysis::Holder hAnalysis(new AudioAnalysis);
+            analyzer->GetResult(*hAnalysis);
+            lock_guard<mutex> lk(m_wfLock);
+            m_hAudioAnalysis = hAnalysis;
+        }
+        if (!m_quit)
+            NotifyWaveformProgress(wfNotifiedIdx, wfIdx, true);
         m_genWfEof = true;
         m_logger->Log(DEBUG) << "Leave GenWaveformThreadProc(), " << wfIdx << " samples generated." << endl;
     }
 
+    template <typename T>
+    static void WriteSidecarValue(ostream& os, const T& val)
+    {
+        os.write((const char*)&val, sizeof(T));
+    }
+
+    template <typename T>
+    static bool ReadSidecarValue(istream& is, T& val)
+    {
+        is.read((char*)&val, sizeof(T));
+        return (bool)is;
+    }
+
+    static void WriteSidecarFloats(ostream& os, const vector<float>& vals)
+    {
+        WriteSidecarValue(os, (uint32_t)vals.size());
+        os.write((const char*)vals.data(), (streamsize)vals.size()*sizeof(float));
+    }
+
+    static bool ReadSidecarFloats(istream& is, vector<float>& vals)
+    {
+        uint32_t size;
+        if (!ReadSidecarValue(is, size))
+            return false;
+        vals.resize(size);
+        is.read((char*)vals.data(), (streamsize)size*sizeof(float));
+        return (bool)is;
+    }
+
+    string GetSidecarCachePath(const string& url) const
+    {
+        if (m_sidecarCacheDir.empty())
+            return url+SIDECAR_FILE_EXT;
+        string dirPath = m_sidecarCacheDir;
+        if (dirPath.back() != '/' && dirPath.back() != '\\')
+            dirPath.push_back('/');
+        // media files with the same name may exist in different directories
+        ostringstream oss;
+        oss << dirPath << SysUtils::ExtractFileName(url) << "." << hex << hash<string>()(url) << SIDECAR_FILE_EXT;
+        return oss.str();
+    }
+
+    bool LoadSidecarCache()
+    {
+        const string url = m_hParser->GetUrl();
+        uint64_t fileSize;
+        int64_t modifyTime;
+        if (!SysUtils::GetFileStatus(url, fileSize, modifyTime))
+            return false;
+        const string cachePath = GetSidecarCachePath(url);
+        ifstream ifs(cachePath, ios::binary);
+        if (!ifs.is_open())
+            return false;
+
+        // header & media file identity
+        char magic[sizeof(SIDECAR_MAGIC)];
+        uint32_t version, urlLen;
+        uint64_t cachedFileSize;
+        int64_t cachedModifyTime;
+        ifs.read(magic, sizeof(magic));
+        if (!ifs || memcmp(magic, SIDECAR_MAGIC, sizeof(magic)) != 0 || !ReadSidecarValue(ifs, version) || version != SIDECAR_VERSION)
+        {
+            m_logger->Log(WARN) << "Sidecar cache file '" << cachePath << "' is not a valid overview cache of version " << SIDECAR_VERSION << "." << endl;
+            return false;
+        }
+        string cachedUrl;
+        if (!ReadSidecarValue(ifs, urlLen))
+            return false;
+        cachedUrl.resize(urlLen);
+        ifs.read(&cachedUrl[0], urlLen);
+        if (!ReadSidecarValue(ifs, cachedFileSize) || !ReadSidecarValue(ifs, cachedModifyTime))
+            return false;
+        if (cachedUrl != url || cachedFileSize != fileSize || cachedModifyTime != modifyTime)
+        {
+            m_logger->Log(DEBUG) << "Sidecar cache file '" << cachePath << "' is stale, ignore it." << endl;
+            return false;
+        }
+
+        // waveform section
+        uint8_t hasWaveform;
+        if (!ReadSidecarValue(ifs, hasWaveform))
+            return false;
+        if (hasWaveform)
+        {
+            double aggregateSamples, aggregateDuration;
+            float minSample, maxSample;
+            uint32_t chCnt;
+            if (!ReadSidecarValue(ifs, aggregateSamples) || !ReadSidecarValue(ifs, aggregateDuration) ||
+                !ReadSidecarValue(ifs, minSample) || !ReadSidecarValue(ifs, maxSample) || !ReadSidecarValue(ifs, chCnt))
+                return false;
+            vector<vector<float>> pcm(chCnt);
+            for (auto& chpcm : pcm)
+            {
+                if (!ReadSidecarFloats(ifs, chpcm))
+                    return false;
+            }
+
+            // audio analysis results, which are generated in the same pass as the waveform
+            uint8_t hasAnalysis;
+            if (!ReadSidecarValue(ifs, hasAnalysis))
+                return false;
+            AudioAnalysis::Holder hAnalysis;
+            if (hasAnalysis)
+            {
+                hAnalysis = AudioAnalysis::Holder(new AudioAnalysis);
+                if (!ReadSidecarValue(ifs, hAnalysis->integratedLoudness) || !ReadSidecarValue(ifs, hAnalysis->maxShortTermLoudness) ||
+                    !ReadSidecarValue(ifs, hAnalysis->shortTermInterval) || !ReadSidecarFloats(ifs, hAnalysis->shortTermLoudness) ||
+                    !ReadSidecarValue(ifs, hAnalysis->samplePeak) || !ReadSidecarValue(ifs, hAnalysis->truePeak) || !ReadSidecarValue(ifs, chCnt))
+                    return false;
+                hAnalysis->rms.resize(chCnt);
+                for (auto& chrms : hAnalysis->rms)
+                {
+                    if (!ReadSidecarFloats(ifs, chrms))
+                        return false;
+                }
+            }
+
+            if (!m_wfFromCache && m_hWaveform && m_hWaveform->aggregateSamples == aggregateSamples && m_hWaveform->pcm.size() == pcm.size() &&
+                (!m_analyzeAudio || hAnalysis))
+            {
+                {
+                    lock_guard<mutex> lk(m_wfLock);
+                    m_hAudioAnalysis = hAnalysis;
+                }
+                m_hWaveform->aggregateDuration = aggregateDuration;
+                m_hWaveform->minSample = minSample;
+                m_hWaveform->maxSample = maxSample;
+                m_hWaveform->pcm = std::move(pcm);
+                m_wfValidCnt = (uint32_t)m_hWaveform->pcm[0].size();
+                m_wfFromCache = true;
+                m_genWfEof = true;
+                NotifyWaveformProgress(0, m_wfValidCnt, true);
+            }
+        }
+
+        // snapshots section
+        m_ssFromCache = false;
+        uint8_t hasSnapshots;
+        if (!ReadSidecarValue(ifs, hasSnapshots) || !hasSnapshots || !m_sidecarCacheSnapshots)
+            return m_wfFromCache;
+        uint32_t ssCount, outWidth, outHeight;
+        int32_t clrfmt, interp;
+        int64_t vidStartMts, vidDurMts;
+        if (!ReadSidecarValue(ifs, ssCount) || !ReadSidecarValue(ifs, outWidth) || !ReadSidecarValue(ifs, outHeight) ||
+            !ReadSidecarValue(ifs, clrfmt) || !ReadSidecarValue(ifs, interp) || !ReadSidecarValue(ifs, vidStartMts) || !ReadSidecarValue(ifs, vidDurMts))
+            return m_wfFromCache;
+        if (ssCount != m_ssCount || outWidth != m_frmCvt.GetOutWidth() || outHeight != m_frmCvt.GetOutHeight() ||
+            clrfmt != (int32_t)m_frmCvt.GetOutColorFormat() || interp != (int32_t)m_frmCvt.GetResizeInterpolateMode() ||
+            vidStartMts != m_vidStartMts || vidDurMts != m_vidDurMts)
+        {
+            m_logger->Log(DEBUG) << "Snapshot settings are changed, ignore the snapshots in sidecar cache file '" << cachePath << "'." << endl;
+            return m_wfFromCache;
+        }
+        vector<Snapshot> snapshots(ssCount);
+        for (auto& ss : snapshots)
+        {
+            uint8_t sameFrame;
+            int32_t w, h, c, dtype, imgClrfmt, clrspc, clrrng, flags;
+            double timestamp;
+            uint64_t dataSize;
+            if (!ReadSidecarValue(ifs, ss.index) || !ReadSidecarValue(ifs, sameFrame) || !ReadSidecarValue(ifs, ss.sameAsIndex) ||
+                !ReadSidecarValue(ifs, ss.ssFrmPts) || !ReadSidecarValue(ifs, timestamp) || !ReadSidecarValue(ifs, dataSize))
+                return m_wfFromCache;
+            ss.sameFrame = sameFrame != 0;
+            if (ss.index >= ssCount || ss.sameAsIndex >= ssCount)
+                return m_wfFromCache;
+            if (dataSize > 0)
+            {
+                if (!ReadSidecarValue(ifs, w) || !ReadSidecarValue(ifs, h) || !ReadSidecarValue(ifs, c) || !ReadSidecarValue(ifs, dtype) ||
+                    !ReadSidecarValue(ifs, imgClrfmt) || !ReadSidecarValue(ifs, clrspc) || !ReadSidecarValue(ifs, clrrng) || !ReadSidecarValue(ifs, flags))
+                    return m_wfFromCache;
+                ss.img.create_type(w, h, c, (ImDataType)dtype);
+                if (ss.img.empty() || (uint64_t)ss.img.total()*ss.img.elemsize != dataSize)
+                    return m_wfFromCache;
+                ifs.read((char*)ss.img.data, (streamsize)dataSize);
+                if (!ifs)
+                    return m_wfFromCache;
+                ss.img.color_format = (ImColorFormat)imgClrfmt;
+                ss.img.color_space = (ImColorSpace)clrspc;
+                ss.img.color_range = (ImColorRange)clrrng;
+                ss.img.flags = flags;
+            }
+            ss.img.time_stamp = timestamp;
+        }
+        // scene analysis results of the snapshots
+        uint8_t hasScene;
+        if (!ReadSidecarValue(ifs, hasScene))
+            return m_wfFromCache;
+        SceneAnalysis::Holder hScene;
+        if (hasScene)
+        {
+            hScene = SceneAnalysis::Holder(new SceneAnalysis);
+            if (!ReadSidecarFloats(ifs, hScene->histogramDiff) || !ReadSidecarFloats(ifs, hScene->motionScore) || !ReadSidecarFloats(ifs, hScene->sceneChangeScore))
+                return m_wfFromCache;
+        }
+        if (m_analyzeScene && !hScene)
+            return m_wfFromCache;
+        {
+            lock_guard<mutex> lk(m_sceneLock);
+            m_hSceneAnalysis = hScene;
+        }
+        m_snapshots = std::move(snapshots);
+        m_ssFromCache = true;
+        m_demuxVidEof = m_viddecEof = true;
+        m_genSsEof = true;
+        m_logger->Log(DEBUG) << "Loaded " << (m_wfFromCache ? "waveform & " : "") << "snapshots from sidecar cache file '" << cachePath << "'." << endl;
+        return true;
+    }
+
+    bool SaveSidecarCache()
+    {
+        const string url = m_hParser->GetUrl();
+        uint64_t fileSize;
+        int64_t modifyTime;
+        if (!SysUtils::GetFileStatus(url, fileSize, modifyTime))
+            return false;
+
+        const bool saveWaveform = m_hWaveform && (m_wfFromCache || (m_decodeAudio && m_genWfEof));
+        bool saveSnapshots = m_sidecarCacheSnapshots && HasVideo() && (m_ssFromCache || (m_decodeVideo && m_genSsEof));
+        if (saveSnapshots)
+        {
+            // only cpu images can be serialized
+            auto iter = find_if(m_snapshots.begin(), m_snapshots.end(), [](const Snapshot& ss) {
+                return !ss.img.empty() && ss.img.device != IM_DD_CPU;
+            });
+            saveSnapshots = iter == m_snapshots.end();
+        }
+        if (!saveWaveform && !saveSnapshots)
+            return false;
+
+        // write into a temporary file first, so a partially written cache file is never picked up
+        const string cachePath = GetSidecarCachePath(url);
+        const string tmpPath = cachePath+".tmp";
+        {
+            ofstream ofs(tmpPath, ios::binary|ios::trunc);
+            if (!ofs.is_open())
+            {
+                m_logger->Log(WARN) << "FAILED to create sidecar cache file '" << tmpPath << "'!" << endl;
+                return false;
+            }
+            ofs.write(SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+            WriteSidecarValue(ofs, SIDECAR_VERSION);
+            WriteSidecarValue(ofs, (uint32_t)url.size());
+            ofs.write(url.data(), url.size());
+            WriteSidecarValue(ofs, fileSize);
+            WriteSidecarValue(ofs, modifyTime);
+
+            WriteSidecarValue(ofs, (uint8_t)(saveWaveform ? 1 : 0));
+            if (saveWaveform)
+            {
+                WriteSidecarValue(ofs, m_hWaveform->aggregateSamples);
+                WriteSidecarValue(ofs, m_hWaveform->aggregateDuration);
+                WriteSidecarValue(ofs, m_hWaveform->minSample);
+                WriteSidecarValue(ofs, m_hWaveform->maxSample);
+                WriteSidecarValue(ofs, (uint32_t)m_hWaveform->pcm.size());
+                for (auto& chpcm : m_hWaveform->pcm)
+                    WriteSidecarFloats(ofs, chpcm);
+
+                AudioAnalysis::Holder hAnalysis = GetAudioAnalysis();
+                WriteSidecarValue(ofs, (uint8_t)(hAnalysis ? 1 : 0));
+                if (hAnalysis)
+                {
+                    WriteSidecarValue(ofs, hAnalysis->integratedLoudness);
+                    WriteSidecarValue(ofs, hAnalysis->maxShortTermLoudness);
+                    WriteSidecarValue(ofs, hAnalysis->shortTermInterval);
+                    WriteSidecarFloats(ofs, hAnalysis->shortTermLoudness);
+                    WriteSidecarValue(ofs, hAnalysis->samplePeak);
+                    WriteSidecarValue(ofs, hAnalysis->truePeak);
+                    WriteSidecarValue(ofs, (uint32_t)hAnalysis->rms.size());
+                    for (auto& chrms : hAnalysis->rms)
+                        WriteSidecarFloats(ofs, chrms);
+                }
+            }
+
+            WriteSidecarValue(ofs, (uint8_t)(saveSnapshots ? 1 : 0));
+            if (saveSnapshots)
+            {
+                WriteSidecarValue(ofs, m_ssCount);
+                WriteSidecarValue(ofs, (uint32_t)m_frmCvt.GetOutWidth());
+                WriteSidecarValue(ofs, (uint32_t)m_frmCvt.GetOutHeight());
+                WriteSidecarValue(ofs, (int32_t)m_frmCvt.GetOutColorFormat());
+                WriteSidecarValue(ofs, (int32_t)m_frmCvt.GetResizeInterpolateMode());
+                WriteSidecarValue(ofs, m_vidStartMts);
+                WriteSidecarValue(ofs, m_vidDurMts);
+                for (auto& ss : m_snapshots)
+                {
+                    const ImGui::ImMat& img = ss.img;
+                    const uint64_t dataSize = img.empty() ? 0 : (uint64_t)img.total()*img.elemsize;
+                    WriteSidecarValue(ofs, ss.index);
+                    WriteSidecarValue(ofs, (uint8_t)(ss.sameFrame ? 1 : 0));
+                    WriteSidecarValue(ofs, ss.sameAsIndex);
+                    WriteSidecarValue(ofs, ss.ssFrmPts);
+                    WriteSidecarValue(ofs, img.time_stamp);
+                    WriteSidecarValue(ofs, dataSize);
+                    if (dataSize > 0)
+                    {
+                        WriteSidecarValue(ofs, (int32_t)img.w);
+                        WriteSidecarValue(ofs, (int32_t)img.h);
+                        WriteSidecarValue(ofs, (int32_t)img.c);
+                        WriteSidecarValue(ofs, (int32_t)img.type);
+                        WriteSidecarValue(ofs, (int32_t)img.color_format);
+                        WriteSidecarValue(ofs, (int32_t)img.color_space);
+                        WriteSidecarValue(ofs, (int32_t)img.color_range);
+                        WriteSidecarValue(ofs, (int32_t)img.flags);
+                        ofs.write((const char*)img.data, (streamsize)dataSize);
+                    }
+                }
+
+                SceneAnalysis::Holder hScene = GetSceneAnalysis();
+                WriteSidecarValue(ofs, (uint8_t)(hScene ? 1 : 0));
+                if (hScene)
+                {
+                    WriteSidecarFloats(ofs, hScene->histogramDiff);
+                    WriteSidecarFloats(ofs, hScene->motionScore);
+                    WriteSidecarFloats(ofs, hScene->sceneChangeScore);
+                }
+            }
+            if (!ofs)
+            {
+                m_logger->Log(WARN) << "FAILED to write sidecar cache file '" << tmpPath << "'!" << endl;
+                ofs.close();
+                remove(tmpPath.c_str());
+                return false;
+            }
+        }
+        remove(cachePath.c_str());
+        if (rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+        {
+            m_logger->Log(WARN) << "FAILED to rename sidecar cache file '" << tmpPath << "' to '" << cachePath << "'!" << endl;
+            remove(tmpPath.c_str());
+            return false;
+        }
+        m_logger->Log(DEBUG) << "Saved overview results into sidecar cache file '" << cachePath << "'." << endl;
+        return true;
+    }
+
+    Waveform::Holder CopyWaveform(uint32_t startIdx, uint32_t endIdx) const
+    {
+        Waveform::Holder hWaveform = m_hWaveform;
+        if (!hWaveform)
+            return nullptr;
+        Waveform::Holder hCopy(new Waveform);
+        lock_guard<mutex> lk(m_wfLock);
+        hCopy->aggregateSamples = hWaveform->aggregateSamples;
+        hCopy->aggregateDuration = hWaveform->aggregateDuration;
+        hCopy->minSample = hWaveform->minSample;
+        hCopy->maxSample = hWaveform->maxSample;
+        hCopy->pcm.resize(hWaveform->pcm.size());
+        for (size_t i = 0; i < hCopy->pcm.size(); i++)
+        {
+            auto& srcpcm = hWaveform->pcm[i];
+            uint32_t chEndIdx = endIdx < srcpcm.size() ? endIdx : (uint32_t)srcpcm.size();
+            if (startIdx < chEndIdx)
+                hCopy->pcm[i].assign(srcpcm.begin()+startIdx, srcpcm.begin()+chEndIdx);
+        }
+        return hCopy;
+    }
+
+    void NotifyWaveformProgress(uint32_t startIdx, uint32_t endIdx, bool isFinished)
+    {
+        WaveformCallback callback;
+        {
+            lock_guard<mutex> lk(m_wfLock);
+            callback = m_wfCallback;
+        }
+        if (!callback || (startIdx >= endIdx && !isFinished))
+            return;
+        callback(CopyWaveform(startIdx, endIdx), startIdx, isFinished);
+    }
+
     void ReleaseResources(bool callFromReleaseProc = false)
     {
         WaitAllThreadsQuit(callFromReleaseProc);
@@ -1424,6 +2482,7 @@ private:
         m_auddecEof = false;
         m_genWfEof = false;
         m_prepared = false;
+        m_prepareFailed = false;
     }
 
     void ReleaseResourceProc()
@@ -1446,6 +2505,8 @@ private:
                 return;
             }
             lock_guard<recursive_mutex> lk(m_apiLock, adopt_lock);
+            if (m_sidecarCacheEnabled && !(m_wfFromCache && m_ssFromCache))
+                SaveSidecarCache();
             m_logger->Log(DEBUG) << "AUTO RELEASE decoding resources." << endl;
             ReleaseResources(true);
         }
@@ -1463,6 +2524,7 @@ private:
 
     AVFormatContext* m_avfmtCtx{nullptr};
     bool m_prepared{false};
+    atomic_bool m_prepareFailed{false};  // set by the thread calling Prepare(), the threads waiting for it quit then
     int m_vidStmIdx{-1};
     int m_audStmIdx{-1};
     bool m_isImage{false};
@@ -1502,6 +2564,10 @@ private:
     // generate snapshots thread
     thread m_genSsThread;
     bool m_genSsEof{false};
+    // parallel snapshot worker threads, each has its own demux & decode context
+    uint32_t m_viddecCount{1};
+    vector<thread> m_ssWorkerThreads;
+    atomic_uint32_t m_finishedSsWorkerCnt{0};
     // demux audio thread
     thread m_demuxAudThread;
     list<AVPacket*> m_audpktQ;
@@ -1541,12 +2607,30 @@ private:
     uint32_t m_singleFramePixels{200};
     double m_minAggregateSamples{5};
     double m_fixedAggregateSamples{0};
+    atomic_uint32_t m_wfValidCnt{0};
+    mutable mutex m_wfLock;
+    bool m_analyzeAudio{false};
+    AudioAnalysis::Holder m_hAudioAnalysis;
+    WaveformCallback m_wfCallback;
+    atomic_uint32_t m_wfCallbackInterval{2048};  // read by the waveform thread without 'm_wfLock'
+
+    // sidecar cache
+    bool m_sidecarCacheEnabled{false};
+    string m_sidecarCacheDir;
+    bool m_sidecarCacheSnapshots{true};
+    bool m_wfFromCache{false};
+    bool m_ssFromCache{false};
 
     // AVFrame -> ImMat
     bool m_useRszFactor{false};
     bool m_ssSizeChanged{false};
     float m_ssWFacotr{1.f}, m_ssHFacotr{1.f};
     AVFrameToImMatConverter m_frmCvt;
+
+    // scene analysis
+    bool m_analyzeScene{false};
+    SceneAnalysis::Holder m_hSceneAnalysis;
+    mutable mutex m_sceneLock;
 };
 
 static const auto OVERVIEW_HOLDER_DELETER = [] (Overview* p) {
@@ -0,0 +1,96 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <functional>
+#include "PcmBlockCache.h"
+
+using namespace std;
+
+namespace MediaCore
+{
+PcmBlockCache& PcmBlockCache::GetInstance()
+{
+    static PcmBlockCache s_instance;
+    return s_instance;
+}
+
+size_t PcmBlockCache::KeyHash::operator()(const Key& key) const
+{
+    size_t h = hash<string>()(key.source);
+    h = h*31+hash<string>()(key.sampleFormat);
+    h = h*31+key.sampleRate;
+    h = h*31+key.channels;
+    h = h*31+hash<int64_t>()(key.blockIndex);
+    return h;
+}
+
+void PcmBlockCache::SetMemoryBudget(uint64_t budget)
+{
+    lock_guard<mutex> lk(m_cacheLock);
+    m_memoryBudget = budget;
+    EvictBlocks();
+}
+
+void PcmBlockCache::Clear()
+{
+    lock_guard<mutex> lk(m_cacheLock);
+    m_blocks.clear();
+    m_lruList.clear();
+    m_usedMemory = 0;
+}
+
+bool PcmBlockCache::GetBlock(const Key& key, ImGui::ImMat& amat)
+{
+    lock_guard<mutex> lk(m_cacheLock);
+    auto iter = m_blocks.find(key);
+    if (iter == m_blocks.end())
+        return false;
+    m_lruList.splice(m_lruList.begin(), m_lruList, iter->second);
+    amat = iter->second->second;
+    return true;
+}
+
+void PcmBlockCache::PutBlock(const Key& key, const ImGui::ImMat& amat)
+{
+    const uint64_t blockSize = amat.total()*amat.elemsize;
+    lock_guard<mutex> lk(m_cacheLock);
+    if (m_memoryBudget == 0 || blockSize > m_memoryBudget)
+        return;
+    auto iter = m_blocks.find(key);
+    if (iter != m_blocks.end())
+    {
+        // another clip of the same source has decoded this block, keep the existing one
+        m_lruList.splice(m_lruList.begin(), m_lruList, iter->second);
+        return;
+    }
+    m_lruList.emplace_front(key, amat);
+    m_blocks[key] = m_lruList.begin();
+    m_usedMemory += blockSize;
+    EvictBlocks();
+}
+
+void PcmBlockCache::EvictBlocks()
+{
+    while (m_usedMemory > m_memoryBudget && !m_lruList.empty())
+    {
+        auto& block = m_lruList.back();
+        m_usedMemory -= block.second.total()*block.second.elemsize;
+        m_blocks.erase(block.first);
+        m_lruList.pop_back();
+    }
+}
+}
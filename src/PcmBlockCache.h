@@ -0,0 +1,86 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include "immat.h"
+
+namespace MediaCore
+{
+    // Process-wide cache of decoded and resampled pcm blocks, shared by all the audio clips. A block holds
+    // 'BLOCK_SAMPLES' samples of a source at the output sample rate, starting at sample 'blockIndex*BLOCK_SAMPLES'
+    // of the source, only the last block of a source can be shorter. The blocks are evicted in LRU order to
+    // keep the total size within the memory budget.
+    class PcmBlockCache
+    {
+    public:
+        static const uint32_t BLOCK_SAMPLES = 4096;
+        static const uint64_t DEFAULT_MEMORY_BUDGET = 64ULL*1024*1024;
+
+        struct Key
+        {
+            std::string source;
+            uint32_t sampleRate;
+            uint32_t channels;
+            std::string sampleFormat;
+            int64_t blockIndex;
+
+            bool operator==(const Key& other) const
+            {
+                return blockIndex == other.blockIndex && sampleRate == other.sampleRate && channels == other.channels
+                    && sampleFormat == other.sampleFormat && source == other.source;
+            }
+        };
+
+        static PcmBlockCache& GetInstance();
+
+        // 0 disables the cache, the cached blocks beyond the new budget are dropped
+        void SetMemoryBudget(uint64_t budget);
+        uint64_t GetMemoryBudget() const { return m_memoryBudget; }
+        bool IsEnabled() const { return m_memoryBudget > 0; }
+        uint64_t GetUsedMemory() const { return m_usedMemory; }
+        void Clear();
+        bool GetBlock(const Key& key, ImGui::ImMat& amat);
+        void PutBlock(const Key& key, const ImGui::ImMat& amat);
+
+    private:
+        PcmBlockCache() = default;
+        PcmBlockCache(const PcmBlockCache&) = delete;
+        PcmBlockCache& operator=(const PcmBlockCache&) = delete;
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const;
+        };
+        using LruList = std::list<std::pair<Key, ImGui::ImMat>>;
+
+        void EvictBlocks();
+
+    private:
+        std::mutex m_cacheLock;
+        LruList m_lruList;  // the most recently used at front
+        std::unordered_map<Key, LruList::iterator, KeyHash> m_blocks;
+        // changed under 'm_cacheLock', read without it by the getters
+        std::atomic_uint64_t m_memoryBudget{DEFAULT_MEMORY_BUDGET};
+        std::atomic_uint64_t m_usedMemory{0};
+    };
+}
@@ -0,0 +1,529 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "RenderFrameCache.h"
+
+using namespace std;
+
+namespace MediaCore
+{
+// Lossless block codec using the LZ4 block format: sequences of (token, literals, 16-bit offset, match length),
+// the last sequence only has literals. It is in-tree because the frames only need a fast and dependency-free codec.
+static const uint32_t LZ_MIN_MATCH = 4;
+static const uint32_t LZ_HASH_LOG = 16;
+static const size_t LZ_MFLIMIT = 12;
+static const size_t LZ_LAST_LITERALS = 5;
+
+static inline uint32_t LzRead32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint8_t* LzWriteLength(uint8_t* op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// Returns the compressed size, or 0 if the output doesn't fit into 'dstCap' bytes
+static size_t LzCompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCap)
+{
+    vector<uint32_t> hashTable(1<<LZ_HASH_LOG, 0);
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* const iend = src+srcSize;
+    const uint8_t* const mflimit = srcSize > LZ_MFLIMIT ? iend-LZ_MFLIMIT : src;
+    const uint8_t* const matchlimit = iend-LZ_LAST_LITERALS;
+    uint8_t* op = dst;
+    uint8_t* const oend = dst+dstCap;
+    uint32_t missCount = 0;
+
+    while (ip < mflimit)
+    {
+        const uint32_t seq = LzRead32(ip);
+        const uint32_t h = (seq*2654435761u)>>(32-LZ_HASH_LOG);
+        const uint8_t* ref = src+hashTable[h];
+        hashTable[h] = (uint32_t)(ip-src);
+        if (ref >= ip || ip-ref > 65535 || LzRead32(ref) != seq)
+        {
+            // skip faster on incompressible data
+            ip += 1+(missCount++>>6);
+            continue;
+        }
+        missCount = 0;
+        const uint8_t* mp = ip+LZ_MIN_MATCH;
+        const uint8_t* rp = ref+LZ_MIN_MATCH;
+        while (mp < matchlimit && *mp == *rp)
+        {
+            mp++; rp++;
+        }
+        const size_t litLen = ip-anchor;
+        const size_t matchLen = mp-ip-LZ_MIN_MATCH;
+        if (op+1+litLen/255+1+litLen+2+matchLen/255+1 > oend)
+            return 0;
+        uint8_t* token = op++;
+        *token = (uint8_t)((litLen >= 15 ? 15 : litLen)<<4);
+        if (litLen >= 15)
+            op = LzWriteLength(op, litLen-15);
+        memcpy(op, anchor, litLen);
+        op += litLen;
+        const uint16_t offset = (uint16_t)(ip-ref);
+        *op++ = (uint8_t)(offset&0xff);
+        *op++ = (uint8_t)(offset>>8);
+        *token |= (uint8_t)(matchLen >= 15 ? 15 : matchLen);
+        if (matchLen >= 15)
+            op = LzWriteLength(op, matchLen-15);
+        ip = mp;
+        anchor = ip;
+    }
+
+    const size_t litLen = iend-anchor;
+    if (op+1+litLen/255+1+litLen > oend)
+        return 0;
+    uint8_t* token = op++;
+    *token = (uint8_t)((litLen >= 15 ? 15 : litLen)<<4);
+    if (litLen >= 15)
+        op = LzWriteLength(op, litLen-15);
+    memcpy(op, anchor, litLen);
+    op += litLen;
+    return op-dst;
+}
+
+static bool LzDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    const uint8_t* ip = src;
+    const uint8_t* const iend = src+srcSize;
+    uint8_t* op = dst;
+    uint8_t* const oend = dst+dstSize;
+    while (ip < iend)
+    {
+        const uint8_t token = *ip++;
+        size_t litLen = token>>4;
+        if (litLen == 15)
+        {
+            uint8_t b;
+            do {
+                if (ip >= iend)
+                    return false;
+                b = *ip++;
+                litLen += b;
+            } while (b == 255);
+        }
+        if (litLen > (size_t)(iend-ip) || litLen > (size_t)(oend-op))
+            return false;
+        memcpy(op, ip, litLen);
+        op += litLen;
+        ip += litLen;
+        if (ip >= iend)
+            break;  // the last sequence has no match part
+
+        if (iend-ip < 2)
+            return false;
+        const size_t offset = (size_t)ip[0]|((size_t)ip[1]<<8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op-dst))
+            return false;
+        size_t matchLen = token&15;
+        if (matchLen == 15)
+        {
+            uint8_t b;
+            do {
+                if (ip >= iend)
+                    return false;
+                b = *ip++;
+                matchLen += b;
+            } while (b == 255);
+        }
+        matchLen += LZ_MIN_MATCH;
+        if (matchLen > (size_t)(oend-op))
+            return false;
+        // the match can overlap with the output, copy byte by byte
+        const uint8_t* mp = op-offset;
+        for (size_t i = 0; i < matchLen; i++)
+            op[i] = mp[i];
+        op += matchLen;
+    }
+    return op == oend;
+}
+
+RenderFrameCache::~RenderFrameCache()
+{
+    CloseSpillFile();
+}
+
+bool RenderFrameCache::Configure(uint64_t memoryBudget, bool compress, const string& spillPath, uint64_t diskBudget)
+{
+    lock_guard<mutex> lk(m_cacheLock);
+    m_frames.clear();
+    m_lruList.clear();
+    m_diskEntries.clear();
+    m_renderedFrames.clear();
+    m_usedMemory = 0;
+    CloseSpillFile();
+    m_memoryBudget = memoryBudget;
+    m_compress = compress;
+    if (!spillPath.empty() && diskBudget > 0)
+        return OpenSpillFile(spillPath, diskBudget);
+    return true;
+}
+
+void RenderFrameCache::Clear()
+{
+    lock_guard<mutex> lk(m_cacheLock);
+    m_frames.clear();
+    m_lruList.clear();
+    m_diskEntries.clear();
+    m_renderedFrames.clear();
+    m_usedMemory = 0;
+    m_diskWritePos = 0;
+}
+
+bool RenderFrameCache::GetFrame(uint64_t key, ImGui::ImMat& vmat)
+{
+    lock_guard<mutex> lk(m_cacheLock);
+    auto iter = m_frames.find(key);
+    if (iter == m_frames.end())
+        return false;
+    auto& frame = iter->second;
+    const uint8_t* srcData;
+    uint64_t srcSize;
+    bool compressed;
+    if (frame.inRam)
+    {
+        m_lruList.splice(m_lruList.begin(), m_lruList, frame.lruIter);
+        if (!frame.vmat.empty())
+        {
+            vmat = frame.vmat;
+            return true;
+        }
+        srcData = frame.packed.data();
+        srcSize = frame.packed.size();
+        compressed = true;
+    }
+    else
+    {
+        srcData = m_diskData+frame.diskOffset;
+        srcSize = frame.diskSize;
+        compressed = frame.diskCompressed;
+    }
+
+    ImGui::ImMat res;
+    res.create_type(frame.w, frame.h, frame.c, frame.type);
+    if (res.empty() || (uint64_t)res.total()*res.elemsize != frame.rawSize)
+    {
+        m_errMsg = "Cached frame size mismatch!";
+        RemoveFrame(iter);
+        return false;
+    }
+    if (compressed)
+    {
+        if (!LzDecompress(srcData, srcSize, (uint8_t*)res.data, frame.rawSize))
+        {
+            m_errMsg = "FAILED to decompress the cached frame!";
+            RemoveFrame(iter);
+            return false;
+        }
+    }
+    else
+    {
+        memcpy(res.data, srcData, frame.rawSize);
+    }
+    res.color_format = frame.colorFormat;
+    res.color_space = frame.colorSpace;
+    res.color_range = frame.colorRange;
+    res.flags = frame.flags;
+    res.time_stamp = frame.timestamp;
+    vmat = res;
+    return true;
+}
+
+void RenderFrameCache::PutFrame(uint64_t key, int64_t frameIdx, const ImGui::ImMat& vmat)
+{
+    if (vmat.empty())
+        return;
+    lock_guard<mutex> lk(m_cacheLock);
+    if (m_memoryBudget == 0)
+        return;
+    auto iter = m_frames.find(key);
+    if (iter != m_frames.end())
+    {
+        if (iter->second.inRam)
+            m_lruList.splice(m_lruList.begin(), m_lruList, iter->second.lruIter);
+        m_renderedFrames[frameIdx] = key;
+        return;
+    }
+
+    CachedFrame frame;
+    frame.w = vmat.w;
+    frame.h = vmat.h;
+    frame.c = vmat.c;
+    frame.type = vmat.type;
+    frame.colorFormat = vmat.color_format;
+    frame.colorSpace = vmat.color_space;
+    frame.colorRange = vmat.color_range;
+    frame.flags = vmat.flags;
+    frame.timestamp = vmat.time_stamp;
+    frame.rawSize = (uint64_t)vmat.total()*vmat.elemsize;
+    // frames not in the CPU memory are kept as they are, they can neither be compressed nor be spilled
+    if (m_compress && vmat.device == IM_DD_CPU)
+    {
+        frame.packed.resize(frame.rawSize);
+        const size_t packedSize = LzCompress((const uint8_t*)vmat.data, frame.rawSize, frame.packed.data(), frame.packed.size());
+        if (packedSize > 0)
+        {
+            frame.packed.resize(packedSize);
+            frame.packed.shrink_to_fit();
+        }
+        else
+        {
+            vector<uint8_t>().swap(frame.packed);
+        }
+    }
+    if (frame.packed.empty())
+        frame.vmat = vmat;
+    const uint64_t frameSize = RamSize(frame);
+    if (frameSize > m_memoryBudget)
+        return;
+
+    m_lruList.push_front(key);
+    frame.lruIter = m_lruList.begin();
+    frame.inRam = true;
+    m_frames.emplace(key, std::move(frame));
+    m_usedMemory += frameSize;
+    m_renderedFrames[frameIdx] = key;
+    EvictFrames();
+}
+
+void RenderFrameCache::InvalidateFrames(int64_t startIdx, int64_t endIdx)
+{
+    lock_guard<mutex> lk(m_cacheLock);
+    auto iter0 = m_renderedFrames.lower_bound(startIdx);
+    auto iter1 = m_renderedFrames.lower_bound(endIdx);
+    m_renderedFrames.erase(iter0, iter1);
+}
+
+void RenderFrameCache::GetRenderedFrameRanges(vector<pair<int64_t, int64_t>>& ranges)
+{
+    ranges.clear();
+    lock_guard<mutex> lk(m_cacheLock);
+    auto iter = m_renderedFrames.begin();
+    while (iter != m_renderedFrames.end())
+    {
+        // the frames dropped from the cache are no longer rendered
+        if (m_frames.find(iter->second) == m_frames.end())
+        {
+            iter = m_renderedFrames.erase(iter);
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().second == iter->first)
+            ranges.back().second++;
+        else
+            ranges.push_back({iter->first, iter->first+1});
+        iter++;
+    }
+}
+
+uint64_t RenderFrameCache::RamSize(const CachedFrame& frame) const
+{
+    if (!frame.vmat.empty())
+        return frame.rawSize;
+    return frame.packed.size();
+}
+
+void RenderFrameCache::EvictFrames()
+{
+    while (m_usedMemory > m_memoryBudget && !m_lruList.empty())
+    {
+        const uint64_t key = m_lruList.back();
+        m_lruList.pop_back();
+        auto iter = m_frames.find(key);
+        auto& frame = iter->second;
+        m_usedMemory -= RamSize(frame);
+        frame.inRam = false;
+        if (SpillToDisk(key, frame))
+            ReleaseRamData(frame);
+        else
+            m_frames.erase(iter);
+    }
+}
+
+bool RenderFrameCache::SpillToDisk(uint64_t key, CachedFrame& frame)
+{
+    if (!m_diskData)
+        return false;
+    if (!frame.vmat.empty() && frame.vmat.device != IM_DD_CPU)
+        return false;
+    const bool compressed = frame.vmat.empty();
+    const uint8_t* data = compressed ? frame.packed.data() : (const uint8_t*)frame.vmat.data;
+    const uint64_t size = compressed ? frame.packed.size() : frame.rawSize;
+    if (size > m_diskBudget)
+        return false;
+    // the spill file is used as a ring buffer, the oldest frames are overwritten
+    if (m_diskWritePos+size > m_diskBudget)
+        m_diskWritePos = 0;
+    DropDiskRange(m_diskWritePos, size);
+    memcpy(m_diskData+m_diskWritePos, data, size);
+    frame.onDisk = true;
+    frame.diskCompressed = compressed;
+    frame.diskOffset = m_diskWritePos;
+    frame.diskSize = size;
+    m_diskEntries[m_diskWritePos] = key;
+    m_diskWritePos += size;
+    return true;
+}
+
+void RenderFrameCache::DropDiskRange(uint64_t offset, uint64_t size)
+{
+    auto iter = m_diskEntries.lower_bound(offset);
+    if (iter != m_diskEntries.begin())
+    {
+        auto prevIter = prev(iter);
+        if (prevIter->first+m_frames[prevIter->second].diskSize > offset)
+            iter = prevIter;
+    }
+    while (iter != m_diskEntries.end() && iter->first < offset+size)
+    {
+        // frames on the disk tier are not in the RAM tier
+        m_frames.erase(iter->second);
+        iter = m_diskEntries.erase(iter);
+    }
+}
+
+void RenderFrameCache::ReleaseRamData(CachedFrame& frame)
+{
+    frame.vmat.release();
+    vector<uint8_t>().swap(frame.packed);
+}
+
+void RenderFrameCache::RemoveFrame(unordered_map<uint64_t, CachedFrame>::iterator iter)
+{
+    auto& frame = iter->second;
+    if (frame.inRam)
+    {
+        m_usedMemory -= RamSize(frame);
+        m_lruList.erase(frame.lruIter);
+    }
+    if (frame.onDisk)
+        m_diskEntries.erase(frame.diskOffset);
+    m_frames.erase(iter);
+}
+
+bool RenderFrameCache::OpenSpillFile(const string& spillPath, uint64_t diskBudget)
+{
+#if defined(_WIN32)
+    HANDLE hFile = CreateFileA(spillPath.c_str(), GENERIC_READ|GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        m_errMsg = "FAILED to create spill file '"+spillPath+"'!";
+        return false;
+    }
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READWRITE, (DWORD)(diskBudget>>32), (DWORD)(diskBudget&0xffffffff), NULL);
+    if (!hMapping)
+    {
+        CloseHandle(hFile);
+        m_errMsg = "FAILED to create file mapping for spill file '"+spillPath+"'!";
+        return false;
+    }
+    void* pData = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)diskBudget);
+    if (!pData)
+    {
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        m_errMsg = "FAILED to map spill file '"+spillPath+"'!";
+        return false;
+    }
+    m_hSpillFile = hFile;
+    m_hSpillMapping = hMapping;
+#else
+    int fd = open(spillPath.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        m_errMsg = "FAILED to create spill file '"+spillPath+"'!";
+        return false;
+    }
+#if defined(__linux__)
+    // allocate the disk space ahead, writing into the mapping of a sparse file fails with SIGBUS when the disk is full
+    const bool allocated = posix_fallocate(fd, 0, (off_t)diskBudget) == 0;
+#else
+    const bool allocated = ftruncate(fd, (off_t)diskBudget) == 0;
+#endif
+    if (!allocated)
+    {
+        close(fd);
+        unlink(spillPath.c_str());
+        ostringstream oss;
+        oss << "FAILED to allocate " << diskBudget << " bytes for spill file '" << spillPath << "'!";
+        m_errMsg = oss.str();
+        return false;
+    }
+    void* pData = mmap(nullptr, (size_t)diskBudget, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (pData == MAP_FAILED)
+    {
+        close(fd);
+        unlink(spillPath.c_str());
+        m_errMsg = "FAILED to map spill file '"+spillPath+"'!";
+        return false;
+    }
+    m_spillFd = fd;
+#endif
+    m_spillPath = spillPath;
+    m_diskData = (uint8_t*)pData;
+    m_diskBudget = diskBudget;
+    m_diskWritePos = 0;
+    return true;
+}
+
+void RenderFrameCache::CloseSpillFile()
+{
+    if (!m_diskData)
+        return;
+#if defined(_WIN32)
+    // the file is deleted on close
+    UnmapViewOfFile(m_diskData);
+    CloseHandle((HANDLE)m_hSpillMapping);
+    CloseHandle((HANDLE)m_hSpillFile);
+    m_hSpillMapping = nullptr;
+    m_hSpillFile = nullptr;
+#else
+    munmap(m_diskData, (size_t)m_diskBudget);
+    close(m_spillFd);
+    unlink(m_spillPath.c_str());
+    m_spillFd = -1;
+#endif
+    m_diskData = nullptr;
+    m_diskBudget = 0;
+    m_diskWritePos = 0;
+    m_spillPath.clear();
+}
+}
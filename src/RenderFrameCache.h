@@ -0,0 +1,134 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include "immat.h"
+
+namespace MediaCore
+{
+    // FNV-1a hasher for building the content keys of 'RenderFrameCache'
+    class ContentHasher
+    {
+    public:
+        template <typename T>
+        ContentHasher& Add(const T& value)
+        {
+            const uint8_t* p = (const uint8_t*)&value;
+            for (size_t i = 0; i < sizeof(T); i++)
+            {
+                m_hash ^= p[i];
+                m_hash *= 1099511628211ULL;
+            }
+            return *this;
+        }
+        ContentHasher& Add(const std::string& value)
+        {
+            for (char c : value)
+                Add(c);
+            return Add(value.size());
+        }
+        uint64_t Value() const { return m_hash; }
+
+    private:
+        uint64_t m_hash{14695981039346656037ULL};
+    };
+
+    // Cache of rendered frames addressed by a content hash, which is calculated from the frame index and everything
+    // contributing to the frame. The frames are kept in a RAM tier within a memory budget, optionally compressed with
+    // a lossless LZ4-style block codec. When a spill file is configured, the frames evicted from the RAM tier are moved
+    // into a memory-mapped disk tier, which is used as a ring buffer within a disk budget.
+    class RenderFrameCache
+    {
+    public:
+        RenderFrameCache() = default;
+        RenderFrameCache(const RenderFrameCache&) = delete;
+        RenderFrameCache& operator=(const RenderFrameCache&) = delete;
+        ~RenderFrameCache();
+
+        // 'spillPath' is the path of the spill file, the disk tier is disabled if it's empty or 'diskBudget' is 0.
+        // All the cached frames are dropped.
+        bool Configure(uint64_t memoryBudget, bool compress, const std::string& spillPath, uint64_t diskBudget);
+        void Clear();
+        bool GetFrame(uint64_t key, ImGui::ImMat& vmat);
+        void PutFrame(uint64_t key, int64_t frameIdx, const ImGui::ImMat& vmat);
+        // Frames in index range [startIdx, endIdx) are no longer reported as rendered, until they are put again.
+        // The cached data is kept, it can still be hit if the content turns back to the same.
+        void InvalidateFrames(int64_t startIdx, int64_t endIdx);
+        // Get the rendered frame index ranges [first, second), whose frames are still available in the cache
+        void GetRenderedFrameRanges(std::vector<std::pair<int64_t, int64_t>>& ranges);
+        std::string GetError() const { return m_errMsg; }
+
+    private:
+        struct CachedFrame
+        {
+            int32_t w, h, c;
+            ImDataType type;
+            ImColorFormat colorFormat;
+            ImColorSpace colorSpace;
+            ImColorRange colorRange;
+            int32_t flags;
+            double timestamp;
+            uint64_t rawSize;
+            ImGui::ImMat vmat;              // uncompressed frame in the RAM tier
+            std::vector<uint8_t> packed;    // compressed frame in the RAM tier
+            bool inRam{false};
+            bool onDisk{false};
+            bool diskCompressed{false};
+            uint64_t diskOffset{0};
+            uint64_t diskSize{0};
+            std::list<uint64_t>::iterator lruIter;
+        };
+
+        uint64_t RamSize(const CachedFrame& frame) const;
+        void EvictFrames();
+        bool SpillToDisk(uint64_t key, CachedFrame& frame);
+        void DropDiskRange(uint64_t offset, uint64_t size);
+        void ReleaseRamData(CachedFrame& frame);
+        void RemoveFrame(std::unordered_map<uint64_t, CachedFrame>::iterator iter);
+        bool OpenSpillFile(const std::string& spillPath, uint64_t diskBudget);
+        void CloseSpillFile();
+
+    private:
+        std::mutex m_cacheLock;
+        std::unordered_map<uint64_t, CachedFrame> m_frames;
+        std::list<uint64_t> m_lruList;  // keys of the frames in the RAM tier, the most recently used at front
+        std::map<uint64_t, uint64_t> m_diskEntries;  // offset in the spill file -> key
+        std::map<int64_t, uint64_t> m_renderedFrames;  // frame index -> key of the latest rendered frame
+        uint64_t m_memoryBudget{0};
+        uint64_t m_usedMemory{0};
+        bool m_compress{false};
+
+        std::string m_spillPath;
+        uint8_t* m_diskData{nullptr};
+        uint64_t m_diskBudget{0};
+        uint64_t m_diskWritePos{0};
+#if defined(_WIN32)
+        void* m_hSpillFile{nullptr};
+        void* m_hSpillMapping{nullptr};
+#else
+        int m_spillFd{-1};
+#endif
+        std::string m_errMsg;
+    };
+}
@@ -124,18 +124,7 @@ public:
 
         m_deprecatedTextures.clear();
 
-        if (m_viddecCtx)
-        {
-            avcodec_free_context(&m_viddecCtx);
-            m_viddecCtx = nullptr;
-        }
-        if (m_viddecHwDevCtx)
-        {
-            av_buffer_unref(&m_viddecHwDevCtx);
-            m_viddecHwDevCtx = nullptr;
-        }
-        m_vidHwPixFmt = AV_PIX_FMT_NONE;
-        m_viddecDevType = AV_HWDEVICE_TYPE_NONE;
+        CloseVideoDecoders();
         if (m_avfmtCtx)
         {
             avformat_close_input(&m_avfmtCtx);
@@ -155,6 +144,8 @@ public:
         m_vidFrmCnt = 0;
         m_vidMaxIndex = 0;
         m_maxCacheSize = 0;
+        m_avgGopMts = 0;
+        m_keyFrameSnapActive = false;
 
         m_hSeekPoints = nullptr;
         m_prepared = false;
@@ -197,10 +188,14 @@ public:
         }
 
         lock_guard<mutex> readLock(m_goptskListReadLocks[0]);
+        uint32_t hitCnt = 0;
+        bool evictedInView = false;
         for (auto& goptsk : m_goptskList)
         {
             if (idx0 >= goptsk->TaskRange().SsIdx().second || idx1 < goptsk->TaskRange().SsIdx().first)
                 continue;
+            if (goptsk->evictedSsCnt > 0)
+                evictedInView = true;
             auto ssIter = goptsk->ssImgList.begin();
             while (ssIter != goptsk->ssImgList.end())
             {
@@ -208,8 +203,19 @@ public:
                 if (ss->index < idx0 || ss->index > idx1)
                     continue;
                 images[ss->index-idx0] = ss->img;
+                ss->lastAccess = ++m_ssAccessTick;
+                hitCnt++;
             }
         }
+        m_ssHitCnt += hitCnt;
+        m_ssMissCnt += images.size()-hitCnt;
+        // some of the evicted SS come into view again, the snapshot update thread decides to decode them once more
+        if (evictedInView)
+        {
+            lock_guard<mutex> lk(m_redoRequestLock);
+            m_redoRequestIdx = {idx0, idx1};
+            m_redoRequested = true;
+        }
         return true;
     }
 
@@ -280,8 +286,8 @@ public:
 
         WaitAllThreadsQuit();
         FlushAllQueues();
-        if (m_viddecCtx)
-            avcodec_flush_buffers(m_viddecCtx);
+        for (auto viddecCtx : m_viddecCtxs)
+            avcodec_flush_buffers(viddecCtx);
 
         m_snapWindowSize = windowSize;
         m_wndFrmCnt = frameCount;
@@ -319,6 +325,109 @@ public:
         return true;
     }
 
+    bool SetVideoDecoderCount(uint32_t count) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (count < 1)
+        {
+            m_errMsg = "Argument 'count' must be greater or equal than 1!";
+            return false;
+        }
+        if (m_viddecCount == count)
+            return true;
+        m_viddecCount = count;
+        if (m_prepared)
+        {
+            WaitAllThreadsQuit();
+            FlushAllQueues();
+            CloseVideoDecoders();
+            if (!OpenVideoDecoders())
+                return false;
+            ResetGopDecodeTaskList();
+            {
+                lock_guard<mutex> lk(m_viewerListLock);
+                for (auto& hViewer : m_viewers)
+                {
+                    Viewer_Impl* viewer = dynamic_cast<Viewer_Impl*>(hViewer.get());
+                    viewer->UpdateSnapwnd(viewer->GetCurrWindowPos(), true);
+                }
+            }
+            StartAllThreads();
+        }
+        else if (!m_viddecThreads.empty())
+        {
+            // not prepared yet, restart the threads to match the new decoder count
+            WaitAllThreadsQuit();
+            StartAllThreads();
+        }
+        return true;
+    }
+
+    uint32_t GetVideoDecoderCount() const override
+    {
+        return m_viddecCount;
+    }
+
+    bool EnableKeyFrameSnap(bool enable, double gopDurFactor) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (gopDurFactor < 1.)
+        {
+            m_errMsg = "Argument 'gopDurFactor' must be greater or equal than 1.0!";
+            return false;
+        }
+        if (m_keyFrameSnapEnabled == enable && m_keyFrameSnapGopFactor == gopDurFactor)
+            return true;
+        m_keyFrameSnapEnabled = enable;
+        m_keyFrameSnapGopFactor = gopDurFactor;
+        if (m_prepared)
+        {
+            double windowSize = m_snapWindowSize;
+            return ConfigSnapWindow(windowSize, m_wndFrmCnt, true);
+        }
+        return true;
+    }
+
+    bool SetPrefetchLookAhead(double seconds) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (seconds < 0)
+        {
+            m_errMsg = "Argument 'seconds' must NOT be negative!";
+            return false;
+        }
+        m_prefetchLookAhead = seconds;
+        return true;
+    }
+
+    bool IsKeyFrameSnapEnabled() const override
+    {
+        return m_keyFrameSnapEnabled;
+    }
+
+    bool IsKeyFrameSnapActive() const override
+    {
+        return m_keyFrameSnapActive;
+    }
+
+    bool SetCacheMemoryBudget(uint64_t bytes) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        m_ssMemBudget = bytes;
+        return true;
+    }
+
+    CacheStatistics GetCacheStatistics() const override
+    {
+        CacheStatistics stats;
+        stats.memoryUsage = m_ssMemUsage;
+        stats.memoryBudget = m_ssMemBudget;
+        stats.hitCount = m_ssHitCnt;
+        stats.missCount = m_ssMissCnt;
+        stats.evictionCount = m_ssEvictCnt;
+        return stats;
+    }
+
     double GetMinWindowSize() const override
     {
         return CalcMinWindowSize(m_wndFrmCnt);
@@ -519,6 +628,7 @@ private:
         if (m_maxCacheSize < intWndFrmCnt)
             m_maxCacheSize = intWndFrmCnt;
         m_prevWndCacheSize = (m_maxCacheSize-intWndFrmCnt)/2;
+        m_keyFrameSnapActive = m_keyFrameSnapEnabled && m_avgGopMts > 0 && m_ssIntvMts > m_avgGopMts*m_keyFrameSnapGopFactor;
     }
 
     bool IsSsIdxValid(int32_t idx) const
@@ -601,6 +711,7 @@ private:
             m_logger->Log(Error) << m_errMsg << endl;
             return false;
         }
+        m_avgGopMts = m_hSeekPoints->empty() ? 0 : (double)m_vidDurMts/m_hSeekPoints->size();
 
         int fferr;
         fferr = avformat_find_stream_info(m_avfmtCtx, nullptr);
@@ -624,16 +735,8 @@ private:
                 return false;
             }
 
-            if (m_vidPreferUseHw)
-            {
-                if (!OpenHwVideoDecoder())
-                    if (!OpenVideoDecoder())
-                        return false;
-            }
-            else if (!OpenVideoDecoder())
+            if (!OpenVideoDecoders())
                 return false;
-            m_logger->Log(INFO) << "SnapshotGenerator for file '" << m_hParser->GetUrl() << "' opened video decoder '" << 
-                m_viddecCtx->codec->name << "'(" << (m_viddecDevType==AV_HWDEVICE_TYPE_NONE ? "SW" : av_hwdevice_get_type_name(m_viddecDevType)) << ")." << endl;
 
             CalcWindowVariables();
             ResetGopDecodeTaskList();
@@ -663,38 +766,80 @@ private:
         return true;
     }
 
-    bool OpenVideoDecoder()
+    bool OpenVideoDecoders()
+    {
+        // each decoder instance works on its own _GopDecodeTask, so the codec internal threads are shared out among them
+        int decThreadCnt = (int)ceil(8./m_viddecCount);
+        for (uint32_t i = 0; i < m_viddecCount; i++)
+        {
+            AVCodecContext* viddecCtx = nullptr;
+            AVBufferRef* hwDevCtx = nullptr;
+            if (m_vidPreferUseHw)
+            {
+                if (!OpenHwVideoDecoder(viddecCtx, hwDevCtx))
+                    if (!OpenVideoDecoder(viddecCtx, decThreadCnt))
+                        return false;
+            }
+            else if (!OpenVideoDecoder(viddecCtx, decThreadCnt))
+                return false;
+            m_viddecCtxs.push_back(viddecCtx);
+            m_viddecHwDevCtxs.push_back(hwDevCtx);
+            m_logger->Log(INFO) << "SnapshotGenerator for file '" << m_hParser->GetUrl() << "' opened video decoder #" << i << " '" <<
+                viddecCtx->codec->name << "'(" << (hwDevCtx ? av_hwdevice_get_type_name(m_viddecDevType) : "SW") << ")." << endl;
+        }
+        m_maxPendingVidfrmCnt = m_pendingVidfrmCntPerDecoder*(int32_t)m_viddecCount;
+        return true;
+    }
+
+    void CloseVideoDecoders()
     {
-        m_viddecCtx = avcodec_alloc_context3(m_viddec);
-        if (!m_viddecCtx)
+        for (auto& viddecCtx : m_viddecCtxs)
+            avcodec_free_context(&viddecCtx);
+        m_viddecCtxs.clear();
+        for (auto& hwDevCtx : m_viddecHwDevCtxs)
+        {
+            if (hwDevCtx)
+                av_buffer_unref(&hwDevCtx);
+        }
+        m_viddecHwDevCtxs.clear();
+        m_vidHwPixFmt = AV_PIX_FMT_NONE;
+        m_viddecDevType = AV_HWDEVICE_TYPE_NONE;
+    }
+
+    bool OpenVideoDecoder(AVCodecContext*& viddecCtx, int threadCount)
+    {
+        viddecCtx = avcodec_alloc_context3(m_viddec);
+        if (!viddecCtx)
         {
             m_errMsg = "FAILED to allocate new AVCodecContext!";
             return false;
         }
-        m_viddecCtx->opaque = this;
+        viddecCtx->opaque = this;
 
         int fferr;
-        fferr = avcodec_parameters_to_context(m_viddecCtx, m_vidStream->codecpar);
+        fferr = avcodec_parameters_to_context(viddecCtx, m_vidStream->codecpar);
         if (fferr < 0)
         {
+            avcodec_free_context(&viddecCtx);
             m_errMsg = FFapiFailureMessage("avcodec_parameters_to_context", fferr);
             return false;
         }
 
-        m_viddecCtx->thread_count = 8;
-        // m_viddecCtx->thread_type = FF_THREAD_FRAME;
-        fferr = avcodec_open2(m_viddecCtx, m_viddec, nullptr);
+        viddecCtx->thread_count = threadCount;
+        // viddecCtx->thread_type = FF_THREAD_FRAME;
+        fferr = avcodec_open2(viddecCtx, m_viddec, nullptr);
         if (fferr < 0)
         {
+            avcodec_free_context(&viddecCtx);
             m_errMsg = FFapiFailureMessage("avcodec_open2", fferr);
             return false;
         }
-        m_logger->Log(DEBUG) << "Video decoder '" << m_viddec->name << "' opened." << " thread_count=" << m_viddecCtx->thread_count
-            << ", thread_type=" << m_viddecCtx->thread_type << endl;
+        m_logger->Log(DEBUG) << "Video decoder '" << m_viddec->name << "' opened." << " thread_count=" << viddecCtx->thread_count
+            << ", thread_type=" << viddecCtx->thread_type << endl;
         return true;
     }
 
-    bool OpenHwVideoDecoder()
+    bool OpenHwVideoDecoder(AVCodecContext*& viddecCtx, AVBufferRef*& hwDevCtx)
     {
         int fferr;
         AVHWDeviceType hwDevType = AV_HWDEVICE_TYPE_NONE;
@@ -750,10 +895,10 @@ private:
         }
 
         m_viddecDevType = hwDevType;
-        m_viddecCtx = hwDecCtx;
-        m_viddecHwDevCtx = devCtx;
+        viddecCtx = hwDecCtx;
+        hwDevCtx = devCtx;
         m_logger->Log(DEBUG) << "Use hardware device type '" << av_hwdevice_get_type_name(m_viddecDevType) << "'." << endl;
-        m_logger->Log(DEBUG) << "Video decoder(HW) '" << m_viddecCtx->codec->name << "' opened." << endl;
+        m_logger->Log(DEBUG) << "Video decoder(HW) '" << viddecCtx->codec->name << "' opened." << endl;
         return true;
     }
 
@@ -861,7 +1006,29 @@ private:
                                     currTask->demuxerEof = true;
                             }
 
-                            if (!currTask->demuxerEof)
+                            if (!currTask->demuxerEof && m_keyFrameSnapActive)
+                            {
+                                // in key-frame snap mode, the snapshot candidates are fixed when the task is created,
+                                // only the packets up to the key frame need to be sent to the decoder.
+                                bool isKeyPkt = (avpkt.flags&AV_PKT_FLAG_KEY) != 0;
+                                m_logger->Log(VERBOSE) << "--> Queuing video packet(key-frame snap), pts=" << avpkt.pts << ", isKey=" << isKeyPkt << endl;
+                                AVPacket* enqpkt = av_packet_clone(&avpkt);
+                                if (!enqpkt)
+                                {
+                                    m_logger->Log(Error) << "FAILED to invoke [DEMUX]av_packet_clone()!" << endl;
+                                    break;
+                                }
+                                {
+                                    lock_guard<mutex> lk(currTask->avpktQLock);
+                                    currTask->avpktQ.push_back(enqpkt);
+                                }
+                                if (isKeyPkt)
+                                    currTask->demuxerEof = true;
+                                av_packet_unref(&avpkt);
+                                avpktLoaded = false;
+                                idleLoop = false;
+                            }
+                            else if (!currTask->demuxerEof)
                             {
                                 uint32_t bias{0};
                                 int32_t ssIdx = CheckFrameSsBias(avpkt.pts, bias);
@@ -960,12 +1127,18 @@ private:
         return true;
     }
 
-    void VideoDecodeThreadProc()
+    void VideoDecodeThreadProc(uint32_t decIdx)
     {
-        m_logger->Log(VERBOSE) << "Enter VideoDecodeThreadProc()..." << endl;
+        m_logger->Log(VERBOSE) << "Enter VideoDecodeThreadProc(#" << decIdx << ")..." << endl;
 
         while (!m_prepared && !m_quit)
             this_thread::sleep_for(chrono::milliseconds(5));
+        if (decIdx >= m_viddecCtxs.size())
+        {
+            m_logger->Log(VERBOSE) << "Leave VideoDecodeThreadProc(#" << decIdx << "), no decoder instance." << endl;
+            return;
+        }
+        AVCodecContext* viddecCtx = m_viddecCtxs[decIdx];
 
         GopDecodeTaskHolder currTask;
         AVFrame avfrm = {0};
@@ -980,11 +1153,12 @@ private:
             if (!currTask || currTask->cancel || currTask->redoDecoding || currTask->decoderEof)
             {
                 GopDecodeTaskHolder oldTask = currTask;
-                currTask = FindNextDecoderTask();
+                if (oldTask)
+                    ReleaseDecoderTask(oldTask);
+                currTask = FindNextDecoderTask(decIdx);
                 if (currTask)
                 {
-                    currTask->decoding = true;
-                    m_logger->Log(DEBUG) << "==> Change decoding task to build SS ["
+                    m_logger->Log(DEBUG) << "==> Decoder #" << decIdx << " change decoding task to build SS ["
                         << currTask->m_range.SsIdx().first << ", " << currTask->m_range.SsIdx().second << "), pts=["
                         << currTask->m_range.SeekPts().first << "(" << MillisecToString(CvtVidPtsToMts(currTask->m_range.SeekPts().first)) << "), "
                         << currTask->m_range.SeekPts().second << "(" << MillisecToString(CvtVidPtsToMts(currTask->m_range.SeekPts().second)) << ")]" << endl;
@@ -1004,8 +1178,8 @@ private:
                     }
                     else
                     {
-                        m_logger->Log(DEBUG) << ">>>--->>> Sending NULL ptr to video decoder <<<---<<<" << endl;
-                        avcodec_send_packet(m_viddecCtx, nullptr);
+                        m_logger->Log(DEBUG) << ">>>--->>> Sending NULL ptr to video decoder #" << decIdx << " <<<---<<<" << endl;
+                        avcodec_send_packet(viddecCtx, nullptr);
                         sentNullPacket = true;
                     }
                 }
@@ -1013,7 +1187,7 @@ private:
 
             if (needResetDecoder)
             {
-                avcodec_flush_buffers(m_viddecCtx);
+                avcodec_flush_buffers(viddecCtx);
                 needResetDecoder = false;
                 sentNullPacket = false;
             }
@@ -1023,7 +1197,7 @@ private:
             do{
                 if (!avfrmLoaded)
                 {
-                    int fferr = avcodec_receive_frame(m_viddecCtx, &avfrm);
+                    int fferr = avcodec_receive_frame(viddecCtx, &avfrm);
                     if (fferr == 0)
                     {
                         m_logger->Log(VERBOSE) << "<<< avcodec_receive_frame() pts=" << avfrm.pts << "(" << MillisecToString(CvtVidPtsToMts(avfrm.pts)) << ")." << endl;
@@ -1048,7 +1222,15 @@ private:
                 }
 
                 hasOutput = avfrmLoaded;
-                if (avfrmLoaded)
+                if (avfrmLoaded && m_keyFrameSnapActive)
+                {
+                    if (!EnqueueKeyFrameSnapshots(&avfrm))
+                        m_logger->Log(VERBOSE) << "Drop video frame pts=" << avfrm.pts << ". No corresponding key-frame GopDecoderTask can be found." << endl;
+                    av_frame_unref(&avfrm);
+                    avfrmLoaded = false;
+                    idleLoop = false;
+                }
+                else if (avfrmLoaded)
                 {
                     int32_t ssIdx{-1};
                     uint32_t bias{UINT32_MAX};
@@ -1099,7 +1281,7 @@ private:
                 {
                     bool popAvpkt = false;
                     AVPacket* avpkt = currTask->avpktQ.front();
-                    int fferr = avcodec_send_packet(m_viddecCtx, avpkt);
+                    int fferr = avcodec_send_packet(viddecCtx, avpkt);
                     if (fferr == 0)
                     {
                         m_logger->Log(VERBOSE) << ">>> avcodec_send_packet() pts=" << avpkt->pts << "(" << MillisecToString(CvtVidPtsToMts(avpkt->pts)) << ")." << endl;
@@ -1140,7 +1322,7 @@ private:
             currTask->decoderEof = true;
         if (avfrmLoaded)
             av_frame_unref(&avfrm);
-        m_logger->Log(VERBOSE) << "Leave VideoDecodeThreadProc()." << endl;
+        m_logger->Log(VERBOSE) << "Leave VideoDecodeThreadProc(#" << decIdx << ")." << endl;
     }
 
     void UpdateSnapshotThreadProc()
@@ -1186,6 +1368,8 @@ private:
                         if (m_pendingVidfrmCnt < 0)
                             m_logger->Log(Error) << "Pending video AVFrame ptr count is NEGATIVE! " << m_pendingVidfrmCnt << endl;
                         ss->img->mTimestampMs = CalcSnapshotMts(ss->index);
+                        ss->lastAccess = ++m_ssAccessTick;
+                        ss->UpdateMemorySize();
                         idleLoop = false;
                     }
                     if (!ss->img->mImgMat.empty())
@@ -1209,7 +1393,10 @@ private:
                         idleLoop = false;
                     }
                 }
+                EvictSnapshotsOverBudget();
             }
+            if (m_redoRequested)
+                RedoEvictedTasks();
 
             if (idleLoop)
                 this_thread::sleep_for(chrono::milliseconds(5));
@@ -1251,9 +1438,12 @@ private:
         m_demuxThread = thread(&Generator_Impl::DemuxThreadProc, this);
         thnOss << "SsgDmx-" << fileName;
         SysUtils::SetThreadName(m_demuxThread, thnOss.str());
-        m_viddecThread = thread(&Generator_Impl::VideoDecodeThreadProc, this);
-        thnOss.str(""); thnOss << "SsgVdc-" << fileName;
-        SysUtils::SetThreadName(m_viddecThread, thnOss.str());
+        for (uint32_t i = 0; i < m_viddecCount; i++)
+        {
+            m_viddecThreads.push_back(thread(&Generator_Impl::VideoDecodeThreadProc, this, i));
+            thnOss.str(""); thnOss << "SsgVdc" << i << "-" << fileName;
+            SysUtils::SetThreadName(m_viddecThreads.back(), thnOss.str());
+        }
         m_updateSsThread = thread(&Generator_Impl::UpdateSnapshotThreadProc, this);
         thnOss.str(""); thnOss << "SsgUss-" << fileName;
         SysUtils::SetThreadName(m_updateSsThread, thnOss.str());
@@ -1270,11 +1460,12 @@ private:
             m_demuxThread.join();
             m_demuxThread = thread();
         }
-        if (m_viddecThread.joinable())
+        for (auto& viddecThread : m_viddecThreads)
         {
-            m_viddecThread.join();
-            m_viddecThread = thread();
+            if (viddecThread.joinable())
+                viddecThread.join();
         }
+        m_viddecThreads.clear();
         if (m_updateSsThread.joinable())
         {
             m_updateSsThread.join();
@@ -1338,6 +1529,7 @@ private:
                 av_frame_free(&avfrm);
                 m_owner->m_pendingVidfrmCnt--;
             }
+            m_owner->m_ssMemUsage -= memSize;
             if (img->mTextureHolder)
             {
                 lock_guard<mutex> lk(m_owner->m_deprecatedTextureLock);
@@ -1345,6 +1537,14 @@ private:
             }
         }
 
+        void UpdateMemorySize()
+        {
+            uint64_t newSize = img->mImgMat.empty() ? 0 : (uint64_t)img->mImgMat.total()*img->mImgMat.elemsize;
+            m_owner->m_ssMemUsage += newSize;
+            m_owner->m_ssMemUsage -= memSize;
+            memSize = newSize;
+        }
+
         Generator_Impl* m_owner;
         Image::Holder img;
         int32_t index;
@@ -1352,6 +1552,8 @@ private:
         int64_t pts;
         int64_t bias;
         bool fixed{false};
+        uint64_t memSize{0};
+        uint64_t lastAccess{0};
     };
 
     struct _SnapWindow
@@ -1363,6 +1565,7 @@ private:
         int32_t cacheIdx1;
         int64_t seekPos00;
         int64_t seekPos10;
+        int32_t scrollDir;
 
         bool IsInView(int32_t idx) const
         { return idx >= viewIdx0 && idx <= viewIdx1; }
@@ -1396,6 +1599,7 @@ private:
             bool IsInView() const { return m_isInView; }
             void SetInView(bool isInView) { m_isInView = isInView; }
             int32_t DistanceToViewWindow() const { return m_distanceToViewWnd; }
+            void SetDistanceToViewWindow(int32_t distance) { m_distanceToViewWnd = distance; }
 
             friend bool operator==(const Range& oprnd1, const Range& oprnd2)
             {
@@ -1451,24 +1655,44 @@ private:
         bool demuxing{false};
         bool demuxerEof{false};
         bool decoding{false};
+        int32_t decoderIdx{-1};
         bool redoDecoding{false};
         bool allCandDecoded{false};
         bool decoderEof{false};
         bool cancel{false};
+        uint32_t evictedSsCnt{0};
     };
     using GopDecodeTaskHolder = shared_ptr<_GopDecodeTask>;
 
-    _SnapWindow CreateSnapWindow(double wndpos)
+    _SnapWindow CreateSnapWindow(double wndpos, double scrollSpeed)
     {
         if (!m_prepared)
-            return { wndpos, -1, -1, -1, -1, INT64_MIN, INT64_MIN };
+            return { wndpos, -1, -1, -1, -1, INT64_MIN, INT64_MIN, 0 };
         int32_t index0 = CalcSsIndexFromTs(wndpos);
         int32_t index1 = CalcSsIndexFromTs(wndpos+m_snapWindowSize);
-        int32_t cacheIdx0 = index0-(int32_t)m_prevWndCacheSize;
+        int32_t scrollDir = 0;
+        int32_t cacheIdx0 = index0-CalcPrevWndCacheSize(scrollSpeed, scrollDir);
         int32_t cacheIdx1 = cacheIdx0+(int32_t)m_maxCacheSize-1;
         pair<int64_t, int64_t> seekPos0 = GetSeekPosBySsIndex(cacheIdx0);
         pair<int64_t, int64_t> seekPos1 = GetSeekPosBySsIndex(cacheIdx1);
-        return { wndpos, index0, index1, cacheIdx0, cacheIdx1, seekPos0.first, seekPos1.first };
+        return { wndpos, index0, index1, cacheIdx0, cacheIdx1, seekPos0.first, seekPos1.first, scrollDir };
+    }
+
+    int32_t CalcPrevWndCacheSize(double scrollSpeed, int32_t& scrollDir)
+    {
+        scrollDir = 0;
+        if (m_prefetchLookAhead <= 0 || scrollSpeed == 0)
+            return (int32_t)m_prevWndCacheSize;
+        // move the spare cache capacity to the scrolling direction, the total cache size stays the same
+        const int32_t spareCacheSize = (int32_t)m_maxCacheSize-(int32_t)ceil(m_wndFrmCnt);
+        const int32_t quantStep = spareCacheSize > 8 ? spareCacheSize/8 : 1;
+        int32_t lookAheadIdxCnt = (int32_t)ceil(abs(scrollSpeed)*m_prefetchLookAhead*1000./m_ssIntvMts);
+        lookAheadIdxCnt = (lookAheadIdxCnt+quantStep-1)/quantStep*quantStep;
+        int32_t aheadCacheSize = spareCacheSize-(int32_t)m_prevWndCacheSize+lookAheadIdxCnt;
+        if (aheadCacheSize > spareCacheSize)
+            aheadCacheSize = spareCacheSize;
+        scrollDir = scrollSpeed > 0 ? 1 : -1;
+        return scrollDir > 0 ? spareCacheSize-aheadCacheSize : aheadCacheSize;
     }
 
     list<GopDecodeTaskHolder> FindFrameSsPosition(int64_t pts, int32_t& ssIdx, uint32_t& bias)
@@ -1576,6 +1800,20 @@ private:
         return ptsPair;
     }
 
+    pair<int64_t, int64_t> GetNearestKeyFramePtsBySsIndex(int32_t index)
+    {
+        const auto& seekPoints = *m_hSeekPoints;
+        if (seekPoints.empty())
+            return { INT64_MIN, INT64_MIN };
+        int64_t targetPts = (int64_t)floor(index*m_ssIntvPts+m_vidStartPts);
+        auto iter = lower_bound(seekPoints.begin(), seekPoints.end(), targetPts);
+        if (iter == seekPoints.end() || (iter != seekPoints.begin() && targetPts-*(iter-1) <= *iter-targetPts))
+            iter--;
+        int64_t first = *iter++;
+        int64_t second = iter == seekPoints.end() ? INT64_MAX : *iter;
+        return { first, second };
+    }
+
     pair<int32_t, int32_t> CalcSsIndexPairFromPtsPair(const pair<int64_t, int64_t>& ptsPair, int32_t startIdx)
     {
         int32_t idx0 = (int32_t)ceil((double)(ptsPair.first-m_vidStartPts-m_vidfrmIntvPtsHalf)/m_ssIntvPts);
@@ -1636,8 +1874,13 @@ private:
                 auto iter = find(totalTaskRanges.begin(), totalTaskRanges.end(), tskrng);
                 if (iter == totalTaskRanges.end())
                     totalTaskRanges.push_back(tskrng);
-                else if (tskrng.IsInView())
-                    iter->SetInView(true);
+                else
+                {
+                    if (tskrng.IsInView())
+                        iter->SetInView(true);
+                    if (tskrng.DistanceToViewWindow() < iter->DistanceToViewWindow())
+                        iter->SetDistanceToViewWindow(tskrng.DistanceToViewWindow());
+                }
             }
         }
         m_logger->Log(DEBUG) << ">>>>> Aggregated task ranges <<<<<<<" << endl << "\t";
@@ -1666,6 +1909,7 @@ private:
             {
                 m_logger->Log(DEBUG) << "~~~~> Remove DUPLICATED task range [" << (*taskIter)->TaskRange().SsIdx().first << ", " << (*taskIter)->TaskRange().SsIdx().second << ")" << endl;
                 task->m_range.SetInView(iter->IsInView());
+                task->m_range.SetDistanceToViewWindow(iter->DistanceToViewWindow());
                 totalTaskRanges.erase(iter);
                 taskIter++;
             }
@@ -1729,14 +1973,20 @@ private:
         return candidateTask;
     }
 
-    GopDecodeTaskHolder FindNextDecoderTask()
+    void ReleaseDecoderTask(GopDecodeTaskHolder& task)
+    {
+        lock_guard<mutex> lk(m_goptskListReadLocks[1]);
+        task->decoderIdx = -1;
+    }
+
+    GopDecodeTaskHolder FindNextDecoderTask(uint32_t decIdx)
     {
         lock_guard<mutex> lk(m_goptskListReadLocks[1]);
         GopDecodeTaskHolder candidateTask = nullptr;
         int32_t shortestDistanceToViewWnd = INT32_MAX;
         for (auto& task : m_goptskList)
         {
-            if (!task->cancel && task->demuxing && (!task->decoding || task->redoDecoding))
+            if (!task->cancel && task->demuxing && task->decoderIdx < 0 && (!task->decoding || task->redoDecoding))
             {
                 if (task->IsInView())
                 {
@@ -1771,6 +2021,11 @@ private:
                 candidateTask->avpktBkupQ.pop_front();
             }
         }
+        if (candidateTask)
+        {
+            candidateTask->decoding = true;
+            candidateTask->decoderIdx = (int32_t)decIdx;
+        }
         return candidateTask;
     }
 
@@ -1787,11 +2042,148 @@ private:
         return nxttsk;
     }
 
+    // Redo decoding on the finished tasks whose evicted SS are requested again, only called on the snapshot update thread
+    void RedoEvictedTasks()
+    {
+        pair<int32_t, int32_t> reqIdx;
+        {
+            lock_guard<mutex> lk(m_redoRequestLock);
+            reqIdx = m_redoRequestIdx;
+            m_redoRequested = false;
+        }
+        lock_guard<mutex> lk(m_goptskListReadLocks[0]);
+        for (auto& goptsk : m_goptskList)
+        {
+            if (reqIdx.first >= goptsk->TaskRange().SsIdx().second || reqIdx.second < goptsk->TaskRange().SsIdx().first)
+                continue;
+            if (goptsk->evictedSsCnt > 0 && goptsk->decoderEof && !goptsk->redoDecoding && !goptsk->cancel)
+            {
+                m_logger->Log(DEBUG) << "--> REDO decoding on evicted _GopDecodeTask, ssIdxPair=[" << goptsk->TaskRange().SsIdx().first
+                    << ", " << goptsk->TaskRange().SsIdx().second << ")." << endl;
+                goptsk->evictedSsCnt = 0;
+                goptsk->redoDecoding = true;
+            }
+        }
+    }
+
+    void EvictSnapshotsOverBudget()
+    {
+        if (m_ssMemBudget == 0 || m_ssMemUsage <= m_ssMemBudget)
+            return;
+
+        list<_SnapWindow> viewWnds;
+        {
+            lock_guard<mutex> lk(m_viewerListLock);
+            for (auto& hViewer : m_viewers)
+            {
+                Viewer_Impl* viewer = dynamic_cast<Viewer_Impl*>(hViewer.get());
+                viewWnds.push_back(viewer->GetSnapWindow());
+            }
+        }
+
+        // a _Picture can be shared by several tasks, it's evicted from all of them at once and its size is counted once
+        struct _EvictCandidate
+        {
+            _Picture* picture;
+            list<pair<GopDecodeTaskHolder, list<_Picture::Holder>::iterator>> refs;
+            int32_t distanceToViewWnd;
+            uint64_t lastAccess;
+        };
+        lock_guard<mutex> lk(m_goptskListReadLocks[0]);
+        vector<_EvictCandidate> candidates;
+        unordered_map<_Picture*, size_t> candIndices;
+        for (auto& t : m_goptskList)
+        {
+            for (auto ssIter = t->ssImgList.begin(); ssIter != t->ssImgList.end(); ssIter++)
+            {
+                auto candIter = candIndices.find(ssIter->get());
+                if (candIter != candIndices.end())
+                {
+                    candidates[candIter->second].refs.push_back({t, ssIter});
+                    continue;
+                }
+                const int32_t ssIdx = (*ssIter)->index;
+                int32_t distance = INT32_MAX;
+                for (auto& wnd : viewWnds)
+                {
+                    int32_t d = ssIdx < wnd.viewIdx0 ? wnd.viewIdx0-ssIdx : (ssIdx > wnd.viewIdx1 ? ssIdx-wnd.viewIdx1 : 0);
+                    if (d < distance)
+                        distance = d;
+                }
+                // the SS inside any view window are never evicted
+                if (distance > 0)
+                {
+                    candIndices[ssIter->get()] = candidates.size();
+                    candidates.push_back({ssIter->get(), {{t, ssIter}}, distance, (*ssIter)->lastAccess});
+                }
+            }
+        }
+        // evict the farthest SS first, the least recently used one if the distances are equal
+        sort(candidates.begin(), candidates.end(), [] (const _EvictCandidate& a, const _EvictCandidate& b) {
+            return a.distanceToViewWnd > b.distanceToViewWnd || (a.distanceToViewWnd == b.distanceToViewWnd && a.lastAccess < b.lastAccess);
+        });
+        uint32_t evictCnt = 0;
+        uint64_t memUsage = m_ssMemUsage;
+        for (auto& cand : candidates)
+        {
+            if (memUsage <= m_ssMemBudget)
+                break;
+            memUsage -= min(memUsage, cand.picture->memSize);
+            for (auto& ref : cand.refs)
+            {
+                ref.first->ssImgList.erase(ref.second);
+                ref.first->evictedSsCnt++;
+            }
+            evictCnt++;
+        }
+        m_ssEvictCnt += evictCnt;
+        if (evictCnt > 0)
+            m_logger->Log(DEBUG) << "Evicted " << evictCnt << " SS images, memory usage " << m_ssMemUsage << "/" << m_ssMemBudget << "." << endl;
+    }
+
+    bool EnqueueKeyFrameSnapshots(AVFrame* frm)
+    {
+        list<GopDecodeTaskHolder> kfGopTasks;
+        {
+            lock_guard<mutex> lk(m_goptskListReadLocks[0]);
+            for (auto& t : m_goptskList)
+            {
+                if (!t->cancel && t->TaskRange().SeekPts().first == frm->pts)
+                    kfGopTasks.push_back(t);
+            }
+        }
+        if (kfGopTasks.empty())
+            return false;
+
+        for (auto& t : kfGopTasks)
+        {
+            list<int32_t> ssIdxList;
+            for (auto& elem : t->ssCandidates)
+                ssIdxList.push_back(elem.first);
+            for (auto ssIdx : ssIdxList)
+            {
+                // one key frame can make many SS, the pending frame limit is checked before each of them
+                while (!m_quit && !t->cancel && m_pendingVidfrmCnt >= m_maxPendingVidfrmCnt)
+                    this_thread::sleep_for(chrono::milliseconds(5));
+                if (m_quit || t->cancel)
+                    break;
+                uint32_t bias = (uint32_t)floor(abs(ssIdx*m_ssIntvPts+m_vidStartPts-frm->pts));
+                m_logger->Log(DEBUG) << "Enqueue key-frame SS#" << ssIdx << ", pts=" << frm->pts << "(ts=" << MillisecToString(CvtVidPtsToMts(frm->pts))
+                    << "), bias=" << bias << "." << endl;
+                if (!EnqueueSnapshotAVFrame({t}, frm, ssIdx, bias))
+                    m_logger->Log(WARN) << "FAILED to enqueue key-frame SS#" << ssIdx << ", pts=" << frm->pts << "." << endl;
+            }
+        }
+        return true;
+    }
+
     bool EnqueueSnapshotAVFrame(list<GopDecodeTaskHolder> ssGopTasks, AVFrame* frm, int32_t ssIdx, uint32_t bias)
     {
         if (ssGopTasks.empty())
             return false;
 
+        // multiple decoder threads may enqueue the same SS of the adjacent tasks simultaneously
+        lock_guard<mutex> enqLk(m_ssEnqueueLock);
         AVFrame* _avfrm = av_frame_clone(frm);
         if (!_avfrm)
         {
@@ -1872,6 +2264,7 @@ public:
 
         bool Seek(double pos) override
         {
+            RecordSeekPosition(pos);
             UpdateSnapwnd(pos);
             return true;
         }
@@ -1884,6 +2277,7 @@ public:
         bool GetSnapshots(double startPos, vector<Image::Holder>& snapshots) override
         {
             // AutoSection _as("GetSs");
+            RecordSeekPosition(startPos);
             UpdateSnapwnd(startPos);
             auto res = m_owner->GetSnapshots(startPos, snapshots);
             return res;
@@ -1937,6 +2331,7 @@ public:
         }
 
         bool IsTaskRangeChanged() const { return m_taskRangeChanged; }
+        _SnapWindow GetSnapWindow() const { return m_snapwnd; }
 
         list<_GopDecodeTask::Range> CheckTaskRanges()
         {
@@ -1946,13 +2341,44 @@ public:
             return std::move(taskRanges);
         }
 
+        // only the position changes are recorded, repeated calls at the same position aren't scrolling
+        void RecordSeekPosition(double pos)
+        {
+            lock_guard<mutex> lk(m_seekHistoryLock);
+            if (!m_seekHistory.empty() && m_seekHistory.back().second == pos)
+                return;
+            auto now = GetTimePoint();
+            // a scrolling started after a pause is not measured from the positions before the pause
+            if (!m_seekHistory.empty() && CountElapsedMillisec(m_seekHistory.back().first, now) > SEEK_HISTORY_DURATION_MS)
+                m_seekHistory.clear();
+            m_seekHistory.push_back({now, pos});
+            while (m_seekHistory.size() > 2 && CountElapsedMillisec(m_seekHistory.front().first, now) > SEEK_HISTORY_DURATION_MS)
+                m_seekHistory.pop_front();
+        }
+
+        // scroll speed in seconds of media per second, negative value means scrolling backward
+        double EstimateScrollSpeed()
+        {
+            lock_guard<mutex> lk(m_seekHistoryLock);
+            if (m_seekHistory.size() < 2)
+                return 0;
+            auto& first = m_seekHistory.front();
+            auto& last = m_seekHistory.back();
+            if (CountElapsedMillisec(last.first, GetTimePoint()) > SEEK_HISTORY_DURATION_MS)
+                return 0;
+            int64_t elapsedMs = CountElapsedMillisec(first.first, last.first);
+            if (elapsedMs <= 0)
+                return 0;
+            return (last.second-first.second)*1000./elapsedMs;
+        }
+
         void UpdateSnapwnd(double wndpos, bool force = false)
         {
             // AutoSection _as("UpdSnapWnd");
-            _SnapWindow snapwnd = m_owner->CreateSnapWindow(wndpos);
+            _SnapWindow snapwnd = m_owner->CreateSnapWindow(wndpos, EstimateScrollSpeed());
             list<_GopDecodeTask::Range> taskRanges;
             bool taskRangeChanged = false;
-            if ((force || snapwnd.viewIdx0 != m_snapwnd.viewIdx0 || snapwnd.viewIdx1 != m_snapwnd.viewIdx1) &&
+            if ((force || snapwnd.viewIdx0 != m_snapwnd.viewIdx0 || snapwnd.viewIdx1 != m_snapwnd.viewIdx1 || snapwnd.cacheIdx0 != m_snapwnd.cacheIdx0) &&
                 (snapwnd.seekPos00 != INT64_MIN || snapwnd.seekPos10 != INT64_MIN))
             {
                 int32_t buildIdx0 = snapwnd.cacheIdx0 >= 0 ? snapwnd.cacheIdx0 : 0;
@@ -1960,8 +2386,23 @@ public:
                 list<GopDecodeTaskHolder> goptskList;
                 while (buildIdx0 <= buildIdx1)
                 {
-                    auto ptsPair = m_owner->GetSeekPosBySsIndex(buildIdx0);
-                    auto ssIdxPair = m_owner->CalcSsIndexPairFromPtsPair(ptsPair, buildIdx0);
+                    pair<int64_t, int64_t> ptsPair;
+                    pair<int32_t, int32_t> ssIdxPair;
+                    if (m_owner->m_keyFrameSnapActive)
+                    {
+                        // group the snapshots sharing the same nearest key frame into one task
+                        ptsPair = m_owner->GetNearestKeyFramePtsBySsIndex(buildIdx0);
+                        ssIdxPair = { buildIdx0, buildIdx0+1 };
+                        while (ssIdxPair.first > 0 && m_owner->GetNearestKeyFramePtsBySsIndex(ssIdxPair.first-1).first == ptsPair.first)
+                            ssIdxPair.first--;
+                        while (ssIdxPair.second <= m_owner->m_vidMaxIndex && m_owner->GetNearestKeyFramePtsBySsIndex(ssIdxPair.second).first == ptsPair.first)
+                            ssIdxPair.second++;
+                    }
+                    else
+                    {
+                        ptsPair = m_owner->GetSeekPosBySsIndex(buildIdx0);
+                        ssIdxPair = m_owner->CalcSsIndexPairFromPtsPair(ptsPair, buildIdx0);
+                    }
                     if (ssIdxPair.second <= buildIdx0)
                     {
                         m_logger->Log(WARN) << "Snap window DOESN'T PROCEED! 'buildIdx0'(" << buildIdx0 << ") is NOT INCLUDED in the next 'ssIdxPair'["
@@ -1974,6 +2415,9 @@ public:
                     int32_t distanceToViewWnd = isInView ? 0 : (ssIdxPair.second <= snapwnd.viewIdx0 ?
                             snapwnd.viewIdx0-ssIdxPair.second : ssIdxPair.first-snapwnd.viewIdx1);
                     if (distanceToViewWnd < 0) distanceToViewWnd = -distanceToViewWnd;
+                    // deprioritize the tasks behind the scrolling direction
+                    if ((snapwnd.scrollDir > 0 && ssIdxPair.second <= snapwnd.viewIdx0) || (snapwnd.scrollDir < 0 && ssIdxPair.first > snapwnd.viewIdx1))
+                        distanceToViewWnd *= BEHIND_SCROLL_DISTANCE_FACTOR;
                     taskRanges.push_back(_GopDecodeTask::Range(ptsPair, ssIdxPair, isInView, distanceToViewWnd));
                     buildIdx0 = ssIdxPair.second;
                 }
@@ -2009,6 +2453,10 @@ public:
         list<_GopDecodeTask::Range> m_taskRanges;
         mutex m_taskRangeLock;
         bool m_taskRangeChanged{false};
+        list<pair<TimePoint, double>> m_seekHistory;
+        mutex m_seekHistoryLock;
+        static const int64_t SEEK_HISTORY_DURATION_MS = 300;
+        static const int32_t BEHIND_SCROLL_DISTANCE_FACTOR = 4;
     };
 
 private:
@@ -2029,18 +2477,19 @@ private:
     AVStream* m_vidStream{nullptr};
     AVStream* m_audStream{nullptr};
     AVCodecPtr m_viddec{nullptr};
-    AVCodecContext* m_viddecCtx{nullptr};
+    uint32_t m_viddecCount{1};
+    vector<AVCodecContext*> m_viddecCtxs;
+    vector<AVBufferRef*> m_viddecHwDevCtxs;
     bool m_vidPreferUseHw{true};
     AVHWDeviceType m_vidUseHwType{AV_HWDEVICE_TYPE_NONE};
     AVPixelFormat m_vidHwPixFmt{AV_PIX_FMT_NONE};
     AVHWDeviceType m_viddecDevType{AV_HWDEVICE_TYPE_NONE};
-    AVBufferRef* m_viddecHwDevCtx{nullptr};
 
     // demuxing thread
     thread m_demuxThread;
     uint32_t m_maxPendingTaskCountForDecoding = 8;
-    // video decoding thread
-    thread m_viddecThread;
+    // video decoding threads, one for each decoder instance
+    vector<thread> m_viddecThreads;
     // update snapshots thread
     thread m_updateSsThread;
     // free gop task thread
@@ -2061,6 +2510,11 @@ private:
     double m_ssIntvPts{0};
     double m_cacheFactor{10.0};
     uint32_t m_maxCacheSize{0};
+    double m_prefetchLookAhead{0};
+    double m_avgGopMts{0};
+    bool m_keyFrameSnapEnabled{false};
+    double m_keyFrameSnapGopFactor{2.0};
+    atomic_bool m_keyFrameSnapActive{false};
     uint32_t m_prevWndCacheSize;
     list<Viewer::Holder> m_viewers;
     mutex m_viewerListLock;
@@ -2070,7 +2524,9 @@ private:
     list<GopDecodeTaskHolder> m_goptskToFree;
     mutex m_goptskFreeLock;
     atomic_int32_t m_pendingVidfrmCnt{0};
+    int32_t m_pendingVidfrmCntPerDecoder{2};
     int32_t m_maxPendingVidfrmCnt{2};
+    mutex m_ssEnqueueLock;
     // textures
     list<TextureHolder> m_deprecatedTextures;
     mutex m_deprecatedTextureLock;
@@ -2079,6 +2535,17 @@ private:
     bool m_ssSizeChanged{false};
     float m_ssWFacotr{1.f}, m_ssHFacotr{1.f};
     AVFrameToImMatConverter m_frmCvt;
+    // snapshot memory budget and statistics
+    atomic_uint64_t m_ssMemBudget{0};
+    atomic_uint64_t m_ssMemUsage{0};
+    atomic_uint64_t m_ssAccessTick{0};
+    atomic_uint64_t m_ssHitCnt{0};
+    atomic_uint64_t m_ssMissCnt{0};
+    atomic_uint64_t m_ssEvictCnt{0};
+    // the SS index range with evicted SS requested by GetSnapshots(), handled on the snapshot update thread
+    pair<int32_t, int32_t> m_redoRequestIdx{0, 0};
+    atomic_bool m_redoRequested{false};
+    mutex m_redoRequestLock;
 };
 
 static const auto SNAPSHOT_VIEWER_HOLDER_DELETER = [] (Viewer* p) {
@@ -15,6 +15,8 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "SysUtils.h"
 #if defined(_WIN32) && !defined(__MINGW64__)
 #include <windows.h>
@@ -145,4 +147,22 @@ std::string ExtractDirectoryPath(const std::string& path)
         return path.substr(0, lastSlashPos+1);
     }
 }
+
+bool GetFileStatus(const std::string& path, uint64_t& fileSize, int64_t& modifyTime)
+{
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#endif
+    if ((st.st_mode&S_IFMT) != S_IFREG)
+        return false;
+    fileSize = (uint64_t)st.st_size;
+    modifyTime = (int64_t)st.st_mtime;
+    return true;
+}
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+    Copyright (c) 2023 CodeWin
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+
+namespace MediaCore
+{
+    // Sorted-vector index over a list of timeline items (clips or overlaps) which is kept sorted by 'Start()'.
+    // Besides the item range, each entry holds the running maximum of 'End()' from the first entry, so that
+    // position lookups and range queries cost O(log n + k) instead of walking the whole list.
+    // The index must be rebuilt after the list is changed or re-sorted.
+    template <typename T>
+    class TimelineIndex
+    {
+    public:
+        using ItemIter = typename std::list<T>::iterator;
+
+        struct Entry
+        {
+            int64_t start;
+            int64_t end;
+            int64_t maxEnd;
+            ItemIter iter;
+            // serial number of the last seek operation applied on this item, maintained by the owner
+            uint32_t seekSerial;
+            T item;
+        };
+
+        TimelineIndex(std::list<T>& items) : m_items(items) {}
+
+        // The seek serial numbers of the items remaining in the list are kept
+        void Rebuild()
+        {
+            std::unordered_map<const void*, uint32_t> seekSerials;
+            for (auto& e : m_entries)
+                seekSerials[e.item.get()] = e.seekSerial;
+            m_entries.clear();
+            m_entries.reserve(m_items.size());
+            int64_t maxEnd = INT64_MIN;
+            for (auto iter = m_items.begin(); iter != m_items.end(); iter++)
+            {
+                const int64_t start = (*iter)->Start();
+                const int64_t end = (*iter)->End();
+                if (maxEnd < end)
+                    maxEnd = end;
+                auto serialIter = seekSerials.find(iter->get());
+                const uint32_t seekSerial = serialIter != seekSerials.end() ? serialIter->second : 0;
+                m_entries.push_back({start, end, maxEnd, iter, seekSerial, *iter});
+            }
+        }
+
+        size_t Size() const { return m_entries.size(); }
+        Entry& GetEntry(size_t idx) { return m_entries[idx]; }
+
+        // The first item whose 'End()' is after 'pos', where forward reading from 'pos' starts
+        ItemIter FindForward(int64_t pos)
+        {
+            auto iter = std::upper_bound(m_entries.begin(), m_entries.end(), pos, [] (int64_t pos, const Entry& e) {
+                return pos < e.maxEnd;
+            });
+            return iter != m_entries.end() ? iter->iter : m_items.end();
+        }
+
+        // The first item whose 'Start()' is after 'pos', backward reading from 'pos' starts from its previous item
+        ItemIter FindBackward(int64_t pos)
+        {
+            auto iter = std::upper_bound(m_entries.begin(), m_entries.end(), pos, [] (int64_t pos, const Entry& e) {
+                return pos < e.start;
+            });
+            return iter != m_entries.end() ? iter->iter : m_items.end();
+        }
+
+        Entry* FindEntry(const T& item)
+        {
+            auto iter = std::find_if(m_entries.begin(), m_entries.end(), [&item] (const Entry& e) {
+                return e.item == item;
+            });
+            return iter != m_entries.end() ? &(*iter) : nullptr;
+        }
+
+        // Collect the indices of the entries intersecting with range [pos0, pos1)
+        void Query(int64_t pos0, int64_t pos1, std::vector<size_t>& result) const
+        {
+            result.clear();
+            auto iter = std::upper_bound(m_entries.begin(), m_entries.end(), pos0, [] (int64_t pos, const Entry& e) {
+                return pos < e.maxEnd;
+            });
+            for (; iter != m_entries.end() && iter->start < pos1; iter++)
+            {
+                if (iter->end > pos0)
+                    result.push_back(iter-m_entries.begin());
+            }
+        }
+
+    private:
+        std::list<T>& m_items;
+        std::vector<Entry> m_entries;
+    };
+}
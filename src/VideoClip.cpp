@@ -20,8 +20,12 @@
 #include <ColorConvert_vulkan.h>
 #include <AlphaBlending_vulkan.h>
 #endif
+#include <mutex>
+#include <unordered_map>
+#include <tuple>
 #include "VideoClip.h"
 #include "VideoTransformFilter.h"
+#include "FFUtils.h"
 #include "Logger.h"
 #include "DebugHelper.h"
 #include "SysUtils.h"
@@ -32,6 +36,16 @@ using namespace Logger;
 namespace MediaCore
 {
 bool VideoClip::USE_HWACCEL = true;
+bool VideoClip::LAZY_READER = false;
+
+static bool IsOpaquePixelFormat(const string& pixfmtName)
+{
+    const AVPixelFormat pixfmt = av_get_pix_fmt(pixfmtName.c_str());
+    if (pixfmt == AV_PIX_FMT_NONE)
+        return false;
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixfmt);
+    return desc && (desc->flags&AV_PIX_FMT_FLAG_ALPHA) == 0;
+}
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 // VideoClip_VideoImpl
@@ -56,32 +70,27 @@ public:
         auto vidStm = hParser->GetBestVideoStream();
         if (vidStm->isImage)
             throw invalid_argument("This video stream is an IMAGE, it should be instantiated with a 'VideoClip_ImageImpl' instance!");
-        m_hReader = MediaReader::CreateVideoInstance();
-        m_hReader->EnableHwAccel(VideoClip::USE_HWACCEL);
-        if (!m_hReader->Open(hParser))
-            throw runtime_error(m_hReader->GetError());
-        uint32_t readerWidth, readerHeight;
+        m_hParser = hParser;
+        m_srcOpaque = IsOpaquePixelFormat(vidStm->format);
         if (outWidth*vidStm->height > outHeight*vidStm->width)
         {
-            readerHeight = outHeight;
-            readerWidth = vidStm->width*outHeight/vidStm->height;
+            m_readerHeight = outHeight;
+            m_readerWidth = vidStm->width*outHeight/vidStm->height;
         }
         else
         {
-            readerWidth = outWidth;
-            readerHeight = vidStm->height*outWidth/vidStm->width;
+            m_readerWidth = outWidth;
+            m_readerHeight = vidStm->height*outWidth/vidStm->width;
         }
-        readerWidth += readerWidth&0x1;
-        readerHeight += readerHeight&0x1;
-        ImInterpolateMode interpMode = IM_INTERPOLATE_BICUBIC;
-        if (readerWidth*readerHeight < vidStm->width*vidStm->height)
-            interpMode = IM_INTERPOLATE_AREA;
-        if (!m_hReader->ConfigVideoReader(readerWidth, readerHeight, IM_CF_RGBA, interpMode))
-            throw runtime_error(m_hReader->GetError());
+        m_readerWidth += m_readerWidth&0x1;
+        m_readerHeight += m_readerHeight&0x1;
+        m_interpMode = IM_INTERPOLATE_BICUBIC;
+        if (m_readerWidth*m_readerHeight < vidStm->width*vidStm->height)
+            m_interpMode = IM_INTERPOLATE_AREA;
         if (frameRate.num <= 0 || frameRate.den <= 0)
             throw invalid_argument("Invalid argument value for 'frameRate'!");
         m_frameRate = frameRate;
-        m_srcDuration = static_cast<int64_t>(m_hReader->GetVideoStream()->duration*1000);
+        m_srcDuration = static_cast<int64_t>(vidStm->duration*1000);
         if (startOffset < 0)
             throw invalid_argument("Argument 'startOffset' can NOT be NEGATIVE!");
         if (endOffset < 0)
@@ -90,12 +99,11 @@ public:
             throw invalid_argument("Argument 'startOffset/endOffset', clip duration is NOT LARGER than 0!");
         m_startOffset = startOffset;
         m_endOffset = endOffset;
-        m_hReader->SetDirection(forward);
-        if (!m_hReader->SeekTo((double)startOffset/1000))
-            throw runtime_error(m_hReader->GetError());
+        m_readForward = forward;
+        // in lazy mode, the clip holds only the metadata until the read position comes into the wakeup range
         bool suspend = readpos < -m_wakeupRange || readpos > Duration()+m_wakeupRange;
-        if (!m_hReader->Start(suspend))
-            throw runtime_error(m_hReader->GetError());
+        if (!VideoClip::LAZY_READER || !suspend)
+            OpenReader(suspend);
         m_hWarpFilter = CreateVideoTransformFilter();
         if (!m_hWarpFilter->Initialize(outWidth, outHeight))
             throw runtime_error(m_hWarpFilter->GetError());
@@ -109,7 +117,7 @@ public:
 
     MediaParser::Holder GetMediaParser() const override
     {
-        return m_hReader->GetMediaParser();
+        return m_hParser;
     }
 
     int64_t Id() const override
@@ -154,12 +162,12 @@ public:
 
     uint32_t SrcWidth() const override
     {
-        return m_hReader->GetVideoOutWidth();
+        return m_readerWidth;
     }
 
     uint32_t SrcHeight() const override
     {
-        return m_hReader->GetVideoOutHeight();
+        return m_readerHeight;
     }
 
     uint32_t OutWidth() const override
@@ -172,6 +180,12 @@ public:
         return m_hWarpFilter->GetOutHeight();
     }
 
+    bool IsOpaque() const override
+    {
+        // an external filter may bring in transparency
+        return m_srcOpaque && !m_hFilter;
+    }
+
     void SetTrackId(int64_t trackId) override
     {
         m_trackId = trackId;
@@ -216,7 +230,13 @@ public:
             eof = true;
             return;
         }
-        if (m_hReader->IsSuspended())
+        if (!m_hReader)
+        {
+            // the reader is opened on demand, if it's not woken up in advance by 'NotifyReadPos()'
+            m_readPos = pos;
+            OpenReader(false);
+        }
+        else if (m_hReader->IsSuspended())
         {
             m_hReader->Wakeup();
             // Log(DEBUG) << ">>>> Clip#" << m_id <<" is WAKEUP." << endl;
@@ -253,21 +273,35 @@ public:
             return;
         if (pos < 0)
             pos = 0;
-        if (!m_hReader->SeekTo((double)(pos+m_startOffset)/1000))
-            throw runtime_error(m_hReader->GetError());
+        m_readPos = pos;
         m_eof = false;
+        // a released reader will seek to 'm_readPos' when it's re-opened
+        if (m_hReader && !m_hReader->SeekTo((double)(pos+m_startOffset)/1000))
+            throw runtime_error(m_hReader->GetError());
     }
 
     void NotifyReadPos(int64_t pos) override
     {
         if (pos < -m_wakeupRange || pos > Duration()+m_wakeupRange)
         {
-            if (!m_hReader->IsSuspended())
+            if (!m_hReader)
+                return;
+            if (VideoClip::LAZY_READER && (pos <= -m_releaseRange || pos >= Duration()+m_releaseRange))
+            {
+                ReleaseReader();
+                // Log(DEBUG) << ">>>> Clip#" << m_id <<" is RELEASED." << endl;
+            }
+            else if (!m_hReader->IsSuspended())
             {
                 m_hReader->Suspend();
                 // Log(DEBUG) << ">>>> Clip#" << m_id <<" is SUSPENDED." << endl;
             }
         }
+        else if (!m_hReader)
+        {
+            OpenReader(false);
+            // Log(DEBUG) << ">>>> Clip#" << m_id <<" is RE-OPENED." << endl;
+        }
         else if (m_hReader->IsSuspended())
         {
             m_hReader->Wakeup();
@@ -277,7 +311,9 @@ public:
 
     void SetDirection(bool forward) override
     {
-        m_hReader->SetDirection(forward);
+        m_readForward = forward;
+        if (m_hReader)
+            m_hReader->SetDirection(forward);
     }
 
     void SetFilter(VideoFilter::Holder filter) override
@@ -303,12 +339,43 @@ public:
         return m_hWarpFilter;
     }
 
+private:
+    void OpenReader(bool suspend)
+    {
+        // the parsed 'MediaParser' instance is reused, so re-opening a released reader doesn't probe the media again
+        auto hReader = MediaReader::CreateVideoInstance();
+        hReader->EnableHwAccel(VideoClip::USE_HWACCEL);
+        if (!hReader->Open(m_hParser))
+            throw runtime_error(hReader->GetError());
+        if (!hReader->ConfigVideoReader(m_readerWidth, m_readerHeight, IM_CF_RGBA, m_interpMode))
+            throw runtime_error(hReader->GetError());
+        hReader->SetDirection(m_readForward);
+        if (!hReader->SeekTo((double)(m_readPos+m_startOffset)/1000))
+            throw runtime_error(hReader->GetError());
+        if (!hReader->Start(suspend))
+            throw runtime_error(hReader->GetError());
+        m_hReader = hReader;
+    }
+
+    void ReleaseReader()
+    {
+        m_hReader->Close();
+        m_hReader = nullptr;
+    }
+
 private:
     ALogger* m_logger;
     int64_t m_id;
     int64_t m_trackId{-1};
     MediaInfo::Holder m_hInfo;
+    MediaParser::Holder m_hParser;
+    bool m_srcOpaque;
     MediaReader::Holder m_hReader;
+    uint32_t m_readerWidth;
+    uint32_t m_readerHeight;
+    ImInterpolateMode m_interpMode;
+    bool m_readForward{true};
+    int64_t m_readPos{0};
     int64_t m_srcDuration;
     int64_t m_start;
     int64_t m_startOffset;
@@ -319,6 +386,9 @@ private:
     VideoFilter::Holder m_hFilter;
     VideoTransformFilterHolder m_hWarpFilter;
     int64_t m_wakeupRange{1000};
+    // in lazy mode, the reader is released when the read position is out of this range, it's larger than the
+    // seek range of the track, so that a clip at the edge doesn't open and release its reader over and over
+    int64_t m_releaseRange{3000};
 };
 
 static const auto VIDEO_CLIP_HOLDER_VIDEOIMPL_DELETER = [] (VideoClip* p) {
@@ -338,12 +408,139 @@ VideoClip::Holder VideoClip::CreateVideoInstance(
 VideoClip::Holder VideoClip_VideoImpl::Clone(uint32_t outWidth, uint32_t outHeight, const Ratio& frameRate) const
 {
     VideoClip_VideoImpl* newInstance = new VideoClip_VideoImpl(
-        m_id, m_hReader->GetMediaParser(), outWidth, outHeight, frameRate, m_start, m_startOffset, m_endOffset, 0, true);
+        m_id, m_hParser, outWidth, outHeight, frameRate, m_start, m_startOffset, m_endOffset, 0, true);
     if (m_hFilter) newInstance->SetFilter(m_hFilter->Clone());
     newInstance->m_hWarpFilter = m_hWarpFilter->Clone(outWidth, outHeight);
     return VideoClip::Holder(newInstance, VIDEO_CLIP_HOLDER_VIDEOIMPL_DELETER);
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////
+// StillImagePool
+///////////////////////////////////////////////////////////////////////////////////////////
+// Decoded still images, shared by all the image clips using the same source with the same size.
+// An image is decoded only once, and is freed after the last clip referring to it is destroyed.
+// The shared image is read-only, it must be cloned before being modified in place.
+class StillImagePool
+{
+public:
+    using ImageHolder = shared_ptr<const ImGui::ImMat>;
+
+    static StillImagePool& GetInstance()
+    {
+        static StillImagePool s_instance;
+        return s_instance;
+    }
+
+    // Returns null on failure, with the reason in 'errMsg'
+    ImageHolder GetImage(MediaParser::Holder hParser, uint32_t width, uint32_t height, ImInterpolateMode interpMode, string& errMsg)
+    {
+        ostringstream keyOss;
+        keyOss << hParser->GetUrl() << "@" << width << "x" << height << ":" << (int)interpMode;
+        const string key = keyOss.str();
+        {
+            lock_guard<mutex> lk(m_poolLock);
+            auto iter = m_images.find(key);
+            if (iter != m_images.end())
+            {
+                auto hImage = iter->second.lock();
+                if (hImage)
+                    return hImage;
+            }
+        }
+        // decode without holding the lock, so that the clips of the other images are not blocked
+        ImGui::ImMat* pImage = new ImGui::ImMat();
+        ImageHolder hImage(pImage);
+        if (!DecodeImage(hParser, width, height, interpMode, *pImage, errMsg))
+            return nullptr;
+        lock_guard<mutex> lk(m_poolLock);
+        // another clip may have decoded the same image meanwhile, the first one is kept
+        auto iter = m_images.find(key);
+        if (iter != m_images.end())
+        {
+            auto hExistingImage = iter->second.lock();
+            if (hExistingImage)
+                return hExistingImage;
+        }
+        // remove the expired entries
+        for (auto it = m_images.begin(); it != m_images.end();)
+        {
+            if (it->second.expired())
+                it = m_images.erase(it);
+            else
+                it++;
+        }
+        m_images[key] = hImage;
+        return hImage;
+    }
+
+private:
+    StillImagePool()
+    {
+        m_logger = GetLogger("StillImagePool");
+    }
+
+    string FFapiFailureMessage(const string& apiName, int fferr)
+    {
+        ostringstream oss;
+        oss << "FF api '" << apiName << "' returns error! fferr=" << fferr << ".";
+        return oss.str();
+    }
+
+    bool DecodeImage(MediaParser::Holder hParser, uint32_t width, uint32_t height, ImInterpolateMode interpMode, ImGui::ImMat& image, string& errMsg)
+    {
+        const string url = hParser->GetUrl();
+        AVFormatContext* avfmtCtx = nullptr;
+        int fferr = avformat_open_input(&avfmtCtx, url.c_str(), nullptr, nullptr);
+        if (fferr < 0)
+        {
+            errMsg = FFapiFailureMessage("avformat_open_input", fferr);
+            return false;
+        }
+        fferr = avformat_find_stream_info(avfmtCtx, nullptr);
+        if (fferr < 0)
+        {
+            avformat_close_input(&avfmtCtx);
+            errMsg = FFapiFailureMessage("avformat_find_stream_info", fferr);
+            return false;
+        }
+        // the probe frame generated when opening the decoder is the decoded image
+        FFUtils::OpenVideoDecoderOptions opts;
+        opts.onlyUseSoftwareDecoder = true;
+        FFUtils::OpenVideoDecoderResult res;
+        bool success = FFUtils::OpenVideoDecoder(avfmtCtx, hParser->GetBestVideoStreamIndex(), &opts, &res);
+        if (!success)
+        {
+            ostringstream oss;
+            oss << "Open video decoder FAILED! Error is '" << res.errMsg << "'.";
+            errMsg = oss.str();
+        }
+        else
+        {
+            AVFrameToImMatConverter frmCvt;
+            frmCvt.SetOutSize(width, height);
+            frmCvt.SetOutColorFormat(IM_CF_RGBA);
+            frmCvt.SetResizeInterpolateMode(interpMode);
+            success = frmCvt.ConvertImage(res.probeFrame.get(), image, 0);
+            if (!success)
+                errMsg = frmCvt.GetError();
+            else
+                m_logger->Log(DEBUG) << "Decoded still image (" << image.w << "x" << image.h << ") from '" << url << "'." << endl;
+        }
+        if (res.decCtx)
+            avcodec_free_context(&res.decCtx);
+        avformat_close_input(&avfmtCtx);
+        return success;
+    }
+
+private:
+    ALogger* m_logger;
+    mutex m_poolLock;
+    unordered_map<string, weak_ptr<const ImGui::ImMat>> m_images;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// VideoClip_ImageImpl
+///////////////////////////////////////////////////////////////////////////////////////////
 class VideoClip_ImageImpl : public VideoClip
 {
 public:
@@ -358,33 +555,32 @@ public:
         auto vidStm = hParser->GetBestVideoStream();
         if (!vidStm->isImage)
             throw invalid_argument("This video stream is NOT an IMAGE, it should be instantiated with a 'VideoClip_VideoImpl' instance!");
-        m_hReader = MediaReader::CreateInstance();
-        if (!m_hReader->Open(hParser))
-            throw runtime_error(m_hReader->GetError());
-        uint32_t readerWidth, readerHeight;
+        m_hParser = hParser;
+        m_srcOpaque = IsOpaquePixelFormat(vidStm->format);
         if (outWidth*vidStm->height > outHeight*vidStm->width)
         {
-            readerHeight = outHeight;
-            readerWidth = vidStm->width*outHeight/vidStm->height;
+            m_readerHeight = outHeight;
+            m_readerWidth = vidStm->width*outHeight/vidStm->height;
         }
         else
         {
-            readerWidth = outWidth;
-            readerHeight = vidStm->height*outWidth/vidStm->width;
+            m_readerWidth = outWidth;
+            m_readerHeight = vidStm->height*outWidth/vidStm->width;
         }
-        readerWidth += readerWidth&0x1;
-        readerHeight += readerHeight&0x1;
+        m_readerWidth += m_readerWidth&0x1;
+        m_readerHeight += m_readerHeight&0x1;
         ImInterpolateMode interpMode = IM_INTERPOLATE_BICUBIC;
-        if (readerWidth*readerHeight < vidStm->width*vidStm->height)
+        if (m_readerWidth*m_readerHeight < vidStm->width*vidStm->height)
             interpMode = IM_INTERPOLATE_AREA;
-        if (!m_hReader->ConfigVideoReader(readerWidth, readerHeight, IM_CF_RGBA, interpMode))
-            throw runtime_error(m_hReader->GetError());
         if (duration <= 0)
             throw invalid_argument("Argument 'duration' must be positive!");
         m_srcDuration = duration;
         m_start = start;
-        if (!m_hReader->Start())
-            throw runtime_error(m_hReader->GetError());
+        // the image is decoded only once, and shared with the other clips using the same source
+        string errMsg;
+        m_hImage = StillImagePool::GetInstance().GetImage(hParser, m_readerWidth, m_readerHeight, interpMode, errMsg);
+        if (!m_hImage)
+            throw runtime_error(errMsg);
         m_hWarpFilter = CreateVideoTransformFilter();
         if (!m_hWarpFilter->Initialize(outWidth, outHeight))
             throw runtime_error(m_hWarpFilter->GetError());
@@ -398,7 +594,7 @@ public:
 
     MediaParser::Holder GetMediaParser() const override
     {
-        return m_hReader->GetMediaParser();
+        return m_hParser;
     }
 
     int64_t Id() const override
@@ -443,12 +639,12 @@ public:
 
     uint32_t SrcWidth() const override
     {
-        return m_hReader->GetVideoOutWidth();
+        return m_readerWidth;
     }
 
     uint32_t SrcHeight() const override
     {
-        return m_hReader->GetVideoOutHeight();
+        return m_readerHeight;
     }
 
     uint32_t OutWidth() const override
@@ -461,6 +657,12 @@ public:
         return m_hWarpFilter->GetOutHeight();
     }
 
+    bool IsOpaque() const override
+    {
+        // an external filter may bring in transparency
+        return m_srcOpaque && !m_hFilter;
+    }
+
     void SetTrackId(int64_t trackId) override
     {
         m_trackId = trackId;
@@ -486,19 +688,31 @@ public:
 
     void ReadVideoFrame(int64_t pos, vector<CorrelativeFrame>& frames, ImGui::ImMat& out, bool& eof) override
     {
-        ImGui::ImMat image;
-        if (!m_hReader->ReadVideoFrame(0, image, eof))
-            throw runtime_error(m_hReader->GetError());
+        // the pooled image is shared by reference, it's only read from here on
+        ImGui::ImMat image = *m_hImage;
+        eof = false;
         frames.push_back({CorrelativeFrame::PHASE_SOURCE_FRAME, m_id, m_trackId, image});
 
-        // process with external filter
+        // process with external filter, which may work in place, so it gets its own copy of the shared image
         VideoFilter::Holder filter = m_hFilter;
         if (filter)
-            image = filter->FilterImage(image, pos/*+m_start*/);
+            image = filter->FilterImage(image.clone(), pos/*+m_start*/);
         frames.push_back({CorrelativeFrame::PHASE_AFTER_FILTER, m_id, m_trackId, image});
 
-        // process with transform filter
-        image = m_hWarpFilter->FilterImage(image, pos/*+m_start*/);
+        // process with transform filter, the output is reused if neither the input nor the transform parameters can change
+        const bool paramsChanged = UpdateTransformParams();
+        if (!filter && !paramsChanged && !m_transformedImage.empty() && m_hWarpFilter->GetKeyPoint()->GetCurveCount() == 0)
+        {
+            image = m_transformedImage;
+        }
+        else
+        {
+            image = m_hWarpFilter->FilterImage(image, pos/*+m_start*/);
+            if (!filter)
+                m_transformedImage = image;
+            else
+                m_transformedImage.release();
+        }
         frames.push_back({CorrelativeFrame::PHASE_AFTER_TRANSFORM, m_id, m_trackId, image});
         out = image;
     }
@@ -535,15 +749,76 @@ public:
         return m_hWarpFilter;
     }
 
+private:
+    struct TransformParams
+    {
+        uint32_t outWidth{0}, outHeight{0};
+        string outputFormat;
+        ScaleType scaleType{SCALE_TYPE__FIT};
+        int32_t posOffsetH{0}, posOffsetV{0};
+        uint32_t cropL{0}, cropT{0}, cropR{0}, cropB{0};
+        float fposOffsetH{0}, fposOffsetV{0};
+        float fcropL{0}, fcropT{0}, fcropR{0}, fcropB{0};
+        double rotateAngle{0};
+        double scaleH{1}, scaleV{1};
+
+        bool operator==(const TransformParams& other) const
+        {
+            return tie(outWidth, outHeight, outputFormat, scaleType, posOffsetH, posOffsetV, cropL, cropT, cropR, cropB,
+                    fposOffsetH, fposOffsetV, fcropL, fcropT, fcropR, fcropB, rotateAngle, scaleH, scaleV) ==
+                tie(other.outWidth, other.outHeight, other.outputFormat, other.scaleType, other.posOffsetH, other.posOffsetV,
+                    other.cropL, other.cropT, other.cropR, other.cropB, other.fposOffsetH, other.fposOffsetV,
+                    other.fcropL, other.fcropT, other.fcropR, other.fcropB, other.rotateAngle, other.scaleH, other.scaleV);
+        }
+    };
+
+    // Returns true if any of the transform parameters has changed since the last call
+    bool UpdateTransformParams()
+    {
+        auto hWarpFilter = m_hWarpFilter;
+        TransformParams params;
+        params.outWidth = hWarpFilter->GetOutWidth();
+        params.outHeight = hWarpFilter->GetOutHeight();
+        params.outputFormat = hWarpFilter->GetOutputFormat();
+        params.scaleType = hWarpFilter->GetScaleType();
+        params.posOffsetH = hWarpFilter->GetPositionOffsetH();
+        params.posOffsetV = hWarpFilter->GetPositionOffsetV();
+        params.cropL = hWarpFilter->GetCropMarginL();
+        params.cropT = hWarpFilter->GetCropMarginT();
+        params.cropR = hWarpFilter->GetCropMarginR();
+        params.cropB = hWarpFilter->GetCropMarginB();
+        params.fposOffsetH = hWarpFilter->GetPositionOffsetHScale();
+        params.fposOffsetV = hWarpFilter->GetPositionOffsetVScale();
+        params.fcropL = hWarpFilter->GetCropMarginLScale();
+        params.fcropT = hWarpFilter->GetCropMarginTScale();
+        params.fcropR = hWarpFilter->GetCropMarginRScale();
+        params.fcropB = hWarpFilter->GetCropMarginBScale();
+        params.rotateAngle = hWarpFilter->GetRotationAngle();
+        params.scaleH = hWarpFilter->GetScaleH();
+        params.scaleV = hWarpFilter->GetScaleV();
+        if (hWarpFilter == m_hCachedWarpFilter && params == m_transformParams)
+            return false;
+        m_hCachedWarpFilter = hWarpFilter;
+        m_transformParams = params;
+        return true;
+    }
+
 private:
     int64_t m_id;
     int64_t m_trackId{-1};
     MediaInfo::Holder m_hInfo;
-    MediaReader::Holder m_hReader;
+    MediaParser::Holder m_hParser;
+    bool m_srcOpaque;
+    StillImagePool::ImageHolder m_hImage;
+    uint32_t m_readerWidth;
+    uint32_t m_readerHeight;
     int64_t m_srcDuration;
     int64_t m_start;
     VideoFilter::Holder m_hFilter;
     VideoTransformFilterHolder m_hWarpFilter;
+    VideoTransformFilterHolder m_hCachedWarpFilter;
+    TransformParams m_transformParams;
+    ImGui::ImMat m_transformedImage;
 };
 
 static const auto VIDEO_CLIP_HOLDER_IMAGEIMPL_DELETER = [] (VideoClip* p) {
@@ -562,7 +837,7 @@ VideoClip::Holder VideoClip::CreateImageInstance(
 VideoClip::Holder VideoClip_ImageImpl::Clone(uint32_t outWidth, uint32_t outHeight, const Ratio& frameRate) const
 {
     VideoClip_ImageImpl* newInstance = new VideoClip_ImageImpl(
-        m_id, m_hReader->GetMediaParser(), outWidth, outHeight, m_start, m_srcDuration);
+        m_id, m_hParser, outWidth, outHeight, m_start, m_srcDuration);
     if (m_hFilter) newInstance->SetFilter(m_hFilter->Clone());
     newInstance->m_hWarpFilter = m_hWarpFilter->Clone(outWidth, outHeight);
     return VideoClip::Holder(newInstance, VIDEO_CLIP_HOLDER_IMAGEIMPL_DELETER);
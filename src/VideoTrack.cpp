@@ -17,9 +17,12 @@
 
 #include <sstream>
 #include <algorithm>
+#include <unordered_map>
 #include "VideoTrack.h"
 #include "MediaCore.h"
 #include "DebugHelper.h"
+#include "TimelineIndex.h"
+#include "RenderFrameCache.h"
 
 using namespace std;
 
@@ -37,7 +40,7 @@ class VideoTrack_Impl : public VideoTrack
 {
 public:
     VideoTrack_Impl(int64_t id, uint32_t outWidth, uint32_t outHeight, const Ratio& frameRate)
-        : m_id(id), m_outWidth(outWidth), m_outHeight(outHeight), m_frameRate(frameRate)
+        : m_id(id), m_outWidth(outWidth), m_outHeight(outHeight), m_frameRate(frameRate), m_clipIndex(m_clips), m_overlapIndex(m_overlaps)
     {
         m_readClipIter = m_clips.begin();
     }
@@ -73,9 +76,7 @@ public:
         m_duration = lastClip->Start()+lastClip->Duration();
         // update overlap
         UpdateClipOverlap(hClip);
-        // call 'SeekTo()' to update iterators
-        const int64_t readPos = m_readFrames*1000*m_frameRate.den/m_frameRate.num;
-        SeekTo(readPos);
+        UpdateAfterEdit(hClip, hClip->Start(), hClip->End());
     }
 
     void MoveClip(int64_t id, int64_t start) override
@@ -87,8 +88,9 @@ public:
 
         if (hClip->Start() == start)
             return;
-        else
-            hClip->SetStart(start);
+        const int64_t oldStart = hClip->Start();
+        const int64_t oldEnd = hClip->End();
+        hClip->SetStart(start);
 
         if (!CheckClipRangeValid(id, hClip->Start(), hClip->End()))
             throw invalid_argument("Invalid argument for moving clip!");
@@ -100,9 +102,7 @@ public:
         m_duration = lastClip->Start()+lastClip->Duration();
         // update overlap
         UpdateClipOverlap(hClip);
-        // call 'SeekTo()' to update iterators
-        const int64_t readPos = m_readFrames*1000*m_frameRate.den/m_frameRate.num;
-        SeekTo(readPos);
+        UpdateAfterEdit(hClip, min(oldStart, hClip->Start()), max(oldEnd, hClip->End()));
     }
 
     void ChangeClipRange(int64_t id, int64_t startOffset, int64_t endOffset) override
@@ -112,6 +112,8 @@ public:
         if (!hClip)
             throw invalid_argument("Invalid value for argument 'id'!");
 
+        const int64_t oldStart = hClip->Start();
+        const int64_t oldEnd = hClip->End();
         bool rangeChanged = false;
         if (hClip->IsImage())
         {
@@ -157,9 +159,7 @@ public:
         m_duration = lastClip->Start()+lastClip->Duration();
         // update overlap
         UpdateClipOverlap(hClip);
-        // call 'SeekTo()' to update iterators
-        const int64_t readPos = m_readFrames*1000*m_frameRate.den/m_frameRate.num;
-        SeekTo(readPos);
+        UpdateAfterEdit(hClip, min(oldStart, hClip->Start()), max(oldEnd, hClip->End()));
     }
 
     VideoClip::Holder RemoveClipById(int64_t clipId) override
@@ -175,9 +175,7 @@ public:
         m_clips.erase(iter);
         hClip->SetTrackId(-1);
         UpdateClipOverlap(hClip, true);
-        // call 'SeekTo()' to update iterators
-        const int64_t readPos = m_readFrames*1000*m_frameRate.den/m_frameRate.num;
-        SeekTo(readPos);
+        UpdateAfterEdit(hClip, hClip->Start(), hClip->End());
 
         if (m_clips.empty())
             m_duration = 0;
@@ -205,9 +203,7 @@ public:
         m_clips.erase(iter);
         hClip->SetTrackId(-1);
         UpdateClipOverlap(hClip, true);
-        // call 'SeekTo()' to update iterators
-        const int64_t readPos = m_readFrames*1000*m_frameRate.den/m_frameRate.num;
-        SeekTo(readPos);
+        UpdateAfterEdit(hClip, hClip->Start(), hClip->End());
 
         if (m_clips.empty())
             m_duration = 0;
@@ -290,67 +286,20 @@ public:
         if (pos < 0)
             throw invalid_argument("Argument 'pos' can NOT be NEGATIVE!");
 
+        // update read iterators
         if (m_readForward)
         {
-            // update read clip iterator
-            m_readClipIter = m_clips.end();
-            {
-                auto iter = m_clips.begin();
-                while (iter != m_clips.end())
-                {
-                    const VideoClip::Holder& hClip = *iter;
-                    int64_t clipPos = pos-hClip->Start();
-                    hClip->SeekTo(clipPos);
-                    if (m_readClipIter == m_clips.end() && clipPos < hClip->Duration())
-                        m_readClipIter = iter;
-                    iter++;
-                }
-            }
-            // update read overlap iterator
-            m_readOverlapIter = m_overlaps.end();
-            {
-                auto iter = m_overlaps.begin();
-                while (iter != m_overlaps.end())
-                {
-                    const VideoOverlap::Holder& hOverlap = *iter;
-                    int64_t overlapPos = pos-hOverlap->Start();
-                    if (m_readOverlapIter == m_overlaps.end() && overlapPos < hOverlap->Duration())
-                    {
-                        m_readOverlapIter = iter;
-                        break;
-                    }
-                    iter++;
-                }
-            }
+            m_readClipIter = m_clipIndex.FindForward(pos);
+            m_readOverlapIter = m_overlapIndex.FindForward(pos);
         }
         else
         {
-            m_readClipIter = m_clips.end();
-            {
-                auto riter = m_clips.rbegin();
-                while (riter != m_clips.rend())
-                {
-                    const VideoClip::Holder& hClip = *riter;
-                    int64_t clipPos = pos-hClip->Start();
-                    hClip->SeekTo(clipPos);
-                    if (m_readClipIter == m_clips.end() && clipPos >= 0)
-                        m_readClipIter = riter.base();
-                    riter++;
-                }
-            }
-            m_readOverlapIter = m_overlaps.end();
-            {
-                auto riter = m_overlaps.rbegin();
-                while (riter != m_overlaps.rend())
-                {
-                    const VideoOverlap::Holder& hOverlap = *riter;
-                    int64_t overlapPos = pos-hOverlap->Start();
-                    if (m_readOverlapIter == m_overlaps.end() && overlapPos >= 0)
-                        m_readOverlapIter = riter.base();
-                    riter++;
-                }
-            }
+            m_readClipIter = m_clipIndex.FindBackward(pos);
+            m_readOverlapIter = m_overlapIndex.FindBackward(pos);
         }
+        // only the clips near the read position are sought now, the others are sought when they are approached
+        m_seekSerial++;
+        SeekClipsNearReadPos(pos);
 
         m_readFrames = (int64_t)(pos*m_frameRate.num/(m_frameRate.den*1000));
     }
@@ -383,8 +332,8 @@ public:
         lock_guard<recursive_mutex> lk(m_apiLock);
 
         const int64_t readPos = m_readFrames*1000*m_frameRate.den/m_frameRate.num;
-        for (auto& clip : m_clips)
-            clip->NotifyReadPos(readPos-clip->Start());
+        NotifyClipsNearReadPos(readPos);
+        m_readFrameOpaque = false;
 
         if (m_readForward)
         {
@@ -414,6 +363,7 @@ public:
                     if (readPos < hClip->End())
                     {
                         hClip->ReadVideoFrame(readPos-hClip->Start(), frames, out, eof);
+                        m_readFrameOpaque = !out.empty() && IsClipCoveringOutput(hClip);
                         break;
                     }
                     else
@@ -445,7 +395,10 @@ public:
                 auto& hClip = *m_readClipIter;
                 bool eof = false;
                 if (readPos >= hClip->Start() && readPos < hClip->End())
+                {
                     hClip->ReadVideoFrame(readPos-hClip->Start(), frames, out, eof);
+                    m_readFrameOpaque = !out.empty() && IsClipCoveringOutput(hClip);
+                }
             }
 
             out.time_stamp = (double)readPos/1000;
@@ -453,6 +406,60 @@ public:
         }
     }
 
+    bool IsReadFrameOpaque() const override
+    {
+        return m_readFrameOpaque;
+    }
+
+    void InvalidateRange(int64_t start, int64_t end) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (start >= end)
+            return;
+        MarkInvalidRange(start, end);
+        // the content of the clips and overlaps in this range is changed in a way not told by their parameters
+        m_contentRevision++;
+        m_clipIndex.Query(start, end, m_queryResult);
+        for (auto idx : m_queryResult)
+            m_clipRevisions[(*m_clipIndex.GetEntry(idx).iter)->Id()] = m_contentRevision;
+        m_overlapIndex.Query(start, end, m_queryResult);
+        for (auto idx : m_queryResult)
+            m_overlapRevisions[(*m_overlapIndex.GetEntry(idx).iter)->Id()] = m_contentRevision;
+    }
+
+    bool TakeInvalidRange(int64_t& start, int64_t& end) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        if (m_invalidStart >= m_invalidEnd)
+            return false;
+        start = m_invalidStart;
+        end = m_invalidEnd;
+        m_invalidStart = INT64_MAX;
+        m_invalidEnd = INT64_MIN;
+        return true;
+    }
+
+    uint64_t GetContentHash(int64_t pos) override
+    {
+        lock_guard<recursive_mutex> lk(m_apiLock);
+        ContentHasher hasher;
+        hasher.Add(m_outWidth).Add(m_outHeight);
+        m_clipIndex.Query(pos, pos+1, m_queryResult);
+        for (auto idx : m_queryResult)
+            HashClip(hasher, *m_clipIndex.GetEntry(idx).iter, pos);
+        m_overlapIndex.Query(pos, pos+1, m_queryResult);
+        for (auto idx : m_queryResult)
+        {
+            auto& overlap = *m_overlapIndex.GetEntry(idx).iter;
+            auto revIter = m_overlapRevisions.find(overlap->Id());
+            hasher.Add(overlap->Id()).Add(overlap->Start()).Add(overlap->End())
+                .Add(overlap->FrontClip()->Id()).Add(overlap->RearClip()->Id())
+                .Add(GetObjectId(overlap->GetTransition()))
+                .Add(revIter != m_overlapRevisions.end() ? revIter->second : 0u);
+        }
+        return hasher.Value();
+    }
+
     void SetDirection(bool forward) override
     {
         if (m_readForward == forward)
@@ -512,8 +519,10 @@ public:
 private:
     bool CheckClipRangeValid(int64_t clipId, int64_t start, int64_t end)
     {
-        for (auto& overlap : m_overlaps)
+        m_overlapIndex.Query(start, end, m_queryResult);
+        for (auto idx : m_queryResult)
         {
+            auto& overlap = *m_overlapIndex.GetEntry(idx).iter;
             if (clipId == overlap->FrontClip()->Id() || clipId == overlap->RearClip()->Id())
                 continue;
             if ((start > overlap->Start() && start < overlap->End()) ||
@@ -526,6 +535,7 @@ private:
     void UpdateClipOverlap(VideoClip::Holder hUpdateClip, bool remove = false)
     {
         const int64_t id1 = hUpdateClip->Id();
+        m_clipIndex.Rebuild();
         // remove invalid overlaps
         auto ovIter = m_overlaps.begin();
         while (ovIter != m_overlaps.end())
@@ -550,8 +560,10 @@ private:
         if (!remove)
         {
             // add new overlaps
-            for (auto& clip : m_clips)
+            m_clipIndex.Query(hUpdateClip->Start(), hUpdateClip->End(), m_queryResult);
+            for (auto idx : m_queryResult)
             {
+                auto& clip = *m_clipIndex.GetEntry(idx).iter;
                 if (hUpdateClip == clip)
                     continue;
                 if (VideoOverlap::HasOverlap(hUpdateClip, clip))
@@ -573,9 +585,151 @@ private:
 
         // sort overlap by 'Start' time
         m_overlaps.sort(OVERLAP_SORT_CMP);
+        m_overlapIndex.Rebuild();
+    }
+
+    void SeekClipsNearReadPos(int64_t readPos)
+    {
+        m_clipIndex.Query(readPos-CLIP_SEEK_RANGE, readPos+CLIP_SEEK_RANGE, m_queryResult);
+        for (auto idx : m_queryResult)
+        {
+            auto& entry = m_clipIndex.GetEntry(idx);
+            if (entry.seekSerial != m_seekSerial)
+            {
+                const VideoClip::Holder& hClip = *entry.iter;
+                hClip->SeekTo(readPos-hClip->Start());
+                entry.seekSerial = m_seekSerial;
+            }
+        }
+    }
+
+    void NotifyClipsNearReadPos(int64_t readPos)
+    {
+        SeekClipsNearReadPos(readPos);
+        // the notifications go further than the seek range, so that the clips get released before they stop being notified
+        m_clipIndex.Query(readPos-CLIP_RELEASE_NOTIFY_RANGE, readPos+CLIP_RELEASE_NOTIFY_RANGE, m_queryResult);
+        // clips leaving the notify range get a last notification, so they can suspend themselves
+        vector<VideoClip::Holder> nearClips;
+        nearClips.reserve(m_queryResult.size());
+        for (auto idx : m_queryResult)
+            nearClips.push_back(*m_clipIndex.GetEntry(idx).iter);
+        for (auto& hClip : m_notifiedClips)
+        {
+            if (hClip->TrackId() == m_id && find(nearClips.begin(), nearClips.end(), hClip) == nearClips.end())
+                hClip->NotifyReadPos(readPos-hClip->Start());
+        }
+        for (auto& hClip : nearClips)
+            hClip->NotifyReadPos(readPos-hClip->Start());
+        m_notifiedClips = std::move(nearClips);
+    }
+
+    // After an edit, only the read iterators are updated and the edited clip is sought, the other clips keep their read positions
+    void UpdateAfterEdit(const VideoClip::Holder& hClip, int64_t invalidStart, int64_t invalidEnd)
+    {
+        const int64_t readPos = ReadPos();
+        if (m_readForward)
+        {
+            m_readClipIter = m_clipIndex.FindForward(readPos);
+            m_readOverlapIter = m_overlapIndex.FindForward(readPos);
+        }
+        else
+        {
+            m_readClipIter = m_clipIndex.FindBackward(readPos);
+            m_readOverlapIter = m_overlapIndex.FindBackward(readPos);
+        }
+        auto pEntry = m_clipIndex.FindEntry(hClip);
+        if (pEntry)
+        {
+            if (hClip->End() > readPos-CLIP_SEEK_RANGE && hClip->Start() < readPos+CLIP_SEEK_RANGE)
+            {
+                hClip->SeekTo(readPos-hClip->Start());
+                pEntry->seekSerial = m_seekSerial;
+            }
+            else
+            {
+                // let it be sought when it's approached
+                pEntry->seekSerial = m_seekSerial-1;
+            }
+        }
+        MarkInvalidRange(invalidStart, invalidEnd);
+    }
+
+    // The clip edits are told by the clip parameters, so only the invalid range is recorded
+    void MarkInvalidRange(int64_t start, int64_t end)
+    {
+        if (start >= end)
+            return;
+        if (m_invalidStart > start)
+            m_invalidStart = start;
+        if (m_invalidEnd < end)
+            m_invalidEnd = end;
+    }
+
+    // Id of a filter or transition object, which is not reused by another object allocated at the same address.
+    // The changes of their parameters are told by InvalidateRange().
+    template <typename T>
+    uint64_t GetObjectId(const shared_ptr<T>& hObj)
+    {
+        if (!hObj)
+            return 0;
+        if (m_objectIds.size() > 1024)
+        {
+            for (auto iter = m_objectIds.begin(); iter != m_objectIds.end();)
+                iter = iter->second.first.expired() ? m_objectIds.erase(iter) : next(iter);
+        }
+        auto& entry = m_objectIds[hObj.get()];
+        if (entry.second == 0 || entry.first.expired())
+        {
+            entry.first = hObj;
+            entry.second = ++m_objectIdCounter;
+        }
+        return entry.second;
+    }
+
+    void HashClip(ContentHasher& hasher, const VideoClip::Holder& hClip, int64_t pos)
+    {
+        auto revIter = m_clipRevisions.find(hClip->Id());
+        auto hFilter = hClip->GetFilter();
+        hasher.Add(hClip->Id()).Add(hClip->Start()).Add(hClip->StartOffset()).Add(hClip->EndOffset()).Add(hClip->Duration())
+            .Add(GetObjectId(hFilter)).Add(hFilter ? hFilter->GetFilterName() : string())
+            .Add(revIter != m_clipRevisions.end() ? revIter->second : 0u);
+        auto hTransform = hClip->GetTransformFilter();
+        if (hTransform)
+        {
+            hasher.Add(GetObjectId(hTransform)).Add(hTransform->GetScaleType())
+                .Add(hTransform->GetPositionOffsetH()).Add(hTransform->GetPositionOffsetV())
+                .Add(hTransform->GetPositionOffsetHScale()).Add(hTransform->GetPositionOffsetVScale())
+                .Add(hTransform->GetCropMarginL()).Add(hTransform->GetCropMarginT())
+                .Add(hTransform->GetCropMarginR()).Add(hTransform->GetCropMarginB())
+                .Add(hTransform->GetCropMarginLScale()).Add(hTransform->GetCropMarginTScale())
+                .Add(hTransform->GetCropMarginRScale()).Add(hTransform->GetCropMarginBScale())
+                .Add(hTransform->GetRotationAngle()).Add(hTransform->GetScaleH()).Add(hTransform->GetScaleV());
+            // the key points override the parameters above, their values at this frame are what the frame depends on
+            auto pKeyPoints = hTransform->GetKeyPoint();
+            const int64_t clipPos = pos-hClip->Start();
+            hasher.Add(pKeyPoints->GetCurveCount());
+            for (int i = 0; i < pKeyPoints->GetCurveCount(); i++)
+                hasher.Add(pKeyPoints->GetCurveName(i)).Add(pKeyPoints->GetValue(i, clipPos));
+        }
+    }
+
+    bool IsClipCoveringOutput(const VideoClip::Holder& hClip)
+    {
+        if (!hClip->IsOpaque())
+            return false;
+        int32_t x, y;
+        uint32_t w, h;
+        if (!hClip->GetTransformFilter()->CalcOutputRect(x, y, w, h))
+            return false;
+        return x <= 0 && y <= 0 && x+(int64_t)w >= m_outWidth && y+(int64_t)h >= m_outHeight;
     }
 
 private:
+    // range around the read position in which the clips are sought, it must be larger than the clip wakeup range
+    static const int64_t CLIP_SEEK_RANGE = 2000;
+    // range around the read position in which the clips are notified, it must be larger than the clip release range
+    static const int64_t CLIP_RELEASE_NOTIFY_RANGE = 4000;
+
     recursive_mutex m_apiLock;
     int64_t m_id;
     uint32_t m_outWidth;
@@ -585,10 +739,23 @@ private:
     list<VideoClip::Holder>::iterator m_readClipIter;
     list<VideoOverlap::Holder> m_overlaps;
     list<VideoOverlap::Holder>::iterator m_readOverlapIter;
+    TimelineIndex<VideoClip::Holder> m_clipIndex;
+    TimelineIndex<VideoOverlap::Holder> m_overlapIndex;
+    vector<size_t> m_queryResult;
+    vector<VideoClip::Holder> m_notifiedClips;
+    uint32_t m_seekSerial{0};
     int64_t m_readFrames{0};
     int64_t m_duration{0};
     bool m_readForward{true};
     bool m_visible{true};
+    bool m_readFrameOpaque{false};
+    int64_t m_invalidStart{INT64_MAX};
+    int64_t m_invalidEnd{INT64_MIN};
+    uint32_t m_contentRevision{0};
+    unordered_map<int64_t, uint32_t> m_clipRevisions;
+    unordered_map<int64_t, uint32_t> m_overlapRevisions;
+    unordered_map<const void*, pair<weak_ptr<void>, uint64_t>> m_objectIds;
+    uint64_t m_objectIdCounter{0};
 };
 
 static const auto VIDEO_TRACK_HOLDER_DELETER = [] (VideoTrack* p) {
@@ -18,6 +18,7 @@
 #pragma once
 #include "VideoTransformFilter.h"
 #include <mutex>
+#include <cmath>
 
 namespace MediaCore
 {
@@ -315,6 +316,62 @@ namespace MediaCore
         float GetCropMarginBScale() const override
         { return m_fcropB; }
 
+        bool CalcOutputRect(int32_t& x, int32_t& y, uint32_t& w, uint32_t& h) override
+        {
+            std::lock_guard<std::recursive_mutex> lk(m_processLock);
+            // the rectangle is unknown before any input is processed, or if it's animated by the key points or rotated
+            if (m_inWidth == 0 || m_inHeight == 0 || m_outWidth == 0 || m_outHeight == 0)
+                return false;
+            if (m_keyPoints.GetCurveCount() > 0 || std::fmod(m_rotateAngle, 360.) != 0)
+                return false;
+            double fitScaleWidth{(double)m_inWidth}, fitScaleHeight{(double)m_inHeight};
+            const bool inputIsWider = (uint64_t)m_inWidth*m_outHeight > (uint64_t)m_inHeight*m_outWidth;
+            switch (m_scaleType)
+            {
+                case SCALE_TYPE__FIT:
+                case SCALE_TYPE__FILL:
+                if (inputIsWider == (m_scaleType == SCALE_TYPE__FIT))
+                {
+                    fitScaleWidth = m_outWidth;
+                    fitScaleHeight = std::round((double)m_inHeight*m_outWidth/m_inWidth);
+                }
+                else
+                {
+                    fitScaleHeight = m_outHeight;
+                    fitScaleWidth = std::round((double)m_inWidth*m_outHeight/m_inHeight);
+                }
+                break;
+                case SCALE_TYPE__CROP:
+                break;
+                case SCALE_TYPE__STRETCH:
+                fitScaleWidth = m_outWidth;
+                fitScaleHeight = m_outHeight;
+                break;
+            }
+            const double ratioH = fitScaleWidth/m_inWidth*m_scaleRatioH;
+            const double ratioV = fitScaleHeight/m_inHeight*m_scaleRatioV;
+            if (ratioH <= 0 || ratioV <= 0)
+                return false;
+            const double posOffH = m_needUpdatePositionParamScale ? (double)(int32_t)(m_fposOffsetH*m_outWidth) : m_posOffsetH;
+            const double posOffV = m_needUpdatePositionParamScale ? (double)(int32_t)(m_fposOffsetV*m_outHeight) : m_posOffsetV;
+            double cropL = m_needUpdateCropParamScale ? (double)(uint32_t)(m_inWidth*m_fcropL) : m_cropL;
+            double cropR = m_needUpdateCropParamScale ? (double)(uint32_t)(m_inWidth*m_fcropR) : m_cropR;
+            double cropT = m_needUpdateCropParamScale ? (double)(uint32_t)(m_inHeight*m_fcropT) : m_cropT;
+            double cropB = m_needUpdateCropParamScale ? (double)(uint32_t)(m_inHeight*m_fcropB) : m_cropB;
+            const double x0 = ((double)m_outWidth-m_inWidth*ratioH)/2+posOffH;
+            const double y0 = ((double)m_outHeight-m_inHeight*ratioV)/2+posOffV;
+            const double l = x0+cropL*ratioH, r = x0+((double)m_inWidth-cropR)*ratioH;
+            const double t = y0+cropT*ratioV, b = y0+((double)m_inHeight-cropB)*ratioV;
+            // rounded inward, so the rectangle never claims more than the area really covered by the image
+            const double rx = std::ceil(l), ry = std::ceil(t);
+            const double rw = std::floor(r)-rx, rh = std::floor(b)-ry;
+            if (rw <= 0 || rh <= 0)
+                return false;
+            x = (int32_t)rx; y = (int32_t)ry;
+            w = (uint32_t)rw; h = (uint32_t)rh;
+            return true;
+        }
+
         std::string GetError() const override
         { return m_errMsg; }
 
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include "AudioEffectFilter.h"
+#include "Logger.h"
+
+using namespace std;
+using namespace Logger;
+using namespace MediaCore;
+
+static const uint32_t SAMPLE_RATE = 48000;
+static const uint32_t CHANNELS = 2;
+static const int FRAME_SIZE = 1024;
+
+static ImGui::ImMat MakeFrame(int64_t index, float level)
+{
+    ImGui::ImMat m;
+    m.create_type(FRAME_SIZE, 1, (int)CHANNELS, IM_DT_FLOAT32);
+    m.elempack = 1;
+    m.flags = IM_MAT_FLAGS_AUDIO_FRAME;
+    m.rate = { (int)SAMPLE_RATE, 1 };
+    m.time_stamp = (double)index*FRAME_SIZE/SAMPLE_RATE;
+    float* data = (float*)m.data;
+    for (size_t i = 0; i < (size_t)FRAME_SIZE*CHANNELS; i++)
+        data[i] = level;
+    return m;
+}
+
+// With neutral parameters, the input frame must come out as the same buffer. Then a volume ramp is started on
+// a constant signal, the output of channel 0 must move to the target without any step larger than a ramp step.
+static bool TestFilter(AudioEffectFilter::Backend backendType)
+{
+    const string backend = backendType == AudioEffectFilter::BACKEND_NATIVE ? "native" : "FFmpeg";
+    auto hFilter = AudioEffectFilter::CreateInstance("AEFilterTest", backendType);
+    const uint32_t composeFlags = AudioEffectFilter::VOLUME|AudioEffectFilter::PAN|AudioEffectFilter::EQUALIZER
+            |AudioEffectFilter::GATE|AudioEffectFilter::COMPRESSOR;
+    if (!hFilter->Init(composeFlags, "fltp", CHANNELS, SAMPLE_RATE))
+    {
+        Log(Error) << "[" << backend << "] FAILED to initialize AudioEffectFilter! Error is '" << hFilter->GetError() << "'." << endl;
+        return false;
+    }
+
+    // 0.5 is below the knee of the default compressor parameters
+    const float level = 0.5f;
+    int64_t frameIndex = 0;
+    for (; frameIndex < 10; frameIndex++)
+    {
+        ImGui::ImMat in = MakeFrame(frameIndex, level);
+        list<ImGui::ImMat> out;
+        if (!hFilter->ProcessData(in, out))
+        {
+            Log(Error) << "[" << backend << "] FAILED to process data! Error is '" << hFilter->GetError() << "'." << endl;
+            return false;
+        }
+        if (out.size() != 1 || out.front().data != in.data)
+        {
+            Log(Error) << "[" << backend << "] Frame #" << frameIndex << " of the neutral filter is NOT the input buffer." << endl;
+            return false;
+        }
+    }
+
+    const float targetVolume = 0.25f;
+    const uint32_t rampSamples = 4800;
+    AudioEffectFilter::VolumeParams volParams;
+    volParams.volume = targetVolume;
+    volParams.rampSamples = rampSamples;
+    volParams.rampCurve = AudioEffectFilter::RAMP_LINEAR;
+    hFilter->SetVolumeParams(&volParams);
+    const float rampStep = level*(1.f-targetVolume)/rampSamples;
+    vector<float> samples;
+    for (int i = 0; i < 10; i++, frameIndex++)
+    {
+        ImGui::ImMat in = MakeFrame(frameIndex, level);
+        list<ImGui::ImMat> out;
+        if (!hFilter->ProcessData(in, out))
+        {
+            Log(Error) << "[" << backend << "] FAILED to process data! Error is '" << hFilter->GetError() << "'." << endl;
+            return false;
+        }
+        for (auto& m : out)
+        {
+            const float* data = (const float*)m.data;
+            samples.insert(samples.end(), data, data+m.w);
+        }
+    }
+    if (samples.size() <= rampSamples)
+    {
+        Log(Error) << "[" << backend << "] Only " << samples.size() << " samples are output during the ramp." << endl;
+        return false;
+    }
+    float prev = level, maxStep = 0;
+    for (auto s : samples)
+    {
+        maxStep = max(maxStep, fabs(s-prev));
+        prev = s;
+    }
+    const float finalLevel = samples.back();
+    Log(INFO) << "[" << backend << "] Volume ramp: max step " << maxStep << ", ramp step " << rampStep << ", final level " << finalLevel << "." << endl;
+    if (maxStep > rampStep*1.01f+1e-6f)
+    {
+        Log(Error) << "[" << backend << "] The volume ramp has a step of " << maxStep << "." << endl;
+        return false;
+    }
+    if (fabs(finalLevel-level*targetVolume) > 1e-4f)
+    {
+        Log(Error) << "[" << backend << "] The volume ramp ends at " << finalLevel << ", " << level*targetVolume << " is expected." << endl;
+        return false;
+    }
+    return true;
+}
+
+// Usage: AudioEffectFilterTest
+int main(int argc, const char* argv[])
+{
+    GetDefaultLogger()->SetShowLevels(DEBUG);
+    AudioEffectFilter::GetLogger()->SetShowLevels(DEBUG);
+
+    bool success = TestFilter(AudioEffectFilter::BACKEND_FFMPEG);
+    success = TestFilter(AudioEffectFilter::BACKEND_NATIVE) && success;
+
+    Log(INFO) << (success ? "PASSED." : "FAILED.") << endl;
+    return success ? 0 : -1;
+}
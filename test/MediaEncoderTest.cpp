@@ -1,8 +1,14 @@
 #include <iostream>
 #include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include "MediaParser.h"
 #include "MediaReader.h"
 #include "MediaEncoder.h"
+#include "MultiTrackVideoReader.h"
+#include "MultiTrackAudioReader.h"
+#include "MultiTrackExporter.h"
 #include "Logger.h"
 
 using namespace std;
@@ -16,8 +22,261 @@ struct MediaHandlers
     MediaEncoder::Holder hEncoder;
 };
 
+static const uint32_t BENCH_OUT_WIDTH{1920}, BENCH_OUT_HEIGHT{1080};
+static const Ratio BENCH_OUT_FRAMERATE = { 25, 1 };
+static const uint32_t BENCH_OUT_CHANNELS = 2;
+static const uint32_t BENCH_OUT_SAMPLERATE = 44100;
+
+// A synthetic timeline is built with 'trackCount' video and audio tracks, each track is filled with clips cut from
+// the source file and the upper video tracks are scaled down, so that mixing, transitions and transforms are all
+// involved. The readers are set up in offline mode.
+static int BuildBenchTimeline(MediaParser::Holder hParser, int trackCount, double exportDuration,
+        MultiTrackVideoReader::Holder hMtvReader, MultiTrackAudioReader::Holder hMtaReader, bool& hasVideo, bool& hasAudio)
+{
+    const int64_t clipLength = 4000;
+    const int64_t clipOverlap = 500;
+    const int64_t srcDuration = (int64_t)(hParser->GetMediaInfo()->duration*1000);
+    if (srcDuration < clipLength)
+    {
+        Log(Error) << "Source file is too short, at least " << clipLength << "ms is required." << endl;
+        return -1;
+    }
+    hasVideo = hParser->GetBestVideoStreamIndex() >= 0;
+    hasAudio = hParser->GetBestAudioStreamIndex() >= 0;
+
+    if (hasVideo && (!hMtvReader->Configure(BENCH_OUT_WIDTH, BENCH_OUT_HEIGHT, BENCH_OUT_FRAMERATE) || !hMtvReader->SetOfflineMode(true) || !hMtvReader->Start()))
+    {
+        Log(Error) << "FAILED to setup MultiTrackVideoReader! Error is '" << hMtvReader->GetError() << "'." << endl;
+        return -2;
+    }
+    if (hasAudio && (!hMtaReader->Configure(BENCH_OUT_CHANNELS, BENCH_OUT_SAMPLERATE) || !hMtaReader->SetOfflineMode(true) || !hMtaReader->Start()))
+    {
+        Log(Error) << "FAILED to setup MultiTrackAudioReader! Error is '" << hMtaReader->GetError() << "'." << endl;
+        return -3;
+    }
+    int64_t idIndex = 1;
+    for (int i = 0; i < trackCount; i++)
+    {
+        VideoTrack::Holder hVidTrack = hasVideo ? hMtvReader->AddTrack(idIndex++) : nullptr;
+        AudioTrack::Holder hAudTrack = hasAudio ? hMtaReader->AddTrack(idIndex++) : nullptr;
+        // clips are overlapped with each other to make transitions, and staggered among the tracks
+        int64_t start = i*clipOverlap;
+        int64_t startOffset = (i*clipLength)%(srcDuration-clipLength+1);
+        while (start < exportDuration*1000)
+        {
+            const int64_t endOffset = srcDuration-startOffset-clipLength;
+            if (hVidTrack)
+            {
+                auto hClip = hVidTrack->AddNewClip(idIndex++, hParser, start, startOffset, endOffset, 0);
+                if (i > 0)
+                {
+                    auto hTransform = hClip->GetTransformFilter();
+                    hTransform->SetScaleH(0.5);
+                    hTransform->SetScaleV(0.5);
+                    hTransform->SetPositionOffset((int32_t)(BENCH_OUT_WIDTH/8*i), (int32_t)(BENCH_OUT_HEIGHT/8*i));
+                }
+            }
+            if (hAudTrack)
+                hAudTrack->AddNewClip(idIndex++, hParser, start, startOffset, endOffset);
+            start += clipLength-clipOverlap;
+            startOffset = (startOffset+clipLength/2)%(srcDuration-clipLength+1);
+        }
+    }
+    if (hasVideo)
+        hMtvReader->Refresh();
+    if (hasAudio)
+        hMtaReader->Refresh();
+    return 0;
+}
+
+// Export benchmark: the synthetic timeline is rendered in offline mode and encoded into the output file.
+// Usage: MediaEncoderTest --bench <source file> <output file> [track count] [duration in seconds]
+static int RunExportBenchmark(int argc, const char* argv[])
+{
+    if (argc < 4)
+    {
+        Log(Error) << "Wrong arguments!" << endl;
+        return -1;
+    }
+    const string srcPath = argv[2];
+    const string outPath = argv[3];
+    const int trackCount = argc > 4 ? atoi(argv[4]) : 4;
+    const double exportDuration = argc > 5 ? atof(argv[5]) : 30;
+    const uint32_t outWidth{BENCH_OUT_WIDTH}, outHeight{BENCH_OUT_HEIGHT};
+    const Ratio outFrameRate = BENCH_OUT_FRAMERATE;
+    const uint32_t outAudChannels = BENCH_OUT_CHANNELS;
+    const uint32_t outSampleRate = BENCH_OUT_SAMPLERATE;
+
+    MediaParser::Holder hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(srcPath))
+    {
+        Log(Error) << "FAILED to open MediaParser by file '" << srcPath << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return -1;
+    }
+    auto hMtvReader = MultiTrackVideoReader::CreateInstance();
+    auto hMtaReader = MultiTrackAudioReader::CreateInstance();
+    bool hasVideo, hasAudio;
+    int ret = BuildBenchTimeline(hParser, trackCount, exportDuration, hMtvReader, hMtaReader, hasVideo, hasAudio);
+    if (ret != 0)
+        return ret;
+
+    auto hEncoder = MediaEncoder::CreateInstance();
+    if (!hEncoder->Open(outPath))
+    {
+        Log(Error) << "FAILED to open MediaEncoder by '" << outPath << "'! Error is '" << hEncoder->GetError() << "'." << endl;
+        return -4;
+    }
+    string vidEncImgFormat, audEncSmpFormat;
+    if (hasVideo && !hEncoder->ConfigureVideoStream("h264", vidEncImgFormat, outWidth, outHeight, outFrameRate, 10*1000*1000))
+    {
+        Log(Error) << "FAILED to configure video encoder! Error is '" << hEncoder->GetError() << "'." << endl;
+        return -5;
+    }
+    if (hasAudio && !hEncoder->ConfigureAudioStream("aac", audEncSmpFormat, outAudChannels, outSampleRate, 128*1000))
+    {
+        Log(Error) << "FAILED to configure audio encoder! Error is '" << hEncoder->GetError() << "'." << endl;
+        return -6;
+    }
+    hEncoder->Start();
+
+    auto t0 = chrono::steady_clock::now();
+    bool vidInputEof = !hasVideo;
+    bool audInputEof = !hasAudio;
+    double audpos = 0, vidpos = 0;
+    uint32_t vidFrameCount = 0;
+    ImGui::ImMat vmat, amat;
+    while (!vidInputEof || !audInputEof)
+    {
+        if ((!vidInputEof && vidpos <= audpos) || audInputEof)
+        {
+            vidpos = (double)vidFrameCount*outFrameRate.den/outFrameRate.num;
+            if (vidpos >= exportDuration)
+            {
+                vmat.release();
+                hEncoder->EncodeVideoFrame(vmat);
+                vidInputEof = true;
+                continue;
+            }
+            if (!hMtvReader->ReadVideoFrame((int64_t)(vidpos*1000), vmat))
+            {
+                Log(Error) << "FAILED to read video frame! Error is '" << hMtvReader->GetError() << "'." << endl;
+                break;
+            }
+            vmat.time_stamp = vidpos;
+            if (!hEncoder->EncodeVideoFrame(vmat))
+            {
+                Log(Error) << "FAILED to encode video frame! Error is '" << hEncoder->GetError() << "'." << endl;
+                break;
+            }
+            vidFrameCount++;
+        }
+        else
+        {
+            bool eof;
+            if (!hMtaReader->ReadAudioSamples(amat, eof))
+            {
+                Log(Error) << "FAILED to read audio samples! Error is '" << hMtaReader->GetError() << "'." << endl;
+                break;
+            }
+            audpos = amat.time_stamp;
+            if (eof || audpos >= exportDuration)
+            {
+                amat.release();
+                hEncoder->EncodeAudioSamples(nullptr, 0);
+                audInputEof = true;
+                continue;
+            }
+            if (!hEncoder->EncodeAudioSamples(amat))
+            {
+                Log(Error) << "FAILED to encode audio samples! Error is '" << hEncoder->GetError() << "'." << endl;
+                break;
+            }
+        }
+    }
+    hEncoder->FinishEncoding();
+    hEncoder->Close();
+    auto t1 = chrono::steady_clock::now();
+
+    const double elapsed = chrono::duration_cast<chrono::duration<double>>(t1-t0).count();
+    const double rendered = hasVideo ? (double)vidFrameCount*outFrameRate.den/outFrameRate.num : audpos;
+    Log(INFO) << "Export benchmark: " << trackCount << " track(s), " << rendered << "s rendered in " << elapsed << "s, "
+        << (elapsed > 0 ? vidFrameCount/elapsed : 0) << " fps, " << (elapsed > 0 ? rendered/elapsed : 0) << "x realtime." << endl;
+    hMtvReader->Close();
+    hMtaReader->Close();
+    return 0;
+}
+
+// Segment-parallel export benchmark: the synthetic timeline is exported by MultiTrackExporter, which renders and
+// encodes the video in 'segment count' segments in parallel, then concatenates them with the audio.
+// Usage: MediaEncoderTest --export <source file> <output file> [segment count] [track count] [duration in seconds] [smart]
+static int RunSegmentExportBenchmark(int argc, const char* argv[])
+{
+    if (argc < 4)
+    {
+        Log(Error) << "Wrong arguments!" << endl;
+        return -1;
+    }
+    const string srcPath = argv[2];
+    const string outPath = argv[3];
+    const uint32_t segmentCount = argc > 4 ? (uint32_t)atoi(argv[4]) : 0;
+    const int trackCount = argc > 5 ? atoi(argv[5]) : 4;
+    const double exportDuration = argc > 6 ? atof(argv[6]) : 30;
+    const bool smartRender = argc > 7 && strcmp(argv[7], "smart") == 0;
+
+    MediaParser::Holder hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(srcPath))
+    {
+        Log(Error) << "FAILED to open MediaParser by file '" << srcPath << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return -1;
+    }
+    auto hMtvReader = MultiTrackVideoReader::CreateInstance();
+    auto hMtaReader = MultiTrackAudioReader::CreateInstance();
+    bool hasVideo, hasAudio;
+    int ret = BuildBenchTimeline(hParser, trackCount, exportDuration, hMtvReader, hMtaReader, hasVideo, hasAudio);
+    if (ret != 0)
+        return ret;
+
+    MultiTrackExporter::VideoSettings vidSettings;
+    vidSettings.codecName = "h264";
+    vidSettings.width = BENCH_OUT_WIDTH;
+    vidSettings.height = BENCH_OUT_HEIGHT;
+    vidSettings.frameRate = BENCH_OUT_FRAMERATE;
+    vidSettings.bitRate = 10*1000*1000;
+    vidSettings.gopSize = 50;
+    MultiTrackExporter::AudioSettings audSettings;
+    audSettings.codecName = "aac";
+    audSettings.channels = BENCH_OUT_CHANNELS;
+    audSettings.sampleRate = BENCH_OUT_SAMPLERATE;
+    audSettings.bitRate = 128*1000;
+
+    auto hExporter = MultiTrackExporter::CreateInstance();
+    hExporter->EnableSmartRender(smartRender);
+    auto t0 = chrono::steady_clock::now();
+    const bool success = hExporter->Export(outPath, hasVideo ? hMtvReader : nullptr, vidSettings, hasAudio ? hMtaReader : nullptr, audSettings,
+            0, (int64_t)(exportDuration*1000), segmentCount);
+    auto t1 = chrono::steady_clock::now();
+    hMtvReader->Close();
+    hMtaReader->Close();
+    if (!success)
+    {
+        Log(Error) << "FAILED to export! Error is '" << hExporter->GetError() << "'." << endl;
+        return -4;
+    }
+
+    const double elapsed = chrono::duration_cast<chrono::duration<double>>(t1-t0).count();
+    const double frameCount = exportDuration*BENCH_OUT_FRAMERATE.num/BENCH_OUT_FRAMERATE.den;
+    Log(INFO) << "Segment export benchmark: " << trackCount << " track(s), " << (segmentCount > 0 ? to_string(segmentCount) : string("auto"))
+        << " segment(s), " << exportDuration << "s exported in " << elapsed << "s, " << (elapsed > 0 ? frameCount/elapsed : 0) << " fps, "
+        << (elapsed > 0 ? exportDuration/elapsed : 0) << "x realtime." << endl;
+    return 0;
+}
+
 int main(int argc, const char* argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+        return RunExportBenchmark(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--export") == 0)
+        return RunSegmentExportBenchmark(argc, argv);
     if (argc < 3)
     {
         Log(Error) << "Wrong arguments!" << endl;
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+#include "MediaParser.h"
+#include "MediaReader.h"
+#include "MediaRemuxer.h"
+#include "Logger.h"
+
+using namespace std;
+using namespace Logger;
+using namespace MediaCore;
+
+// Remux the range [start, end) (in millisecond) of the source file into the output file, then read the output back
+// and check that the video frames cover the range snapped to the key frames, with continuous timestamps from 0.
+// Usage: MediaRemuxerTest <source file> <output file> <start> <end>
+int main(int argc, const char* argv[])
+{
+    if (argc < 5)
+    {
+        Log(Error) << "Wrong arguments!" << endl;
+        return -1;
+    }
+    GetDefaultLogger()->SetShowLevels(DEBUG);
+    MediaRemuxer::GetLogger()->SetShowLevels(DEBUG);
+    const string srcPath = argv[1];
+    const string outPath = argv[2];
+    const int64_t start = atoll(argv[3]);
+    const int64_t end = atoll(argv[4]);
+
+    MediaParser::Holder hParser = MediaParser::CreateInstance();
+    if (!hParser->Open(srcPath))
+    {
+        Log(Error) << "FAILED to open MediaParser by file '" << srcPath << "'! Error is '" << hParser->GetError() << "'." << endl;
+        return -1;
+    }
+    auto vidStream = hParser->GetBestVideoStream();
+    if (!vidStream)
+    {
+        Log(Error) << "No video stream is found in file '" << srcPath << "'." << endl;
+        return -1;
+    }
+    // the range start is snapped backward to a key frame, the end forward
+    hParser->EnableParseInfo(MediaParser::VIDEO_SEEK_POINTS);
+    auto hSeekPoints = hParser->GetVideoSeekPoints(true);
+    double snappedStart = 0, snappedEnd = hParser->GetMediaInfo()->duration;
+    if (hSeekPoints)
+    {
+        for (int64_t pts : *hSeekPoints)
+        {
+            const double t = (double)pts*vidStream->timebase.num/vidStream->timebase.den-vidStream->startTime;
+            if (t <= (double)start/1000)
+                snappedStart = t;
+            if (t >= (double)end/1000 && t < snappedEnd)
+                snappedEnd = t;
+        }
+    }
+
+    auto hRemuxer = MediaRemuxer::CreateInstance();
+    if (!hRemuxer->Remux(hParser, outPath, {{start, end}}))
+    {
+        Log(Error) << "FAILED to remux! Error is '" << hRemuxer->GetError() << "'." << endl;
+        return -2;
+    }
+
+    MediaParser::Holder hOutParser = MediaParser::CreateInstance();
+    if (!hOutParser->Open(outPath))
+    {
+        Log(Error) << "FAILED to open MediaParser by file '" << outPath << "'! Error is '" << hOutParser->GetError() << "'." << endl;
+        return -3;
+    }
+    auto outVidStream = hOutParser->GetBestVideoStream();
+    if (!outVidStream || !Ratio::IsValid(outVidStream->avgFrameRate))
+    {
+        Log(Error) << "No valid video stream is found in the output file." << endl;
+        return -3;
+    }
+    const double frameRate = (double)outVidStream->avgFrameRate.num/outVidStream->avgFrameRate.den;
+    auto hReader = MediaReader::CreateInstance();
+    if (!hReader->Open(hOutParser) || !hReader->ConfigVideoReader(0.25f, 0.25f) || !hReader->Start())
+    {
+        Log(Error) << "FAILED to setup video MediaReader! Error is '" << hReader->GetError() << "'." << endl;
+        return -4;
+    }
+
+    // every frame must be read at its own position, a repeated timestamp means the end is reached
+    int64_t frameCount = 0;
+    double lastTs = -1;
+    bool success = true;
+    const int64_t maxFrames = (int64_t)ceil(outVidStream->duration*frameRate)+(int64_t)ceil(frameRate);
+    while (frameCount < maxFrames)
+    {
+        const double pos = (double)frameCount/frameRate;
+        ImGui::ImMat vmat;
+        bool eof = false;
+        if (!hReader->ReadVideoFrame(pos, vmat, eof) && !eof)
+        {
+            Log(Error) << "FAILED to read video frame! Error is '" << hReader->GetError() << "'." << endl;
+            success = false;
+            break;
+        }
+        if (eof || vmat.time_stamp <= lastTs)
+            break;
+        if (fabs(vmat.time_stamp-pos) > 0.5/frameRate)
+        {
+            Log(Error) << "Frame #" << frameCount << " has timestamp " << vmat.time_stamp << ", " << pos << " is expected." << endl;
+            success = false;
+            break;
+        }
+        lastTs = vmat.time_stamp;
+        frameCount++;
+    }
+    hReader->Close();
+
+    // the end can be moved further if the key frame at it starts an open GOP
+    const int64_t minFrames = llround((snappedEnd-snappedStart)*frameRate);
+    const int64_t outFrames = llround(outVidStream->duration*frameRate);
+    Log(INFO) << "Remuxed [" << start << ", " << end << ") snapped to [" << snappedStart << ", " << snappedEnd << "), "
+        << frameCount << " frames are read, the output duration is " << outVidStream->duration << "s." << endl;
+    if (success && (frameCount < minFrames || frameCount != outFrames))
+    {
+        Log(Error) << "Frame count mismatch! At least " << minFrames << " frames are expected, the output stream has " << outFrames << "." << endl;
+        success = false;
+    }
+    Log(INFO) << (success ? "PASSED." : "FAILED.") << endl;
+    return success ? 0 : -5;
+}
@@ -11,6 +11,7 @@
 #include <vector>
 #include <cmath>
 #include <chrono>
+#include <thread>
 #include "MultiTrackAudioReader.h"
 #include "AudioRender.h"
 #include "FFUtils.h"
@@ -38,7 +39,7 @@ const string c_bookmarkPath = "bookmark.ini";
 class SimplePcmStream : public AudioRender::ByteStream
 {
 public:
-    SimplePcmStream(MultiTrackAudioReader::Holder audrdr) : m_audrdr(audrdr) {}
+    SimplePcmStream(MultiTrackAudioReader::Holder audrdr, bool updatePos = true) : m_audrdr(audrdr), m_updatePos(updatePos) {}
 
     uint32_t Read(uint8_t* buff, uint32_t buffSize, bool blocking) override
     {
@@ -64,7 +65,8 @@ public:
                 bool eof;
                 if (!m_audrdr->ReadAudioSamples(amat, eof))
                     return 0;
-                g_audPos = amat.time_stamp;
+                if (m_updatePos)
+                    g_audPos = amat.time_stamp;
                 m_amat = amat;
                 m_readPosInAmat = 0;
             }
@@ -86,12 +88,66 @@ public:
 
 private:
     MultiTrackAudioReader::Holder m_audrdr;
+    bool m_updatePos;
     ImGui::ImMat m_amat;
     uint32_t m_readPosInAmat{0};
     std::mutex m_amatLock;
 };
 static SimplePcmStream* g_pcmStream = nullptr;
 
+// Measure the seek-to-audible latency of the low-latency mode. A clone of the reader with small frames is played by
+// a null render, which pulls the samples at the real-time pace without an output device. It's sought to a few positions,
+// the render is flushed after each seek, and the time to the first non-silent sample being played is reported.
+static void MeasureSeekToAudibleLatency()
+{
+    const uint32_t samplesPerFrame = 256;
+    const int64_t dur = g_mtAudReader->Duration();
+    if (dur <= 0)
+    {
+        Log(Error) << "No audio to measure the seek-to-audible latency with." << endl;
+        return;
+    }
+    auto hReader = g_mtAudReader->CloneAndConfigure(c_audioRenderChannels, c_audioRenderSampleRate, samplesPerFrame);
+    if (!hReader)
+    {
+        Log(Error) << "FAILED to clone MultiTrackAudioReader! Message is '" << g_mtAudReader->GetError() << "'." << endl;
+        return;
+    }
+    if (!hReader->SetLowLatencyMode(true))
+    {
+        Log(Error) << "FAILED to enable low-latency mode! Message is '" << hReader->GetError() << "'." << endl;
+        return;
+    }
+    SimplePcmStream pcmStream(hReader, false);
+    AudioRender* audrnd = AudioRender::CreateNullInstance();
+    if (!audrnd->OpenDevice(c_audioRenderSampleRate, c_audioRenderChannels, c_audioRenderFormat, &pcmStream, samplesPerFrame))
+    {
+        Log(Error) << "FAILED to open the null audio render! Message is '" << audrnd->GetError() << "'." << endl;
+        AudioRender::ReleaseInstance(&audrnd);
+        return;
+    }
+    audrnd->Resume();
+
+    const int measureCount = 4;
+    for (int i = 0; i < measureCount; i++)
+    {
+        const int64_t seekPos = dur*(i+1)/(measureCount+1);
+        hReader->SeekTo(seekPos);
+        audrnd->Flush();
+        const auto startTime = Clock::now();
+        int64_t latency = -1;
+        while ((latency = audrnd->GetFlushToAudibleLatency()) < 0 && Clock::now()-startTime < chrono::seconds(2))
+            this_thread::sleep_for(chrono::milliseconds(1));
+        if (latency < 0)
+            Log(WARN) << "Seek to " << seekPos << "ms: no audible sample in 2 seconds." << endl;
+        else
+            Log(INFO) << "Seek to " << seekPos << "ms: flush-to-audible latency is " << (double)latency/1000 << "ms." << endl;
+    }
+
+    audrnd->CloseDevice();
+    AudioRender::ReleaseInstance(&audrnd);
+}
+
 
 // Application Framework Functions
 static void MultiTrackAudioReader_Initialize(void** handle)
@@ -600,6 +656,11 @@ static bool MultiTrackAudioReader_Frame(void * handle, bool app_will_quit)
             g_playForward = notForward;
         }
 
+        ImGui::SameLine();
+
+        if (ImGui::Button("Measure Seek Latency"))
+            MeasureSeekToAudibleLatency();
+
         ImGui::Spacing();
 
         ostringstream oss;
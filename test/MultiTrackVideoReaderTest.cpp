@@ -255,7 +255,7 @@ static bool MultiTrackVideoReader_Frame(void * handle, bool app_will_quit)
             VideoTrack::Holder hTrack = g_mtVidReader->GetTrackByIndex(s_clipOpTrackSelIdx);
             VideoClip::Holder hClip = hTrack->GetClipByIndex(s_clipOpClipSelIdx);
             hTrack->MoveClip(hClip->Id(), (int64_t)(s_changeClipStart*1000));
-            g_mtVidReader->Refresh();
+            g_mtVidReader->RefreshInvalidRanges();
         }
         ImGui::EndDisabled();
         ImGui::SameLine(0, 20);
@@ -275,7 +275,7 @@ static bool MultiTrackVideoReader_Frame(void * handle, bool app_will_quit)
             VideoTrack::Holder hTrack = g_mtVidReader->GetTrackByIndex(s_clipOpTrackSelIdx);
             VideoClip::Holder hClip = hTrack->GetClipByIndex(s_clipOpClipSelIdx);
             hTrack->ChangeClipRange(hClip->Id(), (int64_t)(s_changeClipStartOffset*1000), (int64_t)(s_changeClipEndOffset*1000));
-            g_mtVidReader->Refresh();
+            g_mtVidReader->RefreshInvalidRanges();
         }
         ImGui::EndDisabled();
 
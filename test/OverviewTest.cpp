@@ -5,6 +5,7 @@
 #include <ImGuiFileDialog.h>
 #include <string>
 #include <sstream>
+#include <cmath>
 #include "Overview.h"
 #include "FFUtils.h"
 #include "Logger.h"
@@ -51,6 +52,10 @@ static void MediaOverview_Initialize(void** handle)
     // g_movr->SetSnapshotSize(320, 180);
     g_movr->EnableHwAccel(true);
     g_movr->SetSnapshotResizeFactor(0.1, 0.1);
+    g_movr->SetVideoDecoderCount(4);
+    g_movr->EnableSidecarCache(true);
+    g_movr->EnableAudioAnalysis(true);
+    g_movr->EnableSceneAnalysis(true);
     // g_movr->SetSnapshotResizeFactor(0.5f, 0.5f);
     // g_movr2 = CreateMediaOverview();
     // g_movr2->SetSnapshotSize(320, 180);
@@ -99,6 +104,10 @@ static bool MediaOverview_Frame(void * handle, bool app_will_quit)
 
         ImGui::Spacing();
 
+        Overview::SceneAnalysis::Holder hScene = g_movr->GetSceneAnalysis();
+        if (hScene && !hScene->sceneChangeScore.empty())
+            ImGui::PlotHistogram("Scene change", hScene->sceneChangeScore.data(), (int)hScene->sceneChangeScore.size(), 0, nullptr, 0.f, 1.f, ImVec2(io.DisplaySize.x, 40));
+
         Overview::Waveform::Holder hWaveform = g_movr->GetWaveform();
         double startPos = 0;
         double windowSize = 0;
@@ -115,6 +124,11 @@ static bool MediaOverview_Frame(void * handle, bool app_will_quit)
             ImGui::PushStyleColor(ImGuiCol_PlotLines, ImVec4(0.f, 1.f,0.f, 1.f));
             ImGui::PlotLinesEx("Waveform", hWaveform->pcm[0].data()+startOff, windowLen, 0, nullptr, -verticalMax, verticalMax, ImVec2(io.DisplaySize.x, 160), sizeof(float), false);
             ImGui::PopStyleColor();
+            ImGui::Text("Waveform: %u/%d samples generated", g_movr->GetWaveformValidSampleCount(), sampleSize);
+            Overview::AudioAnalysis::Holder hAnalysis = g_movr->GetAudioAnalysis();
+            if (hAnalysis)
+                ImGui::Text("Loudness: integrated %.1f LUFS, max short-term %.1f LUFS, true-peak %.1f dBTP",
+                        hAnalysis->integratedLoudness, hAnalysis->maxShortTermLoudness, 20*log10(hAnalysis->truePeak));
         }
 
         ImGui::Spacing();
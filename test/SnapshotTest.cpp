@@ -4,6 +4,10 @@
 #include <ImGuiFileDialog.h>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
 #include "Overview.h"
 #include "Snapshot.h"
 #include "FFUtils.h"
@@ -21,9 +25,73 @@ static double g_windowPos = 0.f;
 static double g_windowSize = 300.f;
 static double g_windowFrames = 14.0f;
 ImVec2 g_snapImageSize;
+static string g_filePath;
+static thread g_benchThread;
+static atomic_bool g_benchRunning{false};
+static string g_benchResult;
+static mutex g_benchResultLock;
 const string c_imguiIniPath = "ms_test.ini";
 const string c_bookmarkPath = "bookmark.ini";
 
+// Measure the filmstrip generation throughput with different decoder counts
+static void RunFilmstripBenchmark(string filePath)
+{
+    const double benchFrames = 200;
+    const uint32_t decoderCounts[] = { 1, 2, 4, 8, 16 };
+    int showLevelCnt;
+    Level origShowLevel = Snapshot::GetLogger()->GetShowLevels(showLevelCnt);
+    Snapshot::GetLogger()->SetShowLevels(WARN);
+    ostringstream oss;
+    for (auto decCnt : decoderCounts)
+    {
+        auto hSsgen = Snapshot::Generator::CreateInstance();
+        hSsgen->SetSnapshotResizeFactor(0.25f, 0.25f);
+        hSsgen->SetCacheFactor(1);
+        hSsgen->SetVideoDecoderCount(decCnt);
+        if (!hSsgen->Open(filePath))
+        {
+            oss << "FAILED to open '" << filePath << "'! Error is '" << hSsgen->GetError() << "'." << endl;
+            break;
+        }
+        auto hViewer = hSsgen->CreateViewer(0);
+        double wndSize = (double)hSsgen->GetVideoDuration()/1000.;
+        auto t0 = GetTimePoint();
+        hSsgen->ConfigSnapWindow(wndSize, benchFrames);
+        vector<Snapshot::Image::Holder> snapshots;
+        size_t readyCnt = 0;
+        while (true)
+        {
+            if (hViewer->GetSnapshots(0, snapshots))
+            {
+                readyCnt = count_if(snapshots.begin(), snapshots.end(), [] (const Snapshot::Image::Holder& hImg) {
+                    return !hImg->mImgMat.empty();
+                });
+                if (!snapshots.empty() && readyCnt == snapshots.size())
+                    break;
+            }
+            if (CountElapsedMillisec(t0, GetTimePoint()) > 300000)
+                break;
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        auto elapsedMs = CountElapsedMillisec(t0, GetTimePoint());
+        oss << "decoders=" << decCnt << ": " << readyCnt << "/" << snapshots.size() << " snapshots in " << elapsedMs << "ms, "
+            << (elapsedMs > 0 ? (double)readyCnt*1000/elapsedMs : 0.) << " snapshots/s" << endl;
+        hSsgen->ReleaseViewer(hViewer);
+        hSsgen = nullptr;
+        {
+            lock_guard<mutex> lk(g_benchResultLock);
+            g_benchResult = oss.str();
+        }
+    }
+    Snapshot::GetLogger()->SetShowLevels(origShowLevel, showLevelCnt);
+    Log(INFO) << "Filmstrip benchmark on '" << filePath << "':" << endl << oss.str();
+    {
+        lock_guard<mutex> lk(g_benchResultLock);
+        g_benchResult = oss.str();
+    }
+    g_benchRunning = false;
+}
+
 // Application Framework Functions
 static void MediaSnapshot_Initialize(void** handle)
 {
@@ -60,6 +128,8 @@ static void MediaSnapshot_Initialize(void** handle)
 
 static void MediaSnapshot_Finalize(void** handle)
 {
+    if (g_benchThread.joinable())
+        g_benchThread.join();
     g_ssgen->ReleaseViewer(g_ssvw1);
     g_ssgen = nullptr;
     g_movr = nullptr;
@@ -95,6 +165,40 @@ static bool MediaSnapshot_Frame(void * handle, bool app_will_quit)
         ImGui::SameLine();
         if (ImGui::Button("Refresh snapwnd configuration"))
             g_ssgen->ConfigSnapWindow(g_windowSize, g_windowFrames, true);
+        ImGui::SameLine();
+        bool keyFrameSnap = g_ssgen->IsKeyFrameSnapEnabled();
+        if (ImGui::Checkbox("Key-frame snap", &keyFrameSnap))
+            g_ssgen->EnableKeyFrameSnap(keyFrameSnap);
+        if (g_ssgen->IsKeyFrameSnapActive())
+        {
+            ImGui::SameLine();
+            ImGui::TextUnformatted("(active)");
+        }
+        ImGui::SameLine();
+        int decoderCount = (int)g_ssgen->GetVideoDecoderCount();
+        ImGui::PushItemWidth(100);
+        if (ImGui::InputInt("Decoders", &decoderCount) && decoderCount > 0)
+            g_ssgen->SetVideoDecoderCount((uint32_t)decoderCount);
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        ImGui::BeginDisabled(g_benchRunning || g_filePath.empty());
+        if (ImGui::Button("Filmstrip benchmark"))
+        {
+            if (g_benchThread.joinable())
+                g_benchThread.join();
+            g_benchRunning = true;
+            g_benchThread = thread(RunFilmstripBenchmark, g_filePath);
+        }
+        ImGui::EndDisabled();
+        {
+            lock_guard<mutex> lk(g_benchResultLock);
+            if (!g_benchResult.empty())
+                ImGui::TextUnformatted(g_benchResult.c_str());
+        }
+        auto cacheStats = g_ssgen->GetCacheStatistics();
+        ImGui::Text("Cache memory: %.2f MB (budget %.2f MB), hit=%llu, miss=%llu, evicted=%llu",
+            (double)cacheStats.memoryUsage/1024/1024, (double)cacheStats.memoryBudget/1024/1024, (unsigned long long)cacheStats.hitCount,
+            (unsigned long long)cacheStats.missCount, (unsigned long long)cacheStats.evictionCount);
 
         ImGui::Spacing();
 
@@ -171,6 +275,7 @@ static bool MediaSnapshot_Frame(void * handle, bool app_will_quit)
             // g_movr->GetMediaParser()->EnableParseInfo(MediaParser::VIDEO_SEEK_POINTS);
             // g_ssgen->Open(g_movr->GetMediaParser());
             g_ssgen->Open(filePathName);
+            g_filePath = filePathName;
             g_windowPos = (float)g_ssgen->GetVideoMinPos()/1000.f;
             g_windowSize = (float)g_ssgen->GetVideoDuration()/10000.f;
             g_ssgen->ConfigSnapWindow(g_windowSize, g_windowFrames);